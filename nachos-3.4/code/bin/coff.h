@@ -47,3 +47,39 @@ struct scnhdr {
         long            s_flags;        /* flags */
       };
  
+
+/* The symbolic header, at f_symptr, and the external symbols it
+ * lists (cf. <syms.h> on a MIPS system, where these are HDRR and
+ * EXTR).  Only what bin/profsym needs to find each function.
+ */
+typedef struct symhdr {
+        short   magic;          /* 0x7009                               */
+        short   vstamp;         /* version stamp                        */
+        long    ilineMax, cbLine, cbLineOffset;	/* line numbers */
+        long    idnMax, cbDnOffset;	/* dense numbers */
+        long    ipdMax, cbPdOffset;	/* procedure descriptors */
+        long    isymMax, cbSymOffset;	/* local symbols */
+        long    ioptMax, cbOptOffset;	/* optimization symbols */
+        long    iauxMax, cbAuxOffset;	/* auxiliary symbols */
+        long    issMax, cbSsOffset;	/* local strings */
+        long    issExtMax, cbSsExtOffset;	/* external strings */
+        long    ifdMax, cbFdOffset;	/* file descriptors */
+        long    crfd, cbRfdOffset;	/* relative file descriptors */
+        long    iextMax, cbExtOffset;	/* external symbols */
+      } SYMHDR;
+
+typedef struct extsym {
+        short   flags;          /* jmptbl, cobol_main, weakext          */
+        short   ifd;            /* file it is defined in                */
+        long    iss;            /* name, in the external strings        */
+        long    value;          /* address, for a procedure             */
+        unsigned long bits;     /* st:6, sc:5, reserved:1, index:20,
+                                   from the low bit up                  */
+      } EXTSYM;
+
+#define SymType(e)	((e)->bits & 0x3f)
+#define SymClass(e)	(((e)->bits >> 6) & 0x1f)
+
+#define stProc          6       /* a global procedure                   */
+#define stStaticProc    14      /* a static one                         */
+#define scText          1       /* in the text section                  */
@@ -15,6 +15,13 @@
  *	.data	-- initialized data
  *	.bss/.sbss -- uninitialized data (should be zero'd on program startup)
  *
+ * Normally the segments are packed one after the other in the NOFF file.
+ * With "-a align", each one starts at a multiple of "align" in the file,
+ * and must also start at one in memory (link with test/script.paged),
+ * so that with pages of "align" bytes or smaller, no page holds both
+ * code and data: Nachos can then share the code pages between
+ * instances of a program, and read each page with one request.
+ *
  * Copyright (c) 1992-1993 The Regents of the University of California.
  * All rights reserved.  See copyright.h for copyright notice and limitation 
  * of liability and disclaimer of warranty provisions.
@@ -69,6 +76,7 @@ ShortToHost(unsigned short shortword) {
 
 extern void *malloc();
 char *noffFileName = NULL;
+int align = 0;			/* segment alignment, with -a */
 
 /* read and check for error */
 void Read(int fd, char *buf, int nBytes)
@@ -80,6 +88,24 @@ void Read(int fd, char *buf, int nBytes)
     }
 }
 
+/* with -a, move the output to the next multiple of "align", after
+ * checking that the segment at "virtualAddr" is aligned in memory too
+ */
+int Align(int fd, int inNoffFile, int virtualAddr, char *name)
+{
+    if (align == 0)
+	return inNoffFile;
+    if (virtualAddr % align != 0) {
+	fprintf(stderr, "Segment %s at 0x%x is not aligned to 0x%x\n",
+		name, virtualAddr, align);
+	unlink(noffFileName);
+	exit(1);
+    }
+    inNoffFile = (inNoffFile + align - 1) / align * align;
+    lseek(fd, inNoffFile, 0);
+    return inNoffFile;
+}
+
 /* write and check for error */
 void Write(int fd, char *buf, int nBytes)
 {
@@ -99,8 +125,13 @@ main (int argc, char **argv)
     char *buffer;
     NoffHeader noffH;
 
-    if (argc < 2) {
-	fprintf(stderr, "Usage: %s <coffFileName> <noffFileName>\n", argv[0]);
+    if (argc > 2 && !strcmp(argv[1], "-a")) {
+	align = atoi(argv[2]);
+	argc -= 2;
+	argv += 2;
+    }
+    if (argc < 3 || align < 0) {
+	fprintf(stderr, "Usage: coff2noff [-a align] <coffFileName> <noffFileName>\n");
 	exit(1);
     }
     
@@ -169,6 +200,8 @@ main (int argc, char **argv)
 	if (sections[i].s_size == 0) {
 		/* do nothing! */	
 	} else if (!strcmp(sections[i].s_name, ".text")) {
+	    inNoffFile = Align(fdOut, inNoffFile, sections[i].s_paddr,
+				sections[i].s_name);
 	    noffH.code.virtualAddr = sections[i].s_paddr;
 	    noffH.code.inFileAddr = inNoffFile;
 	    noffH.code.size = sections[i].s_size;
@@ -187,6 +220,8 @@ main (int argc, char **argv)
 	        unlink(noffFileName);
 	        exit(1);
 	    }
+	    inNoffFile = Align(fdOut, inNoffFile, sections[i].s_paddr,
+				sections[i].s_name);
 	    noffH.initData.virtualAddr = sections[i].s_paddr;
 	    noffH.initData.inFileAddr = inNoffFile;
 	    noffH.initData.size = sections[i].s_size;
@@ -0,0 +1,246 @@
+/* profsym.c
+ *
+ * This program reads the PC samples a Nachos process wrote (with
+ * "nachos -prof n", to prof.<pid>), and the COFF file the program
+ * was built from, and prints where the program spent its time:
+ *
+ *	profsym coff-file profile	-- samples in each function, most
+ *					   first
+ *	profsym -i coff-file profile	-- samples at each instruction,
+ *					   most first, as function+offset,
+ *					   to find the hot loop inside a
+ *					   function
+ *
+ * Functions are found from the COFF file's external symbols, so a
+ * static function's samples are charged to the global function
+ * before it.  Like coff2noff, this assumes the COFF file is linked at
+ * 0, as the test programs are, so a Nachos PC is a COFF address.
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coff.h"
+
+/* A function of the program, and the samples charged to it */
+typedef struct function {
+   char *name;
+   unsigned int start;
+   int samples;
+} Function;
+
+/* One sampled instruction */
+typedef struct sample {
+   unsigned int pc;
+   int count;
+   Function *function;
+} Sample;
+
+static Function *functions;
+static int numFunctions;
+static Sample *samples;
+static int numSamples, totalSamples, interval;
+static char program[256];
+
+static int
+ByStart(const void *a, const void *b)
+{
+   unsigned int x = ((Function *) a)->start, y = ((Function *) b)->start;
+
+   return (x < y) ? -1 : (x > y);
+}
+
+/* Read the functions from the COFF file's external symbols */
+static void
+ReadFunctions(char *name)
+{
+   FILE *fp = fopen(name, "r");
+   struct filehdr fileh;
+   SYMHDR symh;
+   EXTSYM sym;
+   char *strings;
+   int i;
+
+   if (fp == NULL) {
+	perror(name);
+	exit(1);
+   }
+   if (fread(&fileh, sizeof(fileh), 1, fp) != 1
+	|| fileh.f_magic != MIPSELMAGIC) {
+	fprintf(stderr, "%s: not a MIPS COFF file\n", name);
+	exit(1);
+   }
+   if (fileh.f_symptr == 0
+	|| fseek(fp, fileh.f_symptr, 0) != 0
+	|| fread(&symh, sizeof(symh), 1, fp) != 1) {
+	fprintf(stderr, "%s: has no symbol table\n", name);
+	exit(1);
+   }
+   strings = (char *) malloc(symh.issExtMax + 1);
+   fseek(fp, symh.cbSsExtOffset, 0);
+   if (fread(strings, 1, symh.issExtMax, fp) != symh.issExtMax) {
+	fprintf(stderr, "%s: symbol table is truncated\n", name);
+	exit(1);
+   }
+   strings[symh.issExtMax] = '\0';
+
+   functions = (Function *) malloc((symh.iextMax + 1) * sizeof(Function));
+   numFunctions = 0;
+   fseek(fp, symh.cbExtOffset, 0);
+   for (i = 0; i < symh.iextMax; i++) {
+	if (fread(&sym, sizeof(sym), 1, fp) != 1) {
+	    fprintf(stderr, "%s: symbol table is truncated\n", name);
+	    exit(1);
+	}
+	if ((SymType(&sym) == stProc || SymType(&sym) == stStaticProc)
+		&& SymClass(&sym) == scText
+		&& sym.iss >= 0 && sym.iss < symh.issExtMax) {
+	    functions[numFunctions].name = &strings[sym.iss];
+	    functions[numFunctions].start = sym.value;
+	    functions[numFunctions].samples = 0;
+	    numFunctions++;
+	}
+   }
+   fclose(fp);
+   qsort(functions, numFunctions, sizeof(Function), ByStart);
+}
+
+/* The function "pc" is in: the last one starting at or before it */
+static Function *
+FunctionOf(unsigned int pc)
+{
+   int lo = 0, hi = numFunctions - 1, mid;
+
+   if (numFunctions == 0 || pc < functions[0].start)
+	return NULL;
+   while (lo < hi) {
+	mid = (lo + hi + 1) / 2;
+	if (functions[mid].start <= pc)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+   }
+   return &functions[lo];
+}
+
+/* Read the samples, and charge each to its function */
+static void
+ReadProfile(char *name)
+{
+   FILE *fp = fopen(name, "r");
+   unsigned int pc;
+   int count, max = 64;
+
+   if (fp == NULL) {
+	perror(name);
+	exit(1);
+   }
+   if (fscanf(fp, "# %255s %d %d", program, &totalSamples, &interval) != 3) {
+	fprintf(stderr, "%s: not a Nachos profile\n", name);
+	exit(1);
+   }
+   samples = (Sample *) malloc(max * sizeof(Sample));
+   numSamples = 0;
+   while (fscanf(fp, "%x %d", &pc, &count) == 2) {
+	if (numSamples == max) {
+	    max *= 2;
+	    samples = (Sample *) realloc(samples, max * sizeof(Sample));
+	}
+	samples[numSamples].pc = pc;
+	samples[numSamples].count = count;
+	samples[numSamples].function = FunctionOf(pc);
+	if (samples[numSamples].function != NULL)
+	    samples[numSamples].function->samples += count;
+	numSamples++;
+   }
+   fclose(fp);
+}
+
+static int
+MostSamplesFirst(const void *a, const void *b)
+{
+   return ((Function *) b)->samples - ((Function *) a)->samples;
+}
+
+static int
+MostCountFirst(const void *a, const void *b)
+{
+   return ((Sample *) b)->count - ((Sample *) a)->count;
+}
+
+static double
+Percent(int n)
+{
+   return (totalSamples > 0) ? 100.0 * n / totalSamples : 0.0;
+}
+
+static void
+PrintFunctions()
+{
+   int i, unknown = totalSamples;
+
+   qsort(functions, numFunctions, sizeof(Function), MostSamplesFirst);
+   printf("%10s %7s  %s\n", "samples", "%", "function");
+   for (i = 0; i < numFunctions && functions[i].samples > 0; i++) {
+	printf("%10d %6.2f%%  %s\n", functions[i].samples,
+		Percent(functions[i].samples), functions[i].name);
+	unknown -= functions[i].samples;
+   }
+   if (unknown > 0)
+	printf("%10d %6.2f%%  (outside any function)\n", unknown,
+		Percent(unknown));
+}
+
+static void
+PrintInstructions()
+{
+   int i;
+   Sample *s;
+
+   qsort(samples, numSamples, sizeof(Sample), MostCountFirst);
+   printf("%10s %7s  %-10s %s\n", "samples", "%", "pc", "where");
+   for (i = 0; i < numSamples; i++) {
+	s = &samples[i];
+	printf("%10d %6.2f%%  0x%08x ", s->count, Percent(s->count), s->pc);
+	if (s->function != NULL)
+	    printf("%s+0x%x\n", s->function->name,
+			s->pc - s->function->start);
+	else
+	    printf("?\n");
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   int instructions = 0;
+
+   for (argc--, argv++; argc > 2; argc--, argv++) {
+	if (!strcmp(*argv, "-i"))
+	    instructions = 1;
+	else
+	    break;
+   }
+   if (argc != 2) {
+	fprintf(stderr, "Usage: profsym [-i] coff-file profile\n");
+	exit(1);
+   }
+   ReadFunctions(argv[0]);
+   ReadProfile(argv[1]);
+   printf("%s: %d samples, one every %d ticks\n", program, totalSamples,
+		interval);
+   if (instructions)
+	PrintInstructions();
+   else
+	PrintFunctions();
+   exit(0);
+}
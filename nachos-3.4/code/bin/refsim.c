@@ -0,0 +1,281 @@
+/* refsim.c
+ *
+ * This program reads the page reference trace a Nachos run wrote (with
+ * "nachos -rt file"), and replays it against several page replacement
+ * policies, for a range of memory sizes, to see how far the online
+ * policies are from optimal on a real workload:
+ *
+ *	refsim trace min max [step]	-- page faults of each policy,
+ *					   with min, min+step, ... max
+ *					   frames
+ *	refsim -w trace min max [step]	-- dirty pages written back,
+ *					   instead of faults
+ *
+ * The policies are OPT (Belady's: evict the page used furthest in the
+ * future), LRU, CLOCK (second chance), FIFO and random, like nachos -V
+ * but with global replacement, no shared pages and no read-ahead.  A
+ * page is a (process, virtual page) pair.  Each memory size is a
+ * line: the frames, then one column per policy, for plotting.
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracefmt.h"
+
+enum { OPT, LRU, CLOCK, FIFO, RANDOM, NumPolicies };
+static char *policyNames[NumPolicies] = { "opt", "lru", "clock", "fifo",
+					  "random" };
+
+static int *refs;		/* each reference's page, numbered densely */
+static char *writes;		/* was it a write? */
+static int *nextUse;		/* when the page is referenced next */
+static int numRefs, numPages;
+
+/* For each simulation */
+static int *frameOf;		/* the frame holding each page, or -1 */
+static int *pageIn;		/* the page in each frame, or -1 */
+static int *stamp;		/* per frame: last use (LRU), next use (OPT),
+				 * or use bit (CLOCK) */
+static char *dirty;		/* per frame: written since it was loaded? */
+
+/* The hash table numbering the (process, page) pairs densely */
+static unsigned int *keys;
+static int *ids, tableSize;
+
+static unsigned int
+Hash(unsigned int key)
+{
+   return (key * 2654435761u) % tableSize;
+}
+
+/* Put "key" in the table, as "id"; the table has room */
+static void
+Insert(unsigned int key, int id)
+{
+   unsigned int h = Hash(key);
+
+   while (ids[h] != -1)
+	h = (h + 1) % tableSize;
+   keys[h] = key;
+   ids[h] = id;
+}
+
+/* Make an empty table of "size" entries */
+static void
+NewTable(int size)
+{
+   int i;
+
+   tableSize = size;
+   keys = (unsigned int *) malloc(size * sizeof(unsigned int));
+   ids = (int *) malloc(size * sizeof(int));
+   for (i = 0; i < size; i++)
+	ids[i] = -1;
+}
+
+/* Return the number of a (process, page) pair, numbering new ones */
+static int
+PageNumber(unsigned int key)
+{
+   unsigned int h = Hash(key), *oldKeys;
+   int *oldIds, oldSize, i;
+
+   while (ids[h] != -1 && keys[h] != key)
+	h = (h + 1) % tableSize;
+   if (ids[h] != -1)
+	return ids[h];
+   if (2 * (numPages + 1) > tableSize) {	/* grow the table first */
+	oldKeys = keys;
+	oldIds = ids;
+	oldSize = tableSize;
+	NewTable(2 * tableSize);
+	for (i = 0; i < oldSize; i++)
+	   if (oldIds[i] != -1)
+		Insert(oldKeys[i], oldIds[i]);
+	free(oldKeys);
+	free(oldIds);
+   }
+   Insert(key, numPages);
+   return numPages++;
+}
+
+/* Read the trace, and work out each reference's next use, for OPT */
+static void
+ReadTrace(char *name)
+{
+   FILE *fp = fopen(name, "r");
+   RefTraceHeader header;
+   unsigned int word;
+   int *last, max = 65536, i;
+
+   if (fp == NULL) {
+	perror(name);
+	exit(1);
+   }
+   if (fread(&header, sizeof(header), 1, fp) != 1
+	|| header.refMagic != REFMAGIC) {
+	fprintf(stderr, "%s: not a Nachos page reference trace\n", name);
+	exit(1);
+   }
+   NewTable(1024);
+   refs = (int *) malloc(max * sizeof(int));
+   writes = (char *) malloc(max);
+   numRefs = numPages = 0;
+   while (fread(&word, sizeof(word), 1, fp) == 1) {
+	if (numRefs == max) {
+	   max *= 2;
+	   refs = (int *) realloc(refs, max * sizeof(int));
+	   writes = (char *) realloc(writes, max);
+	}
+	refs[numRefs] = PageNumber(word & ~RefWriteBit);
+	writes[numRefs] = RefIsWrite(word);
+	numRefs++;
+   }
+   fclose(fp);
+   free(keys);
+   free(ids);
+
+   nextUse = (int *) malloc((numRefs + 1) * sizeof(int));
+   last = (int *) malloc((numPages + 1) * sizeof(int));
+   for (i = 0; i < numPages; i++)
+	last[i] = numRefs;		/* never again */
+   for (i = numRefs - 1; i >= 0; i--) {
+	nextUse[i] = last[refs[i]];
+	last[refs[i]] = i;
+   }
+   free(last);
+   printf("# %s: %d references to %d pages of %d bytes\n", name, numRefs,
+		numPages, header.pageSize);
+}
+
+/* Pick the frame to evict, with every frame full */
+static int
+Victim(int policy, int frames, int *hand)
+{
+   int f, best = 0;
+
+   switch (policy) {
+     case OPT:			/* next used furthest away */
+	for (f = 1; f < frames; f++)
+	   if (stamp[f] > stamp[best])
+		best = f;
+	return best;
+     case LRU:			/* used longest ago */
+	for (f = 1; f < frames; f++)
+	   if (stamp[f] < stamp[best])
+		best = f;
+	return best;
+     case CLOCK:		/* first without its use bit */
+	while (stamp[*hand]) {
+	   stamp[*hand] = 0;
+	   *hand = (*hand + 1) % frames;
+	}
+	best = *hand;
+	*hand = (*hand + 1) % frames;
+	return best;
+     case FIFO:			/* loaded longest ago */
+	best = *hand;
+	*hand = (*hand + 1) % frames;
+	return best;
+     default:
+	return rand() % frames;
+   }
+}
+
+/* Replay the trace with "frames" frames; count faults and write-backs */
+static void
+Simulate(int policy, int frames, int *faults, int *writebacks)
+{
+   int i, f, page, used = 0, hand = 0;
+
+   for (i = 0; i < numPages; i++)
+	frameOf[i] = -1;
+   *faults = *writebacks = 0;
+   srand(1);
+   for (i = 0; i < numRefs; i++) {
+	page = refs[i];
+	f = frameOf[page];
+	if (f == -1) {
+	   (*faults)++;
+	   if (used < frames)
+		f = used++;
+	   else {
+		f = Victim(policy, frames, &hand);
+		frameOf[pageIn[f]] = -1;
+		if (dirty[f])
+		   (*writebacks)++;
+	   }
+	   pageIn[f] = page;
+	   frameOf[page] = f;
+	   dirty[f] = 0;
+	}
+	if (writes[i])
+	   dirty[f] = 1;
+	switch (policy) {
+	  case OPT:
+	   stamp[f] = nextUse[i];
+	   break;
+	  case LRU:
+	   stamp[f] = i;
+	   break;
+	  case CLOCK:
+	   stamp[f] = 1;
+	   break;
+	}
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   int showWrites = 0, min, max, step = 1, frames, p;
+   int faults, writebacks;
+
+   for (argc--, argv++; argc > 0 && **argv == '-'; argc--, argv++) {
+	if (!strcmp(*argv, "-w"))
+	   showWrites = 1;
+	else
+	   break;
+   }
+   if (argc < 3 || argc > 4) {
+	fprintf(stderr, "Usage: refsim [-w] trace min max [step]\n");
+	exit(1);
+   }
+   min = atoi(argv[1]);
+   max = atoi(argv[2]);
+   if (argc == 4)
+	step = atoi(argv[3]);
+   if (min < 1 || max < min || step < 1) {
+	fprintf(stderr, "refsim: bad frame range\n");
+	exit(1);
+   }
+   ReadTrace(argv[0]);
+
+   frameOf = (int *) malloc((numPages + 1) * sizeof(int));
+   pageIn = (int *) malloc(max * sizeof(int));
+   stamp = (int *) malloc(max * sizeof(int));
+   dirty = (char *) malloc(max);
+   printf("# %s\n#%7s", showWrites ? "write-backs" : "page faults", "frames");
+   for (p = 0; p < NumPolicies; p++)
+	printf(" %10s", policyNames[p]);
+   printf("\n");
+   for (frames = min; frames <= max; frames += step) {
+	printf("%8d", frames);
+	for (p = 0; p < NumPolicies; p++) {
+	   Simulate(p, frames, &faults, &writebacks);
+	   printf(" %10d", showWrites ? writebacks : faults);
+	}
+	printf("\n");
+   }
+   exit(0);
+}
@@ -0,0 +1,244 @@
+/* tracedump.c
+ *
+ * This program reads a Nachos event trace (written by "nachos -tr file")
+ * and prints it as a timeline, one event per line:
+ *
+ *	tracedump file		-- every event, oldest first
+ *	tracedump -s file	-- per-thread totals: CPU time (from the
+ *				   context switches), times dispatched,
+ *				   page faults, system calls, disk requests
+ *	tracedump -b n file	-- page faults, evictions and disk requests
+ *				   in each interval of n ticks, to spot
+ *				   thrashing
+ *
+ * See tracefmt.h for the format of the file.
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracefmt.h"
+
+/* Per-thread totals, for -s */
+typedef struct threadTotals {
+   int thread;
+   int runTicks;		/* time between being switched to and away */
+   int runs;			/* times switched to */
+   int faults, syscalls, diskRequests;
+} ThreadTotals;
+
+static ThreadTotals *totals = NULL;
+static int numTotals = 0, maxTotals = 0;
+
+static char *eventNames[] = { "?", "switch", "fault", "evict", "syscall",
+			      "sysret", "read", "write" };
+
+static TraceRecord *records;
+static int numRecords;
+
+/* Read the whole trace, and put its records in order, oldest first */
+static void
+ReadTrace(char *name)
+{
+   FILE *fp = fopen(name, "r");
+   TraceHeader header;
+   TraceRecord *slots;
+   int numSlots, first, i;
+
+   if (fp == NULL) {
+	perror(name);
+	exit(1);
+   }
+   if (fread(&header, sizeof(header), 1, fp) != 1
+	|| header.traceMagic != TRACEMAGIC) {
+	fprintf(stderr, "%s: not a Nachos event trace\n", name);
+	exit(1);
+   }
+   numSlots = header.numSlots;
+   slots = (TraceRecord *) malloc(numSlots * sizeof(TraceRecord));
+   if (fread(slots, sizeof(TraceRecord), numSlots, fp) != numSlots) {
+	fprintf(stderr, "%s: trace is truncated\n", name);
+	exit(1);
+   }
+   fclose(fp);
+
+   if (header.numRecords <= numSlots) {
+	numRecords = header.numRecords;
+	first = 0;
+   } else {				/* wrapped: oldest ones are gone */
+	numRecords = numSlots;
+	first = header.numRecords % numSlots;
+	fprintf(stderr, "%s: only the last %d of %d events were kept\n",
+		name, numSlots, header.numRecords);
+   }
+   records = (TraceRecord *) malloc(numSlots * sizeof(TraceRecord));
+   for (i = 0; i < numRecords; i++)
+	records[i] = slots[(first + i) % numSlots];
+   free(slots);
+}
+
+static char *
+EventName(int type)
+{
+   if (type < 0 || type >= sizeof(eventNames) / sizeof(char *))
+	return eventNames[0];
+   return eventNames[type];
+}
+
+static void
+PrintTimeline()
+{
+   int i;
+   TraceRecord *r;
+
+   printf("%10s %10s  %-8s %s\n", "tick", "thread", "event", "details");
+   for (i = 0; i < numRecords; i++) {
+	r = &records[i];
+	printf("%10d %10d  %-8s ", r->tick, r->thread, EventName(r->type));
+	switch (r->type) {
+	  case TraceSwitch:
+	    printf("%d -> %d\n", r->arg1, r->arg2);
+	    break;
+	  case TracePageFault:
+	    printf("page %d of process %d\n", r->arg1, r->arg2);
+	    break;
+	  case TraceEvict:
+	    printf("frame %d (page %d)\n", r->arg1, r->arg2);
+	    break;
+	  case TraceSyscall:
+	    printf("call %d\n", r->arg1);
+	    break;
+	  case TraceSysret:
+	    printf("call %d returned %d\n", r->arg1, r->arg2);
+	    break;
+	  case TraceDiskRead:
+	  case TraceDiskWrite:
+	    printf("sector %d, %d ticks\n", r->arg1, r->arg2);
+	    break;
+	  default:
+	    printf("%d %d\n", r->arg1, r->arg2);
+	    break;
+	}
+   }
+}
+
+static ThreadTotals *
+Totals(int thread)
+{
+   int i;
+
+   for (i = 0; i < numTotals; i++)
+	if (totals[i].thread == thread)
+	    return &totals[i];
+   if (numTotals == maxTotals) {
+	maxTotals = (maxTotals == 0) ? 16 : 2 * maxTotals;
+	totals = (ThreadTotals *) realloc(totals,
+					maxTotals * sizeof(ThreadTotals));
+   }
+   memset(&totals[numTotals], 0, sizeof(ThreadTotals));
+   totals[numTotals].thread = thread;
+   return &totals[numTotals++];
+}
+
+static void
+PrintSummary()
+{
+   int i, since = -1;
+   TraceRecord *r;
+   ThreadTotals *t;
+
+   for (i = 0; i < numRecords; i++) {
+	r = &records[i];
+	t = Totals(r->thread);
+	switch (r->type) {
+	  case TraceSwitch:
+	    if (since >= 0)
+		t->runTicks += r->tick - since;
+	    Totals(r->arg2)->runs++;
+	    since = r->tick;
+	    break;
+	  case TracePageFault:
+	    t->faults++;
+	    break;
+	  case TraceSyscall:
+	    t->syscalls++;
+	    break;
+	  case TraceDiskRead:
+	  case TraceDiskWrite:
+	    t->diskRequests++;
+	    break;
+	}
+   }
+   printf("%10s %10s %6s %8s %8s %8s\n", "thread", "ticks", "runs",
+	  "faults", "syscalls", "disk");
+   for (i = 0; i < numTotals; i++)
+	printf("%10d %10d %6d %8d %8d %8d\n", totals[i].thread,
+	       totals[i].runTicks, totals[i].runs, totals[i].faults,
+	       totals[i].syscalls, totals[i].diskRequests);
+}
+
+static void
+PrintBuckets(int width)
+{
+   int i, start, faults = 0, evictions = 0, disk = 0;
+   TraceRecord *r;
+
+   if (numRecords == 0)
+	return;
+   start = records[0].tick - records[0].tick % width;
+   printf("%10s %8s %8s %8s\n", "tick", "faults", "evict", "disk");
+   for (i = 0; i <= numRecords; i++) {
+	r = (i < numRecords) ? &records[i] : NULL;
+	while (r == NULL || r->tick >= start + width) {
+	    if (faults + evictions + disk > 0)
+		printf("%10d %8d %8d %8d\n", start, faults, evictions, disk);
+	    faults = evictions = disk = 0;
+	    start += width;
+	    if (r == NULL)
+		return;
+	}
+	if (r->type == TracePageFault)
+	    faults++;
+	else if (r->type == TraceEvict)
+	    evictions++;
+	else if (r->type == TraceDiskRead || r->type == TraceDiskWrite)
+	    disk++;
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   int summary = 0, width = 0;
+
+   for (argc--, argv++; argc > 1; argc--, argv++) {
+	if (!strcmp(*argv, "-s"))
+	    summary = 1;
+	else if (!strcmp(*argv, "-b") && argc > 2) {
+	    width = atoi(*++argv);
+	    argc--;
+	} else
+	    break;
+   }
+   if (argc != 1 || width < 0) {
+	fprintf(stderr, "Usage: tracedump [-s] [-b ticks] tracefile\n");
+	exit(1);
+   }
+   ReadTrace(*argv);
+   if (summary)
+	PrintSummary();
+   else if (width > 0)
+	PrintBuckets(width);
+   else
+	PrintTimeline();
+   exit(0);
+}
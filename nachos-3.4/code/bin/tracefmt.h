@@ -0,0 +1,73 @@
+/* tracefmt.h 
+ *     Data structures defining the format of a Nachos event trace file,
+ *     written by the -tr option and read by tracedump.
+ *
+ *     The file is a header followed by a fixed number of record slots.
+ *     Records are written in order, wrapping around to the first slot
+ *     once they are all used, so the file always holds the most recent
+ *     "numSlots" events.
+ */
+
+#ifndef TRACEFMT_H
+#define TRACEFMT_H
+
+#define TRACEMAGIC	0x7ace0001	/* magic number denoting a Nachos
+					 * event trace file
+					 */
+
+/* Event types, and what their arguments mean */
+#define TraceSwitch	1	/* context switch: old thread ID, new one */
+#define TracePageFault	2	/* page fault: virtual page, process ID */
+#define TraceEvict	3	/* page evicted: frame, virtual page */
+#define TraceSyscall	4	/* syscall entry: syscall number, 0 */
+#define TraceSysret	5	/* syscall exit: syscall number, result */
+#define TraceDiskRead	6	/* disk read request: sector, latency */
+#define TraceDiskWrite	7	/* disk write request: sector, latency */
+
+typedef struct traceRecord {
+   int tick;			/* stats->totalTicks at the event */
+   int thread;			/* the running thread: its process ID
+				 * (0 for kernel threads), or its address
+				 * if Nachos isn't running user programs
+				 */
+   int type;			/* one of the event types above */
+   int arg1, arg2;		/* depend on the type */
+} TraceRecord;
+
+typedef struct traceHeader {
+   int traceMagic;		/* should be TRACEMAGIC */
+   int numSlots;		/* number of record slots in the file */
+   int numRecords;		/* records ever written; the oldest one
+				 * kept is in slot numRecords % numSlots
+				 * once numRecords > numSlots
+				 */
+   int pad;
+} TraceHeader;
+
+/* A page reference trace, written by the -rt option and read by refsim,
+ * is a RefTraceHeader followed by one word per reference, made of the
+ * process ID, whether it was a write, and the virtual page number.
+ * A reference to the page the same process referenced last is left
+ * out, unless it is a write after reads: it is a hit under any
+ * replacement policy, and changes none of their choices.
+ */
+
+#define REFMAGIC	0x7ace0002	/* magic number denoting a Nachos
+					 * page reference trace file
+					 */
+
+#define RefPageBits	19		/* bits of virtual page number */
+#define RefWriteBit	(1 << RefPageBits)
+#define RefPIDShift	(RefPageBits + 1)	/* the rest: process ID */
+
+#define RefPage(w)	((w) & (RefWriteBit - 1))
+#define RefIsWrite(w)	(((w) & RefWriteBit) != 0)
+#define RefPID(w)	((unsigned) (w) >> RefPIDShift)
+
+typedef struct refTraceHeader {
+   int refMagic;		/* should be REFMAGIC */
+   int pageSize;		/* PageSize of the Nachos that wrote it */
+   int pad[2];
+} RefTraceHeader;
+
+#endif /* TRACEFMT_H */
@@ -11,10 +11,12 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	Once all the entries in the directory are used, the table doubles
+//	in size; the directory file grows when it is written back.
+//
+//	Names are found through a hash index (chained, with as many 
+//	buckets as there are entries), which is never stored on disk: it 
+//	is rebuilt whenever the table is fetched or grows.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -37,10 +39,10 @@
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-	table[i].inUse = FALSE;
+    table = NULL;
+    buckets = chain = NULL;
+    tableSize = 0;
+    Resize(size);
 }
 
 //----------------------------------------------------------------------
@@ -51,11 +53,14 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] buckets;
+    delete [] chain;
 } 
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk.  The table is as
+//	big as the file.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -63,20 +68,93 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    int size = file->Length() / sizeof(DirectoryEntry);
+
+    delete [] table;
+    table = new DirectoryEntry[size];
+    tableSize = size;
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    Rehash();
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Return
+//	FALSE if the table has grown, and there was no room on disk for
+//	the file to grow with it.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
-void
+bool
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int size = tableSize * sizeof(DirectoryEntry);
+
+    return file->WriteAt((char *)table, size, 0) == size;
+}
+
+//----------------------------------------------------------------------
+// Directory::Hash
+// 	Return the hash bucket for file name "name".  Only the first
+//	FileNameMaxLen characters count, as only those are kept.
+//----------------------------------------------------------------------
+
+int
+Directory::Hash(char *name)
+{
+    unsigned int hash = 0;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+	hash = hash * 31 + name[i];
+    return hash % tableSize;
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash
+// 	Rebuild the hash index from the table.
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash()
+{
+    delete [] buckets;
+    delete [] chain;
+    buckets = new int[tableSize];
+    chain = new int[tableSize];
+    for (int i = 0; i < tableSize; i++)
+	buckets[i] = -1;
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse) {
+	    int bucket = Hash(table[i].name);
+
+	    chain[i] = buckets[bucket];
+	    buckets[bucket] = i;
+	}
+}
+
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Make the table "size" entries long, keeping the entries in it.
+//----------------------------------------------------------------------
+
+void
+Directory::Resize(int size)
+{
+    DirectoryEntry *old = table;
+
+    ASSERT(size >= tableSize);
+    table = new DirectoryEntry[size];
+    for (int i = 0; i < size; i++)
+	if (i < tableSize)
+	    table[i] = old[i];
+	else {
+	    table[i].inUse = FALSE;
+	    table[i].isDirectory = FALSE;
+	}
+    tableSize = size;
+    delete [] old;
+    Rehash();
 }
 
 //----------------------------------------------------------------------
@@ -90,8 +168,10 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    if (tableSize == 0)
+	return -1;
+    for (int i = buckets[Hash(name)]; i != -1; i = chain[i])
+        if (!strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
     return -1;		// name not in directory
 }
@@ -103,43 +183,54 @@ Directory::FindIndex(char *name)
 //	in the directory.
 //
 //	"name" -- the file name to look up
+//	"isDirectory" -- if not NULL, set to whether the file is a
+//		directory
 //----------------------------------------------------------------------
 
 int
-Directory::Find(char *name)
+Directory::Find(char *name, bool *isDirectory)
 {
     int i = FindIndex(name);
 
-    if (i != -1)
-	return table[i].sector;
-    return -1;
+    if (i == -1)
+	return -1;
+    if (isDirectory != NULL)
+	*isDirectory = table[i].isDirectory;
+    return table[i].sector;
 }
 
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.  If
+//	the directory is full, it doubles in size.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDirectory" -- is the file a directory?
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector)
+Directory::Add(char *name, int newSector, bool isDirectory)
 { 
+    int i, bucket;
+
     if (FindIndex(name) != -1)
 	return FALSE;
-
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    for (i = 0; i < tableSize; i++)
+        if (!table[i].inUse)
+	    break;
+    if (i == tableSize)
+	Resize(max(2 * tableSize, 1));	// full: grow
+    table[i].inUse = TRUE;
+    table[i].isDirectory = isDirectory;
+    strncpy(table[i].name, name, FileNameMaxLen); 
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].sector = newSector;
+    bucket = Hash(table[i].name);
+    chain[i] = buckets[bucket];
+    buckets[bucket] = i;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -154,13 +245,31 @@ bool
 Directory::Remove(char *name)
 { 
     int i = FindIndex(name);
+    int *link;
 
     if (i == -1)
 	return FALSE; 		// name not in directory
+    for (link = &buckets[Hash(name)]; *link != i; link = &chain[*link])
+	;
+    *link = chain[i];
     table[i].inUse = FALSE;
     return TRUE;	
 }
 
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if there are no files in the directory.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse)
+	    return FALSE;
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // Directory::List
 // 	List all the file names in the directory. 
@@ -171,7 +280,7 @@ Directory::List()
 {
    for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+	    printf("%s%s\n", table[i].name, table[i].isDirectory ? "/" : "");
 }
 
 //----------------------------------------------------------------------
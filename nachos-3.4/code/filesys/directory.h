@@ -4,7 +4,11 @@
 //      A directory is a table of pairs: <file name, sector #>,
 //	giving the name of each file in the directory, and 
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) on disk.  An entry can 
+//	itself be a directory, so directories form a tree.
+//
+//	In memory, the table is indexed by a hash of the names, so
+//	looking a name up does not search the whole table.
 //
 //      We assume mutual exclusion is provided by the caller.
 //
@@ -19,8 +23,9 @@
 
 #include "openfile.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+#define FileNameMaxLen 		23	// for simplicity, we assume 
+					// file names are <= 23 characters
+					// long (so an entry is 32 bytes)
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -32,6 +37,7 @@
 class DirectoryEntry {
   public:
     bool inUse;				// Is this directory entry in use?
+    bool isDirectory;			// Is the file a directory?
     int sector;				// Location on disk to find the 
 					//   FileHeader for this file 
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
@@ -42,7 +48,9 @@ class DirectoryEntry {
 // the directory describes a file, and where to find it on disk.
 //
 // The directory data structure can be stored in memory, or on disk.
-// When it is on disk, it is stored as a regular Nachos file.
+// When it is on disk, it is stored as a regular Nachos file.  The
+// table grows when it is full, and the file with it, so there is no
+// limit on the number of files in a directory.
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
@@ -55,16 +63,21 @@ class Directory {
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
-					// directory contents back to disk
+    bool WriteBack(OpenFile *file);	// Write modifications to 
+					// directory contents back to disk;
+					// FALSE if the disk is too full
 
-    int Find(char *name);		// Find the sector number of the 
+    int Find(char *name, bool *isDirectory = NULL);
+					// Find the sector number of the 
 					// FileHeader for file: "name"
 
-    bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool Add(char *name, int newSector, bool isDirectory = FALSE);  
+					// Add a file name into the directory
 
     bool Remove(char *name);		// Remove a file from the directory
 
+    bool IsEmpty();			// Are there no files in it?
+
     void List();			// Print the names of all the files
 					//  in the directory
     void Print();			// Verbose print of the contents
@@ -76,8 +89,15 @@ class Directory {
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
 
+    int *buckets;			// Hash index of the names: the first
+					// entry in each bucket, or -1
+    int *chain;				// The next entry in the same bucket
+
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    void Resize(int size);		// Make room for "size" entries
+    void Rehash();			// Rebuild the hash index
+    int Hash(char *name);		// Which bucket "name" goes in
 };
 
 #endif // DIRECTORY_H
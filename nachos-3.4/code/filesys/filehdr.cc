@@ -4,11 +4,12 @@
 //
 //	The file header is used to locate where on disk the 
 //	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	table of extents -- each entry in the table gives a run of
+//	consecutive disk sectors containing that portion of the file 
+//	data.  The table size is chosen so that the file header
+//	will be just big enough to fit in one disk sector.  A run
+//	can be as long as we like, so there is no need for indirect
+//	blocks.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -31,26 +32,149 @@
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
 //	Allocate data blocks for the file out of the map of free disk blocks.
-//	Return FALSE if there are not enough free blocks to accomodate
-//	the new file.
+//	Seeks are what make our disk slow, so we want the data in one 
+//	run, as close as we can get to the file header:  we look for one
+//	from the start of the header's track onwards, then from the start
+//	of the disk.  If there is no run big enough, we take the first 
+//	free sectors after the header, in as few pieces as there are.
+//
+//	Return FALSE if there are not enough free blocks to accomodate 
+//	the new file, or they are in too many pieces.
 //
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the number of bytes in the file
+//	"near" is the sector holding the file header
 //----------------------------------------------------------------------
 
 bool
-FileHeader::Allocate(BitMap *freeMap, int fileSize)
+FileHeader::Allocate(BitMap *freeMap, int fileSize, int near)
 { 
+    int sector;
+    int track = near - near % SectorsPerTrack;
+
     numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
+    numSectors = numExtents = 0;
+    if (freeMap->NumClear() < divRoundUp(fileSize, SectorSize))
 	return FALSE;		// not enough space
+    if (fileSize == 0)
+	return TRUE;
+
+    sector = freeMap->FindRun(track, divRoundUp(fileSize, SectorSize));
+    if (sector == -1)
+	sector = freeMap->FindRun(0, divRoundUp(fileSize, SectorSize));
+    if (sector == -1)
+	sector = near;		// no luck: piece it together
+    return AddSectors(freeMap, divRoundUp(fileSize, SectorSize), sector);
+}
 
-    for (int i = 0; i < numSectors; i++)
-	dataSectors[i] = freeMap->Find();
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Make the file "newSize" bytes long, allocating more data blocks 
+//	for it out of the map of free disk blocks.  We allocate at least 
+//	GrowthSectors at a time, so that a file growing a few bytes per
+//	write takes one trip to the free map every few sectors, rather
+//	than one per write, and so that its data stays in long runs: the
+//	new sectors come right after the file's last ones if they are
+//	free, or as close after them as we can get.
+//
+//	Return FALSE (and leave the file as it was) if there are not 
+//	enough free blocks, or they are in too many pieces.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"newSize" is the new length of the file, in bytes
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Extend(BitMap *freeMap, int newSize)
+{
+    int needed = divRoundUp(newSize, SectorSize) - numSectors;
+    int chunk = min(max(needed, GrowthSectors), freeMap->NumClear());
+    int from = 0;
+
+    if (needed <= 0)
+	return SetLength(newSize);
+    if (chunk < needed)
+	return FALSE;			// not enough space
+    if (numExtents > 0)
+	from = extents[numExtents - 1].start + extents[numExtents - 1].length;
+    if (from >= NumSectors)
+	from = 0;
+    if (!AddSectors(freeMap, chunk, from) && 
+		(chunk == needed || !AddSectors(freeMap, needed, from)))
+	return FALSE;
+    numBytes = newSize;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetLength
+// 	Make the file "newSize" bytes long, without allocating anything:
+//	return FALSE if it hasn't got enough data blocks for that.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::SetLength(int newSize)
+{
+    if (newSize > numSectors * SectorSize)
+	return FALSE;
+    numBytes = newSize;
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::AddSectors
+// 	Allocate "count" more data blocks at the end of the file, in the
+//	first free sectors at or after "from" (wrapping around to the
+//	start of the disk), in as few runs as we can.  A run that starts
+//	where the file's last one ends just makes that one longer.
+//
+//	Return FALSE, and mark none of them, if it would take more than 
+//	NumExtents runs.  The caller has checked that there is enough 
+//	free space.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AddSectors(BitMap *freeMap, int count, int from)
+{
+    int oldExtents = numExtents, oldSectors = numSectors;
+    int oldLength = (numExtents > 0) ? extents[numExtents - 1].length : 0;
+    int needed, sector = from, length;
+    Extent *last;
+
+    for (needed = count; needed > 0; needed -= length) {
+	sector = freeMap->NextClear(sector);
+	if (sector == -1)
+	    sector = freeMap->NextClear(0);	// wrap around
+	length = freeMap->ClearRun(sector, needed);
+	last = (numExtents > 0) ? &extents[numExtents - 1] : NULL;
+	if (last != NULL && last->start + last->length == sector)
+	    last->length += length;		// carry on where it left off
+	else if (numExtents < NumExtents) {
+	    last = &extents[numExtents++];
+	    last->start = sector;
+	    last->length = length;
+	} else
+	    break;				// too fragmented
+	freeMap->MarkRun(sector, length);
+	numSectors += length;
+	sector += length;
+    }
+    if (needed == 0)
+	return TRUE;
+
+    // give back what we took
+    for (int i = numExtents - 1; i >= oldExtents - 1 && i >= 0; i--) {
+	int keep = (i == oldExtents - 1) ? oldLength : 0;
+
+	for (int j = keep; j < extents[i].length; j++)
+	    freeMap->Clear(extents[i].start + j);
+	extents[i].length = keep;
+    }
+    numExtents = oldExtents;
+    numSectors = oldSectors;
+    return FALSE;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
 // 	De-allocate all the space allocated for data blocks for this file.
@@ -61,10 +185,13 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    for (int i = 0; i < numSectors; i++) {
-	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
-    }
+    for (int i = 0; i < numExtents; i++)
+	for (int j = 0; j < extents[i].length; j++) {
+	    int sector = extents[i].start + j;
+
+	    ASSERT(freeMap->Test(sector));  // ought to be marked!
+	    freeMap->Clear(sector);
+	}
 }
 
 //----------------------------------------------------------------------
@@ -77,6 +204,7 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
+    ASSERT(sizeof(FileHeader) == SectorSize);
     synchDisk->ReadSector(sector, (char *)this);
 }
 
@@ -90,6 +218,7 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
+    ASSERT(sizeof(FileHeader) == SectorSize);
     synchDisk->WriteSector(sector, (char *)this); 
 }
 
@@ -106,7 +235,15 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    return(dataSectors[offset / SectorSize]);
+    int sector = offset / SectorSize;	// within the file
+
+    for (int i = 0; i < numExtents; i++) {
+	if (sector < extents[i].length)
+	    return extents[i].start + sector;
+	sector -= extents[i].length;
+    }
+    ASSERT(FALSE);			// past the end of the file
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -133,11 +270,12 @@ FileHeader::Print()
     char *data = new char[SectorSize];
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-    for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+    for (i = 0; i < numExtents; i++)
+	printf("%d-%d ", extents[i].start, 
+			extents[i].start + extents[i].length - 1);
     printf("\nFile contents:\n");
-    for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+    for (i = k = 0; k < numBytes; i++) {
+	synchDisk->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -148,3 +286,128 @@ FileHeader::Print()
     }
     delete [] data;
 }
+
+//----------------------------------------------------------------------
+// FileHeaderTable::FileHeaderTable
+// 	Initialize an empty table of open file headers.
+//----------------------------------------------------------------------
+
+FileHeaderTable::FileHeaderTable()
+{
+    for (int i = 0; i < HeaderBuckets; i++)
+	buckets[i] = NULL;
+    lock = new Lock("file header table");
+}
+
+FileHeaderTable::~FileHeaderTable()
+{
+    OpenHeader *entry;
+
+    for (int i = 0; i < HeaderBuckets; i++)
+	while ((entry = buckets[i]) != NULL) {
+	    buckets[i] = entry->next;
+	    if (entry->dirty && !entry->removed)
+		entry->hdr->WriteBack(entry->sector);
+	    delete entry->hdr;
+	    delete entry;
+	}
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Acquire
+// 	Return the header of the file whose header is in "sector", for a
+//	new OpenFile.  If the file is open already, share its header;
+//	otherwise read it in.
+//----------------------------------------------------------------------
+
+FileHeader *
+FileHeaderTable::Acquire(int sector)
+{
+    OpenHeader *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    if (entry == NULL) {
+	entry = new OpenHeader;
+	entry->sector = sector;
+	entry->hdr = new FileHeader;
+	entry->hdr->FetchFrom(sector);
+	entry->refs = 0;
+	entry->dirty = entry->removed = FALSE;
+	entry->next = buckets[sector % HeaderBuckets];
+	buckets[sector % HeaderBuckets] = entry;
+    }
+    entry->refs++;
+    lock->Release();
+    return entry->hdr;
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Release
+// 	An OpenFile is done with header "hdr", from "sector".  When the
+//	last one is, write the header back if any of them changed it 
+//	(unless the file has been deleted), and forget it.
+//
+//	"dirty" -- did this OpenFile change the header without writing
+//		it back?
+//----------------------------------------------------------------------
+
+void
+FileHeaderTable::Release(int sector, FileHeader *hdr, bool dirty)
+{
+    OpenHeader **link, *entry;
+
+    lock->Acquire();
+    for (link = &buckets[sector % HeaderBuckets]; (*link)->hdr != hdr;
+							link = &(*link)->next)
+	;
+    entry = *link;
+    if (dirty)
+	entry->dirty = TRUE;
+    if (--entry->refs == 0) {
+	*link = entry->next;
+	if (entry->dirty && !entry->removed)
+	    entry->hdr->WriteBack(sector);
+	delete entry->hdr;
+	delete entry;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Removed
+// 	The file whose header is in "sector" has been deleted, though it
+//	may still be open.  The sector may be reused for a new file, so  
+//	the old header must not be written back, nor found by Acquire.
+//----------------------------------------------------------------------
+
+void
+FileHeaderTable::Removed(int sector)
+{
+    OpenHeader *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    if (entry != NULL)
+	entry->removed = TRUE;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileHeaderTable::Find
+// 	Return the entry for the header in "sector", or NULL if that file
+//	isn't open.
+//----------------------------------------------------------------------
+
+OpenHeader *
+FileHeaderTable::Find(int sector)
+{
+    OpenHeader *entry;
+
+    for (entry = buckets[sector % HeaderBuckets]; entry != NULL;
+							entry = entry->next)
+	if (entry->sector == sector && !entry->removed)
+	    return entry;
+    return NULL;
+}
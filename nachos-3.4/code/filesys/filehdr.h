@@ -17,19 +17,31 @@
 #include "disk.h"
 #include "bitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+// A run of consecutive disk sectors holding part of a file.
+
+class Extent {
+  public:
+    int start;				// First sector of the run
+    int length;				// Number of sectors in it
+};
+
+#define NumExtents 	((int) ((SectorSize - 3 * sizeof(int)) / sizeof(Extent)))
+#define HeaderPad	((SectorSize - 3 * sizeof(int)) % sizeof(Extent) \
+				/ sizeof(int))	// ints left over
+#define GrowthSectors	8	// sectors a growing file gets at a time
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of extents: runs of 
+// consecutive data sectors, in file order.  A file's data is allocated
+// in as few runs as the free space allows -- usually just one.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.  That limits a file to NumExtents runs, but
+// not its length: a file can be as big as the free space on the disk,
+// as long as the space isn't too fragmented.
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
@@ -37,9 +49,17 @@
 
 class FileHeader {
   public:
-    bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
+    bool Allocate(BitMap *bitMap, int fileSize, int near = 0);
+						// Initialize a file header, 
 						//  including allocating space 
-						//  on disk for the file data
+						//  on disk for the file data,
+						//  close to sector "near"
+    bool Extend(BitMap *bitMap, int newSize);	// Make the file longer,
+						//  allocating more data blocks
+						//  if it has to
+    bool SetLength(int newSize);		// Make the file longer, 
+						//  within the data blocks it
+						//  already has
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
 						//  data blocks
 
@@ -57,10 +77,62 @@ class FileHeader {
     void Print();			// Print the contents of the file.
 
   private:
+    bool AddSectors(BitMap *bitMap, int count, int from);
+					// Allocate "count" more data 
+					// sectors, from "from" on
+
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+					// (a growing file may have some
+					// past the end)
+    int numExtents;			// Number of runs of them
+    Extent extents[NumExtents];		// Where the data sectors are, in
+					// order
+    int pad[HeaderPad];			// Fill out the sector, since it is
+					// read and written in place
+};
+
+// The headers of the files that are open, shared by all the OpenFiles
+// of each file (in UNIX terms, the "in-core inode table").  Opening a
+// file that is already open reads nothing from disk, and every opener
+// sees the file grow at once.  A header goes when its last opener does.
+
+#define HeaderBuckets	31		// hash buckets, by header sector
+
+class OpenHeader {
+  public:
+    int sector;				// Where the header lives on disk
+    FileHeader *hdr;
+    int refs;				// OpenFiles using it
+    bool dirty;				// Must it be written back?
+    bool removed;			// Has the file been deleted?
+    OpenHeader *next;			// In the same hash bucket
+};
+
+class Lock;
+
+class FileHeaderTable {
+  public:
+    FileHeaderTable();			// An empty table
+    ~FileHeaderTable();
+
+    FileHeader *Acquire(int sector);	// The header in "sector", read in
+					// if it isn't open already
+    void Release(int sector, FileHeader *hdr, bool dirty);
+					// Done with it; if no one else is 
+					// using it, write it back if it 
+					// (or "dirty") says so, and drop it
+    void Removed(int sector);		// The file has been deleted: don't
+					// write the header back, or give
+					// it to later opens
+
+  private:
+    OpenHeader *Find(int sector);	// The entry for the file in 
+					// "sector", or NULL
+
+    OpenHeader *buckets[HeaderBuckets];
+    Lock *lock;				// Held while reading a header in, 
+					// so no one sees it half read
 };
 
 #endif // FILEHDR_H
@@ -28,16 +28,19 @@
 //	modified part of the directory and/or bitmap, we simply discard
 //	the changed version, without writing it back to disk.
 //
+//	Each such operation is a journal transaction (cf. journal.h):
+//	the sectors it changes reach the disk together, through the log,
+//	so a crash leaves the file system as it was before or after.
+//
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   files only grow -- there is no way to truncate one
+//	   a file's data can be in at most NumExtents pieces on disk
+//	   directory entries are never reclaimed: an emptied directory 
+//	     file stays as big as it ever got
+//	   only metadata is logged: after a crash, a file may hold
+//	    blocks that were never written
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -50,6 +53,9 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "journal.h"
+#include "synch.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -57,13 +63,47 @@
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directories; a directory grows
+// when it fills up.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
 #define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+//----------------------------------------------------------------------
+// FindHeaderSector
+// 	Pick a free sector for the header of a new file of "fileSize" 
+//	bytes, and mark it in use.  Return -1 if the disk is full.
+//
+//	Each track is a "cylinder group": we put the header on the track 
+//	nearest the directory's that has room for the header and the
+//	file's data (or a whole track's worth, for big files), so that
+//	FileHeader::Allocate can put the data right after the header,
+//	and looking a file up and reading it costs few seeks.
+//----------------------------------------------------------------------
+
+static int
+FindHeaderSector(BitMap *freeMap, int fileSize)
+{
+    int home = DirectorySector / SectorsPerTrack;
+    int needed = min(1 + divRoundUp(fileSize, SectorSize), SectorsPerTrack);
+    int sector;
+
+    for (int distance = 0; distance < NumTracks; distance++)
+	for (int side = -1; side <= 1; side += 2) {
+	    int track = home + side * distance;
+
+	    if (track < 0 || track >= NumTracks || (distance == 0 && side > 0))
+		continue;
+	    if (freeMap->CountClear(track * SectorsPerTrack, SectorsPerTrack)
+								>= needed) {
+		sector = freeMap->NextClear(track * SectorsPerTrack);
+		freeMap->Mark(sector);
+		return sector;
+	    }
+	}
+    return freeMap->Find();	// no track has room: anywhere will do
+}
+
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
@@ -80,6 +120,7 @@
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    lock = new RWLock("file system", TRUE);
     if (format) {
         BitMap *freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
@@ -92,6 +133,9 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	freeMap->MarkRun(LogStart, LogSectors);	// and for the log
+	freeMap->MarkRun(SwapStart, SwapSectors);	// and the swap area
+	journal->Format();
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
@@ -128,18 +172,131 @@ FileSystem::FileSystem(bool format)
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
-
+	}
         delete freeMap; 
 	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
-	}
     } else {
     // if we are not formatting the disk, just open the files representing
-    // the bitmap and directory; these are left open while Nachos is running
+    // the bitmap and directory; these are left open while Nachos is running.
+    // First finish anything left in the log when Nachos last stopped.
+	journal->Recover();
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
     }
+
+    // The root directory stays in memory, as the first entry of the
+    // directory cache
+    dirCacheLock = new Lock("directory cache");
+    dirCacheClock = 0;
+    for (int i = 0; i < DirCacheSize; i++)
+	dirCache[i].sector = -1;
+    dirCache[0].sector = DirectorySector;
+    dirCache[0].file = directoryFile;
+    dirCache[0].dir = new Directory(NumDirEntries);
+    dirCache[0].dir->FetchFrom(directoryFile);
+    dirCache[0].lastUse = 0;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::GetDirectory
+// 	Return the directory whose file header is in "sector", from the
+//	directory cache.  If it isn't there, read it in, in place of the
+//	least recently used one (never the root).  The caller must hold
+//	dirCacheLock.
+//
+//	Directories in the cache are always up to date: every change is
+//	made to the cached copy and written straight back.
+//----------------------------------------------------------------------
+
+DirCacheEntry *
+FileSystem::GetDirectory(int sector)
+{
+    DirCacheEntry *victim = NULL;
+
+    ASSERT(dirCacheLock->isHeldByCurrentThread());
+    for (int i = 0; i < DirCacheSize; i++) {
+	if (dirCache[i].sector == sector) {
+	    dirCache[i].lastUse = ++dirCacheClock;
+	    return &dirCache[i];
+	}
+	if (i > 0 && (victim == NULL || (victim->sector != -1 && 
+		(dirCache[i].sector == -1 || 
+		 dirCache[i].lastUse < victim->lastUse))))
+	    victim = &dirCache[i];
+    }
+    if (victim->sector != -1) {
+	delete victim->dir;
+	delete victim->file;
+    }
+    DEBUG('f', "Reading directory at sector %d into the cache\n", sector);
+    victim->sector = sector;
+    victim->file = new OpenFile(sector);
+    victim->dir = new Directory(NumDirEntries);
+    victim->dir->FetchFrom(victim->file);
+    victim->lastUse = ++dirCacheClock;
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ForgetDirectory
+// 	Drop the directory whose file header is in "sector" from the
+//	directory cache, if it is there (it is being removed).
+//----------------------------------------------------------------------
+
+void
+FileSystem::ForgetDirectory(int sector)
+{
+    for (int i = 1; i < DirCacheSize; i++)
+	if (dirCache[i].sector == sector) {
+	    delete dirCache[i].dir;
+	    delete dirCache[i].file;
+	    dirCache[i].sector = -1;
+	}
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindParent
+// 	Look up the directory a path names a file in: every component
+//	but the last must be a directory.  Each component is one hash 
+//	lookup, in a directory that is usually already in the cache.
+//	A leading "/" is optional; the path is always from the root.
+//
+//	Returns the directory, from the directory cache, or NULL if the 
+//	path is empty or goes through something that isn't a directory.
+//	The caller must hold dirCacheLock while it uses the directory.
+//
+//	"path" -- the path name
+//	"leaf" -- where to put its last component, which must have room
+//		for FileNameMaxLen + 1 characters (longer names are cut 
+//		short)
+//----------------------------------------------------------------------
+
+DirCacheEntry *
+FileSystem::FindParent(char *path, char *leaf)
+{
+    DirCacheEntry *parent = GetDirectory(DirectorySector);
+    char *p = path;
+    bool isDirectory;
+    int sector, n;
+
+    for (;;) {
+	while (*p == '/')
+	    p++;
+	for (n = 0; *p != '\0' && *p != '/'; p++)
+	    if (n < FileNameMaxLen)
+		leaf[n++] = *p;
+	leaf[n] = '\0';
+	while (*p == '/')
+	    p++;
+	if (*p == '\0')
+	    return (n > 0) ? parent : NULL;	// "leaf" is the last one
+	sector = parent->dir->Find(leaf, &isDirectory);
+	if (sector == -1 || !isDirectory)
+	    return NULL;
+	parent = GetDirectory(sector);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -174,43 +331,154 @@ FileSystem::FileSystem(bool format)
 bool
 FileSystem::Create(char *name, int initialSize)
 {
-    Directory *directory;
+    char leaf[FileNameMaxLen + 1];
+    DirCacheEntry *parent;
+    bool success;
+
+    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+
+    lock->WriteAcquire();
+    journal->Begin();
+    dirCacheLock->Acquire();
+    parent = FindParent(name, leaf);
+    success = (parent != NULL) && AddFile(parent, leaf, initialSize, FALSE);
+    dirCacheLock->Release();
+    journal->End();
+    lock->WriteRelease();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Mkdir
+// 	Create an empty directory (similar to UNIX mkdir).  Return FALSE
+//	if the name is taken, the directory it would go in doesn't exist,
+//	or there isn't room.
+//
+//	"name" -- path name of the directory to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Mkdir(char *name)
+{
+    char leaf[FileNameMaxLen + 1];
+    DirCacheEntry *parent;
+    bool success;
+
+    DEBUG('f', "Making directory %s\n", name);
+
+    lock->WriteAcquire();
+    journal->Begin();
+    dirCacheLock->Acquire();
+    parent = FindParent(name, leaf);
+    success = (parent != NULL) && 
+			AddFile(parent, leaf, DirectoryFileSize, TRUE);
+    if (success) {
+	Directory *directory = new Directory(NumDirEntries);
+	OpenFile *file = new OpenFile(parent->dir->Find(leaf));
+
+	directory->WriteBack(file);		// it starts out empty
+	delete file;
+	delete directory;
+    }
+    dirCacheLock->Release();
+    journal->End();
+    lock->WriteRelease();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AddFile
+// 	Do the work of Create and Mkdir.  The caller holds the file system
+//	lock, to write, and dirCacheLock.
+//
+//	"parent" -- the directory to put the file in
+//	"leaf" -- the file's name there
+//	"initialSize" -- size of file to be created
+//	"isDirectory" -- is the file a directory?
+//----------------------------------------------------------------------
+
+bool
+FileSystem::AddFile(DirCacheEntry *parent, char *leaf, int initialSize,
+			bool isDirectory)
+{
+    Directory *directory = parent->dir;
     BitMap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    if (directory->Find(leaf) != -1)
+      return FALSE;			// file is already in directory
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-
-    if (directory->Find(name) != -1)
-      success = FALSE;			// file is already in directory
-    else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
-        sector = freeMap->Find();	// find a sector to hold the file header
-    	if (sector == -1) 		
-            success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
-            success = FALSE;	// no space in directory
-	else {
-    	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, initialSize))
-            	success = FALSE;	// no space on disk for data
-	    else {	
-	    	success = TRUE;
-		// everthing worked, flush all changes back to disk
-    	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
-    	    	freeMap->WriteBack(freeMapFile);
+    freeMap = new BitMap(NumSectors);
+    freeMap->FetchFrom(freeMapFile);
+    sector = FindHeaderSector(freeMap, initialSize);
+					// find a sector to hold the file header
+    if (sector == -1) 		
+	success = FALSE;		// no free block for file header 
+    else {
+	hdr = new FileHeader;
+	if (!hdr->Allocate(freeMap, initialSize, sector))
+	    success = FALSE;	// no space on disk for data
+	else {	
+	    // everthing worked, flush all changes back to disk -- the
+	    // bitmap before the directory, since the directory may need
+	    // more space, and Extend reads the bitmap from disk
+	    success = TRUE;
+	    directory->Add(leaf, sector, isDirectory);
+	    hdr->WriteBack(sector); 		
+	    freeMap->WriteBack(freeMapFile);
+	    if (!directory->WriteBack(parent->file)) {
+		directory->Remove(leaf);	// no room for it to grow
+		hdr->Deallocate(freeMap);
+		freeMap->Clear(sector);
+		freeMap->WriteBack(freeMapFile);
+		success = FALSE;
 	    }
-            delete hdr;
 	}
-        delete freeMap;
+	delete hdr;
+    }
+    delete freeMap;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Extend
+// 	Make an open file longer, allocating more data blocks for it.
+//	Called by OpenFile::WriteAt, when a write runs past the data
+//	blocks the file already has.  The new bitmap and file header go 
+//	to the buffer cache, and reach the disk together, through the log.
+//
+//	"hdr" -- the open file's header
+//	"sector" -- where the header lives on disk
+//	"newSize" -- the length the file should have
+//
+// Returns FALSE, leaving the file as it was, if the disk is full.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Extend(FileHeader *hdr, int sector, int newSize)
+{
+    BitMap *freeMap;
+    bool success;
+
+    DEBUG('f', "Extending file at sector %d to %d bytes\n", sector, newSize);
+    bool locked = lock->isWriteHeldByCurrentThread();	// growing a
+							// directory?
+    if (!locked)
+	lock->WriteAcquire();
+    journal->Begin();			// (nested, for a directory)
+    freeMap = new BitMap(NumSectors);
+    freeMap->FetchFrom(freeMapFile);
+    success = hdr->Extend(freeMap, newSize);
+    if (success) {
+	freeMap->WriteBack(freeMapFile);
+	hdr->WriteBack(sector);
     }
-    delete directory;
+    delete freeMap;
+    journal->End();
+    if (!locked)
+	lock->WriteRelease();
     return success;
 }
 
@@ -227,16 +495,21 @@ FileSystem::Create(char *name, int initialSize)
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
+    char leaf[FileNameMaxLen + 1];
+    DirCacheEntry *parent;
     OpenFile *openFile = NULL;
-    int sector;
+    int sector = -1;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
+    lock->ReadAcquire();
+    dirCacheLock->Acquire();
+    parent = FindParent(name, leaf);
+    if (parent != NULL)
+	sector = parent->dir->Find(leaf); 
+    dirCacheLock->Release();
     if (sector >= 0) 		
 	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
+    lock->ReadRelease();
     return openFile;				// return NULL if not found
 }
 
@@ -257,17 +530,30 @@ FileSystem::Open(char *name)
 bool
 FileSystem::Remove(char *name)
 { 
-    Directory *directory;
+    char leaf[FileNameMaxLen + 1];
+    DirCacheEntry *parent;
     BitMap *freeMap;
     FileHeader *fileHdr;
-    int sector;
+    bool isDirectory;
+    int sector = -1;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
+    lock->WriteAcquire();
+    journal->Begin();
+    dirCacheLock->Acquire();
+    parent = FindParent(name, leaf);
+    if (parent != NULL)
+	sector = parent->dir->Find(leaf, &isDirectory);
+    if (sector != -1 && isDirectory) {
+	if (!GetDirectory(sector)->dir->IsEmpty())	// leaves "parent"
+	    sector = -1;				// alone: it is newer
+	else
+	    ForgetDirectory(sector);
+    }
     if (sector == -1) {
-       delete directory;
-       return FALSE;			 // file not found 
+       dirCacheLock->Release();
+       journal->End();
+       lock->WriteRelease();
+       return FALSE;			 // file not found, or not empty
     }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
@@ -277,13 +563,16 @@ FileSystem::Remove(char *name)
 
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
-    directory->Remove(name);
+    parent->dir->Remove(leaf);
+    headerTable->Removed(sector);		// in case it is open
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
+    parent->dir->WriteBack(parent->file);	// flush to disk
     delete fileHdr;
-    delete directory;
     delete freeMap;
+    dirCacheLock->Release();
+    journal->End();
+    lock->WriteRelease();
     return TRUE;
 } 
 
@@ -295,11 +584,11 @@ FileSystem::Remove(char *name)
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
-
-    directory->FetchFrom(directoryFile);
-    directory->List();
-    delete directory;
+    lock->ReadAcquire();
+    dirCacheLock->Acquire();
+    GetDirectory(DirectorySector)->dir->List();
+    dirCacheLock->Release();
+    lock->ReadRelease();
 }
 
 //----------------------------------------------------------------------
@@ -318,7 +607,6 @@ FileSystem::Print()
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
     BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -328,14 +616,15 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
+    lock->ReadAcquire();
     freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
-
-    directory->FetchFrom(directoryFile);
-    directory->Print();
+    dirCacheLock->Acquire();
+    GetDirectory(DirectorySector)->dir->Print();
+    dirCacheLock->Release();
+    lock->ReadRelease();
 
     delete bitHdr;
     delete dirHdr;
     delete freeMap;
-    delete directory;
 } 
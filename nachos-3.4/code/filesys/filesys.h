@@ -20,10 +20,10 @@
 //	file system (in a file named "DISK"). 
 //
 //	In the "real" implementation, there are two key data structures used 
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.  
-//	In addition, there is a bitmap for allocating
+//	in the file system.  There is a "root" directory, listing
+//	the files at the top of the file system; as in UNIX, some of them 
+//	can be directories in turn, and files are named by paths like
+//	"dir/file".  In addition, there is a bitmap for allocating
 //	disk sectors.  Both the root directory and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
 //	bootstrap problem when the simulated disk is initialized. 
@@ -65,6 +65,28 @@ class FileSystem {
 };
 
 #else // FILESYS
+#include "disk.h"
+
+class RWLock;
+class Lock;
+class FileHeader;
+class Directory;
+
+#define DirCacheSize	8		// directories kept in memory
+#define SwapSectors	(8 * SectorsPerTrack)	// raw swap area, at the
+#define SwapStart	(NumSectors - SwapSectors)	// end of the disk,
+					// kept out of the file system
+
+// A directory kept in memory, with the file it is stored in.
+
+class DirCacheEntry {
+  public:
+    int sector;				// Its file header; -1 if unused
+    OpenFile *file;
+    Directory *dir;
+    int lastUse;			// For LRU replacement
+};
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -79,7 +101,14 @@ class FileSystem {
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
-    bool Remove(char *name);  		// Delete a file (UNIX unlink)
+    bool Extend(FileHeader *hdr, int sector, int newSize);
+					// Allocate more space for an open
+					// file, whose header is "hdr"
+
+    bool Remove(char *name);  		// Delete a file, or an empty
+					// directory (UNIX unlink)
+
+    bool Mkdir(char *name);		// Create a directory (UNIX mkdir)
 
     void List();			// List all the files in the file system
 
@@ -90,6 +119,28 @@ class FileSystem {
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   RWLock* lock;			// Open and List only read the
+					// directory and bitmap, so they can
+					// run together; Create and Remove
+					// change them
+
+   DirCacheEntry dirCache[DirCacheSize];
+					// Directories recently looked in;
+					// the root is always the first
+   int dirCacheClock;			// Time of the last use of one
+   Lock* dirCacheLock;			// Protects dirCache, since readers
+					// of "lock" fill it in together
+
+   DirCacheEntry *GetDirectory(int sector);
+					// The directory whose header is at
+					// "sector", fetched if need be
+   void ForgetDirectory(int sector);	// Drop it from the cache
+   DirCacheEntry *FindParent(char *path, char *leaf);
+					// Look up all of "path" but the last
+					// component ("leaf")
+   bool AddFile(DirCacheEntry *parent, char *leaf, int initialSize,
+					bool isDirectory);
+					// Create and Mkdir
 };
 
 #endif // FILESYS
@@ -7,6 +7,7 @@
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   Stresstest -- many threads using the file system at once
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -20,6 +21,7 @@
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "synch.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -183,3 +185,146 @@ PerformanceTest()
     stats->Print();
 }
 
+
+//----------------------------------------------------------------------
+// StressTest
+// 	Stress the file system with several threads at once, to exercise
+//	its locking, the buffer cache and the disk scheduler.  Each thread
+//	does StressOps operations, picked at random:
+//	  -- a sequential read or write of its own file, continuing where
+//	     the last one left off
+//	  -- a random read or write of a file all the threads share
+//	  -- opening and closing the shared file
+//	  -- creating, writing and removing a scratch file of its own
+//	Then print how many operations were done per 1000 ticks, and
+//	the disk requests and buffer cache hits per operation.
+//
+//	Implemented as:
+//	  StressThread -- one thread's operations
+//	  StressTest -- set up the files, fork the threads, wait for
+//		and report them
+//----------------------------------------------------------------------
+
+#define StressOps	200		// operations per thread
+#define StressFileSize	4096		// bytes in each thread's own file
+#define SharedFileSize	8192		// and in the shared one
+#define SharedName	"StressShared"
+
+static int stressIOSize;		// bytes per read or write
+static int stressFailures;		// operations that went wrong
+static Semaphore *stressDone;		// V'ed by each thread as it ends
+
+static void
+StressThread(int which)
+{
+    char name[16], scratch[16];
+    char *buffer = new char[stressIOSize];
+    OpenFile *own, *shared, *file;
+    int op, i, position, next = 0;
+
+    sprintf(name, "Stress%d", which);
+    sprintf(scratch, "Scratch%d", which);
+    own = fileSystem->Open(name);
+    shared = fileSystem->Open(SharedName);
+    ASSERT(own != NULL && shared != NULL);
+    for (i = 0; i < stressIOSize; i++)
+	buffer[i] = 'a' + which;
+
+    for (i = 0; i < StressOps; i++) {
+	op = Random() % 7;
+	switch (op) {
+	  case 0:			// sequential, own file
+	  case 1:
+	    if (next + stressIOSize > StressFileSize)
+		next = 0;
+	    if (((op == 0) ? own->ReadAt(buffer, stressIOSize, next)
+			   : own->WriteAt(buffer, stressIOSize, next))
+		    != stressIOSize)
+		stressFailures++;
+	    next += stressIOSize;
+	    break;
+	  case 2:			// random, shared file
+	  case 3:
+	    position = Random() % (SharedFileSize - stressIOSize + 1);
+	    if (((op == 2) ? shared->ReadAt(buffer, stressIOSize, position)
+			   : shared->WriteAt(buffer, stressIOSize, position))
+		    != stressIOSize)
+		stressFailures++;
+	    break;
+	  case 4:
+	  case 5:			// open and close
+	    if ((file = fileSystem->Open(SharedName)) == NULL)
+		stressFailures++;
+	    delete file;
+	    break;
+	  default:			// create, write, remove
+	    if (!fileSystem->Create(scratch, 0)
+		    || (file = fileSystem->Open(scratch)) == NULL) {
+		stressFailures++;
+		break;
+	    }
+	    if (file->Write(buffer, stressIOSize) != stressIOSize)
+		stressFailures++;
+	    delete file;
+	    if (!fileSystem->Remove(scratch))
+		stressFailures++;
+	    break;
+	}
+    }
+    delete own;
+    delete shared;
+    delete [] buffer;
+    stressDone->V();
+}
+
+void
+StressTest(int numThreads, int ioSize)
+{
+    char name[16];
+    long long startTicks, diskRequests, hits, misses, ticks;
+    int i, ops = numThreads * StressOps;
+
+    ASSERT(numThreads > 0 && ioSize > 0 && ioSize <= StressFileSize);
+    printf("Starting file system stress test: %d threads, %d byte I/O\n",
+		numThreads, ioSize);
+    stressIOSize = ioSize;
+    stressFailures = 0;
+    stressDone = new Semaphore("stress done", 0);
+    if (!fileSystem->Create(SharedName, SharedFileSize)) {
+	printf("Stress test: can't create %s\n", SharedName);
+	return;
+    }
+    for (i = 0; i < numThreads; i++) {
+	sprintf(name, "Stress%d", i);
+	if (!fileSystem->Create(name, StressFileSize)) {
+	    printf("Stress test: can't create %s\n", name);
+	    return;
+	}
+    }
+
+    startTicks = stats->totalTicks;
+    diskRequests = stats->numDiskReads + stats->numDiskWrites;
+    hits = stats->numCacheHits;
+    misses = stats->numCacheMisses;
+    for (i = 0; i < numThreads; i++)
+	(new Thread("stress"))->Fork(StressThread, i);
+    for (i = 0; i < numThreads; i++)
+	stressDone->P();
+    ticks = stats->totalTicks - startTicks;
+    diskRequests = stats->numDiskReads + stats->numDiskWrites - diskRequests;
+    hits = stats->numCacheHits - hits;
+    misses = stats->numCacheMisses - misses;
+
+    printf("%d operations (%d failed) in %lld ticks: %.2f per 1000 ticks\n",
+		ops, stressFailures, ticks, (ticks > 0) ? 1000.0 * ops / ticks : 0.0);
+    printf("%.2f disk requests per operation; buffer cache hit rate %.1f%%\n",
+		(double) diskRequests / ops,
+		(hits + misses > 0) ? 100.0 * hits / (hits + misses) : 0.0);
+
+    for (i = 0; i < numThreads; i++) {
+	sprintf(name, "Stress%d", i);
+	fileSystem->Remove(name);
+    }
+    fileSystem->Remove(SharedName);
+    delete stressDone;
+}
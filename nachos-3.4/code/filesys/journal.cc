@@ -0,0 +1,298 @@
+// journal.cc
+//	Routines for the write-ahead log of file system metadata.  See
+//	journal.h.
+//
+//	The log lives in LogSectors sectors that the free map marks in
+//	use, and is read and written around the buffer cache, so that the
+//	cache never holds a stale copy of it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// JournalDaemon, CommitTimer
+// 	Body of the commit daemon thread, and the commit timer interrupt
+//	handler.  C routines, for Fork and Interrupt::Schedule.
+//----------------------------------------------------------------------
+
+static void
+JournalDaemon(int arg)
+{
+    Journal *log = (Journal *)arg;
+
+    log->Daemon();
+}
+
+static void
+CommitTimer(int arg)
+{
+    Journal *log = (Journal *)arg;
+
+    log->CommitDue();
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize a journal with no transaction in progress and nothing
+//	held, and start the commit daemon.  Format or Recover must be
+//	called before the file system is used.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    ASSERT(sizeof(LogHeader) <= SectorSize);
+    logLock = new Lock("journal");
+    owner = NULL;
+    depth = 0;
+    numHeld = numLast = 0;
+    firstHeldAt = 0;
+    sequence = 0;
+    half = 1;				// so the first group goes in half 0
+    timerSet = FALSE;
+    commitDue = new Semaphore("journal commit due", 0);
+    (new Thread("journal daemon"))->Fork(JournalDaemon, (int) this);
+}
+
+Journal::~Journal()
+{
+    delete commitDue;
+    delete logLock;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Empty both halves of the log, on a freshly formatted disk.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    char buf[SectorSize];
+
+    bzero(buf, SectorSize);
+    synchDisk->WriteRaw(LogStart, buf, 1);
+    synchDisk->WriteRaw(LogStart + LogSectors / 2, buf, 1);
+    sequence = 0;
+    half = 1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Nachos is starting on a disk that was already formatted, and may
+//	have stopped in the middle of writing metadata home.  Copy the
+//	newest complete group in the log to where its sectors belong;
+//	everything older is home already.  Then empty the log, so the
+//	group is never applied again on top of later changes.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    char buf[2][SectorSize];
+    LogHeader *hdr[2];
+    char *images;
+    int newest = -1;
+
+    for (int i = 0; i < 2; i++) {
+	synchDisk->ReadRaw(LogStart + i * LogSectors / 2, buf[i], 1);
+	hdr[i] = (LogHeader *) buf[i];
+	if (hdr[i]->magic == LogMagic && hdr[i]->numSectors > 0 &&
+		hdr[i]->numSectors <= LogImages &&
+		(newest == -1 || hdr[i]->sequence > hdr[newest]->sequence))
+	    newest = i;
+    }
+    if (newest != -1) {
+	int n = hdr[newest]->numSectors;
+
+	DEBUG('f', "Journal: reapplying %d sectors of group %d\n", n,
+			hdr[newest]->sequence);
+	images = new char[n * SectorSize];
+	synchDisk->ReadRaw(LogStart + newest * LogSectors / 2 + 1, images, n);
+	for (int i = 0; i < n; i++)
+	    synchDisk->WriteSector(hdr[newest]->sectors[i],
+					&images[i * SectorSize]);
+	synchDisk->Flush();
+	delete [] images;
+	sequence = hdr[newest]->sequence;
+    }
+    Format();				// (keeps the sequence going up)
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction: the sectors written until the matching End
+//	must reach the disk together.  Waits while a commit is writing the
+//	log.  A thread that is already in a transaction just goes deeper.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    if (owner == currentThread) {
+	depth++;
+	return;
+    }
+    logLock->Acquire();
+    owner = currentThread;
+    depth = 1;
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	Finish a transaction.  Its sectors join the group being collected;
+//	commit the group now if it is big enough, or has waited long
+//	enough, and otherwise make sure the commit timer is set.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    ASSERT(owner == currentThread);
+    if (--depth > 0)
+	return;
+    owner = NULL;
+    if (numHeld >= GroupCommitSectors ||
+	    (numHeld > 0 && stats->totalTicks - firstHeldAt >= CommitDelay))
+	CommitGroup();
+    else if (numHeld > 0 && !timerSet) {
+	timerSet = TRUE;
+	interrupt->Schedule(CommitTimer, (int) this, CommitDelay, JournalInt);
+    }
+    logLock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Written
+// 	SynchDisk has put new contents for "sector" in the cache, and the
+//	sector isn't held already.  Return TRUE if the cache should hold
+//	it (pinned, and not written home) until the group is logged: that
+//	is, if the current thread is in a transaction.  Called with the
+//	buffer cache lock held, so it must not wait.
+//----------------------------------------------------------------------
+
+bool
+Journal::Written(int sector)
+{
+    if (owner != currentThread || sector < 0)
+	return FALSE;
+    if (numHeld == LogImages) {		// should never happen
+	DEBUG('f', "Journal full: sector %d written through\n", sector);
+	return FALSE;
+    }
+    if (numHeld == 0)
+	firstHeldAt = stats->totalTicks;
+    held[numHeld++] = sector;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Log every sector held now, and let the cache write them home.
+//	Must not be called from inside a transaction.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    ASSERT(owner != currentThread);
+    logLock->Acquire();
+    CommitGroup();
+    logLock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Daemon
+// 	The commit daemon: commit the group each time the commit timer
+//	goes off.
+//----------------------------------------------------------------------
+
+void
+Journal::Daemon()
+{
+    for (;;) {
+	commitDue->P();
+	Commit();
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitDue
+// 	Commit timer interrupt handler: wake up the commit daemon.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitDue()
+{
+    timerSet = FALSE;
+    commitDue->V();
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitGroup
+// 	Write the held sectors to the other half of the log from the last
+//	group: their contents first, in one request, and then the header
+//	that makes them count.  Before that, force home the sectors of
+//	the last group that aren't in this one, since once this group is
+//	logged, the next one will overwrite the last group's half.
+//	Called with logLock held.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitGroup()
+{
+    char *buf;
+    LogHeader *hdr;
+    int start, i;
+
+    if (numHeld == 0)
+	return;
+    for (i = 0; i < numLast; i++)
+	if (!Holding(last[i]))
+	    synchDisk->FlushSector(last[i]);
+
+    buf = new char[(numHeld + 1) * SectorSize];
+    for (i = 0; i < numHeld; i++)
+	synchDisk->ReadSector(held[i], &buf[(i + 1) * SectorSize]);
+    half = 1 - half;
+    start = LogStart + half * LogSectors / 2;
+    synchDisk->WriteRaw(start + 1, &buf[SectorSize], numHeld);
+
+    bzero(buf, SectorSize);
+    hdr = (LogHeader *) buf;
+    hdr->magic = LogMagic;
+    hdr->sequence = ++sequence;
+    hdr->numSectors = numHeld;
+    for (i = 0; i < numHeld; i++)
+	hdr->sectors[i] = held[i];
+    synchDisk->WriteRaw(start, buf, 1);	// the commit point
+    delete [] buf;
+
+    DEBUG('f', "Journal: group %d, %d sectors\n", sequence, numHeld);
+    stats->numLogCommits++;
+    stats->numLogSectors += numHeld;
+    for (i = 0; i < numHeld; i++) {
+	synchDisk->Unhold(held[i]);	// now the cache may write it home
+	last[i] = held[i];
+    }
+    numLast = numHeld;
+    numHeld = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Holding
+// 	Is "sector" in the group being collected?
+//----------------------------------------------------------------------
+
+bool
+Journal::Holding(int sector)
+{
+    for (int i = 0; i < numHeld; i++)
+	if (held[i] == sector)
+	    return TRUE;
+    return FALSE;
+}
@@ -0,0 +1,105 @@
+// journal.h
+//	Data structures for a write-ahead log of file system metadata.
+//
+//	Create, Remove, Mkdir and growing a file each change several
+//	sectors -- a file header, the directory, the free map -- that
+//	must all reach the disk or none of them.  Each of these is a
+//	"transaction": the sectors it writes are held in the buffer
+//	cache, pinned, until they have been copied to the log.  Once the
+//	log is on disk, the cache writes them home whenever it likes
+//	(the "checkpoint"), so they cost no extra waiting.
+//
+//	Transactions are committed in groups: several transactions'
+//	sectors go to the log in one sequential write, either once
+//	enough of them are held or CommitDelay ticks after the first.
+//	A sector changed by several transactions in a group is logged
+//	once.
+//
+//	The log is two halves of LogSectors / 2 sectors, used in turn.
+//	Each half is a header sector, saying which home sectors it holds,
+//	then their contents.  The header is written last: until it is on
+//	disk the group doesn't count.  Before a half is reused, the
+//	sectors of the group in the other half are forced home, so at
+//	boot we only need to reapply the newest complete group.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "synch.h"
+
+#define LogStart	SectorsPerTrack	// first sector of the log (the
+					// track after the root directory)
+#define LogSectors	(2 * DefaultSectorsPerTrack)	// sectors in the 
+					// log, whatever the geometry
+#define LogImages	(LogSectors / 2 - 1)	// sectors one group can hold
+#define GroupCommitSectors (LogImages / 2)	// held sectors that make
+					// a transaction commit at once
+#define CommitDelay	2000		// ticks a held sector may wait
+					// for its group to commit
+#define LogMagic	0x4c4f4721	// marks a valid log header
+
+// The first sector of each half of the log.
+
+class LogHeader {
+  public:
+    int magic;				// LogMagic, or the half is empty
+    int sequence;			// which group this is; the higher
+					// of the two halves is the newer
+    int numSectors;			// sectors in the group
+    int sectors[LogImages];		// where each one goes
+};
+
+// The following class defines the journal.  FileSystem brackets each
+// change with Begin and End; SynchDisk::WriteSector calls Written for
+// every sector written in between.
+
+class Journal {
+  public:
+    Journal();				// Start with nothing held; fork
+					// the commit daemon
+    ~Journal();
+
+    void Format();			// Empty the log, for a new disk
+    void Recover();			// Reapply the last group committed,
+					// after a crash
+
+    void Begin();			// Start a transaction (they nest,
+					// within one thread)
+    void End();				// Finish it; commit its group if
+					// it is time
+    bool Written(int sector);		// A sector was written: should the
+					// cache hold it until it is logged?
+    void Commit();			// Log everything held now
+
+    void Daemon();			// The commit daemon's work
+    void CommitDue();			// Called by the commit timer
+					// interrupt handler
+
+  private:
+    void CommitGroup();			// Commit; logLock is held
+    bool Holding(int sector);		// Is it in the current group?
+
+    Lock *logLock;			// Held for a transaction, or a
+					// commit, so they never overlap
+    Thread *owner;			// Thread in a transaction, or NULL
+    int depth;				// How deeply nested it is
+
+    int held[LogImages];		// Sectors of the current group
+    int numHeld;
+    long long firstHeldAt;			// When the group was started
+    int last[LogImages];		// Sectors of the last group logged,
+    int numLast;			// which may not be home yet
+    int sequence;			// Of the last group logged
+    int half;				// Which half of the log it is in
+    bool timerSet;			// Is a commit timer pending?
+    Semaphore *commitDue;		// V'ed by the timer
+};
+
+#endif // JOURNAL_H
@@ -5,7 +5,8 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open -- one copy, however many times
+//	the file is open (see FileHeaderTable, in filehdr.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -15,33 +16,44 @@
 #include "filehdr.h"
 #include "openfile.h"
 #include "system.h"
+#include "slab.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
 
+static SlabCache openFileCache("openfile", sizeof(OpenFile));
+
+void *OpenFile::operator new(size_t size) { return openFileCache.Alloc(size); }
+void OpenFile::operator delete(void *p) { openFileCache.Free(p); }
+
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it is there already
+//	because the file is open somewhere else: then we share it.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = headerTable->Acquire(sector);
+    hdrSector = sector;
+    hdrDirty = FALSE;
     seekPosition = 0;
+    lastSectorRead = prefetched = -1;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	If the file has grown since its header was last written back, the
+//	header is written back once the file's last opener closes it.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    headerTable->Release(hdrSector, hdr, hdrDirty);
 }
 
 //----------------------------------------------------------------------
@@ -98,13 +110,17 @@ OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   The whole sectors in the request are read straight into the
+//	   caller's buffer.  A partial sector at either end is read into
+//	   a one-sector buffer, and we only copy the part we are
+//	   interested in.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   The whole sectors are written straight from the caller's
+//	   buffer.  A partial sector at either end must first be read in,
+//	   so that we don't overwrite the unmodified portion; we then copy
+//	   in the data that will be modified, and write it back.
+//	   A write past the end of the file makes the file longer; any
+//	   gap between the old end and "position" reads back as zeroes.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -117,8 +133,8 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, run, firstSector, lastSector, fullFirst, fullLast, end;
+    char buf[SectorSize];
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
@@ -127,19 +143,43 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
+    end = position + numBytes;
     firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    lastSector = divRoundDown(end - 1, SectorSize);
+    fullFirst = divRoundUp(position, SectorSize);	// the whole sectors
+    fullLast = divRoundDown(end, SectorSize) - 1;
+
+    // if we are reading the file in order, start on what comes next
+    if (firstSector == lastSectorRead || firstSector == lastSectorRead + 1)
+	ReadAhead(lastSector, divRoundUp(fileLength, SectorSize));
+    else
+	prefetched = lastSector;
+    lastSectorRead = lastSector;
+
+    // a partial first sector: copy the part we want
+    if (firstSector < fullFirst) {
+	synchDisk->ReadSector(hdr->ByteToSector(position), buf);
+	bcopy(&buf[position - firstSector * SectorSize], into, 
+		min(end, fullFirst * SectorSize) - position);
+    }
+
+    // read the whole sectors in place, a run of consecutive disk 
+    // sectors at a time
+    for (i = fullFirst; i <= fullLast; i += run) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	for (run = 1; i + run <= fullLast; run++)
+	    if (hdr->ByteToSector((i + run) * SectorSize) != sector + run)
+		break;
+        synchDisk->ReadSectors(sector, &into[i * SectorSize - position], run);
+    }
+
+    // a partial last sector, if it isn't the first one as well
+    if (lastSector > fullLast && lastSector >= fullFirst) {
+	synchDisk->ReadSector(hdr->ByteToSector(lastSector * SectorSize), buf);
+	bcopy(buf, &into[lastSector * SectorSize - position], 
+		end - lastSector * SectorSize);
+    }
     return numBytes;
 }
 
@@ -147,44 +187,88 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
+    int i, firstSector, lastSector, fullFirst, fullLast, end;
     char *buf;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position < 0))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
+    if ((position + numBytes) > fileLength) {
+	if (hdr->SetLength(position + numBytes))
+	    hdrDirty = TRUE;			// had room already
+	else if (!fileSystem->Extend(hdr, hdrSector, position + numBytes)) {
+	    if (position >= fileLength)
+		return 0;			// disk full
+	    numBytes = fileLength - position;
+	}
+	if (position > fileLength) {		// clear the gap
+	    buf = new char[position - fileLength];
+	    bzero(buf, position - fileLength);
+	    WriteAt(buf, position - fileLength, fileLength);
+	    delete [] buf;
+	}
+	fileLength = hdr->FileLength();
+    }
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
+    end = position + numBytes;
     firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    lastSector = divRoundDown(end - 1, SectorSize);
+    fullFirst = divRoundUp(position, SectorSize);	// the whole sectors
+    fullLast = divRoundDown(end, SectorSize) - 1;
 
-    buf = new char[numSectors * SectorSize];
+// a partially modified first sector: read it in, copy in the bytes we 
+// want to change, and write it back
+    if (firstSector < fullFirst) {
+	char sectorBuf[SectorSize];
+	int sector = hdr->ByteToSector(position);
 
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
+	synchDisk->ReadSector(sector, sectorBuf);
+	bcopy(from, &sectorBuf[position - firstSector * SectorSize],
+		min(end, fullFirst * SectorSize) - position);
+	synchDisk->WriteSector(sector, sectorBuf);
+    }
 
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
+// the whole sectors are written as they are
+    for (i = fullFirst; i <= fullLast; i++)	
+        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
+					&from[i * SectorSize - position]);
 
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+// and a partially modified last sector, if it isn't the first one too
+    if (lastSector > fullLast && lastSector >= fullFirst) {
+	char sectorBuf[SectorSize];
+	int sector = hdr->ByteToSector(lastSector * SectorSize);
 
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+	synchDisk->ReadSector(sector, sectorBuf);
+	bcopy(&from[lastSector * SectorSize - position], sectorBuf,
+		end - lastSector * SectorSize);
+	synchDisk->WriteSector(sector, sectorBuf);
+    }
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	The file is being read sequentially: ask for the ReadAheadSectors
+//	after "lastSector" to be read into the buffer cache in the
+//	background, skipping any asked for already.
+//
+//	"lastSector" -- the last sector (within the file) being read now
+//	"numSectors" -- the length of the file, in sectors
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int lastSector, int numSectors)
+{
+    int i = max(prefetched + 1, lastSector + 1);
+    int limit = min(lastSector + ReadAheadSectors, numSectors - 1);
+
+    for (; i <= limit; i++)
+	synchDisk->ReadAhead(hdr->ByteToSector(i * SectorSize));
+    if (limit > prefetched)
+	prefetched = limit;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -61,11 +61,16 @@ class OpenFile {
 #else // FILESYS
 class FileHeader;
 
+#define ReadAheadSectors	4	// how far ahead of a sequential
+					// reader to read
+
 class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
 					// at "sector" on the disk
     ~OpenFile();			// Close the file
+    void *operator new(size_t size);	// From a SlabCache, as files are
+    void operator delete(void *p);	// opened and closed all the time
 
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
@@ -87,8 +92,20 @@ class OpenFile {
 					// end of file, tell, lseek back 
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    void ReadAhead(int lastSector, int numSectors);
+					// Prefetch what follows "lastSector"
+
+    FileHeader *hdr;			// Header for this file, shared with
+					// everyone else who has it open
+    int hdrSector;			// Where it lives on disk
+    bool hdrDirty;			// Has the file grown, within the 
+					// data blocks it had?  (If so, the
+					// header is written back when the
+					// last opener closes it)
     int seekPosition;			// Current position within the file
+    int lastSectorRead;			// Last sector of the last ReadAt
+    int prefetched;			// Last sector read ahead, if we are
+					// reading sequentially
 };
 
 #endif // FILESYS
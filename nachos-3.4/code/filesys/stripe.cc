@@ -0,0 +1,111 @@
+// stripe.cc
+//	Routines to read and write a region striped across disks.  See
+//	stripe.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "stripe.h"
+
+//----------------------------------------------------------------------
+// StripeSet::StripeSet
+// 	Initialize a striped region.
+//
+//	"members" -- the disks, in order; unit 0 is on the first
+//	"count" -- how many (at most MaxDisks)
+//	"firstSector" -- the region's first sector, on every disk
+//	"unit" -- sectors in a unit
+//----------------------------------------------------------------------
+
+StripeSet::StripeSet(SynchDisk **members, int count, int firstSector,
+			int unit)
+{
+    ASSERT(count > 0 && count <= MaxDisks && unit > 0);
+    disks = members;
+    numDisks = count;
+    start = firstSector;
+    unitSectors = unit;
+}
+
+//----------------------------------------------------------------------
+// StripeSet::Read, StripeSet::Write
+// 	Read or write a run of consecutive units.
+//
+//	"unit" -- the first unit
+//	"into"/"from" -- the units' contents, one after the other
+//	"count" -- how many units
+//----------------------------------------------------------------------
+
+void
+StripeSet::Read(int unit, char *into, int count)
+{
+    Transfer(unit, into, count, FALSE);
+}
+
+void
+StripeSet::Write(int unit, char *from, int count)
+{
+    Transfer(unit, from, count, TRUE);
+}
+
+//----------------------------------------------------------------------
+// StripeSet::Transfer
+// 	Start one raw request on each disk that holds some of the units,
+//	then wait for all of them.  A disk's units are consecutive on that
+//	disk, but every numDisks'th in "data", so unless a disk has only
+//	one of them, they go through a buffer of their own.
+//----------------------------------------------------------------------
+
+void
+StripeSet::Transfer(int unit, char *data, int count, bool writing)
+{
+    int unitBytes = unitSectors * SectorSize;
+    Semaphore done("stripe request", 0);
+    DiskRequest request[MaxDisks];
+    char *buf[MaxDisks];
+    int first[MaxDisks], units[MaxDisks];
+    int d, i, started = 0;
+
+    ASSERT(unit >= 0 && count > 0);
+    for (d = 0; d < numDisks; d++) {
+	first[d] = unit + (d - unit % numDisks + numDisks) % numDisks;
+	units[d] = 0;
+	buf[d] = NULL;
+	if (first[d] >= unit + count)
+	    continue;			// nothing on this disk
+	units[d] = (unit + count - 1 - first[d]) / numDisks + 1;
+	if (units[d] == 1)
+	    buf[d] = &data[(first[d] - unit) * unitBytes];
+	else {
+	    buf[d] = new char[units[d] * unitBytes];
+	    if (writing)
+		for (i = 0; i < units[d]; i++)
+		    bcopy(&data[(first[d] + i * numDisks - unit) * unitBytes],
+				&buf[d][i * unitBytes], unitBytes);
+	}
+	request[d].sector = start + (first[d] / numDisks) * unitSectors;
+	request[d].numSectors = units[d] * unitSectors;
+	request[d].data = buf[d];
+	request[d].writing = writing;
+	request[d].done = &done;
+	disks[d]->StartRaw(&request[d]);
+	started++;
+    }
+
+    while (started-- > 0)
+	done.P();
+
+    for (d = 0; d < numDisks; d++) {
+	if (units[d] <= 1)
+	    continue;
+	if (!writing)
+	    for (i = 0; i < units[d]; i++)
+		bcopy(&buf[d][i * unitBytes],
+			&data[(first[d] + i * numDisks - unit) * unitBytes],
+			unitBytes);
+	delete [] buf[d];
+    }
+}
@@ -0,0 +1,52 @@
+// stripe.h
+//	Data structures for spreading a region across several disks.
+//
+//	With "-nd n", Nachos simulates n disks: DISK, and raw disks
+//	DISK1, DISK2, ...  Each is a SynchDisk of its own, with its own
+//	request queue and interrupts, so all of them can be working at
+//	once.  A StripeSet cuts a region into units of a fixed number of
+//	sectors, and puts them on the disks round-robin: unit u is on
+//	disk u % n, at the same place in the region on every disk.  So
+//	consecutive units are on different disks, and a request for a run
+//	of them is split into one request per disk, all started before
+//	waiting for any.
+//
+//	The swap area is striped this way, a slot per unit.  The file
+//	system stays on DISK: its sector numbers (in file headers and
+//	the free map) are sectors of one disk.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include "copyright.h"
+#include "synchdisk.h"
+
+// The following class defines a region striped across disks.
+
+class StripeSet {
+  public:
+    StripeSet(SynchDisk **members, int count, int firstSector, int unit);
+					// Units of "unitSectors" sectors,
+					// from sector "start" of each disk
+
+    void Read(int unit, char *into, int count);
+    void Write(int unit, char *from, int count);
+					// Read/write "count" consecutive
+					// units, one request per disk, in
+					// parallel; returns once all are done
+    int NumDisks() { return numDisks; }
+
+  private:
+    void Transfer(int unit, char *data, int count, bool writing);
+
+    SynchDisk **disks;
+    int numDisks;
+    int start;				// first sector of the region
+    int unitSectors;			// sectors per unit
+};
+
+#endif // STRIPE_H
@@ -7,8 +7,17 @@
 //
 //	Use a semaphore to synchronize the interrupt handlers with the
 //	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	handle one operation at a time, queue the requests that arrive
+//	while it is busy; the interrupt handler starts the next one, in
+//	elevator order.
+//
+//	Requests are served from a buffer cache of recently used sectors
+//	when possible.  The cache has its own lock, which is not held
+//	during disk I/O: an entry being read or written is marked busy
+//	instead, and anyone else wanting it waits until it is done.
+//
+//	Read-ahead and write-behind are done by the disk daemon thread,
+//	which is woken by ReadAhead and by WriteSector.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +25,8 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
+#include "journal.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -31,6 +42,19 @@ DiskRequestDone (int arg)
     disk->RequestDone();
 }
 
+//----------------------------------------------------------------------
+// DiskDaemon
+// 	Body of the disk daemon thread.  A C routine, for Fork.
+//----------------------------------------------------------------------
+
+static void
+DiskDaemon (int arg)
+{
+    SynchDisk* disk = (SynchDisk *)arg;
+
+    disk->Daemon();
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
@@ -38,32 +62,56 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"mapped" -- access the file through memory, not system calls
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, bool mapped)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (int) this);
+    active = NULL;
+    queue = new IntrusiveList<DiskRequest>;
+    headKey = 0;
+    disk = new Disk(name, DiskRequestDone, (int) this, mapped);
+
+    cacheLock = new Lock("buffer cache lock");
+    entryReady = new Condition("buffer cache entry ready");
+    lru = new IntrusiveList<CacheEntry>;
+    for (int i = 0; i < CacheBuckets; i++)
+	buckets[i] = NULL;
+    for (int i = 0; i < CacheSectors; i++) {
+	cache[i].sector = -1;
+	cache[i].dirty = cache[i].busy = cache[i].held = FALSE;
+	cache[i].pins = 0;
+	cache[i].hashNext = NULL;
+	lru->Append(&cache[i]);
+    }
+    numDirty = 0;
+
+    readAheadHead = numReadAhead = 0;
+    daemonWork = new Condition("disk daemon work");
+    (new Thread("disk daemon"))->Fork(DiskDaemon, (int) this);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::~SynchDisk
-// 	De-allocate data structures needed for the synchronous disk
-//	abstraction.
+// 	Write back the buffer cache, and de-allocate data structures 
+//	needed for the synchronous disk abstraction.
 //----------------------------------------------------------------------
 
 SynchDisk::~SynchDisk()
 {
+    Flush();
+    delete lru;
+    delete daemonWork;
+    delete entryReady;
+    delete cacheLock;
     delete disk;
-    delete lock;
-    delete semaphore;
+    delete queue;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
 // 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+//	after the data has been read -- from the cache, if it's there.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -72,14 +120,519 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    CacheEntry *entry;
+
+    cacheLock->Acquire();
+    entry = GetEntry(sectorNumber, TRUE);
+    bcopy(entry->data, data, SectorSize);
+    Unpin(entry);
+    cacheLock->Release();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
+// 	Write the contents of a buffer into a disk sector.  The cache
+//	gets the new contents at once; they go to the disk later.  If
+//	the journal wants the sector held until its transaction is
+//	logged, the entry stays pinned until then.
+//
+//	"sectorNumber" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSector(int sectorNumber, char* data)
+{
+    CacheEntry *entry;
+
+    cacheLock->Acquire();
+    entry = GetEntry(sectorNumber, FALSE);	// whole sector: no need to
+    bcopy(data, entry->data, SectorSize);	// read the old contents
+    if (!entry->dirty) {
+	entry->dirty = TRUE;
+	if (++numDirty >= WriteBehindDirty)
+	    daemonWork->Signal(cacheLock);	// time for write-behind
+    }
+    if (journal != NULL && !entry->held && journal->Written(sectorNumber)) {
+	entry->held = TRUE;
+	entry->pins++;			// until Unhold
+    }
+    Unpin(entry);
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read the contents of a run of consecutive disk sectors into a 
+//	buffer.  Cached sectors are copied from the cache; each run of 
+//	sectors that aren't is read with one disk request, if there are
+//	enough clean cache entries free to hold them.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"data" -- the buffer to hold their contents
+//	"numSectors" -- how many sectors to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int sectorNumber, char* data, int numSectors)
+{
+    CacheEntry *run[MaxRunSectors];
+    char *buf = NULL;
+    int i, j, n;
+
+    cacheLock->Acquire();
+    for (i = 0; i < numSectors; i += n) {
+	n = ClaimRun(sectorNumber + i, min(numSectors - i, MaxRunSectors), 
+			run);
+	if (n == 0) {			// cached, or we'd have to wait
+	    run[0] = GetEntry(sectorNumber + i, TRUE);
+	    bcopy(run[0]->data, &data[i * SectorSize], SectorSize);
+	    Unpin(run[0]);
+	    n = 1;
+	    continue;
+	}
+	if (buf == NULL)
+	    buf = new char[MaxRunSectors * SectorSize];
+	cacheLock->Release();
+	DiskIO(sectorNumber + i, buf, FALSE, n);
+	cacheLock->Acquire();
+	for (j = 0; j < n; j++) {
+	    bcopy(&buf[j * SectorSize], run[j]->data, SectorSize);
+	    bcopy(&buf[j * SectorSize], &data[(i + j) * SectorSize], 
+			SectorSize);
+	    run[j]->busy = FALSE;
+	    Unpin(run[j]);
+	}
+	entryReady->Broadcast(cacheLock);
+    }
+    cacheLock->Release();
+    delete [] buf;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write every modified sector in the cache back to the disk, except
+//	the ones held for the journal.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    cacheLock->Acquire();
+    (void) WriteBehind();		// the unused ones, in runs
+    for (int i = 0; i < CacheSectors; i++) {
+	while (cache[i].busy)
+	    entryReady->Wait(cacheLock);
+	if (cache[i].dirty && !cache[i].held) {
+	    cache[i].pins++;
+	    if (cache[i].pins == 1)
+		lru->Detach(&cache[i]);
+	    WriteBack(&cache[i]);
+	    Unpin(&cache[i]);
+	}
+    }
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FlushSector
+// 	Write one sector back to the disk, if it is cached, modified and
+//	not held for the journal.
+//
+//	"sectorNumber" -- the disk sector to write back
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FlushSector(int sectorNumber)
+{
+    CacheEntry *entry;
+
+    cacheLock->Acquire();
+    while ((entry = Lookup(sectorNumber)) != NULL && entry->busy)
+	entryReady->Wait(cacheLock);
+    if (entry != NULL && entry->dirty && !entry->held) {
+	if (entry->pins++ == 0)
+	    lru->Detach(entry);
+	WriteBack(entry);
+	Unpin(entry);
+    }
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Unhold
+// 	The journal has logged a sector it was holding: its entry can be
+//	written back, and reused, like any other.
+//
+//	"sectorNumber" -- the disk sector
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Unhold(int sectorNumber)
+{
+    CacheEntry *entry;
+
+    cacheLock->Acquire();
+    entry = Lookup(sectorNumber);
+    ASSERT(entry != NULL && entry->held);
+    entry->held = FALSE;
+    Unpin(entry);
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadRaw, SynchDisk::WriteRaw
+// 	Read or write a run of consecutive sectors with one disk request,
+//	not going through the cache.  Only for sectors that are never
+//	cached.
+//
+//	"sectorNumber" -- the first disk sector
+//	"data" -- the buffer for their contents
+//	"numSectors" -- how many sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadRaw(int sectorNumber, char* data, int numSectors)
+{
+    DiskIO(sectorNumber, data, FALSE, numSectors);
+}
+
+void
+SynchDisk::WriteRaw(int sectorNumber, char* data, int numSectors)
+{
+    DiskIO(sectorNumber, data, TRUE, numSectors);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadAhead
+// 	Ask the disk daemon to read a sector into the cache, which we
+//	expect to be wanted soon.  Doesn't wait.  The request is dropped
+//	if the sector is already cached or queued, or too many requests
+//	are queued.
+//
+//	"sectorNumber" -- the disk sector to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadAhead(int sectorNumber)
+{
+    int i;
+
+    cacheLock->Acquire();
+    for (i = 0; i < numReadAhead; i++)
+	if (readAhead[(readAheadHead + i) % ReadAheadQueue] == sectorNumber)
+	    break;				// already asked for
+    if (i == numReadAhead && numReadAhead < ReadAheadQueue &&
+				Lookup(sectorNumber) == NULL) {
+	readAhead[(readAheadHead + numReadAhead) % ReadAheadQueue] = 
+								sectorNumber;
+	numReadAhead++;
+	daemonWork->Signal(cacheLock);
+    }
+    cacheLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Daemon
+// 	The disk daemon: read in the sectors queued by ReadAhead, oldest
+//	request first, and when too much of the cache is modified, write
+//	it back.  Sleep when there is nothing to do.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Daemon()
+{
+    cacheLock->Acquire();
+    for (;;) {
+	if (numReadAhead > 0) {
+	    int sector = readAhead[readAheadHead];
+
+	    readAheadHead = (readAheadHead + 1) % ReadAheadQueue;
+	    numReadAhead--;
+	    if (Lookup(sector) == NULL)
+		Unpin(GetEntry(sector, TRUE));
+	} else if (numDirty < WriteBehindDirty || WriteBehind() == 0)
+	    daemonWork->Wait(cacheLock);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Lookup
+// 	Return the cache entry holding a sector, or NULL if it isn't 
+//	cached.  Called with cacheLock held.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Lookup(int sectorNumber)
+{
+    CacheEntry *entry;
+
+    for (entry = buckets[Hash(sectorNumber)]; entry != NULL; 
+					entry = entry->hashNext)
+	if (entry->sector == sectorNumber)
+	    return entry;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::GetEntry
+// 	Return the cache entry for a sector, pinned.  If the sector isn't
+//	cached, take the least recently used unpinned entry for it, 
+//	writing its old contents back first if they were modified.  Wait
+//	if every entry is pinned.  Called with cacheLock held; it is
+//	released while waiting for the disk.
+//
+//	"sectorNumber" -- the sector wanted
+//	"reading" -- FALSE if the caller is about to overwrite the whole
+//		sector, so its old contents needn't be read in
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::GetEntry(int sectorNumber, bool reading)
+{
+    CacheEntry *entry;
+
+    for (;;) {
+	entry = Lookup(sectorNumber);
+	if (entry != NULL) {			// a hit
+	    if (entry->busy) {
+		entryReady->Wait(cacheLock);
+		continue;
+	    }
+	    if (entry->pins++ == 0)
+		lru->Detach(entry);
+	    stats->numCacheHits++;
+	    return entry;
+	}
+
+	entry = lru->Remove();			// a miss: find room
+	if (entry == NULL) {			// everything is pinned
+	    entryReady->Wait(cacheLock);
+	    continue;
+	}
+	if (entry->busy) {			// the daemon is writing it
+	    lru->Prepend(entry);
+	    entryReady->Wait(cacheLock);
+	    continue;
+	}
+	if (entry->dirty) {
+	    entry->pins = 1;
+	    WriteBack(entry);
+	    entry->pins = 0;			// still the one to reuse next,
+	    lru->Prepend(entry);		// but we waited: someone may 
+	    entryReady->Broadcast(cacheLock);	// have brought the sector in
+	    continue;
+	}
+	entry->pins = 1;
+	Unhash(entry);
+	entry->sector = sectorNumber;
+	entry->hashNext = buckets[Hash(sectorNumber)];
+	buckets[Hash(sectorNumber)] = entry;
+	stats->numCacheMisses++;
+	if (reading) {
+	    entry->busy = TRUE;
+	    cacheLock->Release();
+	    DiskRead(sectorNumber, entry->data);
+	    cacheLock->Acquire();
+	    entry->busy = FALSE;
+	    entryReady->Broadcast(cacheLock);
+	}
+	return entry;
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Unpin
+// 	The caller is done with a cache entry.  Once nobody is using it,
+//	it goes on the end of the LRU list.  If it is modified, and too
+//	much of the cache is, wake the daemon: it may have gone to sleep
+//	because every modified entry was pinned.  Called with cacheLock
+//	held.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Unpin(CacheEntry *entry)
+{
+    ASSERT(entry->pins > 0);
+    if (--entry->pins == 0) {
+	lru->Append(entry);
+	entryReady->Broadcast(cacheLock);
+	if (entry->dirty && numDirty >= WriteBehindDirty)
+	    daemonWork->Signal(cacheLock);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBack
+// 	Write a modified, pinned cache entry back to the disk.  Called
+//	with cacheLock held; it is released during the write.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteBack(CacheEntry *entry)
+{
+    entry->busy = TRUE;
+    entry->dirty = FALSE;		// (a write meanwhile waits for us)
+    numDirty--;
+    cacheLock->Release();
+    DiskWrite(entry->sector, entry->data);
+    cacheLock->Acquire();
+    entry->busy = FALSE;
+    entryReady->Broadcast(cacheLock);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBehind
+// 	Write back every modified entry that nobody is using, coalescing
+//	entries for consecutive sectors into one disk request.  They stay
+//	where they are on the LRU list while being written; they are 
+//	marked busy, so nobody reuses them until the write is done.  
+//	Called with cacheLock held.
+//
+// Returns:
+//	the number of entries written
+//----------------------------------------------------------------------
+
+static bool
+Unused(CacheEntry *entry)		// dirty, and nobody using it?
+{
+    return entry != NULL && entry->dirty && !entry->busy && 
+						entry->pins == 0;
+}
+
+int
+SynchDisk::WriteBehind()
+{
+    CacheEntry *run[MaxRunSectors];
+    int written = 0, first, n;
+
+    for (int i = 0; i < CacheSectors; i++) {
+	if (!Unused(&cache[i]))
+	    continue;
+	first = cache[i].sector;	// find the start of its run
+	while (first > 0 && cache[i].sector - first < MaxRunSectors - 1 &&
+					Unused(Lookup(first - 1)))
+	    first--;
+	for (n = 0; n < MaxRunSectors && Unused(Lookup(first + n)); n++)
+	    run[n] = Lookup(first + n);
+	WriteRun(run, n);
+	written += n;
+    }
+    return written;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteRun
+// 	Write a run of modified, unused cache entries for consecutive 
+//	sectors back to the disk with one request.  Called with cacheLock
+//	held; it is released during the write.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteRun(CacheEntry **run, int numSectors)
+{
+    char *buf;
+    int i;
+
+    if (numSectors == 1) {		// no need to copy
+	WriteBack(run[0]);
+	return;
+    }
+    buf = new char[numSectors * SectorSize];
+    for (i = 0; i < numSectors; i++) {
+	run[i]->busy = TRUE;
+	run[i]->dirty = FALSE;
+	numDirty--;
+	bcopy(run[i]->data, &buf[i * SectorSize], SectorSize);
+    }
+    cacheLock->Release();
+    DiskIO(run[0]->sector, buf, TRUE, numSectors);
+    cacheLock->Acquire();
+    for (i = 0; i < numSectors; i++)
+	run[i]->busy = FALSE;
+    entryReady->Broadcast(cacheLock);
+    delete [] buf;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ClaimRun
+// 	Take cache entries for a run of consecutive sectors, starting at
+//	"sectorNumber", that aren't cached, and mark them busy, so the 
+//	caller can read them all in at once.  Stops at the first sector 
+//	that is cached, or when the least recently used entry can't be
+//	reused without waiting.  Called with cacheLock held, which is 
+//	never released.
+//
+//	"sectorNumber" -- the first sector wanted
+//	"numSectors" -- how many we would like, at most
+//	"run" -- where to put the entries, pinned
+//
+// Returns:
+//	the number of entries taken
+//----------------------------------------------------------------------
+
+int
+SynchDisk::ClaimRun(int sectorNumber, int numSectors, CacheEntry **run)
+{
+    CacheEntry *entry;
+    int n, sector;
+
+    for (n = 0; n < numSectors; n++) {
+	sector = sectorNumber + n;
+	if (Lookup(sector) != NULL || (entry = lru->Remove()) == NULL)
+	    break;
+	if (entry->dirty || entry->busy) {	// would have to wait
+	    lru->Prepend(entry);
+	    break;
+	}
+	Unhash(entry);
+	entry->sector = sector;
+	entry->hashNext = buckets[Hash(sector)];
+	buckets[Hash(sector)] = entry;
+	entry->pins = 1;
+	entry->busy = TRUE;
+	stats->numCacheMisses++;
+	run[n] = entry;
+    }
+    return n;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Unhash
+// 	Take a cache entry off its hash chain, if it is on one.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Unhash(CacheEntry *entry)
+{
+    CacheEntry **ptr;
+
+    if (entry->sector == -1)
+	return;
+    for (ptr = &buckets[Hash(entry->sector)]; *ptr != entry; 
+						ptr = &(*ptr)->hashNext)
+	ASSERT(*ptr != NULL);
+    *ptr = entry->hashNext;
+    entry->hashNext = NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskRead
+// 	Read the contents of a disk sector into a buffer.  Return only
+//	after the data has been read.
+//
+//	"sectorNumber" -- the disk sector to read
+//	"data" -- the buffer to hold the contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+SynchDisk::DiskRead(int sectorNumber, char* data)
+{
+    DiskIO(sectorNumber, data, FALSE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskWrite
 // 	Write the contents of a buffer into a disk sector.  Return only
 //	after the data has been written.
 //
@@ -88,22 +641,134 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 //----------------------------------------------------------------------
 
 void
-SynchDisk::WriteSector(int sectorNumber, char* data)
+SynchDisk::DiskWrite(int sectorNumber, char* data)
+{
+    DiskIO(sectorNumber, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskIO
+// 	Send a request to the disk, or if it is busy, queue it; and wait
+//	for the request to be done.
+//
+//	"sectorNumber" -- the (first) disk sector to read or write
+//	"data" -- the buffer for the sectors' contents
+//	"writing" -- TRUE to write the sectors, FALSE to read them
+//	"numSectors" -- how many consecutive sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::DiskIO(int sectorNumber, char* data, bool writing, 
+						int numSectors)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Semaphore done("disk request", 0);
+    DiskRequest request;
+
+    request.sector = sectorNumber;
+    request.numSectors = numSectors;
+    request.data = data;
+    request.writing = writing;
+    request.done = &done;
+    StartRaw(&request);
+    done.P();				// wait for interrupt
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartRaw
+// 	Queue a request for the disk, bypassing the cache, and return at
+//	once; "request->done" is V'ed when it is finished.  A thread can
+//	so keep several disks busy at the same time (see StripeSet).  The
+//	request must not go away until it is done.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartRaw(DiskRequest *request)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    queue->SortedInsert(request, Key(request->sector));
+    if (active == NULL)			// the disk is idle
+	StartNext();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Key
+// 	Return where a request for "sectorNumber" goes in the elevator
+//	order.  Keys increase as the head sweeps up the disk; each sweep is
+//	NumSectors further on.  A sector the head has already passed goes
+//	in the next sweep.  Called with interrupts off.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::Key(int sectorNumber)
+{
+    int key = (headKey / NumSectors) * NumSectors + sectorNumber;
+
+    if (key / SectorsPerTrack < headKey / SectorsPerTrack)
+	key += NumSectors;	// an earlier track: wait for the next sweep
+    return key;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartNext
+// 	Send the next queued request to the disk, if there is one.  That 
+//	is the first one in elevator order, or if others are queued for
+//	the same track, whichever of them can be done soonest.  Called 
+//	with interrupts off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartNext()
+{
+    DiskRequest *best, *next, *others = NULL;
+    int key, bestKey, track;
+
+    active = NULL;
+    if (queue->IsEmpty())
+	return;
+    best = queue->SortedRemove(&bestKey);
+    track = bestKey / SectorsPerTrack;
+    while (queue->SortedPeek(&key) && key / SectorsPerTrack == track) {
+	next = queue->SortedRemove(&key);
+	if (disk->ComputeLatency(next->sector, next->writing, 
+							next->numSectors) <
+		disk->ComputeLatency(best->sector, best->writing, 
+							best->numSectors)) {
+	    best->listKey = bestKey;
+	    best->listNext = others;	// (chain the losers on listNext,
+	    others = best;		// until they are put back)
+	    best = next;
+	    bestKey = key;
+	} else {
+	    next->listKey = key;
+	    next->listNext = others;
+	    others = next;
+	}
+    }
+    while (others != NULL) {
+	next = others->listNext;
+	queue->SortedInsert(others, others->listKey);
+	others = next;
+    }
+
+    active = best;
+    headKey = bestKey;
+    if (best->writing)
+	disk->WriteRequest(best->sector, best->data, best->numSectors);
+    else
+	disk->ReadRequest(best->sector, best->data, best->numSectors);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Wake up the thread waiting for the disk
+//	request to finish, and start the next one.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
 { 
-    semaphore->V();
+    active->done->V();
+    StartNext();
 }
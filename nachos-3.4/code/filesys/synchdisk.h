@@ -14,6 +14,50 @@
 #include "disk.h"
 #include "synch.h"
 
+#define CacheSectors	64		// sectors kept in the buffer cache
+#define CacheBuckets	61		// hash chains for finding them
+#define ReadAheadQueue	16		// read-ahead requests not yet started
+#define MaxRunSectors	8		// most sectors in one disk request
+#define WriteBehindDirty (CacheSectors / 4)	// modified sectors that
+					// wake up the disk daemon
+#define MaxDisks	8		// most simulated disks (-nd)
+
+// One sector's worth of the buffer cache.  While an entry is pinned,
+// it stays put; otherwise it is on the LRU list, and may be reused for
+// another sector.  While it is busy, it is being read from or written
+// to the disk, and its data can't be used yet.  While it is held, it
+// belongs to a journal transaction that hasn't been logged, and must
+// not be written home (it is also pinned).
+
+class CacheEntry {
+  public:
+    int sector;				// which sector, or -1 if none
+    bool dirty;				// modified since it was read?
+    bool busy;				// disk I/O in progress
+    bool held;				// waiting for the journal
+    int pins;				// users that need it to stay put
+    char data[SectorSize];		// the sector's contents
+
+    CacheEntry *hashNext;		// next entry on the same hash chain
+    CacheEntry *listNext, *listPrev;	// neighbours on the LRU list
+    int listKey;			// (unused)
+};
+
+// A request for the raw disk, waiting for its turn or in progress.
+// Requests are sent to the disk in elevator order (see SynchDisk::Key).
+
+class DiskRequest {
+  public:
+    int sector;				// the first sector to read or write
+    int numSectors;			// how many, consecutive
+    char *data;				// where their contents go, or come from
+    bool writing;			// a write?
+    Semaphore *done;			// V'ed once the request is finished
+
+    DiskRequest *listNext, *listPrev;	// neighbours in the request queue
+    int listKey;			// (its elevator order)
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -24,30 +68,110 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// Sectors go through a buffer cache: a read of a sector that is
+// already cached doesn't touch the disk, and a write only updates the
+// cache.  Modified sectors are written back when their entry is reused
+// for another sector (least recently used first), on Flush, and when
+// the SynchDisk is deleted -- except those the journal is holding,
+// which wait until it has logged them.
+//
+// A disk daemon thread works in the background.  It reads in sectors
+// asked for with ReadAhead, before anyone needs them, and once enough
+// of the cache is modified, writes it back (write-behind), so that 
+// reusing an entry rarely has to wait for a write.
+//
+// Any number of threads can be waiting for the raw disk at once.  Their
+// requests are queued, and sent to the disk in C-LOOK order: the head 
+// sweeps towards higher tracks, serving every request on its way, then
+// goes back to the lowest track wanted.  Of the requests on the same 
+// track, the one that will pass under the head soonest goes first.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
+    SynchDisk(char* name, bool mapped = FALSE);
+    					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
-    ~SynchDisk();			// De-allocate the synch disk data
+					// (mapped into memory, if "mapped")
+    ~SynchDisk();			// Write back the cache, and
+					// de-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
+					// or written (into the cache).  On 
+					// a cache miss, these call
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+    void ReadSectors(int sectorNumber, char* data, int numSectors);
+					// Read a run of consecutive sectors;
+					// the ones not cached are read with 
+					// as few requests as possible
+
+    void Flush();			// Write every modified sector in
+					// the cache back to disk
+    void FlushSector(int sectorNumber);	// Write back one, if modified
+
+    void Unhold(int sectorNumber);	// The journal has logged it: it
+					// may go home now
+    void ReadRaw(int sectorNumber, char* data, int numSectors);
+    void WriteRaw(int sectorNumber, char* data, int numSectors);
+					// Read/write consecutive sectors
+					// straight to the disk, bypassing
+					// the cache (for the journal's log)
+    void StartRaw(DiskRequest *request);
+					// Queue a raw request without
+					// waiting; request->done is V'ed
+					// once it is finished
+    void ReadAhead(int sectorNumber);	// Start reading a sector into the
+					// cache, without waiting for it
+    void Daemon();			// The disk daemon's work
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
 
   private:
+    void DiskRead(int sectorNumber, char* data);	// Do the I/O,
+    void DiskWrite(int sectorNumber, char* data);	// and wait for it
+    void DiskIO(int sectorNumber, char* data, bool writing, 
+		int numSectors = 1);
+    int Key(int sectorNumber);		// Its place in the elevator order
+    void StartNext();			// Send the next request to the disk
+
+    CacheEntry *Lookup(int sectorNumber);	// The entry for a sector,
+					// or NULL if it isn't cached
+    CacheEntry *GetEntry(int sectorNumber, bool reading);
+					// Find or load a sector, and pin it
+    void Unpin(CacheEntry *entry);	// Done with it, for now
+    void WriteBack(CacheEntry *entry);	// Write out a dirty entry
+    int WriteBehind();			// Write out the unused dirty ones
+    int ClaimRun(int sectorNumber, int numSectors, CacheEntry **run);
+					// Take entries for uncached sectors
+    void WriteRun(CacheEntry **run, int numSectors);
+					// Write out consecutive dirty ones
+    int Hash(int sectorNumber) { return sectorNumber % CacheBuckets; }
+    void Unhash(CacheEntry *entry);	// Take it off its hash chain
+
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskRequest *active;		// Request the disk is working on
+    IntrusiveList<DiskRequest> *queue;	// Requests waiting for the disk
+    int headKey;			// Key of the last request started:
+					// where the elevator has got to
+
+    CacheEntry cache[CacheSectors];	// The buffer cache
+    CacheEntry *buckets[CacheBuckets];	// Hash chains, by sector
+    IntrusiveList<CacheEntry> *lru;	// Unpinned entries, least recently
+					// used first
+    Lock *cacheLock;			// Protects all of the above
+    Condition *entryReady;		// Signalled when an entry stops 
+					// being busy, or is unpinned
+    int numDirty;			// modified entries
+
+    int readAhead[ReadAheadQueue];	// sectors to read in, in order
+    int readAheadHead, numReadAhead;	// (a circular buffer)
+    Condition *daemonWork;		// Signalled when the daemon has
+					// something to do
 };
 
 #endif // SYNCHDISK_H
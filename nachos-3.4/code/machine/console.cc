@@ -53,7 +53,9 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
     readHandler = readAvail;
     handlerArg = callArg;
     putBusy = FALSE;
-    incoming = EOF;
+    putCount = 0;
+    inHead = inCount = unsignalled = 0;
+    firstUnsignalled = 0;
 
     // start polling for incoming packets
     interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, ConsoleReadInt);
@@ -78,29 +80,63 @@ Console::~Console()
 //	input from the simulated keyboard (eg, has it been typed?).
 //
 //	Only read it in if there is buffer space for it (if the previous
-//	character has been grabbed out of the buffer by the Nachos kernel).
-//	Invoke the "read" interrupt handler, once the character has been 
-//	put into the buffer. 
+//	character has been grabbed out of the buffer by the Nachos kernel,
+//	or, when coalescing, if the ring isn't full).  Invoke the "read" 
+//	interrupt handler once the characters have been put into the 
+//	buffer -- when coalescing, once enough have, or the first has 
+//	waited long enough.
 //----------------------------------------------------------------------
 
 void
 Console::CheckCharAvail()
 {
+    int room = (coalesceEvents > 1 || coalesceTicks > 0) ? ConsoleRingSize : 1;
     char c;
 
     // schedule the next time to poll for a packet
     interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
 			ConsoleReadInt);
 
-    // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
-	return;	  
+    while (inCount < room && Arrived(&c)) {
+	incoming[(inHead + inCount) % ConsoleRingSize] = c;
+	inCount++;
+	if (unsignalled++ == 0)
+	    firstUnsignalled = stats->totalTicks;
+    }
+    if (unsignalled == 0 || (unsignalled < coalesceEvents && inCount < room
+		&& stats->totalTicks - firstUnsignalled < coalesceTicks))
+	return;
+
+    // tell user about them
+    unsignalled = 0;
+    stats->numConsoleInterrupts++;
+    (*readHandler)(handlerArg);	
+}
+
+//----------------------------------------------------------------------
+// Console::Arrived
+// 	Read in a character from the simulated keyboard, if one has been
+//	typed (or, when replaying, if the log has one due by now).
+//
+// Returns:
+//	TRUE, with the character in "ch", or FALSE if there is none
+//----------------------------------------------------------------------
 
-    // otherwise, read character and tell user about it
-    Read(readFileNo, &c, sizeof(char));
-    incoming = c ;
+bool
+Console::Arrived(char *ch)
+{
+    if (inputLog != NULL && inputLog->Replaying()) {
+	if (inputLog->Replay(InputConsole, ch, sizeof(char)) < 0)
+	    return FALSE;	// (the host is never polled in replay)
+    } else {
+	if (!PollFile(readFileNo))
+	    return FALSE;
+	Read(readFileNo, ch, sizeof(char));
+	if (inputLog != NULL)
+	    inputLog->Record(InputConsole, ch, sizeof(char));
+    }
     stats->numConsoleCharsRead++;
-    (*readHandler)(handlerArg);	
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -114,7 +150,7 @@ void
 Console::WriteDone()
 {
     putBusy = FALSE;
-    stats->numConsoleCharsWritten++;
+    stats->numConsoleCharsWritten += putCount;
     (*writeHandler)(handlerArg);
 }
 
@@ -127,9 +163,13 @@ Console::WriteDone()
 char
 Console::GetChar()
 {
-   char ch = incoming;
+   char ch;
 
-   incoming = EOF;
+   if (inCount == 0)
+	return EOF;
+   ch = incoming[inHead];
+   inHead = (inHead + 1) % ConsoleRingSize;
+   inCount--;
    return ch;
 }
 
@@ -145,6 +185,50 @@ Console::PutChar(char ch)
     ASSERT(putBusy == FALSE);
     WriteFile(writeFileNo, &ch, sizeof(char));
     putBusy = TRUE;
+    putCount = 1;
     interrupt->Schedule(ConsoleWriteDone, (int)this, ConsoleTime,
 					ConsoleWriteInt);
 }
+
+//----------------------------------------------------------------------
+// Console::PutBlock()
+// 	Write "count" characters to the simulated display at once.  The
+//	interrupt comes when the last of them would be out: ConsoleTime,
+//	as for one character, plus ConsoleByteTime for each.
+//----------------------------------------------------------------------
+
+void
+Console::PutBlock(char *from, int count)
+{
+    ASSERT(putBusy == FALSE && count > 0);
+    WriteFile(writeFileNo, from, count);
+    putBusy = TRUE;
+    putCount = count;
+    interrupt->Schedule(ConsoleWriteDone, (int)this,
+			ConsoleTime + count * ConsoleByteTime, ConsoleWriteInt);
+}
+
+//----------------------------------------------------------------------
+// Console::GetBlock()
+// 	Take all the input that is there, up to "size" characters: those
+//	buffered for GetChar, if any, then whatever else has been typed.
+//	Never waits.
+//
+// Returns:
+//	the number of characters taken, 0 if there were none
+//----------------------------------------------------------------------
+
+int
+Console::GetBlock(char *into, int size)
+{
+    int count = 0;
+
+    for (; count < size && inCount > 0; count++) {
+	into[count] = incoming[inHead];
+	inHead = (inHead + 1) % ConsoleRingSize;
+	inCount--;
+    }
+    while (count < size && Arrived(&into[count]))
+	count++;
+    return count;
+}
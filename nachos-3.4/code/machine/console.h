@@ -14,6 +14,10 @@
 //	for read and write, and the device is "duplex" -- a character
 //	can be outgoing and incoming at the same time.
 //
+//	The device can also move blocks, like a DMA controller: PutBlock
+//	writes a whole buffer with one interrupt at the end, and GetBlock
+//	takes all the input that has arrived so far.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -34,6 +38,15 @@
 // is called when a character has arrived, ready to be read in.
 // The interrupt handler "writeDone" is called when an output character 
 // has been "put", so that the next character can be written.
+//
+// With interrupt coalescing (-irq), the device takes in everything 
+// typed, up to ConsoleRingSize characters, and only interrupts once
+// coalesceEvents of them have come in since the last interrupt, or the
+// first of those has waited coalesceTicks; the handler should take all
+// of them (GetBlock).  Otherwise it holds one character at a time, and
+// interrupts for each.
+
+#define ConsoleRingSize	64		// characters the device can hold
 
 class Console {
   public:
@@ -52,11 +65,21 @@ class Console {
     				// "readHandler" is called whenever there is 
 				// a char to be gotten
 
+    void PutBlock(char *from, int count);
+				// Write "count" characters; "writeHandler"
+				// is called once, when they are all out.
+    int GetBlock(char *into, int size);
+				// Take up to "size" characters that have
+				// arrived, without waiting; returns how
+				// many (0 if none)
+
 // internal emulation routines -- DO NOT call these. 
     void WriteDone();	 	// internal routines to signal I/O completion
     void CheckCharAvail();
 
   private:
+    bool Arrived(char *ch);		// Take in a character, if one has
+					// been typed
     int readFileNo;			// UNIX file emulating the keyboard 
     int writeFileNo;			// UNIX file emulating the display
     VoidFunctionPtr writeHandler; 	// Interrupt handler to call when 
@@ -67,9 +90,12 @@ class Console {
 					// interrupt handlers
     bool putBusy;    			// Is a PutChar operation in progress?
 					// If so, you can't do another one!
-    char incoming;    			// Contains the character to be read,
-					// if there is one available. 
-					// Otherwise contains EOF.
+    int putCount;			// characters it is writing
+    char incoming[ConsoleRingSize];	// Characters to be read, oldest
+    int inHead, inCount;		// first: a ring
+    int unsignalled;			// ... how many came since the last
+					// interrupt
+    long long firstUnsignalled;		// ... and when the first of them did
 };
 
 #endif // CONSOLE_H
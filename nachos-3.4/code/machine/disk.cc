@@ -25,6 +25,10 @@
 
 #define DiskSize 	(MagicSize + (NumSectors * SectorSize))
 
+int sectorsPerTrack = DefaultSectorsPerTrack;	// see "-dg"
+int numTracks = DefaultNumTracks;
+DiskModel diskModel = DiskRotating;		// see "-ssd"
+
 // dummy procedure because we can't take a pointer of a member function
 static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 
@@ -38,16 +42,23 @@ static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
 //	   request completes
 //	"callArg" -- argument to pass the interrupt handler
+//	"mapped" -- map the file into memory, and copy sectors in and 
+//	   out of it, instead of a system call per request.  The 
+//	   simulated timing is the same either way.
 //----------------------------------------------------------------------
 
-Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
+Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg, 
+		bool mapped)
 {
     int magicNum;
     int tmp = 0;
 
-    DEBUG('d', "Initializing the disk, 0x%x 0x%x\n", callWhenDone, callArg);
+    DEBUG('d', "Initializing the disk, 0x%x 0x%x: %d tracks of %d sectors, "
+		"%s\n", callWhenDone, callArg, NumTracks, SectorsPerTrack,
+		(diskModel == DiskFlash) ? "flash" : "rotating");
     handler = callWhenDone;
     handlerArg = callArg;
+    model = diskModel;
     lastSector = 0;
     bufferInit = 0;
     
@@ -55,6 +66,8 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
     if (fileno >= 0) {		 	// file exists, check magic number 
 	Read(fileno, (char *) &magicNum, MagicSize);
 	ASSERT(magicNum == MagicNumber);
+	Lseek(fileno, 0, 2);		// ... and that it is this big
+	ASSERT(Tell(fileno) == (int) DiskSize);
     } else {				// file doesn't exist, create it
         fileno = OpenForWrite(name);
 	magicNum = MagicNumber;  
@@ -65,19 +78,62 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
     active = FALSE;
+    image = mapped ? MapOpenFile(fileno, DiskSize) : (char *) NULL;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk (writing it back first, if it is mapped into memory).
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (image != NULL)
+	UnmapFile(image, DiskSize);
     Close(fileno);
 }
 
+//----------------------------------------------------------------------
+// CopyDiskImage
+// 	Copy the UNIX file holding a simulated disk, for snapshots of a
+//	disk set up once (formatted, files copied in) to start later runs
+//	from.  Both files must be closed: the disk isn't running.
+//
+//	"from" must start with the disk magic number and be exactly
+//	DiskSize bytes long, i.e., have been made with the current -dg
+//	geometry; a disk of another geometry would have its free map, 
+//	swap area and log in the wrong places.
+//
+//	"from" -- the disk to copy, which must exist
+//	"to" -- the UNIX file to copy it into
+//----------------------------------------------------------------------
+
+void
+CopyDiskImage(char *from, char *to)
+{
+    char *buffer = new char[DiskSize];
+    int fd, size;
+
+    fd = OpenForReadWrite(from, TRUE);
+    Lseek(fd, 0, 2);
+    size = Tell(fd);
+    if (size != (int) DiskSize) {
+	printf("Disk image %s is %d bytes, not the %d of a disk of %d "
+		"tracks of %d sectors (-dg)\n", from, size, (int) DiskSize,
+		NumTracks, SectorsPerTrack);
+	ASSERT(FALSE);
+    }
+    Lseek(fd, 0, 0);
+    Read(fd, buffer, DiskSize);
+    Close(fd);
+    ASSERT(*(int *) buffer == MagicNumber);	// a disk at all
+    fd = OpenForWrite(to);
+    WriteFile(fd, buffer, DiskSize);
+    Close(fd);
+    delete [] buffer;
+}
+
 //----------------------------------------------------------------------
 // Disk::PrintSector()
 // 	Dump the data in a disk read/write request, for debugging.
@@ -99,55 +155,72 @@ PrintSector (bool writing, int sector, char *data)
 
 //----------------------------------------------------------------------
 // Disk::ReadRequest/WriteRequest
-// 	Simulate a request to read/write a single disk sector
-//	   Do the read/write immediately to the UNIX file
+// 	Simulate a request to read/write a run of consecutive disk sectors
+//	   Do the read/write immediately to the UNIX file, in one call
 //	   Set up an interrupt handler to be called later,
 //	      that will notify the caller when the simulator says
 //	      the operation has completed.
 //
-//	Note that a disk only allows an entire sector to be read/written,
+//	Note that a disk only allows entire sectors to be read/written,
 //	not part of a sector.
 //
-//	"sectorNumber" -- the disk sector to read/write
+//	"sectorNumber" -- the first disk sector to read/write
 //	"data" -- the bytes to be written, the buffer to hold the incoming bytes
+//	"numSectors" -- how many sectors
 //----------------------------------------------------------------------
 
 void
-Disk::ReadRequest(int sectorNumber, char* data)
+Disk::ReadRequest(int sectorNumber, char* data, int numSectors)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    int ticks = ComputeLatency(sectorNumber, FALSE, numSectors);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (numSectors > 0) &&
+		(sectorNumber + numSectors <= NumSectors));
     
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG('d', "Reading %d sectors from sector %d\n", numSectors, 
+		sectorNumber);
+    TRACE(TraceDiskRead, sectorNumber, ticks);
+    if (image != NULL)
+	bcopy(image + SectorSize * sectorNumber + MagicSize, data, 
+		SectorSize * numSectors);
+    else
+	ReadAtOffset(fileno, data, SectorSize * numSectors, 
+		SectorSize * sectorNumber + MagicSize);
     if (DebugIsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(FALSE, sectorNumber + i, data + i * SectorSize);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber + numSectors - 1);
     stats->numDiskReads++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, char* data, int numSectors)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(sectorNumber, TRUE, numSectors);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (numSectors > 0) &&
+		(sectorNumber + numSectors <= NumSectors));
     
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG('d', "Writing %d sectors to sector %d\n", numSectors, 
+		sectorNumber);
+    TRACE(TraceDiskWrite, sectorNumber, ticks);
+    if (image != NULL)
+	bcopy(data, image + SectorSize * sectorNumber + MagicSize, 
+		SectorSize * numSectors);
+    else
+	WriteAtOffset(fileno, data, SectorSize * numSectors, 
+		SectorSize * sectorNumber + MagicSize);
     if (DebugIsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(TRUE, sectorNumber + i, data + i * SectorSize);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber + numSectors - 1);
     stats->numDiskWrites++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
@@ -210,8 +283,40 @@ Disk::ModuloDiff(int to, int from)
 
 //----------------------------------------------------------------------
 // Disk::ComputeLatency()
-// 	Return how long will it take to read/write a disk sector, from
-//	the current position of the disk head.
+// 	Return how long will it take to read/write a disk sector (or a
+//	run of "numSectors" of them), by the disk's timing model.
+//----------------------------------------------------------------------
+
+int
+Disk::ComputeLatency(int newSector, bool writing, int numSectors)
+{
+    if (model == DiskFlash)
+	return FlashLatency(newSector, writing, numSectors);
+    return RotatingLatency(newSector, writing, numSectors);
+}
+
+//----------------------------------------------------------------------
+// Disk::FlashLatency()
+// 	Return how long a flash disk takes for a request: a fixed time to
+//	start it, then the sectors, FlashChannels at a time.  Where the
+//	last request was doesn't matter, and writes are slower than reads.
+//----------------------------------------------------------------------
+
+int
+Disk::FlashLatency(int newSector, bool writing, int numSectors)
+{
+    int rounds = divRoundUp(numSectors, FlashChannels);
+    int latency = FlashCommandTime +
+		rounds * (writing ? FlashWriteTime : FlashReadTime);
+
+    DEBUG('d', "Request latency = %d\n", latency);
+    return latency;
+}
+
+//----------------------------------------------------------------------
+// Disk::RotatingLatency()
+// 	Return how long a rotating disk takes for a request, from the
+//	current position of the disk head.
 //
 //   	Latency = seek time + rotational latency + transfer time
 //   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
@@ -230,26 +335,34 @@ Disk::ModuloDiff(int to, int from)
 //----------------------------------------------------------------------
 
 int
-Disk::ComputeLatency(int newSector, bool writing)
+Disk::RotatingLatency(int newSector, bool writing, int numSectors)
 {
-    int rotation;
+    int rotation, transfer;
     int seek = TimeToSeek(newSector, &rotation);
-    int timeAfter = stats->totalTicks + seek + rotation;
+    long long timeAfter = stats->totalTicks + seek + rotation;
 
 #ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
     // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0) 
+    if ((writing == FALSE) && (seek == 0) && (numSectors == 1)
 		&& (((timeAfter - bufferInit) / RotationTime) 
-	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
+	     		> ModuloDiff(newSector, 
+			    (int) ((bufferInit / RotationTime) % SectorsPerTrack)))) {
         DEBUG('d', "Request latency = %d\n", RotationTime);
 	return RotationTime; // time to transfer sector from the track buffer
     }
 #endif
 
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    rotation += ModuloDiff(newSector, 
+	(int) ((timeAfter / RotationTime) % SectorsPerTrack)) * RotationTime;
+
+    // the rest of a run passes under the head right after the first 
+    // sector, except for a one-track seek at each track boundary
+    transfer = numSectors * RotationTime + SeekTime *
+	((newSector + numSectors - 1) / SectorsPerTrack - 
+					newSector / SectorsPerTrack);
 
-    DEBUG('d', "Request latency = %d\n", seek + rotation + RotationTime);
-    return(seek + rotation + RotationTime);
+    DEBUG('d', "Request latency = %d\n", seek + rotation + transfer);
+    return(seek + rotation + transfer);
 }
 
 //----------------------------------------------------------------------
@@ -267,5 +380,5 @@ Disk::UpdateLast(int newSector)
     if (seek != 0)
 	bufferInit = stats->totalTicks + seek + rotate;
     lastSector = newSector;
-    DEBUG('d', "Updating last sector = %d, %d\n", lastSector, bufferInit);
+    DEBUG('d', "Updating last sector = %d, %lld\n", lastSector, bufferInit);
 }
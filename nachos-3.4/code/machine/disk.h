@@ -45,6 +45,13 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// The size of the disk can be set when Nachos starts (-dg), but never smaller
+// than the default 32 tracks of 32 sectors (the log, the swap area and
+// the root directory have fixed places on it).  The timing model can be
+// set to that of a flash disk instead (-ssd): there is no seek or
+// rotation, just a fixed time per request and per sector, and the
+// sectors of a run are moved FlashChannels at a time, one per channel.
 
 /* Begin:
 *  SectorSize increased to 256 from 128 by Ben for Fall 2011 semester
@@ -53,47 +60,75 @@
 //#define SectorSize 		128	// number of bytes per disk sector
 /* end */
 
-#define SectorsPerTrack 	32	// number of sectors per disk track 
-#define NumTracks 		32	// number of tracks per disk
+#define DefaultSectorsPerTrack	32	// see "-dg"
+#define DefaultNumTracks	32
+
+extern int sectorsPerTrack;		// number of sectors per disk track 
+extern int numTracks;			// number of tracks per disk
+#define SectorsPerTrack 	sectorsPerTrack
+#define NumTracks 		numTracks
 #define NumSectors 		(SectorsPerTrack * NumTracks)
 					// total # of sectors per disk
 
+// Timing models; the values are for "diskModel".
+enum DiskModel { DiskRotating, DiskFlash };
+
+extern DiskModel diskModel;		// see "-ssd"
+
 class Disk {
   public:
-    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg);
+    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg,
+		bool mapped = FALSE);
     					// Create a simulated disk.  
 					// Invoke (*callWhenDone)(callArg) 
 					// every time a request completes.
+					// If "mapped", map the UNIX file
+					// into memory, instead of reading
+					// and writing it.
     ~Disk();				// Deallocate the disk.
     
-    void ReadRequest(int sectorNumber, char* data);
-    					// Read/write an single disk sector.
+    void ReadRequest(int sectorNumber, char* data, int numSectors = 1);
+    					// Read/write a run of "numSectors"
+					// consecutive disk sectors (usually
+					// just one).
 					// These routines send a request to 
     					// the disk and return immediately.
     					// Only one request allowed at a time!
-    void WriteRequest(int sectorNumber, char* data);
+    void WriteRequest(int sectorNumber, char* data, int numSectors = 1);
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
 
-    int ComputeLatency(int newSector, bool writing);	
+    int ComputeLatency(int newSector, bool writing, int numSectors = 1);
     					// Return how long a request to 
-					// newSector will take: 
-					// (seek + rotational delay + transfer)
+					// newSector will take, by the
+					// disk's timing model
 
   private:
     int fileno;				// UNIX file number for simulated disk 
+    char *image;			// The file, mapped into memory, or
+					// NULL if it is read and written
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     int handlerArg;			// Argument to interrupt handler 
     bool active;     			// Is a disk operation in progress?
     int lastSector;			// The previous disk request 
-    int bufferInit;			// When the track buffer started 
+    long long bufferInit;		// When the track buffer started 
 					// being loaded
 
+    DiskModel model;			// How requests are timed
+
+    int RotatingLatency(int newSector, bool writing, int numSectors);
+					// seek + rotational delay + transfer
+    int FlashLatency(int newSector, bool writing, int numSectors);
+					// command + transfer, per channel
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
 };
 
+extern void CopyDiskImage(char *from, char *to);
+					// Copy a disk's UNIX file (for
+					// snapshots of DISK)
+
 #endif // DISK_H
@@ -23,12 +23,14 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "system.h"
+#include "slab.h"
 
 // String definitions for debugging messages
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv",
+			"journal", "transport", "profile", "work", "alarm"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -41,13 +43,45 @@ static char *intTypeNames[] = { "timer", "disk", "console write",
 //	"kind" is the hardware device that generated the interrupt
 //----------------------------------------------------------------------
 
-PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time, 
-				IntType kind)
+PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, 
+				long long time, IntType kind)
 {
     handler = func;
     arg = param;
     when = time;
     type = kind;
+    seq = 0;
+}
+
+//----------------------------------------------------------------------
+// PendingInterrupt::operator new, PendingInterrupt::operator delete
+// 	Pending interrupts come from a cache of their own (see slab.h).
+//----------------------------------------------------------------------
+
+static SlabCache pendingCache("interrupt", sizeof(PendingInterrupt));
+
+void *
+PendingInterrupt::operator new(size_t size)
+{
+    return pendingCache.Alloc(size);
+}
+
+void
+PendingInterrupt::operator delete(void *p)
+{
+    pendingCache.Free(p);
+}
+
+//----------------------------------------------------------------------
+// Earlier
+// 	Should interrupt "a" fire before interrupt "b"?  Ties go to the one
+//	scheduled first, as with the sorted list this heap replaces.
+//----------------------------------------------------------------------
+
+static bool
+Earlier(PendingInterrupt *a, PendingInterrupt *b)
+{
+    return (a->when < b->when) || (a->when == b->when && a->seq < b->seq);
 }
 
 //----------------------------------------------------------------------
@@ -60,10 +94,15 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    maxPending = InitialPending;
+    pending = new PendingInterrupt *[maxPending];
+    numPending = 0;
+    nextSeq = 0;
+    nextDue = NeverDue;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    interrupted = SystemMode;
 }
 
 //----------------------------------------------------------------------
@@ -73,9 +112,9 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
-    delete pending;
+    for (int i = 0; i < numPending; i++)
+	delete pending[i];
+    delete [] pending;
 }
 
 //----------------------------------------------------------------------
@@ -146,21 +185,52 @@ Interrupt::Enable()
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	Usually nothing is due yet, and we return as soon as we've 
+//	advanced the clock.  (A handler is the only thing that can ask
+//	for a yield, so there can't be one to do either.)
+//
+//	With more than one CPU, a user instruction tick is when the CPUs
+//	take turns (see scheduler.h): the clock only moves on once the 
+//	last busy CPU has run its instruction, and then the next round
+//	starts with the first one.  The CPUs stay in lock step, so there
+//	an instruction's cost (cf. Machine::ReadCosts) is only charged to 
+//	user time, not to the clock.
+//
+//	"userTicks" -- what the user instruction cost (SystemTick is 
+//		charged for an interrupt being re-enabled)
 //----------------------------------------------------------------------
 void
-Interrupt::OneTick()
+Interrupt::OneTick(int userTicks)
 {
     MachineStatus old = status;
+    bool multi = (old == UserMode && scheduler->NumCPUs() > 1);
 
 // advance simulated time
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
 	stats->systemTicks += SystemTick;
+	if (currentThread != NULL)		// charge the running thread
+	    currentThread->systemTicks += SystemTick;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->userTicks += userTicks;
+	currentThread->userTicks += userTicks;
+	if (multi) {
+	    if (!scheduler->TurnOver())
+		return;			// this CPU's turn goes on
+	    if (NextCPU(FALSE))
+		return;			// later CPUs had their turn, and the
+					// clock has moved on
+	    stats->totalTicks += scheduler->CPUQuantum() * UserTick;
+	} else
+	    stats->totalTicks += userTicks;
+    }
+    DEBUG('i', "\n== Tick %lld ==\n", stats->totalTicks);
+    if (stats->totalTicks < nextDue) {
+	if (multi)
+	    NextCPU(TRUE);		// the next round starts
+	return;				// nothing to fire
     }
-    DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
@@ -176,6 +246,57 @@ Interrupt::OneTick()
 	currentThread->Yield();
 	status = old;
     }
+    if (multi)
+	NextCPU(TRUE);			// the next round starts
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextCPU
+// 	Let the other CPUs take their turns (see Scheduler::NextCPU), as
+//	kernel code: with interrupts off, in system mode.  When we get 
+//	the CPU back, take any IPI that came for it meanwhile, by 
+//	yielding.
+//
+//	"wrap" -- start a new round, rather than finishing this one
+//
+// Returns:
+//	TRUE if another CPU had a turn
+//----------------------------------------------------------------------
+
+bool
+Interrupt::NextCPU(bool wrap)
+{
+    MachineStatus old = status;
+    bool switched;
+
+    ChangeLevel(IntOn, IntOff);
+    status = SystemMode;
+    switched = scheduler->NextCPU(wrap);
+    if (switched && scheduler->TakeIPI()) {
+	DEBUG('t', "CPU %d reschedules on an IPI\n", scheduler->CurrentCPU());
+	currentThread->Yield();
+    }
+    status = old;
+    ChangeLevel(IntOff, IntOn);
+    return switched;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::TicksUntilDue
+// 	Return how much simulated time can pass before the earliest
+//	pending interrupt is due.  Used by the machine simulation to
+//	run several user instructions between calls to OneTick, knowing
+//	that none of the skipped calls could have fired an interrupt.
+//
+//	If nothing is pending, nothing can fire, so return a large number.
+//----------------------------------------------------------------------
+
+int
+Interrupt::TicksUntilDue()
+{
+    if (nextDue == NeverDue)
+	return NoInterruptDue;
+    return (int) (nextDue - stats->totalTicks);
 }
 
 //----------------------------------------------------------------------
@@ -242,6 +363,7 @@ Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+    scheduler->PrintCPUs();
     Cleanup();     // Never returns.
 }
 
@@ -250,7 +372,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: put it on the heap.  The memory of interrupts that
+//	have fired is reused, through pendingCache.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -264,14 +387,93 @@ Interrupt::Halt()
 void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
-    int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    long long when = stats->totalTicks + fromNow;
+    PendingInterrupt *toOccur;
 
-    DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
+    DEBUG('i', "Scheduling interrupt handler the %s at time = %lld\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    toOccur = new PendingInterrupt(handler, arg, when, type);
+    toOccur->seq = nextSeq++;
+    PushPending(toOccur);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::PushPending
+// 	Add an interrupt to the heap: put it at the bottom, and move it up
+//	past every later one.  Doubles the heap if it is full.
+//----------------------------------------------------------------------
+
+void
+Interrupt::PushPending(PendingInterrupt *toOccur)
+{
+    int i, parent;
+
+    if (numPending == maxPending) {
+	PendingInterrupt **old = pending;
+
+	maxPending *= 2;
+	pending = new PendingInterrupt *[maxPending];
+	for (i = 0; i < numPending; i++)
+	    pending[i] = old[i];
+	delete [] old;
+    }
+    for (i = numPending++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!Earlier(toOccur, pending[parent]))
+	    break;
+	pending[i] = pending[parent];
+    }
+    pending[i] = toOccur;
+    nextDue = pending[0]->when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::PopPending
+// 	Take the earliest interrupt off the heap: move the last one to the
+//	top, and down past every earlier one.
+//
+// Returns:
+//	the interrupt, or NULL if there are none
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::PopPending()
+{
+    PendingInterrupt *first, *last;
+    int i, child;
+
+    if (numPending == 0)
+	return NULL;
+    first = pending[0];
+    last = pending[--numPending];
+    for (i = 0; (child = 2 * i + 1) < numPending; i = child) {
+	if (child + 1 < numPending && Earlier(pending[child + 1], pending[child]))
+	    child++;
+	if (!Earlier(pending[child], last))
+	    break;
+	pending[i] = pending[child];
+    }
+    pending[i] = last;
+    nextDue = (numPending == 0) ? NeverDue : pending[0]->when;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::OnlyTimersPending
+// 	Is every pending interrupt a timer or profiler tick?  Those two
+//	go on forever, so once nothing else is left, an idle machine has
+//	nothing more to wait for.  Only called when idle.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::OnlyTimersPending()
+{
+    for (int i = 0; i < numPending; i++)
+	if (pending[i]->type != TimerInt && pending[i]->type != ProfileInt)
+	    return FALSE;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -291,40 +493,38 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    int when;
+    PendingInterrupt *toOccur;
+    long long when;
 
     ASSERT(level == IntOff);		// interrupts need to be disabled,
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
-
-    if (toOccur == NULL)		// no pending interrupts
+    if (numPending == 0)		// no pending interrupts
 	return FALSE;			
+    when = pending[0]->when;		// look, without taking it off
+    if (when > stats->totalTicks && !advanceClock)
+	return FALSE;			// not time yet
 
-    if (advanceClock && when > stats->totalTicks) {	// advance the clock
+    if (when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
-	return FALSE;
     }
 
 // Check if there is nothing more to do, and if so, quit
-    if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+    if ((status == IdleMode) && OnlyTimersPending())
 	 return FALSE;
-    }
 
-    DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
+    toOccur = PopPending();
+
+    DEBUG('i', "Invoking interrupt handler for the %s at time %lld\n", 
 			intTypeNames[toOccur->type], toOccur->when);
 #ifdef USER_PROGRAM
     if (machine != NULL)
     	machine->DelayedLoad(0, 0);
 #endif
     inHandler = TRUE;
+    interrupted = old;
     status = SystemMode;			// whatever we were doing,
 						// we are now going to be
 						// running in the kernel
@@ -346,7 +546,7 @@ PrintPending(int arg)
 {
     PendingInterrupt *pend = (PendingInterrupt *)arg;
 
-    printf("Interrupt handler %s, scheduled at %d\n", 
+    printf("Interrupt handler %s, scheduled at %lld\n", 
 	intTypeNames[pend->type], pend->when);
 }
 
@@ -359,11 +559,12 @@ PrintPending(int arg)
 void
 Interrupt::DumpState()
 {
-    printf("Time: %d, interrupts %s\n", stats->totalTicks, 
+    printf("Time: %lld, interrupts %s\n", stats->totalTicks, 
 					intLevelNames[level]);
-    printf("Pending interrupts:\n");
+    printf("Pending interrupts (in heap order):\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    for (int i = 0; i < numPending; i++)
+	PrintPending((int) pending[i]);
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -37,6 +37,7 @@
 
 #include "copyright.h"
 #include "list.h"
+#include "stats.h"
 
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
 enum IntStatus { IntOff, IntOn };
@@ -48,9 +49,15 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network.  The file system's journal
+// and the network's reliable connections also use one-shot timers, as
+// do delayed work queue items and sleeping threads.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+				NetworkSendInt, NetworkRecvInt, JournalInt,
+				TransportInt, ProfileInt, WorkInt, AlarmInt};
+
+// Returned by TicksUntilDue when there are no pending interrupts.
+#define NoInterruptDue	0x3fffffff
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -58,21 +65,34 @@ enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt,
 
 class PendingInterrupt {
   public:
-    PendingInterrupt(VoidFunctionPtr func, int param, int time, IntType kind);
+    PendingInterrupt(VoidFunctionPtr func, int param, long long time, 
+		IntType kind);
 				// initialize an interrupt that will
 				// occur in the future
+    void *operator new(size_t size);	// From a SlabCache: one is made
+    void operator delete(void *p);	// and freed for every interrupt
 
     VoidFunctionPtr handler;    // The function (in the hardware device
 				// emulator) to call when the interrupt occurs
     int arg;                    // The argument to the function.
-    int when;			// When the interrupt is supposed to fire
+    long long when;		// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int seq;			// order of scheduling, to break ties
 };
 
+#define InitialPending	16	// starting size of the pending heap
+#define NeverDue	0x7fffffffffffffffLL	// "nextDue" with nothing 
+					// pending
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
 // in the future.
+//
+// Pending interrupts are kept in a binary heap, earliest first (and in
+// the order they were scheduled, for the same time), so scheduling one
+// and firing one are both O(log n), and looking at the next one is
+// free.  Interrupts that have fired are kept for reuse.
 
 class Interrupt {
   public:
@@ -85,6 +105,8 @@ class Interrupt {
     void Enable();			// Enable interrupts.
     IntStatus getLevel() {return level;}// Return whether interrupts
 					// are enabled or disabled
+    bool InHandler() { return inHandler; }	// Is an interrupt handler
+					// running (rather than a thread)?
     
     void Idle(); 			// The ready queue is empty, roll 
 					// simulated time forward until the 
@@ -96,6 +118,9 @@ class Interrupt {
 					// from an interrupt handler
 
     MachineStatus getStatus() { return status; } // idle, kernel, user
+    MachineStatus getInterruptedStatus() { return interrupted; }
+					// In a handler: what the machine
+					// was doing when it was called
     void setStatus(MachineStatus st) { status = st; }
 
     void DumpState();			// Print interrupt state
@@ -110,22 +135,41 @@ class Interrupt {
 	int arg, int when, IntType type);// at time ``when''.  This is called
     					// by the hardware device simulators.
     
-    void OneTick();       		// Advance simulated time
+    void OneTick(int userTicks = UserTick);
+					// Advance simulated time, by
+					// "userTicks" for a user instruction
+
+    int TicksUntilDue();		// How long before the next pending
+					// interrupt is due to fire
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingInterrupt **pending;	// heap of interrupts scheduled to occur
+				// in the future; pending[0] is next
+    int numPending;		// interrupts on the heap
+    int maxPending;		// size of the heap array
+    int nextSeq;		// "seq" for the next interrupt scheduled
+    long long nextDue;		// when pending[0] is due, so OneTick can
+				// tell at a glance that nothing is
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    MachineStatus interrupted;	// status before the current handler
 
     // these functions are internal to the interrupt simulation code
 
+    bool NextCPU(bool wrap);	// Let the other simulated CPUs take
+				// their turn
+
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
 
+    void PushPending(PendingInterrupt *toOccur);  // Add to the heap
+    PendingInterrupt *PopPending();	// Take the earliest off the heap
+    bool OnlyTimersPending();		// Is nothing but the timer and the
+					// profiler left to happen?
+
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
 };
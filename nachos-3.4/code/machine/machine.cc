@@ -11,6 +11,9 @@
 #include "machine.h"
 #include "system.h"
 
+int pageSize = SectorSize;		// see "-ps"
+int numPhysPages = DefaultNumPhysPages;	// see "-np"
+
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
 static char* exceptionNames[] = { "no exception", "syscall", 
@@ -50,28 +53,64 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"blocks" -- if TRUE, advance the clock once per basic block rather
+//		than once per instruction (ignored when single stepping).
+//	"numTLB" -- the number of TLB entries (only used with USE_TLB)
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks, int numTLB)
 {
     int i;
 
+    ASSERT(sizeof(TranslationEntry) == 4);	// packed, see translate.h
+    ASSERT(NumPhysPages < (1 << 27));		// frames fit its 28 bits
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodedCache = new Instruction[MemorySize / 4];
+    decodedValid = new bool[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	decodedValid[i] = FALSE;
+    tlbUseCount = 0;
+    tlbASID = 0;
+    frameRefHook = NULL;
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
+    ASSERT(numTLB > 0);
+    tlbSize = numTLB;
+    tlb = new TLBEntry[tlbSize];
+    tlbLastUse = new unsigned int[tlbSize];
+    for (i = 0; i < tlbSize; i++) {
 	tlb[i].valid = FALSE;
+	tlb[i].numPages = 1;
+	tlb[i].asid = 0;
+	tlbLastUse[i] = 0;
+    }
     pageTable = NULL;
+    pageDirectory = NULL;
 #else	// use linear page table
     tlb = NULL;
+    tlbSize = 0;
+    tlbLastUse = NULL;
     pageTable = NULL;
+    pageDirectory = NULL;
 #endif
 
     singleStep = debug;
+    traceInstructions = DebugIsEnabled('m');
+    xlateEnabled = !DebugIsEnabled('a');
+    FlushXlateCache();
+    blockMode = blocks && !debug;
+    deferredTicks = 0;
+    blockBroken = FALSE;
+    linked = FALSE;
+    for (i = 0; i < NumCostClasses; i++)
+	classTicks[i] = UserTick;
+    tlbMissTicks = walkTicks = cacheMissTicks = 0;
+    instrTicks = 0;
+    for (i = 0; i < NumCacheKinds; i++)
+	cache[i] = NULL;
     CheckEndian();
 }
 
@@ -83,8 +122,88 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    delete [] decodedCache;
+    delete [] decodedValid;
+    if (tlb != NULL) {
         delete [] tlb;
+        delete [] tlbLastUse;
+    }
+    for (int i = 0; i < NumCacheKinds; i++)
+	delete cache[i];
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushXlateCache
+// 	Empty the simulator's translation cache.  Entries are tagged with
+//	the page table they came from and re-checked on every hit, but
+//	a page table can be freed and its storage re-used by a new
+//	address space, so the kernel flushes on every context switch and
+//	whenever it takes a frame away from a page.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushXlateCache()
+{
+    for (int i = 0; i < XlateCacheSize; i++)
+	xlateCache[i].entry = NULL;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedPage
+// 	Throw away the pre-decoded instructions for one physical page,
+//	so that the next fetch from it re-reads and re-decodes mainMemory.
+//	Stores done by the simulated program go through WriteMem, which
+//	handles this itself; the kernel only needs to call this when it
+//	copies a page into mainMemory directly (e.g., on a page fault).
+//
+//	"physPage" -- the physical page whose contents changed
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedPage(int physPage)
+{
+    int first = physPage * (PageSize / 4);
+
+    ASSERT((physPage >= 0) && (physPage < NumPhysPages));
+    for (int i = 0; i < PageSize / 4; i++)
+	decodedValid[first + i] = FALSE;
+    for (int k = 0; k < NumCacheKinds; k++)	// the caches are stale too
+	if (cache[k] != NULL)
+	    cache[k]->Invalidate(physPage * PageSize, PageSize);
+}
+
+//----------------------------------------------------------------------
+// Machine::CacheAccess
+// 	Send an access that has been translated through the L1 cache of
+//	its kind, if there is one.  Count it in the statistics, and for
+//	the running thread.  Charge the instruction cacheMissTicks for
+//	each line moved to or from memory.
+//
+//	"kind" -- ICache for an instruction fetch, DCache otherwise
+//	"physAddr" -- the byte accessed, in mainMemory
+//	"writing" -- TRUE for a store
+//----------------------------------------------------------------------
+
+void
+Machine::CacheAccess(CacheKind kind, int physAddr, bool writing)
+{
+    int moved;
+
+    if (cache[kind] == NULL)
+	return;
+    moved = cache[kind]->Access(physAddr, writing);
+    currentThread->cacheRefs[kind]++;
+    if (moved == 0) {
+	if (kind == ICache) stats->numICacheHits++;
+	else stats->numDCacheHits++;
+	return;
+    }
+    currentThread->cacheMisses[kind]++;
+    if (kind == ICache) stats->numICacheMisses++;
+    else stats->numDCacheMisses++;
+    if (moved > 1)
+	stats->numDCacheWritebacks++;	// only data lines get dirty
+    instrTicks += moved * cacheMissTicks;
 }
 
 //----------------------------------------------------------------------
@@ -100,14 +219,87 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    int ticks = instrTicks;		// other threads may run user code
+					// before the handler returns
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
+    ChargeDeferredTicks();		// the kernel must see the right time
+    blockBroken = TRUE;
+    linked = FALSE;			// the kernel may change anything
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     interrupt->setStatus(UserMode);
+    instrTicks = ticks;
+}
+
+//----------------------------------------------------------------------
+// Machine::ReadCosts
+// 	Set the cost of each class of user instruction, and the penalties
+//	added to it, from a file of lines:
+//
+//	    name ticks
+//
+//	where "name" is a class -- alu, mult, div, load, store, branch --
+//	or one of the penalties:
+//
+//	    tlbmiss	for each TLB miss of an instruction fetch, load or
+//			store (ahead of the kernel's refill)
+//	    walk	for each translation through a two-level page 
+//			table (-pt2, without a TLB)
+//	    cachemiss	for each line an L1 cache (-l1i, -l1d) reads from
+//			or writes back to memory
+//
+//	Anything the file leaves out keeps its default: UserTick for each
+//	class, and no penalties.
+//
+//	An instruction that traps still costs its class, and its
+//	penalties; the kernel's handling of the trap is charged as usual.
+//
+//	"fileName" -- the UNIX file to read
+//----------------------------------------------------------------------
+
+static char *costNames[NumCostClasses] = { "alu", "mult", "div", "load",
+					   "store", "branch" };
+
+void
+Machine::ReadCosts(char *fileName)
+{
+    FILE *fp = fopen(fileName, "r");
+    char name[32];
+    int ticks, i;
+
+    if (fp == NULL) {
+	printf("Can't open cost file %s\n", fileName);
+	ASSERT(FALSE);
+    }
+    while (fscanf(fp, "%31s %d", name, &ticks) == 2) {
+	ASSERT(ticks >= 0);
+	for (i = 0; i < NumCostClasses; i++)
+	    if (!strcmp(name, costNames[i]))
+		break;
+	if (i < NumCostClasses) {
+	    ASSERT(ticks > 0);		// the clock must move on
+	    classTicks[i] = ticks;
+	} else if (!strcmp(name, "tlbmiss"))
+	    tlbMissTicks = ticks;
+	else if (!strcmp(name, "walk"))
+	    walkTicks = ticks;
+	else if (!strcmp(name, "cachemiss"))
+	    cacheMissTicks = ticks;
+	else {
+	    printf("Cost file %s: unknown class %s\n", fileName, name);
+	    ASSERT(FALSE);
+	}
+    }
+    fclose(fp);
+    DEBUG('m', "Costs: alu %d, mult %d, div %d, load %d, store %d, "
+	"branch %d, TLB miss +%d, walk +%d, cache miss +%d\n", 
+	classTicks[CostALU], classTicks[CostMult], classTicks[CostDiv], 
+	classTicks[CostLoad], classTicks[CostStore], classTicks[CostBranch],
+	tlbMissTicks, walkTicks, cacheMissTicks);
 }
 
 //----------------------------------------------------------------------
@@ -127,7 +319,7 @@ void Machine::Debugger()
 
     interrupt->DumpState();
     DumpState();
-    printf("%d> ", stats->totalTicks);
+    printf("%lld> ", stats->totalTicks);
     fflush(stdout);
     fgets(buf, 80, stdin);
     if (sscanf(buf, "%d", &num) == 1)
@@ -25,16 +25,27 @@
 #include "utility.h"
 #include "translate.h"
 #include "disk.h"
+#include "memcache.h"
 
 // Definitions related to the size, and format of user memory
 
-#define PageSize 	SectorSize 	// set the page size equal to
-					// the disk sector size, for
-					// simplicity
+// The page size and the number of physical pages are set at startup
+// ("-ps" and "-np"); by default, a page is the same size as a disk
+// sector, for simplicity, and there are 32 of them.
 
-#define NumPhysPages    32
+extern int pageSize;			// bytes per page (a multiple of 4)
+extern int numPhysPages;		// frames of main memory
+
+#define PageSize 	pageSize
+#define NumPhysPages    numPhysPages
+#define DefaultNumPhysPages 32
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+					// (default; see "-tlb")
+#define PageTableChunk	64		// entries in each second-level
+					// page table (see "-pt2")
+#define XlateCacheSize	16		// entries in the simulator's own
+					// translation cache (power of 2)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -78,6 +89,29 @@ enum ExceptionType { NoException,           // Everything ok!
 //	    registers to act on
 //	    any immediate operand value
 
+class Instruction;
+
+// How many ticks a user instruction costs depends on its class (cf.
+// Machine::ReadCosts).  By default every class costs UserTick, and 
+// nothing else is charged, as in the original Nachos.
+
+enum CostClass { CostALU, CostMult, CostDiv, CostLoad, CostStore,
+		 CostBranch, NumCostClasses };
+
+// What an instruction's handler works on: the registers, and what it
+// leaves for OneInstruction to do when it completes (cf. mipssim.cc).
+
+class OpState {
+  public:
+    int *registers;	// the machine's registers
+    int pcAfter;	// where to go after the delay slot
+    int loadReg;	// delayed load to start, if not 0 ...
+    int loadValue;	// ... and the value it loads
+};
+
+typedef bool (*OpHandler)(Instruction *instr, OpState *state);
+			// execute "instr"; FALSE if it raised an exception
+
 class Instruction {
   public:
     void Decode();	// decode the binary representation of the instruction
@@ -89,6 +123,8 @@ class Instruction {
     unsigned char rs, rt, rd; // Three registers from instruction.
     int extra;       // Immediate or target or shamt field or offset.
                      // Immediates are sign-extended.
+    OpHandler handler;	// routine that executes this opCode
+    unsigned char costClass;	// a CostClass, for the clock
 };
 
 // The following class defines the simulated host workstation hardware, as 
@@ -106,8 +142,11 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-				// for running user programs
+    Machine(bool debug, bool blocks, int numTLB);
+				// Initialize the simulation of the hardware
+				// for running user programs; if "blocks",
+				// run a basic block between clock ticks.
+				// "numTLB" is the number of TLB entries
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -118,11 +157,32 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    void FlushXlateCache();	// forget all cached translations; the
+				// kernel must call this on a context
+				// switch and whenever it evicts a page
+
+    void InvalidateDecodedPage(int physPage);
+				// forget the pre-decoded instructions for
+				// physical page "physPage"; the kernel
+				// must call this whenever it changes the
+				// contents of a frame behind our back
+
+    void ReadCosts(char *fileName);
+				// read the ticks each class of instruction
+				// costs, and the penalties for TLB misses,
+				// page table walks and cache misses, from 
+				// a file
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    void RunBlock(Instruction *instr);
+    				// Run instructions up to the end of the
+				// basic block, then advance the clock
+    void ChargeDeferredTicks();	// Account for the instructions RunBlock
+				// has run without advancing the clock
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -138,6 +198,10 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    bool FastTranslate(int virtAddr, int* physAddr, int size, bool writing);
+    				// Same, but only using the translation
+				// cache; return FALSE (and do nothing) if
+				// Translate has to be called instead
 
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
@@ -156,6 +220,12 @@ class Machine {
     char *mainMemory;		// physical memory to store user program,
 				// code and data, while executing
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
+    bool linked;		// set by an LL instruction, so that the
+    int linkAddr;		// next SC to the same address stores
+
+    void BreakLink() { linked = FALSE; }
+				// make the next SC fail; the kernel must
+				// call this on a context switch
 
 
 // NOTE: the hardware translation of virtual addresses in the user program
@@ -165,7 +235,9 @@ class Machine {
 //  	a software-loaded translation lookaside buffer (tlb) -- a cache of 
 //	  mappings of virtual page #'s to physical page #'s
 //
-// If "tlb" is NULL, the linear page table is used
+// If "tlb" is NULL, the linear page table is used, or if "pageDirectory"
+//	is set instead, a two-level one: pageDirectory[vpn / PageTableChunk]
+//	is NULL or points to the PageTableChunk entries for those pages
 // If "tlb" is non-NULL, the Nachos kernel is responsible for managing
 //	the contents of the TLB.  But the kernel can use any data structure
 //	it wants (eg, segmented paging) for handling TLB cache misses.
@@ -176,17 +248,69 @@ class Machine {
 // Thus the TLB pointer should be considered as *read-only*, although 
 // the contents of the TLB are free to be modified by the kernel software.
 
-    TranslationEntry *tlb;		// this pointer should be considered 
+    TLBEntry *tlb;			// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int tlbSize;			// number of entries in the TLB
+    unsigned int *tlbLastUse;		// for each TLB entry, the value of
+					// tlbUseCount when it was last used
+    unsigned int tlbUseCount;		// counts TLB references, so the
+					// kernel can do LRU replacement
+    int tlbASID;			// the address space ID the TLB
+					// matches entries of
+
+    VoidFunctionPtr frameRefHook;	// if not NULL, called with the
+					// physical page number on every
+					// successful translation (to let
+					// the kernel do LRU page replacement)
 
     TranslationEntry *pageTable;
+    TranslationEntry **pageDirectory;
     unsigned int pageTableSize;
 
+// The L1 caches, cache[ICache] for instruction fetches and cache[DCache]
+// for loads and stores, are NULL unless the kernel sets them up.  They
+// only see physical addresses, once translation has succeeded.
+
+    MemoryCache *cache[NumCacheKinds];
+
   private:
+    TranslationEntry *XlateOwner()	// identifies the current tables
+	{ return (tlb != NULL) ? tlb : 
+	    ((pageTable != NULL) ? pageTable : (TranslationEntry *) pageDirectory); }
+
+    bool traceInstructions;	// print each instruction? (-d m)
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
-    int runUntilTime;		// drop back into the debugger when simulated
+    long long runUntilTime;	// drop back into the debugger when simulated
 				// time reaches this value
+
+    bool blockMode;		// run a basic block at a time (RunBlock)
+    int deferredTicks;		// ticks of the instructions run by 
+				// RunBlock that have not been charged yet
+    bool blockBroken;		// set when the block traps to the kernel
+
+    int classTicks[NumCostClasses];	// what each class of instruction
+				// costs, in ticks
+    int tlbMissTicks;		// extra, for each TLB miss
+    int walkTicks;		// extra, for each translation through a
+				// two-level page table (the directory is
+				// one more memory reference)
+    int instrTicks;		// what the instruction being run costs,
+				// so far
+    int cacheMissTicks;		// extra, for each line an L1 cache moves
+				// to or from memory
+
+    void CacheAccess(CacheKind kind, int physAddr, bool writing);
+				// Count an access through an L1 cache
+
+    XlateCacheEntry xlateCache[XlateCacheSize];
+				// recently used translations
+    bool xlateEnabled;		// use xlateCache? (not with -d a, so the
+				// debug output stays complete)
+
+    Instruction *decodedCache;	// decoded copy of each word of mainMemory,
+				// indexed by physical address / 4
+    bool *decodedValid;		// is the decodedCache entry up to date?
 };
 
 extern void ExceptionHandler(ExceptionType which);
@@ -0,0 +1,132 @@
+// memcache.cc
+//	Routines to simulate a level 1 CPU cache.  See memcache.h.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "memcache.h"
+
+//----------------------------------------------------------------------
+// IsPowerOfTwo
+// 	Is "n" a (positive) power of two?
+//----------------------------------------------------------------------
+
+static bool
+IsPowerOfTwo(int n)
+{
+    return (n > 0) && ((n & (n - 1)) == 0);
+}
+
+//----------------------------------------------------------------------
+// MemoryCache::MemoryCache
+// 	Initialize an empty cache.
+//
+//	"size" -- bytes the cache holds
+//	"lineBytes" -- bytes per line
+//	"assoc" -- lines per set (1 for a direct mapped cache; size / 
+//		lineBytes for a fully associative one)
+//----------------------------------------------------------------------
+
+MemoryCache::MemoryCache(int size, int lineBytes, int assoc)
+{
+    int numLines;
+
+    ASSERT(IsPowerOfTwo(size) && IsPowerOfTwo(lineBytes) 
+		&& IsPowerOfTwo(assoc));
+    ASSERT(lineBytes >= 4 && size >= lineBytes * assoc);
+    lineSize = lineBytes;
+    ways = assoc;
+    numLines = size / lineSize;
+    numSets = numLines / ways;
+    tags = new unsigned int[numLines];
+    valid = new bool[numLines];
+    dirty = new bool[numLines];
+    lastUse = new unsigned int[numLines];
+    for (int i = 0; i < numLines; i++) {
+	valid[i] = dirty[i] = FALSE;
+	lastUse[i] = 0;
+    }
+    useCount = 0;
+}
+
+MemoryCache::~MemoryCache()
+{
+    delete [] tags;
+    delete [] valid;
+    delete [] dirty;
+    delete [] lastUse;
+}
+
+//----------------------------------------------------------------------
+// MemoryCache::Access
+// 	Look the line holding "physAddr" up in its set.  On a miss, bring
+//	it in, in place of an empty line or else the least recently used
+//	one, writing that back first if it is dirty.
+//
+//	An access never spans two lines: user accesses are aligned, and
+//	a line is at least a word.
+//
+//	"physAddr" -- the byte accessed, in mainMemory
+//	"writing" -- TRUE for a store
+//
+// Returns:
+//	the lines moved to or from memory: 0 (a hit), 1 or 2
+//----------------------------------------------------------------------
+
+int
+MemoryCache::Access(int physAddr, bool writing)
+{
+    unsigned int line = (unsigned) physAddr / lineSize;
+    int first = (line % numSets) * ways;
+    int i, victim = first, moved = 1;
+
+    useCount++;
+    for (i = first; i < first + ways; i++)
+	if (valid[i] && tags[i] == line) {
+	    lastUse[i] = useCount;
+	    if (writing)
+		dirty[i] = TRUE;
+	    return 0;			// hit
+	}
+    for (i = first; i < first + ways; i++) {
+	if (!valid[i]) {
+	    victim = i;
+	    break;
+	}
+	if (lastUse[i] < lastUse[victim])
+	    victim = i;
+    }
+    if (valid[victim] && dirty[victim])
+	moved++;			// write the old line back first
+    tags[victim] = line;
+    valid[victim] = TRUE;
+    dirty[victim] = writing;
+    lastUse[victim] = useCount;
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// MemoryCache::Invalidate
+// 	Drop every line holding part of "length" bytes at "physAddr",
+//	without writing it back: memory has been changed under the cache
+//	(as by DMA), and what the cache had is stale.
+//----------------------------------------------------------------------
+
+void
+MemoryCache::Invalidate(int physAddr, int length)
+{
+    unsigned int firstLine = (unsigned) physAddr / lineSize;
+    unsigned int lastLine = (unsigned) (physAddr + length - 1) / lineSize;
+    int i, first;
+
+    for (unsigned int line = firstLine; line <= lastLine; line++) {
+	first = (line % numSets) * ways;
+	for (i = first; i < first + ways; i++)
+	    if (valid[i] && tags[i] == line)
+		valid[i] = dirty[i] = FALSE;
+    }
+}
@@ -0,0 +1,60 @@
+// memcache.h
+//	Data structures to simulate a level 1 CPU cache, in front of
+//	"mainMemory", for studying the locality of user programs.
+//
+//	The cache is set associative, with LRU replacement within a set,
+//	and writes back: a store allocates the line and dirties it, and
+//	the line is only written to memory when it is evicted.  Only the
+//	tags are kept -- the data always comes from mainMemory -- so the
+//	cache changes nothing but the hit and miss counts, and, if a miss
+//	penalty is set (cf. Machine::ReadCosts), simulated time.
+//
+//	The machine has one cache for instruction fetches, and one for
+//	loads and stores, if Nachos is started with "-l1i" or "-l1d".
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MEMCACHE_H
+#define MEMCACHE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// Which of the machine's caches -- for the per-thread counts
+enum CacheKind { ICache, DCache, NumCacheKinds };
+
+class MemoryCache {
+  public:
+    MemoryCache(int size, int lineBytes, int assoc);
+				// A cache of "size" bytes, in lines of 
+				// "lineBytes" bytes, "assoc" lines to a set;
+				// all three powers of two
+    ~MemoryCache();
+
+    int Access(int physAddr, bool writing);
+				// Look up the line holding "physAddr"; 
+				// returns how many lines had to be moved 
+				// to or from memory: 0 on a hit, 1 on a 
+				// miss, 2 if that evicted a dirty line
+    void Invalidate(int physAddr, int length);
+				// Forget the lines holding these bytes,
+				// which something other than the CPU
+				// has changed (e.g., a page being read in)
+
+  private:
+    int lineSize;		// bytes per line
+    int numSets;		// sets in the cache
+    int ways;			// lines per set
+    unsigned int *tags;		// for each line, the memory line it
+				// holds (physAddr / lineSize)
+    bool *valid;		// ... whether it holds one
+    bool *dirty;		// ... and whether it was written since
+    unsigned int *lastUse;	// when each line was last accessed
+    unsigned int useCount;	// counts accesses, for LRU
+};
+
+#endif // MEMCACHE_H
@@ -25,6 +25,8 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	Compiled with -DFAST_SIM, the debugger (-s) is left out.
 //----------------------------------------------------------------------
 
 void
@@ -33,18 +35,75 @@ Machine::Run()
     Instruction *instr = new Instruction;  // storage for decoded instruction
 
     if(DebugIsEnabled('m'))
-        printf("Starting thread \"%s\" at time %d\n",
+        printf("Starting thread \"%s\" at time %lld\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
     for (;;) {
-        OneInstruction(instr);
-	interrupt->OneTick();
+	if (blockMode && !DebugIsEnabled('i') && scheduler->NumCPUs() == 1)
+	    RunBlock(instr);
+	else {
+	    OneInstruction(instr);
+	    interrupt->OneTick(instrTicks);
+	}
+#ifndef FAST_SIM
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
+#endif
     }
 }
 
 
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Execute user instructions up to the end of the current basic
+//	block -- the delay slot of a taken branch or jump, or a trap into
+//	the kernel -- and only then advance the clock.
+//
+//	Simulated time must come out exactly as if OneTick had been
+//	called after every instruction.  The skipped calls would only have
+//	added the instructions' ticks and found nothing due, so we end the
+//	block at the instruction whose ticks reach the next pending 
+//	interrupt, and give the last instruction of every block a real 
+//	OneTick.  If
+//	an instruction traps, RaiseException charges the deferred ticks 
+//	first, so the kernel runs at the same simulated time as before.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlock(Instruction *instr)
+{
+    int room = interrupt->TicksUntilDue();
+    int pc;
+
+    blockBroken = FALSE;
+    for (;;) {
+	pc = registers[PCReg];
+	OneInstruction(instr);
+	if (blockBroken || (registers[PCReg] != pc + 4) 
+			|| (deferredTicks + instrTicks >= room))
+	    break;
+	deferredTicks += instrTicks;
+    }
+    ChargeDeferredTicks();
+    interrupt->OneTick(instrTicks);	// for the last instruction
+}
+
+//----------------------------------------------------------------------
+// Machine::ChargeDeferredTicks
+// 	Advance simulated time for the user instructions that RunBlock
+//	has executed without calling OneTick.  None of them can make an
+//	interrupt due, so just bump the counters.
+//----------------------------------------------------------------------
+
+void
+Machine::ChargeDeferredTicks()
+{
+    stats->totalTicks += deferredTicks;
+    stats->userTicks += deferredTicks;
+    currentThread->userTicks += deferredTicks;
+    deferredTicks = 0;
+}
+
 //----------------------------------------------------------------------
 // TypeToReg
 // 	Retrieve the register # referred to in an instruction. 
@@ -67,6 +126,742 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// Instruction handlers
+// 	One small routine per opcode, each doing just what its instruction
+//	needs (cf. Kane's book).  Decode stores the instruction's handler
+//	in the decoded copy, so OneInstruction dispatches with a single
+//	indirect call through the decoded instruction cache, without 
+//	looking at the opcode again.
+//
+//	"instr" -- the decoded instruction
+//	"s" -- the registers, and what the instruction leaves for
+//		OneInstruction to do once it has completed: where to go 
+//		after the delay slot, and a delayed load to start
+//
+// Returns:
+//	FALSE if the instruction raised an exception (already taken), 
+//	so the rest of OneInstruction must be skipped.
+//----------------------------------------------------------------------
+
+static bool
+OpADD(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    int sum = reg[instr->rs] + reg[instr->rt];
+
+    if (!((reg[instr->rs] ^ reg[instr->rt]) & SIGN_BIT) &&
+	((reg[instr->rs] ^ sum) & SIGN_BIT)) {
+	machine->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    reg[instr->rd] = sum;
+    return TRUE;
+}
+
+static bool
+OpADDI(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    int sum = reg[instr->rs] + instr->extra;
+
+    if (!((reg[instr->rs] ^ instr->extra) & SIGN_BIT) &&
+	((instr->extra ^ sum) & SIGN_BIT)) {
+	machine->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    reg[instr->rt] = sum;
+    return TRUE;
+}
+
+static bool
+OpADDIU(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rt] = s->registers[instr->rs] + instr->extra;
+    return TRUE;
+}
+
+static bool
+OpADDU(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = reg[instr->rs] + reg[instr->rt];
+    return TRUE;
+}
+
+static bool
+OpAND(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = reg[instr->rs] & reg[instr->rt];
+    return TRUE;
+}
+
+static bool
+OpANDI(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rt] = s->registers[instr->rs] & (instr->extra & 0xffff);
+    return TRUE;
+}
+
+// Branches: the target is relative to the delay slot, NextPCReg.
+
+static bool
+OpBEQ(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    if (reg[instr->rs] == reg[instr->rt])
+	s->pcAfter = reg[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+OpBGEZ(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    if (!(reg[instr->rs] & SIGN_BIT))
+	s->pcAfter = reg[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+OpBGEZAL(Instruction *instr, OpState *s)
+{
+    s->registers[R31] = s->registers[NextPCReg] + 4;
+    return OpBGEZ(instr, s);
+}
+
+static bool
+OpBGTZ(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    if (reg[instr->rs] > 0)
+	s->pcAfter = reg[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+OpBLEZ(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    if (reg[instr->rs] <= 0)
+	s->pcAfter = reg[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+OpBLTZ(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    if (reg[instr->rs] & SIGN_BIT)
+	s->pcAfter = reg[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+OpBLTZAL(Instruction *instr, OpState *s)
+{
+    s->registers[R31] = s->registers[NextPCReg] + 4;
+    return OpBLTZ(instr, s);
+}
+
+static bool
+OpBNE(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    if (reg[instr->rs] != reg[instr->rt])
+	s->pcAfter = reg[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+OpDIV(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    if (reg[instr->rt] == 0) {
+	reg[LoReg] = 0;
+	reg[HiReg] = 0;
+    } else {
+	reg[LoReg] = reg[instr->rs] / reg[instr->rt];
+	reg[HiReg] = reg[instr->rs] % reg[instr->rt];
+    }
+    return TRUE;
+}
+
+static bool
+OpDIVU(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    unsigned int rs = (unsigned int) reg[instr->rs];
+    unsigned int rt = (unsigned int) reg[instr->rt];
+
+    if (rt == 0) {
+	reg[LoReg] = 0;
+	reg[HiReg] = 0;
+    } else {
+	reg[LoReg] = (int) (rs / rt);
+	reg[HiReg] = (int) (rs % rt);
+    }
+    return TRUE;
+}
+
+static bool
+OpJ(Instruction *instr, OpState *s)
+{
+    s->pcAfter = (s->pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+OpJAL(Instruction *instr, OpState *s)
+{
+    s->registers[R31] = s->registers[NextPCReg] + 4;
+    return OpJ(instr, s);
+}
+
+static bool
+OpJR(Instruction *instr, OpState *s)
+{
+    s->pcAfter = s->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+OpJALR(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rd] = s->registers[NextPCReg] + 4;
+    return OpJR(instr, s);
+}
+
+// Loads: the value only reaches the register after the next
+// instruction (see DelayedLoad).
+
+static bool
+OpLB(Instruction *instr, OpState *s)
+{
+    int value;
+
+    if (!machine->ReadMem(s->registers[instr->rs] + instr->extra, 1, &value))
+	return FALSE;
+    if (value & 0x80)
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    s->loadReg = instr->rt;
+    s->loadValue = value;
+    return TRUE;
+}
+
+static bool
+OpLBU(Instruction *instr, OpState *s)
+{
+    int value;
+
+    if (!machine->ReadMem(s->registers[instr->rs] + instr->extra, 1, &value))
+	return FALSE;
+    s->loadReg = instr->rt;
+    s->loadValue = value & 0xff;
+    return TRUE;
+}
+
+static bool
+OpLH(Instruction *instr, OpState *s)
+{
+    int addr = s->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (addr & 0x1) {
+	machine->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!machine->ReadMem(addr, 2, &value))
+	return FALSE;
+    if (value & 0x8000)
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    s->loadReg = instr->rt;
+    s->loadValue = value;
+    return TRUE;
+}
+
+static bool
+OpLHU(Instruction *instr, OpState *s)
+{
+    int addr = s->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (addr & 0x1) {
+	machine->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!machine->ReadMem(addr, 2, &value))
+	return FALSE;
+    s->loadReg = instr->rt;
+    s->loadValue = value & 0xffff;
+    return TRUE;
+}
+
+static bool
+OpLUI(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rt] = instr->extra << 16;
+    return TRUE;
+}
+
+static bool
+OpLW(Instruction *instr, OpState *s)
+{
+    int addr = s->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (addr & 0x3) {
+	machine->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    if (!machine->ReadMem(addr, 4, &value))
+	return FALSE;
+    s->loadReg = instr->rt;
+    s->loadValue = value;
+    return TRUE;
+}
+
+// LL and SC (MIPS II) make a read-modify-write of a word atomic: SC
+// stores only if nothing can have come between it and the LL, and sets
+// its register to 1 if it did, 0 if not.  With one processor, only a
+// trap to the kernel (see Machine::RaiseException) or a switch to
+// another thread (Machine::BreakLink) can come between them.
+
+static bool
+OpLL(Instruction *instr, OpState *s)
+{
+    int addr = s->registers[instr->rs] + instr->extra;
+
+    if (!OpLW(instr, s))
+	return FALSE;
+    machine->linked = TRUE;
+    machine->linkAddr = addr;
+    return TRUE;
+}
+
+static bool
+OpSC(Instruction *instr, OpState *s)
+{
+    int addr = s->registers[instr->rs] + instr->extra;
+    bool linked = machine->linked && machine->linkAddr == addr;
+
+    if (addr & 0x3) {
+	machine->RaiseException(AddressErrorException, addr);
+	return FALSE;
+    }
+    machine->linked = FALSE;
+    if (linked && !machine->WriteMem(addr, 4, s->registers[instr->rt]))
+	return FALSE;
+    s->registers[instr->rt] = linked ? 1 : 0;
+    return TRUE;
+}
+
+// LWL and LWR merge into the register's value -- or into the value
+// still on its way to it, from the load just before.
+//
+// ReadMem assumes all 4 byte requests are aligned on an even 
+// word boundary.  Also, the little endian/big endian swap code would
+// fail (I think) if the other cases are ever exercised.
+
+static bool
+OpLWL(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    int addr = reg[instr->rs] + instr->extra;
+    int value, merged;
+
+    ASSERT((addr & 0x3) == 0);  
+    if (!machine->ReadMem(addr, 4, &value))
+	return FALSE;
+    if (reg[LoadReg] == instr->rt)
+	merged = reg[LoadValueReg];
+    else
+	merged = reg[instr->rt];
+    switch (addr & 0x3) {
+      case 0:
+	merged = value;
+	break;
+      case 1:
+	merged = (merged & 0xff) | (value << 8);
+	break;
+      case 2:
+	merged = (merged & 0xffff) | (value << 16);
+	break;
+      case 3:
+	merged = (merged & 0xffffff) | (value << 24);
+	break;
+    }
+    s->loadReg = instr->rt;
+    s->loadValue = merged;
+    return TRUE;
+}
+
+static bool
+OpLWR(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    int addr = reg[instr->rs] + instr->extra;
+    int value, merged;
+
+    ASSERT((addr & 0x3) == 0);  
+    if (!machine->ReadMem(addr, 4, &value))
+	return FALSE;
+    if (reg[LoadReg] == instr->rt)
+	merged = reg[LoadValueReg];
+    else
+	merged = reg[instr->rt];
+    switch (addr & 0x3) {
+      case 0:
+	merged = (merged & 0xffffff00) | ((value >> 24) & 0xff);
+	break;
+      case 1:
+	merged = (merged & 0xffff0000) | ((value >> 16) & 0xffff);
+	break;
+      case 2:
+	merged = (merged & 0xff000000) | ((value >> 8) & 0xffffff);
+	break;
+      case 3:
+	merged = value;
+	break;
+    }
+    s->loadReg = instr->rt;
+    s->loadValue = merged;
+    return TRUE;
+}
+
+static bool
+OpMFHI(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rd] = s->registers[HiReg];
+    return TRUE;
+}
+
+static bool
+OpMFLO(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rd] = s->registers[LoReg];
+    return TRUE;
+}
+
+static bool
+OpMTHI(Instruction *instr, OpState *s)
+{
+    s->registers[HiReg] = s->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+OpMTLO(Instruction *instr, OpState *s)
+{
+    s->registers[LoReg] = s->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+OpMULT(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    Mult(reg[instr->rs], reg[instr->rt], TRUE, &reg[HiReg], &reg[LoReg]);
+    return TRUE;
+}
+
+static bool
+OpMULTU(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    Mult(reg[instr->rs], reg[instr->rt], FALSE, &reg[HiReg], &reg[LoReg]);
+    return TRUE;
+}
+
+static bool
+OpNOR(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = ~(reg[instr->rs] | reg[instr->rt]);
+    return TRUE;
+}
+
+static bool
+OpOR(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = reg[instr->rs] | reg[instr->rt];
+    return TRUE;
+}
+
+static bool
+OpORI(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rt] = s->registers[instr->rs] | (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+OpSB(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    return machine->WriteMem((unsigned) (reg[instr->rs] + instr->extra), 1,
+				reg[instr->rt]);
+}
+
+static bool
+OpSH(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    return machine->WriteMem((unsigned) (reg[instr->rs] + instr->extra), 2,
+				reg[instr->rt]);
+}
+
+static bool
+OpSLL(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rd] = s->registers[instr->rt] << instr->extra;
+    return TRUE;
+}
+
+static bool
+OpSLLV(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = reg[instr->rt] << (reg[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+static bool
+OpSLT(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = (reg[instr->rs] < reg[instr->rt]) ? 1 : 0;
+    return TRUE;
+}
+
+static bool
+OpSLTI(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rt] = (reg[instr->rs] < instr->extra) ? 1 : 0;
+    return TRUE;
+}
+
+static bool
+OpSLTIU(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rt] = ((unsigned int) reg[instr->rs] <
+			(unsigned int) instr->extra) ? 1 : 0;
+    return TRUE;
+}
+
+static bool
+OpSLTU(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = ((unsigned int) reg[instr->rs] <
+			(unsigned int) reg[instr->rt]) ? 1 : 0;
+    return TRUE;
+}
+
+static bool
+OpSRA(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rd] = s->registers[instr->rt] >> instr->extra;
+    return TRUE;
+}
+
+static bool
+OpSRAV(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = reg[instr->rt] >> (reg[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+static bool
+OpSRL(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = (int) ((unsigned int) reg[instr->rt] >> instr->extra);
+    return TRUE;
+}
+
+static bool
+OpSRLV(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = (int) ((unsigned int) reg[instr->rt] >> 
+				(reg[instr->rs] & 0x1f));
+    return TRUE;
+}
+
+static bool
+OpSUB(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    int diff = reg[instr->rs] - reg[instr->rt];
+
+    if (((reg[instr->rs] ^ reg[instr->rt]) & SIGN_BIT) &&
+	((reg[instr->rs] ^ diff) & SIGN_BIT)) {
+	machine->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    reg[instr->rd] = diff;
+    return TRUE;
+}
+
+static bool
+OpSUBU(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = reg[instr->rs] - reg[instr->rt];
+    return TRUE;
+}
+
+static bool
+OpSW(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    return machine->WriteMem((unsigned) (reg[instr->rs] + instr->extra), 4,
+				reg[instr->rt]);
+}
+
+// The little endian/big endian swap code would
+// fail (I think) if the other cases of SWL and SWR are ever exercised.
+
+static bool
+OpSWL(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    int addr = reg[instr->rs] + instr->extra;
+    int value;
+
+    ASSERT((addr & 0x3) == 0);  
+    if (!machine->ReadMem((addr & ~0x3), 4, &value))
+	return FALSE;
+    switch (addr & 0x3) {
+      case 0:
+	value = reg[instr->rt];
+	break;
+      case 1:
+	value = (value & 0xff000000) | ((reg[instr->rt] >> 8) & 0xffffff);
+	break;
+      case 2:
+	value = (value & 0xffff0000) | ((reg[instr->rt] >> 16) & 0xffff);
+	break;
+      case 3:
+	value = (value & 0xffffff00) | ((reg[instr->rt] >> 24) & 0xff);
+	break;
+    }
+    return machine->WriteMem((addr & ~0x3), 4, value);
+}
+
+static bool
+OpSWR(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+    int addr = reg[instr->rs] + instr->extra;
+    int value;
+
+    ASSERT((addr & 0x3) == 0);  
+    if (!machine->ReadMem((addr & ~0x3), 4, &value))
+	return FALSE;
+    switch (addr & 0x3) {
+      case 0:
+	value = (value & 0xffffff) | (reg[instr->rt] << 24);
+	break;
+      case 1:
+	value = (value & 0xffff) | (reg[instr->rt] << 16);
+	break;
+      case 2:
+	value = (value & 0xff) | (reg[instr->rt] << 8);
+	break;
+      case 3:
+	value = reg[instr->rt];
+	break;
+    }
+    return machine->WriteMem((addr & ~0x3), 4, value);
+}
+
+static bool
+OpSYSCALL(Instruction *instr, OpState *s)
+{
+    machine->RaiseException(SyscallException, 0);
+    return FALSE;
+}
+
+static bool
+OpXOR(Instruction *instr, OpState *s)
+{
+    int *reg = s->registers;
+
+    reg[instr->rd] = reg[instr->rs] ^ reg[instr->rt];
+    return TRUE;
+}
+
+static bool
+OpXORI(Instruction *instr, OpState *s)
+{
+    s->registers[instr->rt] = s->registers[instr->rs] ^ (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+OpIllegal(Instruction *instr, OpState *s)	// OP_RES, OP_UNIMP
+{
+    machine->RaiseException(IllegalInstrException, 0);
+    return FALSE;
+}
+
+static bool
+OpNone(Instruction *instr, OpState *s)		// no such opCode
+{
+    ASSERT(FALSE);
+    return FALSE;
+}
+
+// The handler for each opCode value (see mipssim.h).
+
+static OpHandler opHandlers[MaxOpcode + 1] = {
+    OpNone, OpADD, OpADDI, OpADDIU, OpADDU, OpAND, OpANDI, OpBEQ,	// 0
+    OpBGEZ, OpBGEZAL, OpBGTZ, OpBLEZ, OpBLTZ, OpBLTZAL, OpBNE, OpNone,	// 8
+    OpDIV, OpDIVU, OpJ, OpJAL, OpJALR, OpJR, OpLB, OpLBU,		// 16
+    OpLH, OpLHU, OpLUI, OpLW, OpLWL, OpLWR, OpNone, OpMFHI,		// 24
+    OpMFLO, OpNone, OpMTHI, OpMTLO, OpMULT, OpMULTU, OpNOR, OpOR,	// 32
+    OpORI, OpNone, OpSB, OpSH, OpSLL, OpSLLV, OpSLT, OpSLTI,		// 40
+    OpSLTIU, OpSLTU, OpSRA, OpSRAV, OpSRL, OpSRLV, OpSUB, OpSUBU,	// 48
+    OpSW, OpSWL, OpSWR, OpXOR, OpXORI, OpSYSCALL, OpIllegal, OpIllegal,	// 56
+    OpLL, OpSC								// 64
+};
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -88,23 +883,50 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	The one exception is the decoded instruction cache: each word of
+//	physical memory is decoded the first time it is fetched, and
+//	the decoded copy is re-used until the word is written (by 
+//	WriteMem) or the kernel reloads the frame (InvalidateDecodedPage).
+//	The fetch is still translated every time, so page faults and
+//	the use bits behave exactly as before.  "instr" is only scratch
+//	storage now; we point it at the cached copy instead.
+//
+//	Compiled with -DFAST_SIM, the instruction trace (-d m) is left
+//	out altogether.
 //----------------------------------------------------------------------
 
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    int physAddr, slot;
+    ExceptionType exception;
+    OpState state;
 
-    // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    // Fetch instruction; the translations add their penalties, if any,
+    // to what it costs
+    instrTicks = 0;
+    if (!FastTranslate(registers[PCReg], &physAddr, 4, FALSE)) {
+	exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+	if (exception != NoException) {
+	    instrTicks += classTicks[CostALU];	// for the attempt
+	    RaiseException(exception, registers[PCReg]);
+	    return;		// exception occurred
+	}
+    }
+    CacheAccess(ICache, physAddr, FALSE);
+    slot = physAddr / 4;
+    if (!decodedValid[slot]) {
+	decodedCache[slot].value = 
+		WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+	decodedCache[slot].Decode();
+	decodedValid[slot] = TRUE;
+    }
+    instr = &decodedCache[slot];
+    instrTicks += classTicks[instr->costClass];
 
-    if (DebugIsEnabled('m')) {
+#ifndef FAST_SIM
+    if (traceInstructions) {
        struct OpString *str = &opStrings[instr->opCode];
 
        ASSERT(instr->opCode <= MaxOpcode);
@@ -113,455 +935,33 @@ Machine::OneInstruction(Instruction *instr)
 		TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
        printf("\n");
        }
+#endif
     
     // Compute next pc, but don't install in case there's an error or branch.
-    int pcAfter = registers[NextPCReg] + 4;
-    int sum, diff, tmp, value;
-    unsigned int rs, rt, imm;
+    state.registers = registers;
+    state.pcAfter = registers[NextPCReg] + 4;
+    state.loadReg = 0;
+    state.loadValue = 0;
 
-    // Execute the instruction (cf. Kane's book)
-    switch (instr->opCode) {
-	
-      case OP_ADD:
-	sum = registers[instr->rs] + registers[instr->rt];
-	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rd] = sum;
-	break;
-	
-      case OP_ADDI:
-	sum = registers[instr->rs] + instr->extra;
-	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
-	    ((instr->extra ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rt] = sum;
-	break;
-	
-      case OP_ADDIU:
-	registers[instr->rt] = registers[instr->rs] + instr->extra;
-	break;
-	
-      case OP_ADDU:
-	registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
-	break;
-	
-      case OP_AND:
-	registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
-	break;
-	
-      case OP_ANDI:
-	registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
-	break;
-	
-      case OP_BEQ:
-	if (registers[instr->rs] == registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BGEZAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BGEZ:
-	if (!(registers[instr->rs] & SIGN_BIT))
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BGTZ:
-	if (registers[instr->rs] > 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLEZ:
-	if (registers[instr->rs] <= 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLTZAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BLTZ:
-	if (registers[instr->rs] & SIGN_BIT)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BNE:
-	if (registers[instr->rs] != registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_DIV:
-	if (registers[instr->rt] == 0) {
-	    registers[LoReg] = 0;
-	    registers[HiReg] = 0;
-	} else {
-	    registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
-	    registers[HiReg] = registers[instr->rs] % registers[instr->rt];
-	}
-	break;
-	
-      case OP_DIVU:	  
-	  rs = (unsigned int) registers[instr->rs];
-	  rt = (unsigned int) registers[instr->rt];
-	  if (rt == 0) {
-	      registers[LoReg] = 0;
-	      registers[HiReg] = 0;
-	  } else {
-	      tmp = rs / rt;
-	      registers[LoReg] = (int) tmp;
-	      tmp = rs % rt;
-	      registers[HiReg] = (int) tmp;
-	  }
-	  break;
-	
-      case OP_JAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_J:
-	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
-	break;
-	
-      case OP_JALR:
-	registers[instr->rd] = registers[NextPCReg] + 4;
-      case OP_JR:
-	pcAfter = registers[instr->rs];
-	break;
-	
-      case OP_LB:
-      case OP_LBU:
-	tmp = registers[instr->rs] + instr->extra;
-	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
-
-	if ((value & 0x80) && (instr->opCode == OP_LB))
-	    value |= 0xffffff00;
-	else
-	    value &= 0xff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-	
-      case OP_LH:
-      case OP_LHU:	  
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x1) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
-
-	if ((value & 0x8000) && (instr->opCode == OP_LH))
-	    value |= 0xffff0000;
-	else
-	    value &= 0xffff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-      	
-      case OP_LUI:
-	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
-	registers[instr->rt] = instr->extra << 16;
-	break;
-	
-      case OP_LW:
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x3) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-    	
-      case OP_LWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = value;
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
-	    break;
-	  case 3:
-	    nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
-	    break;
-	}
-	nextLoadReg = instr->rt;
-	break;
-      	
-      case OP_LWR:
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = (nextLoadValue & 0xffffff00) |
-		((value >> 24) & 0xff);
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xffff0000) |
-		((value >> 16) & 0xffff);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xff000000)
-		| ((value >> 8) & 0xffffff);
-	    break;
-	  case 3:
-	    nextLoadValue = value;
-	    break;
-	}
-	nextLoadReg = instr->rt;
-	break;
-    	
-      case OP_MFHI:
-	registers[instr->rd] = registers[HiReg];
-	break;
-	
-      case OP_MFLO:
-	registers[instr->rd] = registers[LoReg];
-	break;
-	
-      case OP_MTHI:
-	registers[HiReg] = registers[instr->rs];
-	break;
-	
-      case OP_MTLO:
-	registers[LoReg] = registers[instr->rs];
-	break;
-	
-      case OP_MULT:
-	Mult(registers[instr->rs], registers[instr->rt], TRUE,
-	     &registers[HiReg], &registers[LoReg]);
-	break;
-	
-      case OP_MULTU:
-	Mult(registers[instr->rs], registers[instr->rt], FALSE,
-	     &registers[HiReg], &registers[LoReg]);
-	break;
-	
-      case OP_NOR:
-	registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
-	break;
-	
-      case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
-	break;
-	
-      case OP_ORI:
-	registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
-	break;
-	
-      case OP_SB:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SH:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SLL:
-	registers[instr->rd] = registers[instr->rt] << instr->extra;
-	break;
-	
-      case OP_SLLV:
-	registers[instr->rd] = registers[instr->rt] <<
-	    (registers[instr->rs] & 0x1f);
-	break;
-	
-      case OP_SLT:
-	if (registers[instr->rs] < registers[instr->rt])
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
-	break;
-	
-      case OP_SLTI:
-	if (registers[instr->rs] < instr->extra)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
-	break;
-	
-      case OP_SLTIU:	  
-	rs = registers[instr->rs];
-	imm = instr->extra;
-	if (rs < imm)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
-	break;
-      	
-      case OP_SLTU:	  
-	rs = registers[instr->rs];
-	rt = registers[instr->rt];
-	if (rs < rt)
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
-	break;
-      	
-      case OP_SRA:
-	registers[instr->rd] = registers[instr->rt] >> instr->extra;
-	break;
-	
-      case OP_SRAV:
-	registers[instr->rd] = registers[instr->rt] >>
-	    (registers[instr->rs] & 0x1f);
-	break;
-	
-      case OP_SRL:
-	tmp = registers[instr->rt];
-	tmp >>= instr->extra;
-	registers[instr->rd] = tmp;
-	break;
-	
-      case OP_SRLV:
-	tmp = registers[instr->rt];
-	tmp >>= (registers[instr->rs] & 0x1f);
-	registers[instr->rd] = tmp;
-	break;
-	
-      case OP_SUB:	  
-	diff = registers[instr->rs] - registers[instr->rt];
-	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rd] = diff;
-	break;
-      	
-      case OP_SUBU:
-	registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
-	break;
-	
-      case OP_SW:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = registers[instr->rt];
-	    break;
-	  case 1:
-	    value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
-					    0xffffff);
-	    break;
-	  case 2:
-	    value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
-					    0xffff);
-	    break;
-	  case 3:
-	    value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
-					    0xff);
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SWR:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
-	    break;
-	  case 1:
-	    value = (value & 0xffff) | (registers[instr->rt] << 16);
-	    break;
-	  case 2:
-	    value = (value & 0xff) | (registers[instr->rt] << 8);
-	    break;
-	  case 3:
-	    value = registers[instr->rt];
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SYSCALL:
-	RaiseException(SyscallException, 0);
-	return; 
-	
-      case OP_XOR:
-	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
-	break;
-	
-      case OP_XORI:
-	registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
-	break;
-	
-      case OP_RES:
-      case OP_UNIMP:
-	RaiseException(IllegalInstrException, 0);
-	return;
-	
-      default:
-	ASSERT(FALSE);
-    }
+    // Execute the instruction
+    if (!(*instr->handler)(instr, &state))
+	return;			// exception occurred
     
     // Now we have successfully executed the instruction.
     
-    // Do any delayed load operation
-    DelayedLoad(nextLoadReg, nextLoadValue);
+    // Do any delayed load operation.  LoadReg is 0 unless the previous
+    // instruction was a load, so only a load or the instruction after
+    // one has anything to do; the rest just keep R0 zero.
+    if ((registers[LoadReg] | state.loadReg) != 0)
+	DelayedLoad(state.loadReg, state.loadValue);
+    else
+	registers[0] = 0;
     
     // Advance program counters.
     registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
-    registers[NextPCReg] = pcAfter;
+    registers[NextPCReg] = state.pcAfter;
 }
 
 //----------------------------------------------------------------------
@@ -570,17 +970,55 @@ Machine::OneInstruction(Instruction *instr)
 //
 // 	NOTE -- RaiseException/CheckInterrupts must also call DelayedLoad,
 //	since any delayed load must get applied before we trap to the kernel.
+//
+//	A load into R0 is the same as no load at all (nextReg == 0), so
+//	no load is pending whenever registers[LoadReg] is 0, and then 
+//	there is nothing to do but keep R0 zero.
 //----------------------------------------------------------------------
 
 void
 Machine::DelayedLoad(int nextReg, int nextValue)
 {
+    if ((registers[LoadReg] | nextReg) == 0) {
+	registers[0] = 0;
+	return;
+    }
     registers[registers[LoadReg]] = registers[LoadValueReg];
     registers[LoadReg] = nextReg;
     registers[LoadValueReg] = nextValue;
     registers[0] = 0; 	// and always make sure R0 stays zero.
 }
 
+//----------------------------------------------------------------------
+// CostClassOf
+// 	The class of an opCode, for Machine::ReadCosts: every load and 
+//	store, multiplication, division, branch and jump has a class of 
+//	its own; the rest are ALU operations.
+//----------------------------------------------------------------------
+
+static CostClass
+CostClassOf(int opCode)
+{
+    switch (opCode) {
+      case OP_MULT: case OP_MULTU:
+	return CostMult;
+      case OP_DIV: case OP_DIVU:
+	return CostDiv;
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+      case OP_LWL: case OP_LWR: case OP_LL:
+	return CostLoad;
+      case OP_SB: case OP_SH: case OP_SW: case OP_SWL: case OP_SWR:
+      case OP_SC:
+	return CostStore;
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ: case OP_BLEZ:
+      case OP_BLTZ: case OP_BLTZAL: case OP_BNE: case OP_J: case OP_JAL:
+      case OP_JALR: case OP_JR:
+	return CostBranch;
+      default:
+	return CostALU;
+    }
+}
+
 //----------------------------------------------------------------------
 // Instruction::Decode
 // 	Decode a MIPS instruction 
@@ -623,6 +1061,8 @@ Instruction::Decode()
     	    opCode = OP_UNIMP;
 	}
     }
+    handler = opHandlers[opCode];
+    costClass = CostClassOf(opCode);
 }
 
 //----------------------------------------------------------------------
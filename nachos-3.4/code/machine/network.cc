@@ -19,13 +19,18 @@ static void NetworkReadPoll(int arg)
 { Network *net = (Network *)arg; net->CheckPktAvail(); }
 static void NetworkSendDone(int arg)
 { Network *net = (Network *)arg; net->SendDone(); }
+static void NetworkDeliverDelayed(int arg)
+{ Network *net = (Network *)arg; net->DeliverDelayed(); }
 
 // Initialize the network emulation
 //   addr is used to generate the socket name
 //   reliability says whether we drop packets to emulate unreliable links
 //   readAvail, writeDone, callArg -- analogous to console
+//   fabricFile, if not NULL, describes each link's reliability and 
+//	latency (cf. network.h)
 Network::Network(NetworkAddress addr, double reliability,
-	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg)
+	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg,
+	char *fabricFile)
 {
     ident = addr;
     if (reliability < 0) chanceToWork = 0;
@@ -37,7 +42,14 @@ Network::Network(NetworkAddress addr, double reliability,
     readHandler = readAvail;
     handlerArg = callArg;
     sendBusy = FALSE;
-    inHdr.length = 0;
+    inHead = inCount = unsignalled = 0;
+    firstUnsignalled = 0;
+    numLinks = 0;
+    for (int i = 0; i < MaxDelayed; i++)
+	delayed[i].inUse = FALSE;
+    delayedSeq = 0;
+    if (fabricFile != NULL)
+	ReadFabric(fabricFile);
     
     sock = OpenSocket();
     sprintf(sockName, "SOCKET_%d", (int)addr);
@@ -54,36 +66,63 @@ Network::~Network()
     DeAssignNameToSocket(sockName);
 }
 
-// if a packet is already buffered, we simply delay reading 
-// the incoming packet.  In real life, the incoming 
+// if the buffer is full (one packet, unless coalescing), we simply 
+// delay reading the incoming packets.  In real life, the incoming 
 // packet might be dropped if we can't read it in time.
 void
 Network::CheckPktAvail()
 {
+    int room = (coalesceEvents > 1 || coalesceTicks > 0) ? NetRingSize : 1;
+
     // schedule the next time to poll for a packet
     interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
 
-    if (inHdr.length != 0) 	// do nothing if packet is already buffered
-	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
+    while (inCount < room && Arrived())
+	if (unsignalled++ == 0)
+	    firstUnsignalled = stats->totalTicks;
+    if (unsignalled == 0 || (unsignalled < coalesceEvents && inCount < room
+		&& stats->totalTicks - firstUnsignalled < coalesceTicks))
 	return;
 
-    // otherwise, read packet in
-    char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
+    // tell post office that the packets have arrived
+    unsignalled = 0;
+    stats->numNetInterrupts++;
+    (*readHandler)(handlerArg);	
+}
+
+// read a packet in from the socket (or the replay log), if there is one,
+// onto the end of the ring
+bool
+Network::Arrived()
+{
+    char buffer[MaxWireSize];
+    int size, slot = (inHead + inCount) % NetRingSize;
+
+    if (inputLog != NULL && inputLog->Replaying()) {
+	size = inputLog->Replay(InputPacket, buffer, MaxWireSize);
+	if (size < 0)		// (the socket is never polled in replay)
+	    return FALSE;
+    } else {
+	if (!PollSocket(sock)) 	// do nothing if no packet to be read
+	    return FALSE;
+
+	// otherwise, read packet in
+	size = ReadFromSocket(sock, buffer, MaxWireSize);
+	if (inputLog != NULL)
+	    inputLog->Record(InputPacket, buffer, size);
+    }
 
     // divide packet into header and data
-    inHdr = *(PacketHeader *)buffer;
-    ASSERT((inHdr.to == ident) && (inHdr.length <= MaxPacketSize));
-    bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
-    delete []buffer ;
+    inHdr[slot] = *(PacketHeader *)buffer;
+    ASSERT((inHdr[slot].to == ident) && (inHdr[slot].length <= MaxPacketSize)
+		&& (size == (int) (sizeof(PacketHeader) + inHdr[slot].length)));
+    bcopy(buffer + sizeof(PacketHeader), inbox[slot], inHdr[slot].length);
+    inCount++;
 
     DEBUG('n', "Network received packet from %d, length %d...\n",
-	  				(int) inHdr.from, inHdr.length);
+	  			(int) inHdr[slot].from, inHdr[slot].length);
     stats->numPacketsRecvd++;
-
-    // tell post office that the packet has arrived
-    (*readHandler)(handlerArg);	
+    return TRUE;
 }
 
 // notify user that another packet can be sent
@@ -98,42 +137,135 @@ Network::SendDone()
 // send a packet by concatenating hdr and data, and schedule
 // an interrupt to tell the user when the next packet can be sent 
 //
-// Note we always pad out a packet to MaxWireSize before putting it into
-// the socket, because it's simpler at the receive end.
+// Only the header and hdr.length bytes of data go into the socket; the
+// receive end reads up to MaxWireSize, and gets however much was sent.
 void
 Network::Send(PacketHeader hdr, char* data)
 {
-    char toName[32];
-
-    sprintf(toName, "SOCKET_%d", (int)hdr.to);
-    
     ASSERT((sendBusy == FALSE) && (hdr.length > 0) 
 		&& (hdr.length <= MaxPacketSize) && (hdr.from == ident));
     DEBUG('n', "Sending to addr %d, %d bytes... ", hdr.to, hdr.length);
 
     interrupt->Schedule(NetworkSendDone, (int)this, NetworkTime, NetworkSendInt);
 
-    if (Random() % 100 >= chanceToWork * 100) { // emulate a lost packet
+    NetworkLink *link = FindLink(hdr.to);
+    double chance = (link != NULL) ? link->chanceToWork : chanceToWork;
+
+    if (Random() % 100 >= chance * 100) { // emulate a lost packet
 	DEBUG('n', "oops, lost it!\n");
 	return;
     }
 
     // concatenate hdr and data into a single buffer, and send it out
-    char *buffer = new char[MaxWireSize];
+    char buffer[MaxWireSize];
+    int size = sizeof(PacketHeader) + hdr.length;
+
     *(PacketHeader *)buffer = hdr;
     bcopy(data, buffer + sizeof(PacketHeader), hdr.length);
-    SendToSocket(sock, buffer, MaxWireSize, toName);
-    delete []buffer;
+    if (link == NULL || link->latency == 0) {
+	Transmit(hdr.to, buffer, size);
+	return;
+    }
+
+    // or keep it until it has been on the wire long enough
+    for (int i = 0; i < MaxDelayed; i++)
+	if (!delayed[i].inUse) {
+	    delayed[i].inUse = TRUE;
+	    delayed[i].when = stats->totalTicks + link->latency;
+	    delayed[i].seq = delayedSeq++;
+	    delayed[i].to = hdr.to;
+	    delayed[i].size = size;
+	    bcopy(buffer, delayed[i].buffer, size);
+	    interrupt->Schedule(NetworkDeliverDelayed, (int)this, 
+				link->latency, NetworkSendInt);
+	    return;
+	}
+    DEBUG('n', "too many packets on the wire, latency ignored\n");
+    Transmit(hdr.to, buffer, size);
 }
 
-// read a packet, if one is buffered
+// a delayed packet has been on the wire long enough; put every packet
+// that is due into its socket, oldest first
+void
+Network::DeliverDelayed()
+{
+    for (;;) {
+	DelayedPacket *next = NULL;
+
+	for (int i = 0; i < MaxDelayed; i++)
+	    if (delayed[i].inUse && delayed[i].when <= stats->totalTicks &&
+		    (next == NULL || delayed[i].when < next->when ||
+		     (delayed[i].when == next->when && delayed[i].seq < next->seq)))
+		next = &delayed[i];
+	if (next == NULL)
+	    return;
+	Transmit(next->to, next->buffer, next->size);
+	next->inUse = FALSE;
+    }
+}
+
+// put a packet into the socket of machine "to"; if that Nachos isn't
+// running, the packet is lost
+void
+Network::Transmit(NetworkAddress to, char *buffer, int size)
+{
+    char toName[32];
+
+    sprintf(toName, "SOCKET_%d", (int)to);
+    if (!SendToSocket(sock, buffer, size, toName))
+	DEBUG('n', "machine %d isn't there, packet lost\n", to);
+}
+
+// the first link out of this machine that goes to "to", or NULL if the
+// fabric file doesn't describe one
+NetworkLink *
+Network::FindLink(NetworkAddress to)
+{
+    for (int i = 0; i < numLinks; i++)
+	if (links[i].to == to || links[i].to == -1)
+	    return &links[i];
+    return NULL;
+}
+
+// read the lines of the fabric file that describe links out of this
+// machine; those into it are the other machines' business
+void
+Network::ReadFabric(char *fabricFile)
+{
+    FILE *fp = fopen(fabricFile, "r");
+    NetworkLink link;
+
+    if (fp == NULL) {
+	printf("Can't open fabric file %s\n", fabricFile);
+	ASSERT(FALSE);
+    }
+    while (fscanf(fp, "%d %d %lf %d", &link.from, &link.to, 
+			&link.chanceToWork, &link.latency) == 4) {
+	if (link.from != ident && link.from != -1)
+	    continue;
+	ASSERT(numLinks < MaxLinks && link.latency >= 0);
+	if (link.chanceToWork < 0) link.chanceToWork = 0;
+	else if (link.chanceToWork > 1) link.chanceToWork = 1;
+	links[numLinks++] = link;
+    }
+    fclose(fp);
+    DEBUG('n', "Fabric file %s: %d links out of machine %d\n", fabricFile,
+		numLinks, (int)ident);
+}
+
+// read the oldest packet, if one is buffered
 PacketHeader
 Network::Receive(char* data)
 {
-    PacketHeader hdr = inHdr;
+    PacketHeader hdr;
 
-    inHdr.length = 0;
-    if (hdr.length != 0)
-    	bcopy(inbox, data, hdr.length);
+    if (inCount == 0) {
+	hdr.length = 0;
+	return hdr;
+    }
+    hdr = inHdr[inHead];
+    bcopy(inbox[inHead], data, hdr.length);
+    inHead = (inHead + 1) % NetRingSize;
+    inCount--;
     return hdr;
 }
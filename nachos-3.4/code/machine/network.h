@@ -41,6 +41,43 @@ class PacketHeader {
 #define MaxPacketSize 	(MaxWireSize - sizeof(struct PacketHeader))	
 				// data "payload" of the largest packet
 
+#define MaxLinks	64	// links a fabric file may describe
+#define MaxDelayed	32	// packets that may be held up by link 
+				// latency at once
+#define NetRingSize	16	// arrived packets the device can hold,
+				// when coalescing interrupts
+
+// A fabric file describes the links out of each machine, one per line:
+//
+//	from to reliability latency
+//
+// "from" and "to" are machine ID's, or -1 for any machine; "reliability"
+// replaces the one given to the constructor for packets on this link,
+// and "latency" is how many ticks a packet spends on the wire before
+// the other machine can see it.  The first line that matches is used.
+// Links that no line matches get the constructor's reliability, and
+// no latency.
+
+class NetworkLink {
+  public:
+    NetworkAddress from, to;
+    double chanceToWork;
+    int latency;
+};
+
+// A packet sent on a link with latency, not yet put into the socket.
+
+class DelayedPacket {
+  public:
+    bool inUse;
+    long long when;		// tick at which it arrives
+    int seq;			// order it was sent in, among those due
+				// at the same tick
+    NetworkAddress to;
+    int size;
+    char buffer[MaxWireSize];
+};
+
 
 // The following class defines a physical network device.  The network
 // is capable of delivering fixed sized packets, in order but unreliably, 
@@ -51,12 +88,22 @@ class PacketHeader {
 // a packet.  Note that you can change the seed for the random number 
 // generator, by changing the arguments to RandomInit() in Initialize().
 // The random number generator is used to choose which packets to drop.
+//
+// With interrupt coalescing (-irq), the device takes in every packet
+// waiting, up to NetRingSize, and only interrupts once coalesceEvents
+// have arrived since the last interrupt, or the first of them has 
+// waited coalesceTicks; the handler should Receive until there are no
+// more.  Otherwise it holds one packet at a time, and interrupts for 
+// each.
 
 class Network {
   public:
     Network(NetworkAddress addr, double reliability,
-  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg);
-				// Allocate and initialize network driver
+  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg,
+	  char *fabricFile = NULL);
+				// Allocate and initialize network driver;
+				// read the links' reliability and latency
+				// from "fabricFile", if there is one
     ~Network();			// De-allocate the network driver data
     
     void Send(PacketHeader hdr, char* data);
@@ -72,15 +119,23 @@ class Network {
     PacketHeader Receive(char* data);
     				// Poll the network for incoming messages.  
 				// If there is a packet waiting, copy the 
-				// packet into "data" and return the header.
+				// oldest into "data" and return the header.
 				// If no packet is waiting, return a header 
 				// with length 0.
 
     void SendDone();		// Interrupt handler, called when message is 
 				// sent
     void CheckPktAvail();	// Check if there is an incoming packet
+    void DeliverDelayed();	// Interrupt handler, called when a delayed
+				// packet is due to arrive
 
   private:
+    void ReadFabric(char *fabricFile);	// Load the links out of here
+    NetworkLink *FindLink(NetworkAddress to);	// The one "to" goes over
+    void Transmit(NetworkAddress to, char *buffer, int size);
+				// Put a packet into "to"'s socket
+    bool Arrived();		// Take a packet in, if one is there
+
     NetworkAddress ident;	// This machine's network address
     double chanceToWork;	// Likelihood packet will be dropped
     int sock;			// UNIX socket number for incoming packets
@@ -92,10 +147,16 @@ class Network {
     int handlerArg;		// Argument to be passed to interrupt handler
 				//   (pointer to post office)
     bool sendBusy;		// Packet is being sent.
-    bool packetAvail;		// Packet has arrived, can be pulled off of
-				//   network
-    PacketHeader inHdr;		// Information about arrived packet
-    char inbox[MaxPacketSize];  // Data for arrived packet
+    PacketHeader inHdr[NetRingSize];	// Information about arrived 
+    char inbox[NetRingSize][MaxPacketSize];  // packets, and their data:
+    int inHead, inCount;	// a ring, oldest first
+    int unsignalled;		// ... how many came since the last interrupt
+    long long firstUnsignalled;	// ... and when the first of them did
+
+    NetworkLink links[MaxLinks];	// From the fabric file
+    int numLinks;
+    DelayedPacket delayed[MaxDelayed];	// Packets still on the wire
+    int delayedSeq;		// Sequence number for the next one
 };
 
 #endif // NETWORK_H
@@ -0,0 +1,101 @@
+// replay.cc 
+//	Routines to record the input a simulation gets from outside, and
+//	play it back.  See replay.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "replay.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// InputLog::InputLog
+// 	Create the log file, to record into; or open it, to play back.
+//
+//	"fileName" -- the host file holding the log
+//	"playBack" -- play it back, rather than record?
+//----------------------------------------------------------------------
+
+InputLog::InputLog(char *fileName, bool playBack)
+{
+    replaying = playBack;
+    haveNext = FALSE;
+    if (replaying) {
+	fd = OpenForReadWrite(fileName, TRUE);
+	ReadNext();
+    } else
+	fd = OpenForWrite(fileName);
+}
+
+InputLog::~InputLog()
+{
+    if (replaying && haveNext)
+	printf("Replay: input left over, from tick %lld on\n", next.tick);
+    Close(fd);
+}
+
+//----------------------------------------------------------------------
+// InputLog::Record
+// 	Log an input that a device has just taken in from the host.
+//
+//	"kind" -- InputConsole or InputPacket
+//	"data", "length" -- the character, or the packet
+//----------------------------------------------------------------------
+
+void
+InputLog::Record(int kind, char *data, int length)
+{
+    InputRecord r;
+
+    ASSERT(!replaying);
+    r.tick = stats->totalTicks;
+    r.kind = kind;
+    r.length = length;
+    WriteFile(fd, (char *) &r, sizeof(InputRecord));
+    WriteFile(fd, data, length);
+}
+
+//----------------------------------------------------------------------
+// InputLog::Replay
+// 	Called by a device when it would poll the host for input.  Give 
+//	it the next logged input, if that is of its kind and was taken in
+//	at this very tick.  Devices poll at the same ticks in the same 
+//	order as in the recorded run, so the inputs come back in order;
+//	an input logged for an earlier tick means the run has diverged.
+//
+//	"kind" -- the device's kind of input
+//	"into", "size" -- where to put it, and the most it can take
+//
+// Returns:
+//	the input's length, or -1 if there is none for now
+//----------------------------------------------------------------------
+
+int
+InputLog::Replay(int kind, char *into, int size)
+{
+    int length;
+
+    ASSERT(replaying);
+    ASSERT(!haveNext || next.tick >= stats->totalTicks);	// diverged?
+    if (!haveNext || next.tick != stats->totalTicks || next.kind != kind)
+	return -1;
+    length = next.length;
+    ASSERT(length <= size);
+    Read(fd, into, length);
+    ReadNext();
+    return length;
+}
+
+//----------------------------------------------------------------------
+// InputLog::ReadNext
+// 	Read the header of the next logged input, if there is one.
+//----------------------------------------------------------------------
+
+void
+InputLog::ReadNext()
+{
+    haveNext = (ReadPartial(fd, (char *) &next, sizeof(InputRecord))
+			== sizeof(InputRecord));
+}
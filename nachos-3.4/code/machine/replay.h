@@ -0,0 +1,62 @@
+// replay.h 
+//	Data structures for recording the input a simulation gets from
+//	outside -- console characters and network packets -- and feeding
+//	it back, so that a run can be reproduced exactly.
+//
+//	Everything else in Nachos is already deterministic: simulated
+//	time only depends on what the simulation does, and Random() is a
+//	pseudo-random sequence that depends only on its seed (-rs).  What
+//	isn't is when a character or packet shows up from the host, since
+//	the devices simply poll for them.  So in record mode (-rec file),
+//	each input the console or the network takes in is logged, with
+//	the tick at which it was polled; in replay mode (-rep file), the 
+//	devices don't poll the host at all, and get the logged inputs at
+//	the same ticks instead.  Replay must start from the same disk, 
+//	with the same flags (cf. -ds and -dw).
+//
+//	The log is a sequence of InputRecords, each followed by its
+//	"length" bytes of data.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "copyright.h"
+
+#define InputConsole	0		// kinds of input
+#define InputPacket	1
+
+class InputRecord {
+  public:
+    long long tick;			// when the device took it in
+    short kind;				// InputConsole or InputPacket
+    short length;			// bytes of data that follow
+};
+
+class InputLog {
+  public:
+    InputLog(char *fileName, bool playBack);
+					// Start recording into, or playing
+					// back from, "fileName"
+    ~InputLog();
+
+    bool Replaying() { return replaying; }
+    void Record(int kind, char *data, int length);
+					// Log an input taken in now
+    int Replay(int kind, char *into, int size);
+					// The input of this kind logged for
+					// now, if any: its length, or -1
+
+  private:
+    void ReadNext();			// Read the next record's header
+
+    bool replaying;
+    int fd;				// the log file
+    InputRecord next;			// replay: the next record's header
+    bool haveNext;			// FALSE once the log is used up
+};
+
+#endif // REPLAY_H
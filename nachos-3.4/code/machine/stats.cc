@@ -21,7 +21,89 @@ Statistics::Statistics()
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
+    numConsoleInterrupts = numNetInterrupts = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numRetransmits = numMailsCoalesced = 0;
+    numTLBHits = numTLBMisses = 0;
+    numSuperpageLoads = numPromotions = numPromotionFailures = 0;
+    numMapReads = numMapWrites = 0;
+    numICacheHits = numICacheMisses = 0;
+    numDCacheHits = numDCacheMisses = numDCacheWritebacks = 0;
+    numCacheHits = numCacheMisses = 0;
+    numLogCommits = numLogSectors = 0;
+    processes = NULL;
+    numProcesses = maxProcesses = 0;
+
+    numCounters = numHistograms = 0;
+    Register("ticks.total", &totalTicks);
+    Register("ticks.idle", &idleTicks);
+    Register("ticks.system", &systemTicks);
+    Register("ticks.user", &userTicks);
+    Register("disk.reads", &numDiskReads);
+    Register("disk.writes", &numDiskWrites);
+    Register("cache.hits", &numCacheHits);
+    Register("cache.misses", &numCacheMisses);
+    Register("journal.commits", &numLogCommits);
+    Register("journal.sectors", &numLogSectors);
+    Register("console.reads", &numConsoleCharsRead);
+    Register("console.writes", &numConsoleCharsWritten);
+    Register("console.interrupts", &numConsoleInterrupts);
+    Register("vm.faults", &numPageFaults);
+    Register("vm.evictions", &paging.evictions);
+    Register("vm.cleanEvictions", &paging.cleanEvictions);
+    Register("vm.swapWrites", &paging.dirtyWrites);
+    Register("vm.swapWriteTicks", &paging.swapWriteTicks);
+    Register("vm.swapReads", &paging.swapReads);
+    Register("vm.swapReadTicks", &paging.swapReadTicks);
+    RegisterHistogram("vm.faultLatency", paging.latency, LatencyBuckets);
+    Register("tlb.hits", &numTLBHits);
+    Register("tlb.misses", &numTLBMisses);
+    Register("tlb.superpageLoads", &numSuperpageLoads);
+    Register("vm.promotions", &numPromotions);
+    Register("vm.promotionFailures", &numPromotionFailures);
+    Register("vm.mapReads", &numMapReads);
+    Register("vm.mapWrites", &numMapWrites);
+    Register("l1i.hits", &numICacheHits);
+    Register("l1i.misses", &numICacheMisses);
+    Register("l1d.hits", &numDCacheHits);
+    Register("l1d.misses", &numDCacheMisses);
+    Register("l1d.writebacks", &numDCacheWritebacks);
+    Register("net.packetsSent", &numPacketsSent);
+    Register("net.packetsReceived", &numPacketsRecvd);
+    Register("net.interrupts", &numNetInterrupts);
+    Register("net.retransmits", &numRetransmits);
+    Register("net.mailsCoalesced", &numMailsCoalesced);
+}
+
+Statistics::~Statistics()
+{
+    delete [] processes;
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordProcess
+// 	Remember how much CPU time a process used, to print at shutdown.
+//
+//	"id" -- the process
+//	"user", "system" -- the ticks it spent in user code and the kernel
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordProcess(int id, int user, int system)
+{
+    if (numProcesses == maxProcesses) {		// full: double the array
+	ProcessTimes *old = processes;
+
+	maxProcesses = (maxProcesses == 0) ? 16 : maxProcesses * 2;
+	processes = new ProcessTimes[maxProcesses];
+	for (int i = 0; i < numProcesses; i++)
+	    processes[i] = old[i];
+	delete [] old;
+    }
+    processes[numProcesses].id = id;
+    processes[numProcesses].userTicks = user;
+    processes[numProcesses].systemTicks = system;
+    numProcesses++;
 }
 
 //----------------------------------------------------------------------
@@ -33,12 +115,170 @@ Statistics::Statistics()
 void
 Statistics::Print()
 {
-    printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
-	idleTicks, systemTicks, userTicks);
-    printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
-    printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
+    printf("Ticks: total %lld, idle %lld, system %lld, user %lld\n", 
+	totalTicks, idleTicks, systemTicks, userTicks);
+    for (int i = 0; i < numProcesses; i++)
+	printf("Process %d: system %d, user %d\n", processes[i].id,
+	    processes[i].systemTicks, processes[i].userTicks);
+    printf("Disk I/O: reads %lld, writes %lld\n", numDiskReads, 
+	numDiskWrites);
+    if (numCacheHits + numCacheMisses > 0)
+	printf("Buffer cache: hits %lld, misses %lld (%d%% hits)\n", 
+	    numCacheHits, numCacheMisses, 
+	    (int) (numCacheHits * 100 / (numCacheHits + numCacheMisses)));
+    if (numLogCommits > 0)
+	printf("Journal: commits %lld, sectors logged %lld\n", numLogCommits,
+	    numLogSectors);
+    printf("Console I/O: reads %lld, writes %lld\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
-    printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
-	numPacketsSent);
+    printf("Paging: faults %lld\n", numPageFaults);
+    if (numPageFaults > 0)
+	paging.Print();
+    if (numTLBHits + numTLBMisses > 0)
+	printf("TLB: hits %lld, misses %lld\n", numTLBHits, numTLBMisses);
+    if (numSuperpageLoads + numPromotions + numPromotionFailures > 0)
+	printf("Superpages: TLB loads %lld, promotions %lld (%lld failed)\n",
+	    numSuperpageLoads, numPromotions, numPromotionFailures);
+    if (numMapReads + numMapWrites > 0)
+	printf("Mapped files: pages read %lld, written back %lld\n",
+	    numMapReads, numMapWrites);
+    if (numICacheHits + numICacheMisses > 0)
+	printf("L1 instruction cache: hits %lld, misses %lld\n", 
+	    numICacheHits, numICacheMisses);
+    if (numDCacheHits + numDCacheMisses > 0)
+	printf("L1 data cache: hits %lld, misses %lld, writebacks %lld\n",
+	    numDCacheHits, numDCacheMisses, numDCacheWritebacks);
+    printf("Network I/O: packets received %lld, sent %lld\n", 
+	numPacketsRecvd, numPacketsSent);
+    if (numRetransmits > 0)
+	printf("Network retransmissions: %lld\n", numRetransmits);
+    if (numMailsCoalesced > 0)
+	printf("Network coalescing: %lld messages packed into other "
+		"packets\n", numMailsCoalesced);
+}
+
+//----------------------------------------------------------------------
+// Statistics::Register, Statistics::RegisterHistogram
+// 	Add a counter, or a histogram, to those exported.  Each part of
+//	Nachos registers its own when it starts up, and must not go away
+//	before Nachos exits.
+//
+//	"name" -- what to export it as: "subsystem.what"
+//	"value" -- the counter
+//	"buckets", "numBuckets" -- the histogram (see NamedHistogram)
+//----------------------------------------------------------------------
+
+void
+Statistics::Register(char *name, long long *value)
+{
+    ASSERT(numCounters < MaxCounters);
+    counters[numCounters].name = name;
+    counters[numCounters].value = value;
+    numCounters++;
+}
+
+void
+Statistics::RegisterHistogram(char *name, long long *buckets, int numBuckets)
+{
+    ASSERT(numHistograms < MaxHistograms);
+    histograms[numHistograms].name = name;
+    histograms[numHistograms].buckets = buckets;
+    histograms[numHistograms].numBuckets = numBuckets;
+    numHistograms++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::Export
+// 	Write the current value of every registered counter and histogram
+//	to a file, as one JSON object:
+//
+//	    {"counters": {"ticks.total": 1234, ...},
+//	     "histograms": {"vm.faultLatency": [0, 3, ...], ...}}
+//
+//	The file is written whole each time, so a later export (at exit,
+//	after one on a signal) replaces an earlier one.
+//----------------------------------------------------------------------
+
+void
+Statistics::Export(char *fileName)
+{
+    FILE *fp = fopen(fileName, "w");
+    int i, j;
+
+    if (fp == NULL) {
+	printf("Can't write statistics to %s\n", fileName);
+	return;
+    }
+    fprintf(fp, "{\"counters\": {");
+    for (i = 0; i < numCounters; i++)
+	fprintf(fp, "%s\n  \"%s\": %lld", (i > 0) ? "," : "", 
+		counters[i].name, *counters[i].value);
+    fprintf(fp, "},\n \"histograms\": {");
+    for (i = 0; i < numHistograms; i++) {
+	fprintf(fp, "%s\n  \"%s\": [", (i > 0) ? "," : "", 
+		histograms[i].name);
+	for (j = 0; j < histograms[i].numBuckets; j++)
+	    fprintf(fp, "%s%lld", (j > 0) ? ", " : "", 
+		histograms[i].buckets[j]);
+	fprintf(fp, "]");
+    }
+    fprintf(fp, "}}\n");
+    fclose(fp);
+}
+
+//----------------------------------------------------------------------
+// PagingStats::PagingStats
+// 	Initialize paging metrics to zero.
+//----------------------------------------------------------------------
+
+PagingStats::PagingStats()
+{
+    faults = evictions = cleanEvictions = dirtyWrites = 0;
+    swapReads = swapReadTicks = swapWriteTicks = 0;
+    for (int i = 0; i < LatencyBuckets; i++)
+	latency[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// PagingStats::RecordFault
+// 	Count a page fault, in the latency bucket for the time it took.
+//
+//	"ticks" -- simulated time from the fault to the page being mapped
+//----------------------------------------------------------------------
+
+void
+PagingStats::RecordFault(int ticks)
+{
+    int bucket = 0;
+
+    while (bucket < LatencyBuckets - 1 && ticks >= (1 << bucket))
+	bucket++;
+    faults++;
+    latency[bucket]++;
+}
+
+//----------------------------------------------------------------------
+// PagingStats::Print
+// 	Print paging metrics, and the non-empty part of the latency 
+//	histogram.
+//----------------------------------------------------------------------
+
+void
+PagingStats::Print()
+{
+    int i, first, last;
+
+    printf("  evictions %lld (clean %lld), swap writes %lld in %lld ticks, "
+	"swap reads %lld in %lld ticks\n", evictions, cleanEvictions, 
+	dirtyWrites, swapWriteTicks, swapReads, swapReadTicks);
+    for (first = 0; first < LatencyBuckets && latency[first] == 0; first++)
+	;
+    for (last = LatencyBuckets - 1; last > first && latency[last] == 0; last--)
+	;
+    for (i = first; i <= last; i++)
+	if (i == LatencyBuckets - 1)
+	    printf("  fault latency >= %d ticks: %lld\n", 1 << (i - 1), 
+		latency[i]);
+	else
+	    printf("  fault latency < %d ticks: %lld\n", 1 << i, latency[i]);
 }
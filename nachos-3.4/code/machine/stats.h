@@ -13,32 +13,145 @@
 
 #include "copyright.h"
 
+// Paging activity, kept for the whole system (in Statistics) and for
+// each address space.  A page eviction is "clean" if the page could
+// just be dropped, and "dirty" if it had to be written to swap first.
+
+#define LatencyBuckets	16	// fault latency histogram: bucket i counts
+				// faults that took under 2^i ticks
+
+class PagingStats {
+  public:
+    long long faults;		// page faults serviced
+    long long evictions;	// pages taken out of memory
+    long long cleanEvictions;	// ... without having to write them
+    long long dirtyWrites;	// pages written to swap
+    long long swapReads;	// pages read back from swap
+    long long swapReadTicks;	// time spent reading swap
+    long long swapWriteTicks;	// time spent writing swap
+    long long latency[LatencyBuckets];  // faults, by time to service them
+
+    PagingStats();		// initialize everything to zero
+
+    void RecordFault(int ticks);  // count a fault that took "ticks"
+    void Print();		// print collected statistics
+};
+
+// CPU time used by one process, kept for Statistics::Print once the
+// process is gone.
+
+class ProcessTimes {
+  public:
+    int id;			// the process
+    int userTicks;		// time spent running its user code
+    int systemTicks;		// time spent in the kernel on its behalf
+};
+
+// A counter or histogram kept by some part of Nachos, registered
+// under a name ("subsystem.what") so that it is exported with the rest
+// (cf. Statistics::Register).  The registry only points at the 
+// variables; whoever owns them keeps updating them as usual.
+
+#define MaxCounters	128	// named counters that can be registered
+#define MaxHistograms	8	// and histograms
+
+class NamedCounter {
+  public:
+    char *name;
+    long long *value;
+};
+
+class NamedHistogram {
+  public:
+    char *name;
+    long long *buckets;		// bucket i counts values under 2^i,
+    int numBuckets;		// and the last one all the rest
+};
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
 //
 // The fields in this class are public to make it easier to update.
+// They are all 64 bits, so long runs don't overflow them; that 
+// includes the clock, so everything that remembers a time holds it
+// in a "long long" too (differences between two times still fit an
+// int).
+//
+// Besides printing them at Halt, Nachos can export every registered 
+// counter and histogram -- these ones, and those of the subsystems 
+// that register their own -- as JSON, at exit or on a signal (-js).
 
 class Statistics {
   public:
-    int totalTicks;      	// Total time running Nachos
-    int idleTicks;       	// Time spent idle (no threads to run)
-    int systemTicks;	 	// Time spent executing system code
-    int userTicks;       	// Time spent executing user code
+    long long totalTicks;      	// Total time running Nachos
+    long long idleTicks;       	// Time spent idle (no threads to run)
+    long long systemTicks;	// Time spent executing system code
+    long long userTicks;       	// Time spent executing user code
 				// (this is also equal to # of
 				// user instructions executed)
 
-    int numDiskReads;		// number of disk read requests
-    int numDiskWrites;		// number of disk write requests
-    int numConsoleCharsRead;	// number of characters read from the keyboard
-    int numConsoleCharsWritten; // number of characters written to the display
-    int numPageFaults;		// number of virtual memory page faults
-    int numPacketsSent;		// number of packets sent over the network
-    int numPacketsRecvd;	// number of packets received over the network
+    long long numDiskReads;	// number of disk read requests
+    long long numDiskWrites;	// number of disk write requests
+    long long numConsoleCharsRead;	// number of characters read from 
+				// the keyboard
+    long long numConsoleCharsWritten; // number of characters written to 
+				// the display
+    long long numConsoleInterrupts;	// read interrupts for those
+				// characters (fewer, if coalesced)
+    long long numPageFaults;	// number of virtual memory page faults
+    long long numTLBHits;	// number of translations found in the TLB
+    long long numTLBMisses;	// number of TLB misses (a TLB miss is
+				// only a page fault if the page is not
+				// in memory)
+    long long numSuperpageLoads;	// TLB entries loaded for a superpage
+    long long numPromotions;	// page groups moved into aligned frames to
+    long long numPromotionFailures;	// make a superpage, and attempts
+				// that found no such frames
+    long long numMapReads;	// pages read from mapped files (Mmap),
+    long long numMapWrites;	// and dirty ones written back to them
+    long long numICacheHits;	// instruction fetches that hit in the L1
+    long long numICacheMisses;	// instruction cache, and that missed
+    long long numDCacheHits;	// loads and stores that hit in the L1
+    long long numDCacheMisses;	// data cache, and that missed
+    long long numDCacheWritebacks;	// dirty lines it wrote back
+    long long numCacheHits;	// disk sectors found in the buffer cache
+    long long numCacheMisses;	// and not found there
+    long long numLogCommits;	// groups of metadata changes logged
+    long long numLogSectors;	// sectors written to the log for them
+    long long numPacketsSent;	// number of packets sent over the network
+    long long numPacketsRecvd;	// number of packets received over the 
+				// network
+    long long numNetInterrupts;	// receive interrupts for them
+    long long numRetransmits;	// segments a connection had to send again
+    long long numMailsCoalesced;	// messages packed into a packet 
+				// already queued, instead of one of
+				// their own
+    PagingStats paging;		// page fault, eviction and swap activity
+    ProcessTimes *processes;	// CPU time of each process recorded
+    int numProcesses;		// entries used in "processes"
+    int maxProcesses;		// and allocated
 
     Statistics(); 		// initialize everything to zero
+    ~Statistics();
 
+    void RecordProcess(int id, int user, int system);
+				// a process is done, having used "user"
+				// and "system" ticks
     void Print();		// print collected statistics
+
+    void Register(char *name, long long *value);
+				// export "value" as counter "name"
+    void RegisterHistogram(char *name, long long *buckets, int numBuckets);
+				// ... or "buckets" as a histogram
+    void Export(char *fileName);	// write every registered counter
+				// and histogram to "fileName", as JSON
+
+  private:
+    NamedCounter counters[MaxCounters];
+    int numCounters;
+    NamedHistogram histograms[MaxHistograms];
+    int numHistograms;
 };
 
 // Constants used to reflect the relative time an operation would
@@ -53,7 +166,13 @@ class Statistics {
 #define SystemTick 	10 	// advance each time interrupts are enabled
 #define RotationTime 	500 	// time disk takes to rotate one sector
 #define SeekTime 	500    	// time disk takes to seek past one track
+#define FlashCommandTime 50	// time a flash disk takes to start a request
+#define FlashReadTime	100	// ... to read one sector on one channel
+#define FlashWriteTime	400	// ... and to write one
+#define FlashChannels	4	// sectors a flash disk moves at once
 #define ConsoleTime 	100	// time to read or write one character
+#define ConsoleByteTime	2	// ... and for each byte of a block written
+				// with PutBlock, on top of ConsoleTime
 #define NetworkTime 	100   	// time to send or receive one packet
 #define TimerTicks 	100    	// (average) time between timer interrupts
 
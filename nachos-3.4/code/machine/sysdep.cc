@@ -35,6 +35,8 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <poll.h>
+#include <errno.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -56,18 +58,6 @@ extern "C" {
   //int creat(const char *name, unsigned short mode);
   //int open(const char *name, int flags, ...);
 // void signal(int sig, VoidFunctionPtr func); -- this may work now!
-#ifdef HOST_i386
-int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
-             struct timeval *timeout);
-#else
-#ifdef HOST_SPARC
-int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
-             struct timeval *timeout);
-#else
-int select(int numBits, void *readFds, void *writeFds, void *exceptFds, 
-	struct timeval *timeout);
-#endif
-#endif
 #endif
 
   //int unlink(char *name);
@@ -103,44 +93,54 @@ void exit(int);
 //----------------------------------------------------------------------
 // PollFile
 // 	Check open file or open socket to see if there are any 
-//	characters that can be read immediately.  If so, read them
-//	in, and return TRUE.
+//	characters that can be read immediately.  If so, return TRUE.
+//
+//	Every file or socket ever polled is remembered, and they are
+//	all checked at once, by a single poll(), at most once per tick
+//	of simulated time.  The console and the network both poll on
+//	the same ticks, so the later one just looks at the answer.
 //
-//	In the network case, if there are no threads for us to run,
-//	and no characters to be read,
-//	we need to give the other side a chance to get our host's CPU
-//	(otherwise, we'll go really slowly, since UNIX time-slices
-//	infrequently, and this would be like busy-waiting).  So we
-//	delay for a short fixed time, before allowing ourselves to be
-//	re-scheduled (sort of like a Yield, but cast in terms of UNIX).
+//	If there are no threads for us to run, and no characters to be
+//	read, we need to give the other side a chance to get our host's
+//	CPU (otherwise, we'll go really slowly, since UNIX time-slices
+//	infrequently, and this would be like busy-waiting).  So we wait
+//	for a short time -- but only until one of the files has
+//	something for us, not for a fixed delay per device.
 //
 //	"fd" -- the file descriptor of the file to be polled
 //----------------------------------------------------------------------
 
+#define MaxWatched	8		// files and sockets we poll
+
+static struct pollfd watched[MaxWatched];
+static int numWatched = 0;
+static long long polledAt = -1;		// tick of the last poll()
+
 bool
 PollFile(int fd)
 {
-    int rfd = (1 << fd), wfd = 0, xfd = 0, retVal;
-    struct timeval pollTime;
-
-// decide how long to wait if there are no characters on the file
-    pollTime.tv_sec = 0;
-    if (interrupt->getStatus() == IdleMode)
-        pollTime.tv_usec = 20000;              	// delay to let other nachos run
-    else
-        pollTime.tv_usec = 0;                 	// no delay
-
-// poll file or socket
-#if (defined(HOST_i386) || defined(HOST_SPARC)) 
-    retVal = select(32, (fd_set*)&rfd, (fd_set*)&wfd, (fd_set*)&xfd, &pollTime);
-#else
-    retVal = select(32, &rfd, &wfd, &xfd, &pollTime);
-#endif
+    int i, retVal;
+
+    for (i = 0; i < numWatched; i++)
+	if (watched[i].fd == fd)
+	    break;
+    if (i == numWatched) {		// first time: watch it from now on
+	ASSERT(numWatched < MaxWatched);
+	watched[numWatched].fd = fd;
+	watched[numWatched].events = POLLIN;
+	numWatched++;
+	polledAt = -1;
+    }
 
-    ASSERT((retVal == 0) || (retVal == 1));
-    if (retVal == 0)
-	return FALSE;                 		// no char waiting to be read
-    return TRUE;
+    if (polledAt != stats->totalTicks) {
+	do {				// if idle, delay to let other nachos run
+	    retVal = poll(watched, numWatched,
+			(interrupt->getStatus() == IdleMode) ? 20 : 0);
+	} while (retVal < 0 && errno == EINTR);
+	ASSERT(retVal >= 0);
+	polledAt = stats->totalTicks;
+    }
+    return (watched[i].revents & (POLLIN | POLLHUP)) != 0;
 }
 
 //----------------------------------------------------------------------
@@ -160,6 +160,60 @@ OpenForWrite(char *name)
     return fd;
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Create (or truncate) a file of "size" bytes, and map it into our 
+//	address space, so that stores to memory are written to the file.
+//	Return the address it is mapped at.
+//
+//	"name" -- file name
+//	"size" -- length of the file, in bytes
+//----------------------------------------------------------------------
+
+char *
+MapFile(char *name, int size)
+{
+    int fd = OpenForWrite(name);
+    char *addr;
+
+    ASSERT(ftruncate(fd, size) == 0);
+    addr = MapOpenFile(fd, size);
+    close(fd);				// the mapping stays
+    return addr;
+}
+
+//----------------------------------------------------------------------
+// MapOpenFile
+// 	Map the first "size" bytes of an open file, which must be at 
+//	least that long, into our address space.  Stores to memory are 
+//	written to the file.  Return the address it is mapped at.
+//
+//	"fd" -- the open file
+//	"size" -- how many bytes to map
+//----------------------------------------------------------------------
+
+char *
+MapOpenFile(int fd, int size)
+{
+    char *addr = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE, 
+				MAP_SHARED, fd, 0);
+
+    ASSERT(addr != (char *) MAP_FAILED);
+    return addr;
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Write back and unmap a file mapped by MapFile or MapOpenFile.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int size)
+{
+    msync(addr, size, MS_SYNC);
+    munmap(addr, size);
+}
+
 //----------------------------------------------------------------------
 // OpenForReadWrite
 // 	Open a file for reading or writing.
@@ -214,6 +268,26 @@ WriteFile(int fd, char *buffer, int nBytes)
     ASSERT(retVal == nBytes);
 }
 
+//----------------------------------------------------------------------
+// ReadAtOffset, WriteAtOffset
+// 	Read or write characters at "offset" in an open file, in one 
+//	system call, without moving its file position.  Abort on error.
+//----------------------------------------------------------------------
+
+void
+ReadAtOffset(int fd, char *buffer, int nBytes, int offset)
+{
+    int retVal = pread(fd, buffer, nBytes, offset);
+    ASSERT(retVal == nBytes);
+}
+
+void
+WriteAtOffset(int fd, char *buffer, int nBytes, int offset)
+{
+    int retVal = pwrite(fd, buffer, nBytes, offset);
+    ASSERT(retVal == nBytes);
+}
+
 //----------------------------------------------------------------------
 // Lseek
 // 	Change the location within an open file.  Abort on error.
@@ -349,9 +423,10 @@ PollSocket(int sockID)
 
 //----------------------------------------------------------------------
 // ReadFromSocket
-// 	Read a fixed size packet off the IPC port.  Abort on error.
+// 	Read a packet of at most "packetSize" bytes off the IPC port, and
+//	return its size.  Abort on error.
 //----------------------------------------------------------------------
-void
+int
 ReadFromSocket(int sockID, char *buffer, int packetSize)
 {
     int retVal;
@@ -366,19 +441,22 @@ ReadFromSocket(int sockID, char *buffer, int packetSize)
     retVal = recvfrom(sockID, buffer, packetSize, 0,
 				   (struct sockaddr *) &uName, &size);
 
-    if (retVal != packetSize) {
+    if (retVal <= 0) {
         perror("in recvfrom");
         printf("called: %x, got back %d, %d\n", (unsigned int) buffer, retVal, errno);
     }
-    ASSERT(retVal == packetSize);
+    ASSERT(retVal > 0 && retVal <= packetSize);
+    return retVal;
 }
 
 //----------------------------------------------------------------------
 // SendToSocket
-// 	Transmit a fixed size packet to another Nachos' IPC port.
-//	Abort on error.
+// 	Transmit a packet of "packetSize" bytes to another Nachos' IPC port.
+//	Returns FALSE if there is no such Nachos running (yet, or any 
+//	more): the packet is lost, as on a real network.  Abort on any 
+//	other error.
 //----------------------------------------------------------------------
-void
+bool
 SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
 {
     struct sockaddr_un uName;
@@ -387,7 +465,10 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
     InitSocketName(&uName, toName);
     retVal = sendto(sockID, buffer, packetSize, 0,
 			   (sockaddr*) &uName, sizeof(uName));
+    if (retVal < 0 && (errno == ENOENT || errno == ECONNREFUSED))
+	return FALSE;
     ASSERT(retVal == packetSize);
+    return TRUE;
 }
 
 
@@ -403,6 +484,18 @@ CallOnUserAbort(VoidNoArgFunctionPtr func)
     (void)signal(SIGINT, (VoidFunctionPtr) func);
 }
 
+//----------------------------------------------------------------------
+// CallOnStatsRequest
+// 	Arrange that "func" will be called each time the UNIX process
+//	gets SIGUSR1 (e.g., from "kill -USR1").
+//----------------------------------------------------------------------
+
+void 
+CallOnStatsRequest(VoidNoArgFunctionPtr func)
+{
+    (void)signal(SIGUSR1, (VoidFunctionPtr) func);
+}
+
 //----------------------------------------------------------------------
 // Sleep
 // 	Put the UNIX process running Nachos to sleep for x seconds,
@@ -461,6 +554,21 @@ Random()
     return rand();
 }
 
+//----------------------------------------------------------------------
+// HostNanoseconds
+// 	Return the host's wall clock time, in nanoseconds (with
+//	microsecond resolution), for timing Nachos itself.
+//----------------------------------------------------------------------
+
+long long
+HostNanoseconds()
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000000000LL + now.tv_usec * 1000LL;
+}
+
 //----------------------------------------------------------------------
 // AllocBoundedArray
 // 	Return an array, with the two pages just before 
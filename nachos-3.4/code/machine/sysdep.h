@@ -24,19 +24,26 @@ extern int OpenForReadWrite(char *name, bool crashOnError);
 extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, char *buffer, int nBytes);
+extern void ReadAtOffset(int fd, char *buffer, int nBytes, int offset);
+extern void WriteAtOffset(int fd, char *buffer, int nBytes, int offset);
 extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(char *name);
 
+// Map a file into memory, for writing traces or simulating the disk
+extern char *MapFile(char *name, int size);
+extern char *MapOpenFile(int fd, int size);
+extern void UnmapFile(char *addr, int size);
+
 // Interprocess communication operations, for simulating the network
 extern int OpenSocket();
 extern void CloseSocket(int sockID);
 extern void AssignNameToSocket(char *socketName, int sockID);
 extern void DeAssignNameToSocket(char *socketName);
 extern bool PollSocket(int sockID);
-extern void ReadFromSocket(int sockID, char *buffer, int packetSize);
-extern void SendToSocket(int sockID, char *buffer, int packetSize,char *toName);
+extern int ReadFromSocket(int sockID, char *buffer, int packetSize);
+extern bool SendToSocket(int sockID, char *buffer, int packetSize,char *toName);
 
 // Process control: abort, exit, and sleep
 extern void Abort();
@@ -46,10 +53,16 @@ extern void Delay(int seconds);
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
+// ... and so that "func" is called whenever the process gets SIGUSR1
+extern void CallOnStatsRequest(VoidNoArgFunctionPtr func);
+
 // Initialize the pseudo random number generator
 extern void RandomInit(unsigned seed);
 extern int Random();
 
+// The host's wall clock, for timing Nachos itself
+extern long long HostNanoseconds();
+
 // Allocate, de-allocate an array, such that de-referencing
 // just beyond either end of the array will cause an error
 extern char *AllocBoundedArray(int size);
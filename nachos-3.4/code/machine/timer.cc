@@ -39,17 +39,22 @@ static void TimerHandler(int arg)
 //      "callArg" is the parameter to be passed to the interrupt handler.
 //      "doRandom" -- if true, arrange for the interrupts to occur
 //		at random, instead of fixed, intervals.
+//	"ticks" -- the time between interrupts (the average, if random)
+//	"kind" -- the kind of interrupt to schedule
 //----------------------------------------------------------------------
 
-Timer::Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom)
+Timer::Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom,
+	     int ticks, IntType kind)
 {
     randomize = doRandom;
+    interval = ticks;
     handler = timerHandler;
     arg = callArg; 
+    type = kind;
 
     // schedule the first interrupt from the timer device
     interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
-		TimerInt); 
+		type); 
 }
 
 //----------------------------------------------------------------------
@@ -63,7 +68,7 @@ Timer::TimerExpired()
 {
     // schedule the next timer device interrupt
     interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
-		TimerInt);
+		type);
 
     // invoke the Nachos interrupt handler for this device
     (*handler)(arg);
@@ -79,7 +84,7 @@ int
 Timer::TimeOfNextInterrupt() 
 {
     if (randomize)
-	return 1 + (Random() % (TimerTicks * 2));
+	return 1 + (Random() % (interval * 2));
     else
-	return TimerTicks; 
+	return interval; 
 }
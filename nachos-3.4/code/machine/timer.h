@@ -10,6 +10,9 @@
 //
 //	In order to introduce some randomness into time-slicing, if "doRandom"
 //	is set, then the interrupt comes after a random number of ticks.
+//	The interval (on average, if random) can be set; by default it is
+//	TimerTicks.  So can the interrupt type, so that a second timer
+//	(the profiler's, ProfileInt) can run beside the scheduler's.
 //
 //  DO NOT CHANGE -- part of the machine emulation
 //
@@ -22,11 +25,14 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "stats.h"
+#include "interrupt.h"
 
 // The following class defines a hardware timer. 
 class Timer {
   public:
-    Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom);
+    Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom,
+	  int ticks = TimerTicks, IntType kind = TimerInt);
 				// Initialize the timer, to call the interrupt
 				// handler "timerHandler" every time slice.
     ~Timer() {}
@@ -41,8 +47,10 @@ class Timer {
 
   private:
     bool randomize;		// set if we need to use a random timeout delay
+    int interval;		// ticks between interrupts
     VoidFunctionPtr handler;	// timer interrupt handler 
     int arg;			// argument to pass to interrupt handler
+    IntType type;		// TimerInt, or ProfileInt
 
 };
 
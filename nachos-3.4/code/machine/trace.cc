@@ -0,0 +1,150 @@
+// trace.cc 
+//	Routines to record kernel events in a memory-mapped trace file.
+//	See trace.h and bin/tracefmt.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "trace.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// EventTrace::EventTrace
+// 	Create a trace file with room for "numSlots" records, and map it
+//	into memory.
+//
+//	"fileName" -- the host file to write the trace to
+//	"numSlots" -- how many of the most recent events to keep
+//----------------------------------------------------------------------
+
+EventTrace::EventTrace(char *fileName, int numSlots)
+{
+    ASSERT(numSlots > 0);
+    size = sizeof(TraceHeader) + numSlots * sizeof(TraceRecord);
+    header = (TraceHeader *) MapFile(fileName, size);
+    records = (TraceRecord *) (header + 1);
+    header->traceMagic = TRACEMAGIC;
+    header->numSlots = numSlots;
+    header->numRecords = 0;
+    header->pad = 0;
+}
+
+//----------------------------------------------------------------------
+// EventTrace::~EventTrace
+// 	Make sure the whole trace is in the file, and unmap it.
+//----------------------------------------------------------------------
+
+EventTrace::~EventTrace()
+{
+    UnmapFile((char *) header, size);
+}
+
+//----------------------------------------------------------------------
+// EventTrace::Record
+// 	Record an event in the next slot, overwriting the oldest one once
+//	the file is full.
+//
+//	"type" -- what happened (see tracefmt.h)
+//	"arg1", "arg2" -- its details
+//----------------------------------------------------------------------
+
+void
+EventTrace::Record(int type, int arg1, int arg2)
+{
+    TraceRecord *r = &records[header->numRecords % header->numSlots];
+
+    r->tick = (int) stats->totalTicks;	// (the low 32 bits)
+    r->thread = TraceThreadID(currentThread);
+    r->type = type;
+    r->arg1 = arg1;
+    r->arg2 = arg2;
+    header->numRecords++;
+}
+
+//----------------------------------------------------------------------
+// TraceThreadID
+// 	Return the ID recorded in the trace for "thread": its process ID
+//	(0 for kernel threads) when running user programs.  Otherwise
+//	threads have no IDs, so use its address.
+//----------------------------------------------------------------------
+
+int
+TraceThreadID(Thread *thread)
+{
+    if (thread == NULL)
+	return 0;
+#ifdef USER_PROGRAM
+    return thread->getID();
+#else
+    return (int) thread;
+#endif
+}
+
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// RefTrace::RefTrace
+// 	Create a page reference trace file, and write its header.
+//
+//	"fileName" -- the host file to write the trace to
+//----------------------------------------------------------------------
+
+RefTrace::RefTrace(char *fileName)
+{
+    RefTraceHeader header;
+
+    file = OpenForWrite(fileName);
+    header.refMagic = REFMAGIC;
+    header.pageSize = PageSize;
+    header.pad[0] = header.pad[1] = 0;
+    WriteFile(file, (char *) &header, sizeof(header));
+    count = 0;
+    last = RefWriteBit;			// (matches no read of page 0)
+}
+
+//----------------------------------------------------------------------
+// RefTrace::~RefTrace
+// 	Write out the references still buffered, and close the file.
+//----------------------------------------------------------------------
+
+RefTrace::~RefTrace()
+{
+    Flush();
+    Close(file);
+}
+
+//----------------------------------------------------------------------
+// RefTrace::Reference
+// 	Record that process "pid" referenced virtual page "vpn".  A 
+//	reference to the page just referenced by the same process is 
+//	dropped, unless it is the first write after reads.
+//----------------------------------------------------------------------
+
+void
+RefTrace::Reference(int pid, int vpn, bool writing)
+{
+    unsigned int word = ((unsigned) pid << RefPIDShift) |
+			(vpn & (RefWriteBit - 1)) | (writing ? RefWriteBit : 0);
+
+    if (word == last || (word | RefWriteBit) == last)
+	return;
+    buffer[count++] = word;
+    last = word;
+    if (count == RefBufferWords)
+	Flush();
+}
+
+//----------------------------------------------------------------------
+// RefTrace::Flush
+// 	Write the buffered references to the file.
+//----------------------------------------------------------------------
+
+void
+RefTrace::Flush()
+{
+    if (count > 0)
+	WriteFile(file, (char *) buffer, count * sizeof(unsigned int));
+    count = 0;
+}
+#endif // USER_PROGRAM
@@ -0,0 +1,77 @@
+// trace.h 
+//	Data structures for recording a binary trace of kernel events --
+//	context switches, page faults and evictions, system calls, and 
+//	disk requests -- for offline analysis with bin/tracedump.
+//
+//	The trace is written to a memory-mapped host file (see 
+//	bin/tracefmt.h for its layout), so recording an event is just a 
+//	few stores; nothing is formatted, and nothing is written from 
+//	Nachos until the host gets around to it.  Tracing is off unless
+//	Nachos is started with "-tr file".
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "copyright.h"
+#include "tracefmt.h"
+
+#define TraceSlots	65536		// events kept in the trace file
+
+class Thread;
+
+class EventTrace {
+  public:
+    EventTrace(char *fileName, int numSlots);	// Create the trace file
+    ~EventTrace();			// Write it back, and close it
+
+    void Record(int type, int arg1, int arg2);	// Record an event, 
+					// stamped with the time and the
+					// running thread
+
+  private:
+    TraceHeader *header;		// start of the mapped file
+    TraceRecord *records;		// its record slots
+    int size;				// length of the file, in bytes
+};
+
+#ifdef USER_PROGRAM
+// The following class defines a trace of every page a user program
+// references, for bin/refsim to run replacement policies against.  It
+// is written through a buffer, since it can get long.
+
+#define RefBufferWords	4096		// references written at a time
+
+class RefTrace {
+  public:
+    RefTrace(char *fileName);		// Create the trace file
+    ~RefTrace();			// Write out the rest, and close it
+
+    void Reference(int pid, int vpn, bool writing);
+					// Record a reference, unless it
+					// repeats the last one
+
+  private:
+    void Flush();			// Write out the buffer
+
+    int file;
+    unsigned int buffer[RefBufferWords];
+    int count;				// words in the buffer
+    unsigned int last;			// the last reference recorded
+};
+#endif
+
+extern int TraceThreadID(Thread *thread);	// How "thread" appears in
+					// the trace
+
+// Record an event, if tracing is on ("eventTrace" is in system.h).
+#define TRACE(type, arg1, arg2)						      \
+    do {								      \
+	if (eventTrace != NULL)						      \
+	    eventTrace->Record(type, arg1, arg2);			      \
+    } while (0)
+
+#endif // TRACE_H
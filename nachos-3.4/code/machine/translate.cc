@@ -10,9 +10,9 @@
 //	into the table, to find the physical page #.
 //
 //	Translation lookaside buffer -- associative lookup in the table
-//	to find an entry with the same virtual page #.  If found,
-//	this entry is used for the translation.
-//	If not, it traps to software with an exception. 
+//	to find an entry with the same virtual page #, belonging to the
+//	current address space ID.  If found, this entry is used for the
+//	translation.  If not, it traps to software with an exception. 
 //
 //	In practice, the TLB is much smaller than the amount of physical
 //	memory (16 entries is common on a machine that has 1000's of
@@ -21,7 +21,9 @@
 //	anything at all about that.
 //
 //	Note that the contents of the TLB are specific to an address space.
-//	If the address space changes, so does the contents of the TLB!
+//	Entries are tagged with the address space's ID, so the kernel only
+//	needs to change tlbASID when the address space changes -- though
+//	it must still make sure the entries it left behind are not stale.
 //
 // DO NOT CHANGE -- part of the machine emulation
 //
@@ -91,13 +93,16 @@ Machine::ReadMem(int addr, int size, int *value)
     ExceptionType exception;
     int physicalAddress;
     
-    DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
+    if (!FastTranslate(addr, &physicalAddress, size, FALSE)) {
+	DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, FALSE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
     }
+    CacheAccess(DCache, physicalAddress, FALSE);
     switch (size) {
       case 1:
 	data = machine->mainMemory[physicalAddress];
@@ -140,13 +145,16 @@ Machine::WriteMem(int addr, int size, int value)
     ExceptionType exception;
     int physicalAddress;
      
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
+    if (!FastTranslate(addr, &physicalAddress, size, TRUE)) {
+	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
     }
+    CacheAccess(DCache, physicalAddress, TRUE);
     switch (size) {
       case 1:
 	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
@@ -164,6 +172,7 @@ Machine::WriteMem(int addr, int size, int value)
 	
       default: ASSERT(FALSE);
     }
+    decodedValid[physicalAddress / 4] = FALSE;	// in case it was code
     
     return TRUE;
 }
@@ -189,7 +198,9 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     int i;
     unsigned int vpn, offset;
     TranslationEntry *entry;
+    TLBEntry *tlbEntry = NULL;
     unsigned int pageFrame;
+    XlateCacheEntry *cached;
 
     DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
@@ -200,8 +211,9 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     }
     
     // we must have either a TLB or a page table, but not both!
-    ASSERT(tlb == NULL || pageTable == NULL);	
-    ASSERT(tlb != NULL || pageTable != NULL);	
+    ASSERT(pageTable == NULL || pageDirectory == NULL);
+    ASSERT(tlb == NULL || (pageTable == NULL && pageDirectory == NULL));	
+    ASSERT(tlb != NULL || pageTable != NULL || pageDirectory != NULL);	
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
@@ -213,24 +225,36 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 			virtAddr, pageTableSize);
 	    return AddressErrorException;
-	} else if (!pageTable[vpn].valid) {
-	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
-			virtAddr, pageTableSize);
+	}
+	if (pageDirectory != NULL) {
+	    TranslationEntry *chunk = pageDirectory[vpn / PageTableChunk];
+
+	    instrTicks += walkTicks;		// the extra memory reference
+	    entry = (chunk == NULL) ? NULL : &chunk[vpn % PageTableChunk];
+	} else
+	    entry = &pageTable[vpn];
+	if (entry == NULL || !entry->valid) {
+	    DEBUG('a', "virtual page # %d not in memory!\n", vpn);
 	    return PageFaultException;
 	}
-	entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (((unsigned int)tlb[i].virtualPage) == vpn)) {
-		entry = &tlb[i];			// FOUND!
+        for (entry = NULL, i = 0; i < tlbSize; i++)
+    	    if (tlb[i].valid && tlb[i].asid == tlbASID
+			&& (vpn - (unsigned int) tlb[i].virtualPage
+					< (unsigned int) tlb[i].numPages)) {
+		entry = tlbEntry = &tlb[i];		// FOUND!
 		break;
 	    }
 	if (entry == NULL) {				// not found
     	    DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
+	    stats->numTLBMisses++;
+	    instrTicks += tlbMissTicks;
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	stats->numTLBHits++;
+	tlbLastUse[i] = ++tlbUseCount;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -238,18 +262,85 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	return ReadOnlyException;
     }
     pageFrame = entry->physicalPage;
+    if (tlbEntry != NULL)		// the page's frame, in a superpage
+	pageFrame += vpn - tlbEntry->virtualPage;
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned) NumPhysPages) { 
 	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
     if (writing)
 	entry->dirty = TRUE;
+    if (frameRefHook != NULL)
+	(*frameRefHook)(pageFrame);
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+
+    // remember the translation, so FastTranslate can find it next time
+    cached = &xlateCache[vpn % XlateCacheSize];
+    cached->owner = XlateOwner();
+    cached->vpn = vpn;
+    cached->entry = entry;
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::FastTranslate
+// 	Translate a virtual address using only the simulator's translation
+//	cache.  On a hit, this does exactly what Translate would have done 
+//	(alignment and read-only checks, use and dirty bits), minus the
+//	table search and the debugging output.  On a miss, or if anything
+//	looks unusual, return FALSE so the caller falls back on Translate, 
+//	which will raise any exception and refill the cache.
+//
+//	The cached entry is re-checked on each hit, in case the kernel 
+//	has changed the page table or re-loaded the TLB slot since.
+//
+//	"virtAddr" -- the virtual address to translate
+//	"physAddr" -- the place to store the physical address
+//	"size" -- the amount of memory being read or written
+// 	"writing" -- if TRUE, check the "read-only" bit
+//----------------------------------------------------------------------
+
+bool
+Machine::FastTranslate(int virtAddr, int* physAddr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    XlateCacheEntry *cached = &xlateCache[vpn % XlateCacheSize];
+    TranslationEntry *entry = cached->entry;
+    int pageFrame;
+
+    if (refTrace != NULL)		// every reference comes here first
+	refTrace->Reference(TraceThreadID(currentThread), vpn, writing);
+    if (!xlateEnabled || (entry == NULL) || (cached->vpn != vpn))
+	return FALSE;
+    if (cached->owner != XlateOwner())
+	return FALSE;			// some other address space
+    if (!entry->valid || (writing && entry->readOnly) || (virtAddr & (size - 1)))
+	return FALSE;			// let Translate sort it out
+    pageFrame = entry->physicalPage;
+    if (tlb != NULL) {
+	TLBEntry *tlbEntry = (TLBEntry *) entry;	// owner is the TLB
+
+	if (vpn - (unsigned int) tlbEntry->virtualPage 
+				>= (unsigned int) tlbEntry->numPages
+		|| tlbEntry->asid != tlbASID)
+	    return FALSE;		// TLB slot re-used by the kernel
+	pageFrame += vpn - tlbEntry->virtualPage;
+	stats->numTLBHits++;
+	tlbLastUse[tlbEntry - tlb] = ++tlbUseCount;
+    } else if (pageDirectory != NULL)
+	instrTicks += walkTicks;	// as Translate would have
+
+    entry->use = TRUE;
+    if (writing)
+	entry->dirty = TRUE;
+    if (frameRefHook != NULL)
+	(*frameRefHook)(pageFrame);
+    *physAddr = pageFrame * PageSize + (unsigned) virtAddr % PageSize;
+    return TRUE;
+}
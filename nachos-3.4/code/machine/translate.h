@@ -6,8 +6,8 @@
 //	The data structures in this file are "dual-use" - they
 //	serve both as a page table entry, and as an entry in
 //	a software-managed translation lookaside buffer (TLB).
-//	Either way, each entry is of the form:
-//	<virtual page #, physical page #>.
+//	Either way, each entry maps a virtual page # to a
+//	physical page #.
 //
 // DO NOT CHANGE -- part of the machine emulation
 //
@@ -26,20 +26,60 @@
 // virtual page to one physical page.
 // In addition, there are some extra bits for access control (valid and 
 // read-only) and some bits for usage information (use and dirty).
+//
+// In a page table the virtual page is the entry's index, so it isn't
+// stored: the whole entry is packed into one 32-bit word, and a page
+// table scan (by the page replacer, say) touches 4 bytes per page.  The
+// frame number is signed, so that -1 can mean "no frame".
 
 class TranslationEntry {
+  public:
+    int physicalPage : 28;	// The page number in real memory (relative
+				//  to the start of "mainMemory"
+    unsigned int valid : 1;	// If this bit is set, the translation is
+				// ignored.  (In other words, the entry
+				// hasn't been initialized.)
+    unsigned int readOnly : 1;	// If this bit is set, the user program is
+				// not allowed to modify the contents of
+				// the page.
+    unsigned int use : 1;	// This bit is set by the hardware every
+				// time the page is referenced or modified.
+    unsigned int dirty : 1;	// This bit is set by the hardware every
+				// time the page is modified.
+};
+
+// The following class defines an entry in the TLB, which is searched
+// associatively, so it has to say which virtual page it maps.
+//
+// A TLB entry may also map a "superpage": numPages pages (a power of
+// two) starting at virtualPage, onto as many frames starting at
+// physicalPage, both multiples of numPages.
+//
+// A TLB entry is also tagged with the ID of the address space it
+// belongs to (asid); the hardware only matches entries whose asid is
+// the one in machine->tlbASID, so the TLB can hold the entries of
+// several address spaces at once.
+
+class TLBEntry : public TranslationEntry {
   public:
     int virtualPage;  	// The page number in virtual memory.
-    int physicalPage;  	// The page number in real memory (relative to the
-			//  start of "mainMemory"
-    bool valid;         // If this bit is set, the translation is ignored.
-			// (In other words, the entry hasn't been initialized.)
-    bool readOnly;	// If this bit is set, the user program is not allowed
-			// to modify the contents of the page.
-    bool use;           // This bit is set by the hardware every time the
-			// page is referenced or modified.
-    bool dirty;         // This bit is set by the hardware every time the
-			// page is modified.
+    int numPages;	// How many pages the entry maps
+    int asid;		// The address space it belongs to
+};
+
+// The following class defines an entry in the simulator's own
+// translation cache.  This is not part of the simulated hardware (the
+// kernel never sees it); it just remembers, for a recently used
+// virtual page, which page table or TLB entry translated it, so that
+// the common case of ReadMem/WriteMem can skip the full Translate.
+
+class XlateCacheEntry {
+  public:
+    TranslationEntry *owner;	// The page table (or TLB) the entry came
+				// from, i.e., which address space it is for
+    unsigned int vpn;		// The virtual page being cached
+    TranslationEntry *entry;	// The entry that translated it, NULL if
+				// this cache slot is empty
 };
 
 #endif
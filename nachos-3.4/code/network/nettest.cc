@@ -21,6 +21,7 @@
 #include "system.h"
 #include "network.h"
 #include "post.h"
+#include "transport.h"
 #include "interrupt.h"
 
 // Test out message delivery, by doing the following:
@@ -70,3 +71,38 @@ MailTest(int farAddr)
     // Then we're done!
     interrupt->Halt();
 }
+
+// Test out reliable connections, by doing the same as MailTest, over a
+// Connection between mail box #2 on both machines, with messages that
+// take several segments each.  Run with a lossy network ("-l 0.5") to
+// see the retransmissions.
+
+void
+ReliableMailTest(int farAddr, int window)
+{
+    Connection *connection = new Connection(farAddr, 2, 2, window);
+    char data[200], buffer[200];
+    char *ack = "Got it, every word!";
+    int i, n;
+
+    for (i = 0; i < (int) sizeof(data) - 1; i++)
+	data[i] = 'a' + i % 26;
+    data[i] = '\0';
+
+    // Send the first message, and wait for the other machine's
+    connection->Send(data, sizeof(data));
+    n = connection->Receive(buffer, sizeof(buffer));
+    printf("Got %d bytes from %d (%s)\n", n, farAddr,
+	   (n == sizeof(data) && !strcmp(buffer, data)) ? "intact" : "garbled");
+    fflush(stdout);
+
+    // Acknowledge it, and wait for the other machine's acknowledgement
+    connection->Send(ack, strlen(ack) + 1);
+    n = connection->Receive(buffer, sizeof(buffer));
+    printf("Got \"%s\" from %d\n", buffer, farAddr);
+    fflush(stdout);
+
+    // Make sure the other machine has everything before we go away
+    connection->Close();
+    interrupt->Halt();
+}
@@ -18,28 +18,10 @@
 
 #include "copyright.h"
 #include "post.h"
+#include "system.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
-//----------------------------------------------------------------------
-// Mail::Mail
-//      Initialize a single mail message, by concatenating the headers to
-//	the data.
-//
-//	"pktH" -- source, destination machine ID's
-//	"mailH" -- source, destination mailbox ID's
-//	"data" -- payload data
-//----------------------------------------------------------------------
-
-Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
-{
-    ASSERT(mailH.length <= MaxMailSize);
-
-    pktHdr = pktH;
-    mailHdr = mailH;
-    bcopy(msgData, data, mailHdr.length);
-}
-
 //----------------------------------------------------------------------
 // MailBox::MailBox
 //      Initialize a single mail box within the post office, so that it
@@ -88,61 +70,61 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 // 	Add a message to the mailbox.  If anyone is waiting for message
 //	arrival, wake them up!
 //
-//	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	The message is one of the post office's Mail buffers, which the
+//	network has already filled in; it belongs to the mailbox until
+//	somebody gets it.
 //
-//	"pktHdr" -- source, destination machine ID's
-//	"mailHdr" -- source, destination mailbox ID's
-//	"data" -- payload message data
+//	"mail" -- the message, with both headers
 //----------------------------------------------------------------------
 
 void 
-MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+MailBox::Put(Mail *mail)
 { 
-    Mail *mail = new Mail(pktHdr, mailHdr, data); 
-
     messages->Append((void *)mail);	// put on the end of the list of 
 					// arrived messages, and wake up 
 					// any waiters
 }
 
+void 
+MailBox::Put(Mail **mail, int count)
+{ 
+    messages->AppendBatch((void **)mail, count);
+}
+
 //----------------------------------------------------------------------
 // MailBox::Get
-// 	Get a message from a mailbox, parsing it into the packet header,
-//	mailbox header, and data. 
+// 	Get a message from a mailbox.  The caller copies out what it needs,
+//	and gives the Mail buffer back to the post office's pool.
 //
-//	The calling thread waits if there are no messages in the mailbox.
-//
-//	"pktHdr" -- address to put: source, destination machine ID's
-//	"mailHdr" -- address to put: source, destination mailbox ID's
-//	"data" -- address to put: payload message data
+//	The calling thread waits if there are no messages in the mailbox,
+//	unless "wait" is FALSE; then it gets NULL.
 //----------------------------------------------------------------------
 
-void 
-MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
+Mail *
+MailBox::Get(bool wait) 
 { 
-    DEBUG('n', "Waiting for mail in mailbox\n");
-    Mail *mail = (Mail *) messages->Remove();	// remove message from list;
+    Mail *mail;
+
+    if (wait) {
+	DEBUG('n', "Waiting for mail in mailbox\n");
+	mail = (Mail *) messages->Remove();	// remove message from list;
 						// will wait if list is empty
+    } else if ((mail = (Mail *) messages->TryRemove()) == NULL)
+	return NULL;
 
-    *pktHdr = mail->pktHdr;
-    *mailHdr = mail->mailHdr;
     if (DebugIsEnabled('n')) {
 	printf("Got mail from mailbox: ");
-	PrintHeader(*pktHdr, *mailHdr);
+	PrintHeader(mail->pktHdr, mail->mailHdr);
     }
-    bcopy(mail->data, data, mail->mailHdr.length);
-					// copy the message data into
-					// the caller's buffer
-    delete mail;			// we've copied out the stuff we
-					// need, we can now discard the message
+    return mail;
 }
 
 //----------------------------------------------------------------------
 // PostalHelper, ReadAvail, WriteDone
 // 	Dummy functions because C++ can't indirectly invoke member functions
 //	The first is forked as part of the "postal worker thread; the
-//	later two are called by the network interrupt handler.
+//	next two are called by the network interrupt handler, and the
+//	last by the coalescing timer.
 //
 //	"arg" -- pointer to the Post Office managing the Network
 //----------------------------------------------------------------------
@@ -153,6 +135,8 @@ static void ReadAvail(int arg)
 { PostOffice* po = (PostOffice *) arg; po->IncomingPacket(); }
 static void WriteDone(int arg)
 { PostOffice* po = (PostOffice *) arg; po->PacketSent(); }
+static void FlushHelper(int arg)
+{ PostOffice* po = (PostOffice *) arg; po->FlushTimer(); }
 
 //----------------------------------------------------------------------
 // PostOffice::PostOffice
@@ -171,14 +155,31 @@ static void WriteDone(int arg)
 //	  drops any packets; reliability = 0 means the network never
 //	  delivers any packets)
 //	"nBoxes" is the number of mail boxes in this Post Office
+//	"delay" is how many ticks an outgoing packet may wait for
+//	  more messages to the same machine; 0 sends each message in a
+//	  packet of its own
+//	"fabricFile", if not NULL, gives each link its own reliability 
+//	  and latency
 //----------------------------------------------------------------------
 
-PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
+PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+			int delay, char *fabricFile)
 {
 // First, initialize the synchronization with the interrupt handlers
     messageAvailable = new Semaphore("message available", 0);
-    messageSent = new Semaphore("message sent", 0);
-    sendLock = new Lock("message send lock");
+    queueSlots = new Semaphore("send queue slots", SendQueueSize);
+    sendHead = sendCount = 0;
+    sending = FALSE;
+    coalesceDelay = delay;
+    flushPending = FALSE;
+
+// Every Mail buffer starts out free; the network fills them in place,
+//   so the data must follow right after the mail header
+    ASSERT(mailPool[0].data == (char *)&mailPool[0].mailHdr + sizeof(MailHeader));
+    freeMail = new SynchList();
+    for (int i = 0; i < MailPoolSize; i++)
+	freeMail->Append((void *)&mailPool[i]);
+    numSpare = 0;
 
 // Second, initialize the mailboxes
     netAddr = addr; 
@@ -186,7 +187,8 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
     boxes = new MailBox[nBoxes];
 
 // Third, initialize the network; tell it which interrupt handlers to call
-    network = new Network(addr, reliability, ReadAvail, WriteDone, (int) this);
+    network = new Network(addr, reliability, ReadAvail, WriteDone, (int) this,
+				fabricFile);
 
 
 // Finally, create a thread whose sole job is to wait for incoming messages,
@@ -206,8 +208,8 @@ PostOffice::~PostOffice()
     delete network;
     delete [] boxes;
     delete messageAvailable;
-    delete messageSent;
-    delete sendLock;
+    delete queueSlots;
+    delete freeMail;
 }
 
 //----------------------------------------------------------------------
@@ -215,40 +217,130 @@ PostOffice::~PostOffice()
 // 	Wait for incoming messages, and put them in the right mailbox.
 //
 //      Incoming messages have had the PacketHeader stripped off,
-//	but the MailHeader is still tacked on the front of the data.
+//	but the MailHeader is still tacked on the front of the data; 
+//	the network copies them straight into a free Mail buffer, which
+//	then goes into the mailbox as it is.
+//
+//	If every buffer is waiting in some mailbox, we stop taking packets
+//	off the network until one is received; the network holds on to
+//	the packet meanwhile.
+//
+//	With interrupt coalescing, one interrupt may stand for several
+//	packets, so we take all there are each time.  Free buffers are
+//	taken from the pool several at a time, and what is left of them is
+//	given back, all at once, before waiting for the next interrupt.
 //----------------------------------------------------------------------
 
 void
 PostOffice::PostalDelivery()
 {
     PacketHeader pktHdr;
-    MailHeader mailHdr;
-    char *buffer = new char[MaxPacketSize];
+    Mail *mail;
 
     for (;;) {
-        // first, wait for a message
         messageAvailable->P();	
-        pktHdr = network->Receive(buffer);
+	for (;;) {
+	    // get a buffer to put the next one in, if there is one
+	    mail = TakeBuffer();
+	    pktHdr = network->Receive((char *)&mail->mailHdr);
+	    if (pktHdr.length == 0) {
+		spare[numSpare++] = mail;	// not used after all
+		break;
+	    }
+	    DeliverPacket(pktHdr, mail);
+	}
+	freeMail->AppendBatch((void **)spare, numSpare);
+	numSpare = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// PostOffice::TakeBuffer
+// 	Return a free Mail buffer for the postal worker: one it already
+//	has, or else as many as the pool will give at once, up to 
+//	DeliveryBatch, waiting for one if every buffer is in a mailbox.
+//----------------------------------------------------------------------
+
+Mail *
+PostOffice::TakeBuffer()
+{
+    if (numSpare == 0)
+	numSpare = freeMail->RemoveBatch((void **)spare, DeliveryBatch);
+    return spare[--numSpare];
+}
+
+//----------------------------------------------------------------------
+// PostOffice::DeliverPacket
+// 	Put the messages in a packet just taken off the network into
+//	their mailboxes.
+//
+//	"pktHdr" -- the packet's header
+//	"first" -- the buffer the packet (from the MailHeader on) is in
+//----------------------------------------------------------------------
+
+void
+PostOffice::DeliverPacket(PacketHeader pktHdr, Mail *first)
+{
+    Mail *mail[MaxMailsPerPacket];
+    int numMail;
+    unsigned offset;			// like pktHdr.length
+
+    mail[0] = first;
+
+    // if the sender coalesced several messages into the packet, the 
+    // rest follow the first one; copy each one out into a buffer of
+    // its own before anybody can receive the first one
+    numMail = 1;
+    offset = sizeof(MailHeader) + mail[0]->mailHdr.length;
+    while (offset < pktHdr.length) {
+	ASSERT(numMail < (int) MaxMailsPerPacket);
+	mail[numMail] = TakeBuffer();
+	bcopy((char *)&mail[0]->mailHdr + offset, 
+		    (char *)&mail[numMail]->mailHdr, sizeof(MailHeader));
+	ASSERT(offset + sizeof(MailHeader) + mail[numMail]->mailHdr.length 
+		    <= pktHdr.length);
+	bcopy((char *)&mail[0]->mailHdr + offset + sizeof(MailHeader),
+		    mail[numMail]->data, mail[numMail]->mailHdr.length);
+	offset += sizeof(MailHeader) + mail[numMail]->mailHdr.length;
+	numMail++;
+    }
+    ASSERT(offset == pktHdr.length);
 
-        mailHdr = *(MailHeader *)buffer;
-        if (DebugIsEnabled('n')) {
+    for (int i = 0; i < numMail; i++) {
+	mail[i]->pktHdr = pktHdr;
+	mail[i]->pktHdr.length = sizeof(MailHeader) + 
+				    mail[i]->mailHdr.length;
+	if (DebugIsEnabled('n')) {
 	    printf("Putting mail into mailbox: ");
-	    PrintHeader(pktHdr, mailHdr);
-        }
+	    PrintHeader(mail[i]->pktHdr, mail[i]->mailHdr);
+	}
 
 	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+	ASSERT(0 <= mail[i]->mailHdr.to && mail[i]->mailHdr.to < numBoxes);
+	ASSERT(mail[i]->mailHdr.length <= MaxMailSize);
+    }
 
-	// put into mailbox
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+    // put into mailboxes, each run of messages to the same one at once
+    for (int i = 0, j; i < numMail; i = j) {
+	for (j = i + 1; j < numMail 
+			&& mail[j]->mailHdr.to == mail[i]->mailHdr.to; j++)
+	    ;
+	boxes[mail[i]->mailHdr.to].Put(&mail[i], j - i);
     }
 }
 
 //----------------------------------------------------------------------
 // PostOffice::Send
-// 	Concatenate the MailHeader to the front of the data, and pass 
-//	the result to the Network for delivery to the destination machine.
+// 	Concatenate the MailHeader to the front of the data, and queue 
+//	the result for the Network to deliver to the destination machine.
+//	If the network is idle, it starts on it at once; otherwise
+//	PacketSent starts it once the packets ahead of it are out.  Waits
+//	only if the send queue is full; or, if "wait" is FALSE, gives up
+//	then, and returns FALSE.
+//
+//	When coalescing, the message goes into the last queued packet if 
+//	it can; and a new packet the idle network could start on is held
+//	back instead, until the flush timer goes off.
 //
 //	Note that the MailHeader + data looks just like normal payload
 //	data to the Network.
@@ -256,13 +348,15 @@ PostOffice::PostalDelivery()
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
 //	"data" -- payload message data
+//	"wait" -- may we wait for room in the send queue?
 //----------------------------------------------------------------------
 
-void
-PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
+bool
+PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data,
+			bool wait)
 {
-    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
-						// mailHdr + data
+    OutgoingPacket *packet;
+    IntStatus oldLevel;
 
     if (DebugIsEnabled('n')) {
 	printf("Post send: ");
@@ -275,25 +369,116 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
     pktHdr.from = netAddr;
     pktHdr.length = mailHdr.length + sizeof(MailHeader);
 
-    // concatenate MailHeader and data
-    bcopy(&mailHdr, buffer, sizeof(MailHeader));
-    bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
+    // the queue is only touched with interrupts off, by us and by the
+    // interrupt handler; so queueSlots always counts exactly the free
+    // places we can see
+    oldLevel = interrupt->SetLevel(IntOff);
+    if (coalesceDelay > 0 && Coalesce(pktHdr, mailHdr, data)) {
+	(void) interrupt->SetLevel(oldLevel);
+	return TRUE;
+    }
+    if (!wait && sendCount == SendQueueSize) {
+	(void) interrupt->SetLevel(oldLevel);
+	return FALSE;
+    }
+    queueSlots->P();			// wait for room in the queue
+
+    // concatenate MailHeader and data, in the queue
+    packet = &sendQueue[(sendHead + sendCount) % SendQueueSize];
+    packet->pktHdr = pktHdr;
+    bcopy(&mailHdr, packet->data, sizeof(MailHeader));
+    bcopy(data, packet->data + sizeof(MailHeader), mailHdr.length);
+    sendCount++;
+    if (!sending) {			// the network is idle
+	if (coalesceDelay == 0 || sendCount > 1)
+	    StartSend();
+	else if (!flushPending) {	// hold it, for more to come
+	    flushPending = TRUE;
+	    interrupt->Schedule(FlushHelper, (int) this, coalesceDelay, 
+					NetworkSendInt);
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    return TRUE;
+}
 
-    sendLock->Acquire();   		// only one message can be sent
-					// to the network at any one time
-    network->Send(pktHdr, buffer);
-    messageSent->P();			// wait for interrupt to tell us
-					// ok to send the next message
-    sendLock->Release();
+//----------------------------------------------------------------------
+// PostOffice::Coalesce
+// 	Pack a message in after the ones in the last packet in the send 
+//	queue, if that packet is going to the same machine, the network 
+//	isn't sending it already, and there is room.  A held packet that
+//	has no room for another message is sent at once.  Called with 
+//	interrupts off.
+//
+//	"pktHdr" -- the network header the message would have by itself
+//	"mailHdr" -- source, destination mailbox ID's
+//	"data" -- payload message data
+//
+// Returns:
+//	TRUE if the message was packed in
+//----------------------------------------------------------------------
 
-    delete [] buffer;			// we've sent the message, so
-					// we can delete our buffer
+bool
+PostOffice::Coalesce(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+{
+    int tail = (sendHead + sendCount - 1) % SendQueueSize;
+    OutgoingPacket *packet;
+
+    if (sendCount == 0 || (sending && tail == sendHead))
+	return FALSE;			// nothing waits to go out
+    packet = &sendQueue[tail];
+    if (packet->pktHdr.to != pktHdr.to || 
+		packet->pktHdr.length + pktHdr.length > MaxPacketSize)
+	return FALSE;
+
+    bcopy(&mailHdr, packet->data + packet->pktHdr.length, sizeof(MailHeader));
+    bcopy(data, packet->data + packet->pktHdr.length + sizeof(MailHeader), 
+		mailHdr.length);
+    packet->pktHdr.length += pktHdr.length;
+    stats->numMailsCoalesced++;
+    DEBUG('n', "Coalesced mail into packet to %d, now %d bytes\n", 
+		pktHdr.to, packet->pktHdr.length);
+
+    if (!sending && MaxPacketSize - packet->pktHdr.length <= sizeof(MailHeader))
+	StartSend();			// full: no point holding it
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
-// PostOffice::Send
+// PostOffice::FlushTimer
+// 	Interrupt handler, called when the packet held back for more 
+//	messages has waited coalesceDelay ticks (at most): send it, if 
+//	the network isn't busy with it already.
+//----------------------------------------------------------------------
+
+void
+PostOffice::FlushTimer()
+{
+    flushPending = FALSE;
+    if (!sending && sendCount > 0)
+	StartSend();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::StartSend
+// 	Give the oldest queued packet to the network.  Called with 
+//	interrupts off.
+//----------------------------------------------------------------------
+
+void
+PostOffice::StartSend()
+{
+    OutgoingPacket *packet = &sendQueue[sendHead];
+
+    sending = TRUE;
+    network->Send(packet->pktHdr, packet->data);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Receive
 // 	Retrieve a message from a specific box if one is available, 
-//	otherwise wait for a message to arrive in the box.
+//	otherwise wait for a message to arrive in the box; or, if "wait"
+//	is FALSE, return FALSE at once.
 //
 //	Note that the MailHeader + data looks just like normal payload
 //	data to the Network.
@@ -303,16 +488,28 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
 //	"pktHdr" -- address to put: source, destination machine ID's
 //	"mailHdr" -- address to put: source, destination mailbox ID's
 //	"data" -- address to put: payload message data
+//	"wait" -- may we wait for a message?
 //----------------------------------------------------------------------
 
-void
+bool
 PostOffice::Receive(int box, PacketHeader *pktHdr, 
-				MailHeader *mailHdr, char* data)
+				MailHeader *mailHdr, char* data, bool wait)
 {
     ASSERT((box >= 0) && (box < numBoxes));
 
-    boxes[box].Get(pktHdr, mailHdr, data);
+    Mail *mail = boxes[box].Get(wait);
+
+    if (mail == NULL)
+	return FALSE;			// nothing there, and we can't wait
+
+    *pktHdr = mail->pktHdr;
+    *mailHdr = mail->mailHdr;
     ASSERT(mailHdr->length <= MaxMailSize);
+    bcopy(mail->data, data, mailHdr->length);
+					// copy the message data into
+					// the caller's buffer
+    freeMail->Append((void *)mail);	// and give the buffer back
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -333,6 +530,9 @@ PostOffice::IncomingPacket()
 // 	Interrupt handler, called when the next packet can be put onto the 
 //	network.
 //
+//	Its place in the send queue is free now; start on the next 
+//	packet, if there is one.
+//
 //	The name of this routine is a misnomer; if "reliability < 1",
 //	the packet could have been dropped by the network, so it won't get
 //	through.
@@ -341,6 +541,12 @@ PostOffice::IncomingPacket()
 void 
 PostOffice::PacketSent()
 { 
-    messageSent->V();
+    sendHead = (sendHead + 1) % SendQueueSize;
+    sendCount--;
+    queueSlots->V();
+    if (sendCount > 0)
+	StartSend();
+    else
+	sending = FALSE;
 }
 
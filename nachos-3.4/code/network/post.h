@@ -52,24 +52,43 @@ class MailHeader {
 
 #define MaxMailSize 	(MaxPacketSize - sizeof(MailHeader))
 
-
-// The following class defines the format of an incoming/outgoing 
-// "Mail" message.  The message format is layered: 
+#define SendQueueSize	16	// packets that may wait to go out
+#define MailPoolSize	32	// arrived messages that may wait in the
+				// mailboxes at once
+#define MaxMailsPerPacket (MaxPacketSize / sizeof(MailHeader))
+				// most messages coalescing can pack
+				// into one packet
+#define DeliveryBatch	8	// free buffers the postal worker takes
+				// from the pool at a time
+
+
+// The following class defines the format of an incoming "Mail" 
+// message.  The message format is layered: 
 //	network header (PacketHeader) 
 //	post office header (MailHeader) 
 //	data
+//
+// The post office keeps a fixed pool of these, and the network copies
+// each arriving packet straight into one, from mailHdr on; so mailHdr
+// and data must stay next to each other.  The Mail itself is then
+// handed to the mailbox, and given back to the pool once received.
 
 class Mail {
   public:
-     Mail(PacketHeader pktH, MailHeader mailH, char *msgData);
-				// Initialize a mail message by
-				// concatenating the headers to the data
-
      PacketHeader pktHdr;	// Header appended by Network
      MailHeader mailHdr;	// Header appended by PostOffice
      char data[MaxMailSize];	// Payload -- message data
 };
 
+// A packet waiting in the post office's send queue: the network's
+// header, and the mail header plus the message data.
+
+class OutgoingPacket {
+  public:
+    PacketHeader pktHdr;
+    char data[MaxPacketSize];
+};
+
 // The following class defines a single mailbox, or temporary storage
 // for messages.   Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, and these messages can then be retrieved by
@@ -80,12 +99,12 @@ class MailBox {
     MailBox();			// Allocate and initialize mail box
     ~MailBox();			// De-allocate mail box
 
-    void Put(PacketHeader pktHdr, MailHeader mailHdr, char *data);
-   				// Atomically put a message into the mailbox
-    void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
-   				// Atomically get a message out of the 
+    void Put(Mail *mail);	// Atomically put a message into the mailbox
+    void Put(Mail **mail, int count);	// ... or several, in order
+    Mail *Get(bool wait = TRUE);// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
-				// to get!)
+				// to get, unless "wait" is FALSE; then 
+				// return NULL)
   private:
     SynchList *messages;	// A mailbox is just a list of arrived messages
 };
@@ -98,24 +117,49 @@ class MailBox {
 //
 // Incoming messages are put by the PostOffice into the 
 // appropriate mailbox, waking up any threads waiting on Receive.
+//
+// Outgoing messages are queued, and Send returns at once; the network
+// interrupt handler starts the next packet as soon as the last one is
+// out, so senders never wait for the network unless the queue is full.
+//
+// Optionally, the post office coalesces small messages: one sent to
+// the same machine as the last packet waiting in the queue is packed
+// into that packet, after the messages already there, if it fits.
+// So that an idle network doesn't send each message at once, a 
+// packet is held back for up to "coalesceDelay" ticks, or until it is
+// full, or another packet queues behind it.  The receiving post 
+// office splits the packet back into messages, each with its own 
+// mail header; so either end may coalesce, without the other knowing.
 
 class PostOffice {
   public:
-    PostOffice(NetworkAddress addr, double reliability, int nBoxes);
+    PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+		int delay = 0, char *fabricFile = NULL);
 				// Allocate and initialize Post Office
 				//   "reliability" is how many packets
-				//   get dropped by the underlying network
+				//   get dropped by the underlying network;
+				//   "delay" is how long a packet
+				//   may wait for more messages (0: don't
+				//   coalesce); "fabricFile" describes
+				//   the links (cf. network.h)
     ~PostOffice();		// De-allocate Post Office data
     
-    void Send(PacketHeader pktHdr, MailHeader mailHdr, char *data);
+    bool Send(PacketHeader pktHdr, MailHeader mailHdr, char *data,
+		bool wait = TRUE);
     				// Send a message to a mailbox on a remote 
 				// machine.  The fromBox in the MailHeader is 
-				// the return box for ack's.
+				// the return box for ack's.  Returns once 
+				// the message is queued to be sent; or, if
+				// "wait" is FALSE and the queue is full,
+				// returns FALSE at once.
     
-    void Receive(int box, PacketHeader *pktHdr, 
-		MailHeader *mailHdr, char *data);
+    bool Receive(int box, PacketHeader *pktHdr, 
+		MailHeader *mailHdr, char *data, bool wait = TRUE);
     				// Retrieve a message from "box".  Wait if
-				// there is no message in the box.
+				// there is no message in the box, unless 
+				// "wait" is FALSE; then return FALSE.
+
+    int NumBoxes() { return numBoxes; }
 
     void PostalDelivery();	// Wait for incoming messages, 
 				// and then put them in the correct mailbox
@@ -127,6 +171,8 @@ class PostOffice {
    				// packet has arrived and can be pulled
 				// off of network (i.e., time to call 
 				// PostalDelivery)
+    void FlushTimer();		// Interrupt handler, called when a held
+				// packet has waited long enough
 
   private:
     Network *network;		// Physical network connection
@@ -134,8 +180,30 @@ class PostOffice {
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
     Semaphore *messageAvailable;// V'ed when message has arrived from network
-    Semaphore *messageSent;	// V'ed when next message can be sent to network
-    Lock *sendLock;		// Only one outgoing message at a time
+    Mail mailPool[MailPoolSize];// Buffers for arrived messages
+    SynchList *freeMail;	// Those not waiting in a mailbox
+    void DeliverPacket(PacketHeader pktHdr, Mail *first);
+				// Put the messages of a packet received
+				// into "first" in their mailboxes
+    Mail *TakeBuffer();		// A free Mail buffer for the postal
+				// worker, from "spare" if it can
+    Mail *spare[DeliveryBatch];	// Free buffers the postal worker has
+    int numSpare;		// taken, and not yet used
+    void StartSend();		// Give the packet at the head of the
+				// send queue to the network
+    bool Coalesce(PacketHeader pktHdr, MailHeader mailHdr, char *data);
+				// Pack a message into the last queued
+				// packet, if it can go there
+
+    OutgoingPacket sendQueue[SendQueueSize];
+				// Packets waiting to go out, oldest at
+				// sendHead (a circular buffer)
+    int sendHead, sendCount;
+    bool sending;		// Is the network sending the head one?
+    Semaphore *queueSlots;	// Free places in the send queue
+    int coalesceDelay;		// Ticks a packet may be held; 0 if we
+				// don't coalesce
+    bool flushPending;		// Is a FlushTimer interrupt scheduled?
 };
 
 #endif
@@ -0,0 +1,348 @@
+// transport.cc
+//	Routines for reliable, ordered connections between mailboxes.
+//	See transport.h.
+//
+//	Each connection has two threads of its own: a receiver, which
+//	waits for segments in our mailbox, and a retransmitter, which
+//	waits for the retransmission timer.  The timer is an interrupt,
+//	and can't send anything itself, since sending waits.
+//
+//	There is no way to cancel a pending interrupt, so the timer is
+//	never cancelled: when it goes off, it checks whether it is still
+//	needed, and whether an ack has pushed retransmitAt back meanwhile.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "transport.h"
+
+// A whole message, waiting to be received.
+
+class Message {
+  public:
+    int length;
+    char *data;
+};
+
+//----------------------------------------------------------------------
+// ReceiveHelper, RetransmitHelper, RetransmitTimer, LingerTimer
+// 	Dummy functions because C++ can't indirectly invoke member
+//	functions.  The first two are forked as the connection's threads;
+//	the last two are interrupt handlers.
+//
+//	"arg" -- pointer to the Connection
+//----------------------------------------------------------------------
+
+static void ReceiveHelper(int arg)
+{ Connection *c = (Connection *) arg; c->ReceiveLoop(); }
+static void RetransmitHelper(int arg)
+{ Connection *c = (Connection *) arg; c->RetransmitLoop(); }
+static void RetransmitTimer(int arg)
+{ Connection *c = (Connection *) arg; c->TimerExpired(); }
+static void LingerTimer(int arg)
+{ Connection *c = (Connection *) arg; c->LingerOver(); }
+
+//----------------------------------------------------------------------
+// Connection::Connection
+// 	Set up our end of a connection, and start its threads.  The other
+//	end must set up a connection back to us, from "toBox" to
+//	"fromBox".
+//
+//	"to" -- the machine at the other end
+//	"toBox" -- its mailbox for the connection
+//	"fromBox" -- our mailbox for it, which nobody else may use
+//	"size" -- most segments sent and not yet acked
+//----------------------------------------------------------------------
+
+Connection::Connection(NetworkAddress to, MailBoxAddress toBox,
+			MailBoxAddress fromBox, int size)
+{
+    ASSERT(size > 0 && size <= MaxWindow);
+    farAddr = to;
+    farBox = toBox;
+    localBox = fromBox;
+    window = size;
+    base = nextSeq = 0;
+    retransmitAt = 0;
+    timerPending = FALSE;
+    expected = 0;
+    partialSize = MaxSegmentData;
+    partial = new char[partialSize];
+    partialLength = 0;
+    messages = new SynchList;
+
+    lock = new Lock("connection");
+    windowOpen = new Condition("connection window open");
+    timeout = new Semaphore("connection timeout", 0);
+    lingering = new Semaphore("connection linger", 0);
+    (new Thread("connection receiver"))->Fork(ReceiveHelper, (int) this);
+    (new Thread("connection retransmitter"))->Fork(RetransmitHelper,
+							(int) this);
+}
+
+Connection::~Connection()
+{
+    delete lingering;
+    delete timeout;
+    delete windowOpen;
+    delete lock;
+    delete messages;
+    delete [] partial;
+}
+
+//----------------------------------------------------------------------
+// Connection::Send
+// 	Send a message, as many segments as it takes.  Waits whenever the
+//	window is full, until the other end acks something.
+//
+//	"data" -- the message
+//	"length" -- its length in bytes (may be 0)
+//----------------------------------------------------------------------
+
+void
+Connection::Send(char *data, int length)
+{
+    int done = 0, n;
+    SegmentBuffer *seg;
+
+    lock->Acquire();
+    do {
+	while (nextSeq - base >= window)
+	    windowOpen->Wait(lock);
+	n = min(length - done, (int) MaxSegmentData);
+	seg = &unacked[nextSeq % MaxWindow];
+	seg->hdr.type = SegData;
+	seg->hdr.last = (done + n == length);
+	seg->hdr.length = n;
+	seg->hdr.seq = nextSeq++;
+	bcopy(&data[done], seg->data, n);
+	done += n;
+	if (seg->hdr.seq == base) {	// the timer is for the oldest
+	    retransmitAt = stats->totalTicks + RetransmitTime;
+	    StartTimer(RetransmitTime);
+	}
+	SendSegment(seg);
+    } while (done < length);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Connection::Receive
+// 	Wait for the next message from the other end, and copy it into
+//	"into".  Anything past "size" bytes is thrown away.
+//
+// Returns:
+//	the number of bytes copied
+//----------------------------------------------------------------------
+
+int
+Connection::Receive(char *into, int size)
+{
+    Message *message = (Message *) messages->Remove();
+    int n = min(message->length, size);
+
+    bcopy(message->data, into, n);
+    delete [] message->data;
+    delete message;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// Connection::Close
+// 	Wait until the other end has acked everything we sent.  Then keep
+//	on acking for LingerTime more, in case our last acks got lost and
+//	the other end is still retransmitting.  The connection can't be
+//	used afterwards.
+//----------------------------------------------------------------------
+
+void
+Connection::Close()
+{
+    lock->Acquire();
+    while (base != nextSeq)
+	windowOpen->Wait(lock);
+    lock->Release();
+    interrupt->Schedule(LingerTimer, (int) this, LingerTime, TransportInt);
+    lingering->P();
+}
+
+//----------------------------------------------------------------------
+// Connection::ReceiveLoop
+// 	The receiver thread: take each segment that arrives in our mailbox.
+//	An ack moves the window along.  A data segment is accepted if it
+//	is the one we expect next, and acked either way, so that a sender
+//	whose ack got lost hears again where we are.
+//----------------------------------------------------------------------
+
+void
+Connection::ReceiveLoop()
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    char buffer[MaxMailSize];
+    SegmentHeader *hdr = (SegmentHeader *) buffer;
+
+    for (;;) {
+	postOffice->Receive(localBox, &pktHdr, &mailHdr, buffer);
+	if (pktHdr.from != farAddr || mailHdr.length < sizeof(SegmentHeader))
+	    continue;			// not for this connection
+	lock->Acquire();
+	if (hdr->type == SegAck) {
+	    if (hdr->seq > base && hdr->seq <= nextSeq) {
+		base = hdr->seq;
+		retransmitAt = stats->totalTicks + RetransmitTime;
+		windowOpen->Broadcast(lock);
+	    }
+	} else {
+	    if (hdr->seq == expected) {
+		expected++;
+		Deliver(&buffer[sizeof(SegmentHeader)], hdr->length,
+				hdr->last);
+	    } else
+		DEBUG('n', "Dropping segment %d, expecting %d\n", hdr->seq,
+				expected);
+	    SendAck();
+	}
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::RetransmitLoop
+// 	The retransmitter thread: each time the timer says the oldest
+//	segment has waited too long, send every unacked segment again.
+//----------------------------------------------------------------------
+
+void
+Connection::RetransmitLoop()
+{
+    for (;;) {
+	timeout->P();
+	lock->Acquire();
+	if (base != nextSeq) {
+	    DEBUG('n', "Retransmitting segments %d to %d\n", base,
+			nextSeq - 1);
+	    for (int seq = base; seq < nextSeq; seq++) {
+		SendSegment(&unacked[seq % MaxWindow]);
+		stats->numRetransmits++;
+	    }
+	    retransmitAt = stats->totalTicks + RetransmitTime;
+	    StartTimer(RetransmitTime);
+	}
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// Connection::TimerExpired
+// 	Retransmission timer interrupt handler.  If something is still
+//	unacked and its time has come, wake up the retransmitter;
+//	otherwise, if an ack has moved retransmitAt later, wait until
+//	then.
+//----------------------------------------------------------------------
+
+void
+Connection::TimerExpired()
+{
+    timerPending = FALSE;
+    if (base == nextSeq)
+	return;				// everything got through
+    if (stats->totalTicks >= retransmitAt)
+	timeout->V();
+    else
+	StartTimer((int) (retransmitAt - stats->totalTicks));
+}
+
+//----------------------------------------------------------------------
+// Connection::LingerOver
+// 	Linger timer interrupt handler: let Close return.
+//----------------------------------------------------------------------
+
+void
+Connection::LingerOver()
+{
+    lingering->V();
+}
+
+//----------------------------------------------------------------------
+// Connection::StartTimer
+// 	Schedule the retransmission timer "ticks" from now, unless it is
+//	already scheduled.
+//----------------------------------------------------------------------
+
+void
+Connection::StartTimer(int ticks)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (!timerPending) {
+	timerPending = TRUE;
+	interrupt->Schedule(RetransmitTimer, (int) this, ticks, TransportInt);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Connection::SendSegment, Connection::SendAck
+// 	Put a segment (or an ack) in a message to the other end's mailbox,
+//	and give it to the post office.  Called with the lock held.
+//----------------------------------------------------------------------
+
+void
+Connection::SendSegment(SegmentBuffer *seg)
+{
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+
+    pktHdr.to = farAddr;
+    mailHdr.to = farBox;
+    mailHdr.from = localBox;
+    mailHdr.length = sizeof(SegmentHeader) + seg->hdr.length;
+    postOffice->Send(pktHdr, mailHdr, (char *) seg);
+}
+
+void
+Connection::SendAck()
+{
+    SegmentBuffer ack;
+
+    ack.hdr.type = SegAck;
+    ack.hdr.last = FALSE;
+    ack.hdr.length = 0;
+    ack.hdr.seq = expected;
+    SendSegment(&ack);
+}
+
+//----------------------------------------------------------------------
+// Connection::Deliver
+// 	Add the data of the segment we expected to the message being put
+//	together; if it was the message's last segment, the message is
+//	ready to be received.  Called with the lock held.
+//----------------------------------------------------------------------
+
+void
+Connection::Deliver(char *data, int length, bool last)
+{
+    if (partialLength + length > partialSize) {
+	char *bigger = new char[2 * partialSize];
+
+	bcopy(partial, bigger, partialLength);
+	delete [] partial;
+	partial = bigger;
+	partialSize *= 2;
+    }
+    bcopy(data, &partial[partialLength], length);
+    partialLength += length;
+    if (last) {
+	Message *message = new Message;
+
+	message->length = partialLength;
+	message->data = new char[max(partialLength, 1)];
+	bcopy(partial, message->data, partialLength);
+	messages->Append((void *) message);
+	partialLength = 0;
+    }
+}
@@ -0,0 +1,119 @@
+// transport.h
+//	Data structures for reliable, ordered delivery of messages of any
+//	length between two mailboxes, on top of the post office.
+//
+//	The post office may drop messages, and a message must fit in one
+//	packet.  A Connection cuts each message into segments that do
+//	fit, numbers them, and keeps sending them until the other end
+//	acknowledges them.  The other end only accepts the segment it
+//	expects next, and acknowledges the highest one it has got so far
+//	(a "cumulative" ack), so segments are delivered once each, in
+//	order.
+//
+//	Up to "window" segments may be waiting for their ack at once.
+//	If the oldest of them isn't acked within RetransmitTime ticks,
+//	all of them are sent again ("go back N").
+//
+//	Each end of a connection has a mailbox of its own, which it
+//	uses for both data and acks.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "post.h"
+
+#define SegData		0		// segment types
+#define SegAck		1
+
+#define MaxWindow	16		// largest window allowed
+#define DefaultWindow	4		// segments in flight, by default
+#define RetransmitTime	(100 * NetworkTime)	// ticks to wait for an ack
+#define LingerTime	(2 * RetransmitTime)	// ticks Close keeps acking
+					// the other end's retransmissions
+
+// The header the connection puts in front of each segment's data, in
+// the post office's message.
+
+class SegmentHeader {
+  public:
+    unsigned char type;			// SegData or SegAck
+    unsigned char last;			// last segment of a message?
+    unsigned short length;		// bytes of data that follow
+    int seq;				// SegData: this segment's number;
+					// SegAck: the next one expected
+};
+
+#define MaxSegmentData	(MaxMailSize - sizeof(SegmentHeader))
+
+// A segment sent, kept until it is acknowledged.
+
+class SegmentBuffer {
+  public:
+    SegmentHeader hdr;
+    char data[MaxSegmentData];
+};
+
+// The following class defines one end of a reliable connection.
+
+class Connection {
+  public:
+    Connection(NetworkAddress to, MailBoxAddress toBox,
+		MailBoxAddress fromBox, int size = DefaultWindow);
+					// Talk to "toBox" on machine
+					// "to", from "fromBox" here
+    ~Connection();
+
+    void Send(char *data, int length);	// Send a message; returns once
+					// its last segment has been sent
+					// (not acked)
+    int Receive(char *into, int size);	// Wait for the next message, and
+					// return its length (at most "size")
+    void Close();			// Wait until everything we sent is
+					// acked, and linger a while
+
+    void ReceiveLoop();			// The receiver thread's work
+    void RetransmitLoop();		// The retransmitter thread's work
+    void TimerExpired();		// Called by the retransmission
+					// timer interrupt handler
+    void LingerOver();			// ... and the linger one
+
+  private:
+    void SendSegment(SegmentBuffer *seg);	// Hand a segment to the 
+					// post office
+    void SendAck();			// Tell the other end what we expect
+    void StartTimer(int ticks);		// Make sure the retransmission
+					// timer will go off
+    void Deliver(char *data, int length, bool last);
+					// Add an in-order segment to the
+					// message being put together
+
+    NetworkAddress farAddr;		// The other end
+    MailBoxAddress farBox;
+    MailBoxAddress localBox;		// Our end
+    int window;				// Most segments in flight
+
+    SegmentBuffer unacked[MaxWindow];	// Segments base..nextSeq-1, by
+					// seq % MaxWindow
+    int base;				// Oldest segment not acked yet
+    int nextSeq;			// Number of the next one to send
+    long long retransmitAt;		// When to send them all again
+    bool timerPending;			// Is a timer interrupt scheduled?
+
+    int expected;			// Next segment to accept
+    char *partial;			// Message being put together
+    int partialLength, partialSize;
+    SynchList *messages;		// Whole messages, not yet received
+
+    Lock *lock;				// Protects all of the above
+    Condition *windowOpen;		// Signalled when segments are acked
+    Semaphore *timeout;			// V'ed when it's time to retransmit
+    Semaphore *lingering;		// V'ed when Close may return
+};
+
+#endif // TRANSPORT_H
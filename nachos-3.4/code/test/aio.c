@@ -0,0 +1,57 @@
+/* aio.c
+ *	Exercise asynchronous I/O: write a file with several AioWrites in
+ *	flight at once, then read it back the same way, computing while
+ *	the reads are under way.  Exits with the number of the first check
+ *	that failed, or 0.
+ */
+
+#include "syscall.h"
+
+#define Blocks	4
+#define Chunk	512
+
+char out[Blocks][Chunk], in[Blocks][Chunk];
+AioBlock blocks[Blocks];
+int ids[Blocks];
+
+int
+main()
+{
+    OpenFileId f;
+    int b, i, busy = 0;
+
+    Create("aiofile");
+    f = Open("aiofile");
+    for (b = 0; b < Blocks; b++) {
+	for (i = 0; i < Chunk; i++)
+	    out[b][i] = b + i;
+	blocks[b].file = f;
+	blocks[b].position = b * Chunk;
+	blocks[b].buffer = out[b];
+	blocks[b].size = Chunk;
+	if ((ids[b] = AioWrite(&blocks[b])) < 0)
+	    Exit(1);
+    }
+    for (b = 0; b < Blocks; b++)
+	if (AioWait(ids[b]) != Chunk)
+	    Exit(2);
+
+    for (b = Blocks - 1; b >= 0; b--) {	/* backwards, for the scheduler */
+	blocks[b].buffer = in[b];
+	if ((ids[b] = AioRead(&blocks[b])) < 0)
+	    Exit(3);
+    }
+    while (AioPoll(ids[0]) == 0)	/* something to overlap with */
+	busy++;
+    for (b = 0; b < Blocks; b++)
+	if (AioWait(ids[b]) != Chunk)
+	    Exit(4);
+    for (b = 0; b < Blocks; b++)
+	for (i = 0; i < Chunk; i++)
+	    if (in[b][i] != out[b][i])
+		Exit(5);
+    if (AioPoll(ids[0]) != -1)		/* waited for, so forgotten */
+	Exit(6);
+    Close(f);
+    Exit(0);
+}
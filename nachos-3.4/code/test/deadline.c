@@ -0,0 +1,37 @@
+/* deadline.c
+ *	Exercise the real-time class: join it as a periodic task, run a
+ *	job each period, and sleep until the next.  Run it beside other
+ *	programs (with a time slice, -q, so overruns are caught), and see
+ *	the rt.* statistics for missed deadlines.  Exits with the number
+ *	of the first check that failed, or 0.
+ */
+
+#include "syscall.h"
+
+#define Period		2000
+#define Deadline	1000
+#define Cost		400
+#define Jobs		20
+
+int work[64];
+
+int
+main()
+{
+    int j, i;
+
+    if (RealTime(Period, Deadline, Cost) != 0)
+	Exit(1);
+    if (RealTime(Period, Period, Period) != -1)	/* a whole CPU: too much */
+	Exit(2);
+    if (RealTime(Period, Period + 1, Cost) != -1)	/* due too late */
+	Exit(3);
+    for (j = 0; j < Jobs; j++) {
+	for (i = 0; i < 64; i++)		/* the job */
+	    work[i] += i * j;
+	Sleep(Period);				/* ... then wait for the next */
+    }
+    if (RealTime(0, 0, 0) != 0)
+	Exit(4);
+    Exit(0);
+}
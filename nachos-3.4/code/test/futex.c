@@ -0,0 +1,74 @@
+/* futex.c
+ *	Two processes add to a counter in shared memory, under a lock made
+ *	of CompareAndSwap, Wait and Wake: taking a free lock, or giving
+ *	one back that nobody waits for, never calls the kernel.  Exits
+ *	with 0 if no increment was lost.
+ */
+
+#include "syscall.h"
+
+#define Rounds	500
+
+/* 0: free, 1: held, 2: held, and someone may be waiting */
+typedef struct {
+    int lock;
+    int counter;
+} Shared;
+
+Shared *shared;
+
+void
+Acquire(int *lock)
+{
+    int c = CompareAndSwap(lock, 0, 1);
+
+    while (c != 0) {
+	if (c == 2 || CompareAndSwap(lock, 1, 2) != 0)
+	    Wait(lock, 2);
+	c = CompareAndSwap(lock, 0, 2);
+    }
+}
+
+void
+Release(int *lock)
+{
+    if (CompareAndSwap(lock, 1, 0) != 1) {	/* there may be waiters */
+	*lock = 0;
+	Wake(lock, 1);
+    }
+}
+
+void
+Count()
+{
+    int i, c;
+
+    for (i = 0; i < Rounds; i++) {
+	Acquire(&shared->lock);
+	c = shared->counter;
+	Yield();			/* let the other one try */
+	shared->counter = c + 1;
+	Release(&shared->lock);
+    }
+}
+
+void
+Child()
+{
+    Count();
+    Exit(0);
+}
+
+int
+main()
+{
+    int child;
+
+    shared = (Shared *) ShmAttach(1, sizeof(Shared));
+    if (shared == (Shared *) -1)
+	Exit(1);
+    child = Fork(Child);
+    Count();
+    Join(child);
+    Exit(shared->counter == 2 * Rounds ? 0 : 2);
+}
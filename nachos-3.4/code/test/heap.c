@@ -0,0 +1,42 @@
+/* heap.c
+ *	Exercise Sbrk and malloc: new heap memory must read as zeroes, and
+ *	blocks must not overlap.  Exits with the number of the first check
+ *	that failed, or 0.
+ */
+
+#include "syscall.h"
+
+#define NumBlocks	64
+#define BlockSize	200
+
+int *blocks[NumBlocks];
+
+int
+main()
+{
+    char *p;
+    int i, j;
+
+    if (Sbrk(-1) != (void *) -1)
+	Exit(1);
+    p = (char *) Sbrk(8192);		/* two whole pages, and more */
+    if (p == (char *) -1)
+	Exit(2);
+    for (i = 0; i < 8192; i++)
+	if (p[i] != 0)
+	    Exit(3);
+    for (i = 0; i < NumBlocks; i++) {
+	blocks[i] = (int *) malloc(BlockSize * sizeof(int));
+	if (blocks[i] == 0 || ((int) blocks[i] & 7) != 0)
+	    Exit(4);
+	for (j = 0; j < BlockSize; j++)
+	    blocks[i][j] = i;
+    }
+    for (i = 0; i < NumBlocks; i++) {
+	for (j = 0; j < BlockSize; j++)
+	    if (blocks[i][j] != i)
+		Exit(5);
+	free(blocks[i]);
+    }
+    Exit(0);
+}
@@ -0,0 +1,46 @@
+/* mapfile.c
+ *	Exercise Mmap: write a file, map it, check and change it through
+ *	memory, unmap it, and read the changes back with Read.  Exits
+ *	with the number of the first check that failed, or 0.
+ */
+
+#include "syscall.h"
+
+#define Size	1000
+
+char buffer[Size];
+
+int
+main()
+{
+    OpenFileId f;
+    char *p;
+    int i;
+
+    for (i = 0; i < Size; i++)
+	buffer[i] = i;
+    Create("mapped");
+    f = Open("mapped");
+    Write(buffer, Size, f);
+    Close(f);
+
+    p = (char *) Mmap("mapped", Size);
+    if (p == (char *) -1)
+	Exit(1);
+    for (i = 0; i < Size; i++)
+	if (p[i] != (char) i)
+	    Exit(2);
+    for (i = 0; i < Size; i += 2)
+	p[i] = 0;
+    if (Munmap(p) != 0 || Munmap(p) != -1)
+	Exit(3);
+
+    f = Open("mapped");
+    if (Read(buffer, Size, f) != Size)
+	Exit(4);
+    for (i = 0; i < Size; i++)
+	if (buffer[i] != ((i % 2 == 0) ? 0 : (char) i))
+	    Exit(5);
+    Close(f);
+    Exit(0);
+}
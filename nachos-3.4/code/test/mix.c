@@ -0,0 +1,22 @@
+/* mix.c
+ *	Run several programs at once, for the benchmarks (see ../bench):
+ *	sort and two matrix multiplications compete for the CPU and for
+ *	physical memory.
+ */
+
+#include "syscall.h"
+
+int
+main()
+{
+    SpaceId a, b, c;
+
+    a = Exec("../test/sort");
+    b = Exec("../test/matmult");
+    c = Exec("../test/matmult");
+    Join(a);
+    Join(b);
+    Join(c);
+    Halt();
+    /* not reached */
+}
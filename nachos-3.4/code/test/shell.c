@@ -1,13 +1,17 @@
 #include "syscall.h"
 
+#define MaxStages	4
+
 int
 main()
 {
-    SpaceId newProc;
+    SpaceId procs[MaxStages];
     OpenFileId input = ConsoleInput;
     OpenFileId output = ConsoleOutput;
+    OpenFileId ends[2], from, to;
     char prompt[2], ch, buffer[60];
-    int i;
+    char *stages[MaxStages];
+    int i, n, s;
 
     prompt[0] = '-';
     prompt[1] = '-';
@@ -26,10 +30,36 @@ main()
 
 	buffer[--i] = '\0';
 
-	if( i > 0 ) {
-		newProc = Exec(buffer);
-		Join(newProc);
+	/* "a | b | c": split the line into stages, without the blanks */
+	n = 0;
+	for (i = 0; buffer[i] != '\0' && n < MaxStages; ) {
+	    while (buffer[i] == ' ')
+		i++;
+	    stages[n++] = &buffer[i];
+	    while (buffer[i] != '\0' && buffer[i] != '|')
+		i++;
+	    for (s = i; s > 0 && buffer[s - 1] == ' '; s--)
+		;
+	    if (buffer[i] == '|')
+		i++;
+	    buffer[s] = '\0';
+	}
+
+	/* each stage reads the pipe from the one before, and writes a
+	   new pipe to the one after; we keep none of the ends */
+	from = input;
+	for (s = 0; s < n; s++) {
+	    to = output;
+	    if (s < n - 1 && Pipe(ends) == 0)
+		to = ends[1];
+	    procs[s] = ExecPiped(stages[s], from, to);
+	    if (from != input)
+		Close(from);
+	    if (to != output)
+		Close(to);
+	    from = (to != output) ? ends[0] : input;
 	}
+	for (s = 0; s < n; s++)
+	    Join(procs[s]);
     }
 }
-
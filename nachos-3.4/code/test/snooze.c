@@ -0,0 +1,41 @@
+/* snooze.c
+ *	While the parent Sleeps, a child counts in shared memory: a
+ *	sleeping process must leave the CPU to the others, instead of
+ *	taking turns at it as a Yield loop would.  Exits with 0 if the
+ *	child got to count.
+ */
+
+#include "syscall.h"
+
+typedef struct {
+    int done;
+    int counter;
+} Shared;
+
+Shared *shared;
+
+void
+Child()
+{
+    while (!shared->done) {
+	shared->counter++;
+	Yield();		/* for when nothing preempts us */
+    }
+    Exit(0);
+}
+
+int
+main()
+{
+    int child;
+
+    shared = (Shared *) ShmAttach(2, sizeof(Shared));
+    if (shared == (Shared *) -1)
+	Exit(1);
+    child = Fork(Child);
+    if (Sleep(5000) != 0)
+	Exit(2);
+    shared->done = 1;
+    Join(child);
+    Exit(shared->counter > 0 ? 0 : 3);
+}
@@ -0,0 +1,34 @@
+/* spawn.c
+ *	Starts copies of itself with ExecV and SpawnMany, which must get
+ *	the arguments they were given.  A copy exits with 0 if its argv
+ *	is { "spawn", "<digit>" }; the first one exits with 0 if every 
+ *	copy did.
+ */
+
+#include "syscall.h"
+
+#define Copies	4
+
+int
+main(int argc, char **argv)
+{
+    char *args[3];
+    SpaceId ids[Copies];
+    int i, failed = 0;
+
+    if (argc > 0)		/* a copy */
+	Exit(!(argc == 2 && argv[2] == 0 && argv[0][0] == 's'
+	       && argv[1][0] >= '0' && argv[1][0] <= '9'));
+
+    args[0] = "spawn";
+    args[1] = "7";
+    args[2] = 0;
+    if (Join(ExecV("spawn", args)) != 0)
+	failed = 1;
+    if (SpawnMany("spawn", Copies, ids) != Copies)
+	Exit(2);
+    for (i = 0; i < Copies; i++)
+	if (Join(ids[i]) != 0)
+	    failed = 1;
+    Exit(failed);
+}
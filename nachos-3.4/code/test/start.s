@@ -130,6 +130,273 @@ Yield:
 	j	$31
 	.end Yield
 
+	.globl ExecTickets
+	.ent	ExecTickets
+ExecTickets:
+	addiu $2,$0,SC_ExecTickets
+	syscall
+	j	$31
+	.end ExecTickets
+
+	.globl Send
+	.ent	Send
+Send:
+	addiu $2,$0,SC_Send
+	syscall
+	j	$31
+	.end Send
+
+	.globl Receive
+	.ent	Receive
+Receive:
+	addiu $2,$0,SC_Receive
+	syscall
+	j	$31
+	.end Receive
+
+	.globl SendNB
+	.ent	SendNB
+SendNB:
+	addiu $2,$0,SC_SendNB
+	syscall
+	j	$31
+	.end SendNB
+
+	.globl ReceiveNB
+	.ent	ReceiveNB
+ReceiveNB:
+	addiu $2,$0,SC_ReceiveNB
+	syscall
+	j	$31
+	.end ReceiveNB
+
+	.globl Sbrk
+	.ent	Sbrk
+Sbrk:
+	addiu $2,$0,SC_Sbrk
+	syscall
+	j	$31
+	.end Sbrk
+
+	.globl Mmap
+	.ent	Mmap
+Mmap:
+	addiu $2,$0,SC_Mmap
+	syscall
+	j	$31
+	.end Mmap
+
+	.globl Munmap
+	.ent	Munmap
+Munmap:
+	addiu $2,$0,SC_Munmap
+	syscall
+	j	$31
+	.end Munmap
+
+	.globl ShmAttach
+	.ent	ShmAttach
+ShmAttach:
+	addiu $2,$0,SC_ShmAttach
+	syscall
+	j	$31
+	.end ShmAttach
+
+	.globl Wait
+	.ent	Wait
+Wait:
+	addiu $2,$0,SC_Wait
+	syscall
+	j	$31
+	.end Wait
+
+	.globl Wake
+	.ent	Wake
+Wake:
+	addiu $2,$0,SC_Wake
+	syscall
+	j	$31
+	.end Wake
+
+	.globl Pipe
+	.ent	Pipe
+Pipe:
+	addiu $2,$0,SC_Pipe
+	syscall
+	j	$31
+	.end Pipe
+
+	.globl ExecPiped
+	.ent	ExecPiped
+ExecPiped:
+	addiu $2,$0,SC_ExecPiped
+	syscall
+	j	$31
+	.end ExecPiped
+
+	.globl Sleep
+	.ent	Sleep
+Sleep:
+	addiu $2,$0,SC_Sleep
+	syscall
+	j	$31
+	.end Sleep
+
+	.globl ExecV
+	.ent	ExecV
+ExecV:
+	addiu $2,$0,SC_ExecV
+	syscall
+	j	$31
+	.end ExecV
+
+	.globl SpawnMany
+	.ent	SpawnMany
+SpawnMany:
+	addiu $2,$0,SC_SpawnMany
+	syscall
+	j	$31
+	.end SpawnMany
+
+	.globl AioRead
+	.ent	AioRead
+AioRead:
+	addiu $2,$0,SC_AioRead
+	syscall
+	j	$31
+	.end AioRead
+
+	.globl AioWrite
+	.ent	AioWrite
+AioWrite:
+	addiu $2,$0,SC_AioWrite
+	syscall
+	j	$31
+	.end AioWrite
+
+	.globl AioWait
+	.ent	AioWait
+AioWait:
+	addiu $2,$0,SC_AioWait
+	syscall
+	j	$31
+	.end AioWait
+
+	.globl AioPoll
+	.ent	AioPoll
+AioPoll:
+	addiu $2,$0,SC_AioPoll
+	syscall
+	j	$31
+	.end AioPoll
+
+	.globl RealTime
+	.ent	RealTime
+RealTime:
+	addiu $2,$0,SC_RealTime
+	syscall
+	j	$31
+	.end RealTime
+
+/* -------------------------------------------------------------
+ * CompareAndSwap
+ *	If the word at r4 holds r5, store r6 there; either way, return
+ *	what it held.  LL and SC make it atomic: SC fails, and we try
+ *	again, if the kernel ran in between.  Loads are delayed on this
+ *	machine, hence the nop.
+ * -------------------------------------------------------------
+ */
+
+	.globl CompareAndSwap
+	.ent	CompareAndSwap
+CompareAndSwap:
+	ll	$2,0($4)
+	nop
+	bne	$2,$5,CasDone
+	move	$8,$6
+	sc	$8,0($4)
+	beq	$8,$0,CompareAndSwap	/* lost the link: try again */
+CasDone:
+	j	$31
+	.end CompareAndSwap
+
+/* -------------------------------------------------------------
+ * malloc, free
+ *	A bump allocator: memory is handed out from an "arena" of heap,
+ *	[arenaNext, arenaEnd), which is grown with Sbrk, at least 
+ *	ArenaChunk bytes at a time, when a request doesn't fit.  If
+ *	somebody else moved the end of the heap meanwhile, the arena
+ *	starts over at the new memory.  Nothing is ever given back, so
+ *	free does nothing.
+ *
+ *	Uses only r2, r4, r5 and the temporaries r8-r13, which the
+ *	kernel leaves alone across the Sbrk system call.
+ * -------------------------------------------------------------
+ */
+
+#define ArenaChunk	1024
+
+	.globl malloc
+	.ent	malloc
+malloc:
+	addiu	$4,$4,7			/* round the size up to 8 */
+	li	$8,-8
+	and	$4,$4,$8
+	lui	$8,%hi(arenaNext)
+	lw	$9,%lo(arenaNext)($8)
+	lui	$8,%hi(arenaEnd)
+	lw	$10,%lo(arenaEnd)($8)
+	addu	$11,$9,$4
+	sltu	$12,$10,$11
+	bne	$12,$0,MallocGrow	/* doesn't fit */
+	lui	$8,%hi(arenaNext)
+	sw	$11,%lo(arenaNext)($8)
+	move	$2,$9
+	j	$31
+MallocGrow:
+	move	$13,$4			/* ask for max(size, ArenaChunk), */
+	li	$5,ArenaChunk
+	sltu	$12,$4,$5
+	beq	$12,$0,MallocSbrk
+	move	$4,$5
+MallocSbrk:
+	addiu	$4,$4,8			/* ... and a little to align with */
+	addiu	$2,$0,SC_Sbrk
+	syscall
+	li	$12,-1
+	beq	$2,$12,MallocFail
+	beq	$2,$10,MallocTake	/* just past the old arena? */
+	addiu	$9,$2,7			/* no: start over, aligned */
+	li	$8,-8
+	and	$9,$9,$8
+MallocTake:
+	addu	$10,$2,$4		/* the new end of the arena */
+	lui	$8,%hi(arenaEnd)
+	sw	$10,%lo(arenaEnd)($8)
+	addu	$11,$9,$13
+	lui	$8,%hi(arenaNext)
+	sw	$11,%lo(arenaNext)($8)
+	move	$2,$9
+	j	$31
+MallocFail:
+	move	$2,$0
+	j	$31
+	.end malloc
+
+	.globl free
+	.ent	free
+free:
+	j	$31
+	.end free
+
+	.data
+	.align	2
+arenaNext:
+	.word	0
+arenaEnd:
+	.word	0
+
+	.text
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -0,0 +1,116 @@
+// alarm.cc
+//	Routines to put threads to sleep for a while.  See alarm.h.
+//
+//	The sleep queue is only touched with interrupts off, since the
+//	interrupt handler takes threads off it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "alarm.h"
+
+//----------------------------------------------------------------------
+// AlarmHandler
+// 	Interrupt handler for the alarm's own one-shot interrupt.
+//
+//	"arg" -- pointer to the Alarm
+//----------------------------------------------------------------------
+
+static void
+AlarmHandler(int arg)
+{
+    Alarm *a = (Alarm *) arg;
+
+    a->WakeDue();
+}
+
+Alarm::Alarm()
+{
+    sleepers = NULL;
+    nextInterrupt = NeverDue;
+    numSleeps = 0;
+    stats->Register("alarm.sleeps", &numSleeps);
+}
+
+//----------------------------------------------------------------------
+// Alarm::WaitUntil
+// 	Put the current thread to sleep until simulated time reaches
+//	"when"; returns at once if it already has.  The thread is off the
+//	ready list meanwhile, so it costs the others nothing.
+//----------------------------------------------------------------------
+
+void
+Alarm::WaitUntil(long long when)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Sleeper self, **p;
+
+    if (when <= stats->totalTicks) {
+	(void) interrupt->SetLevel(oldLevel);
+	return;
+    }
+    self.thread = currentThread;
+    self.when = when;
+    for (p = &sleepers; *p != NULL && (*p)->when <= when; p = &(*p)->next)
+	;				// after those due at the same time
+    self.next = *p;
+    *p = &self;
+    numSleeps++;
+    DEBUG('t', "Thread \"%s\" sleeping until tick %lld\n",
+		currentThread->getName(), when);
+
+    // Without the timer, nothing else would wake us.  An interrupt
+    // already due sooner will set up the next one.
+    if (timer == NULL && when < nextInterrupt) {
+	nextInterrupt = when;
+	interrupt->Schedule(AlarmHandler, (int) this,
+			(int) (when - stats->totalTicks), AlarmInt);
+    }
+    currentThread->Sleep();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Alarm::Pause
+// 	Sleep for "ticks" ticks; 0 or less doesn't sleep at all.
+//----------------------------------------------------------------------
+
+void
+Alarm::Pause(int ticks)
+{
+    WaitUntil(stats->totalTicks + ticks);
+}
+
+//----------------------------------------------------------------------
+// Alarm::WakeDue
+// 	Put every thread whose time has come back on the ready list.
+//	Called from the timer interrupt handler and from our own, with
+//	interrupts off.  If our interrupt is the one that went off, and
+//	threads are still sleeping, schedule it again for the first.
+//----------------------------------------------------------------------
+
+void
+Alarm::WakeDue()
+{
+    long long now = stats->totalTicks;
+
+    while (sleepers != NULL && sleepers->when <= now) {
+	Sleeper *s = sleepers;
+
+	sleepers = s->next;
+	DEBUG('t', "Waking thread \"%s\", due at tick %lld\n",
+		s->thread->getName(), s->when);
+	scheduler->ReadyToRun(s->thread);
+    }
+    if (nextInterrupt <= now) {
+	nextInterrupt = NeverDue;
+	if (sleepers != NULL && timer == NULL) {
+	    nextInterrupt = sleepers->when;
+	    interrupt->Schedule(AlarmHandler, (int) this,
+			(int) (sleepers->when - now), AlarmInt);
+	}
+    }
+}
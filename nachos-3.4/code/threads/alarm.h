@@ -0,0 +1,51 @@
+// alarm.h
+//	Data structures for letting threads sleep for a while, instead of
+//	calling Yield over and over until enough time has gone by.
+//
+//	Sleeping threads are kept in a queue sorted by when they are to
+//	wake up, and are woken by the timer interrupt handler.  The timer
+//	only runs when the scheduler needs one (-rs, -q, and the
+//	preemptive policies); without it, the alarm schedules a one-shot
+//	interrupt of its own for the first sleeper.  With the timer, a
+//	thread wakes on the first timer interrupt after its time.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#include "copyright.h"
+#include "thread.h"
+
+// A thread waiting in WaitUntil.  It lives on that thread's stack.
+
+class Sleeper {
+  public:
+    Thread *thread;
+    long long when;			// tick to wake up at
+    Sleeper *next;			// the next one to wake up
+};
+
+// The following class defines the queue of sleeping threads.
+
+class Alarm {
+  public:
+    Alarm();				// Nobody is sleeping
+
+    void WaitUntil(long long when);	// Sleep until totalTicks is "when"
+    void Pause(int ticks);		// Sleep for "ticks" ticks
+    void WakeDue();			// Wake every sleeper whose time has
+					// come; interrupt handlers only
+
+    long long numSleeps;		// WaitUntil calls that slept,
+					// registered as "alarm.sleeps"
+
+  private:
+    Sleeper *sleepers;			// sorted by "when", earliest first
+    long long nextInterrupt;		// when our own interrupt is due,
+					// NeverDue if none is
+};
+
+#endif // ALARM_H
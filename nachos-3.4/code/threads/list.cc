@@ -17,6 +17,7 @@
 
 #include "copyright.h"
 #include "list.h"
+#include "slab.h"
 
 //----------------------------------------------------------------------
 // ListElement::ListElement
@@ -34,6 +35,25 @@ ListElement::ListElement(void *itemPtr, int sortKey)
      next = NULL;	// assume we'll put it at the end of the list 
 }
 
+//----------------------------------------------------------------------
+// ListElement::operator new, ListElement::operator delete
+// 	List elements come from a cache of their own (see slab.h).
+//----------------------------------------------------------------------
+
+static SlabCache elementCache("list", sizeof(ListElement));
+
+void *
+ListElement::operator new(size_t size)
+{
+    return elementCache.Alloc(size);
+}
+
+void
+ListElement::operator delete(void *p)
+{
+    elementCache.Free(p);
+}
+
 //----------------------------------------------------------------------
 // List::List
 //	Initialize a list, empty to start with.
@@ -127,10 +147,30 @@ List::Prepend(void *item)
 void *
 List::Remove()
 {
-	size--;
     return SortedRemove(NULL);  // Same as SortedRemove, but ignore the key
 }
 
+//----------------------------------------------------------------------
+// List::SortedPeek
+//      Look at the key of the first element of a sorted list, without
+//	changing the list.
+//
+// Returns:
+//	FALSE if the list is empty, otherwise TRUE (and the smallest key
+//	is stored in *keyPtr).
+//
+//	"keyPtr" is where to store the key of the first element
+//----------------------------------------------------------------------
+
+bool
+List::SortedPeek(int *keyPtr)
+{
+    if (IsEmpty())
+	return FALSE;
+    *keyPtr = first->key;
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // List::Mapcar
 //	Apply a function to each item on the list, by walking through  
@@ -185,6 +225,7 @@ List::SortedInsert(void *item, int sortKey)
     ListElement *element = new ListElement(item, sortKey);
     ListElement *ptr;		// keep track
 
+    size++;
     if (IsEmpty()) {	// if list is empty, put
         first = element;
         last = element;
@@ -237,6 +278,7 @@ List::SortedRemove(int *keyPtr)
     if (keyPtr != NULL)
         *keyPtr = element->key;
     delete element;
+    size--;
     return thing;
 }
 
@@ -27,6 +27,8 @@
 class ListElement {
    public:
      ListElement(void *itemPtr, int sortKey);	// initialize a list element
+     void *operator new(size_t size);	// From a SlabCache: one is made
+     void operator delete(void *p);	// and freed for every Append
 
      ListElement *next;		// next element on list, 
 				// NULL if this is the last
@@ -57,6 +59,8 @@ class List {
     // Routines to put/get items on/off list in order (sorted by key)
     void SortedInsert(void *item, int sortKey);	// Put item into list
     void *SortedRemove(int *keyPtr); 	  	// Remove first item from list
+    bool SortedPeek(int *keyPtr);		// Look at first key, without
+						// removing anything
 	int getSize(){return size;}
 
   private:
@@ -65,4 +69,141 @@ class List {
 	int size;
 };
 
+// The following class defines an "intrusive" list: instead of a
+// ListElement being allocated for each item, the links are fields of
+// the items themselves.  Adding and removing never allocates, and an
+// item can be taken out of the middle of the list in constant time.
+// In exchange, an item can be on only one such list at a time.
+//
+// A class T to be kept on an IntrusiveList<T> must have the public
+// fields
+//	T *listNext, *listPrev;		// neighbours, NULL at the ends
+//	int listKey;			// priority, for a sorted list
+// Threads (on the ready list, or waiting on a synchronization variable) 
+// are kept this way.
+
+template <class T>
+class IntrusiveList {
+  public:
+    IntrusiveList() { first = last = NULL; size = 0; }
+
+    void Prepend(T *item); 	// Put item at the beginning of the list
+    void Append(T *item); 	// Put item at the end of the list
+    T *Remove(); 	 	// Take item off the front of the list
+    void Detach(T *item);	// Take item out of the list, which it 
+				// must be on
+
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every item
+    bool IsEmpty() { return first == NULL; }
+    int getSize() { return size; }
+
+    void SortedInsert(T *item, int sortKey);	// Put item into list
+    T *SortedRemove(int *keyPtr); 	  	// Remove first item from list
+    bool SortedPeek(int *keyPtr);		// Look at first key
+
+  private:
+    void InsertAfter(T *prev, T *item);	// "prev" NULL means at the front
+
+    T *first;  			// Head of the list, NULL if list is empty
+    T *last;			// Last item on the list
+    int size;			// number of items on the list
+};
+
+// Templates have to be defined where they are used, so the routines
+// are here rather than in list.cc.
+
+template <class T> void
+IntrusiveList<T>::InsertAfter(T *prev, T *item)
+{
+    item->listPrev = prev;
+    item->listNext = (prev == NULL) ? first : prev->listNext;
+    if (item->listNext == NULL)
+	last = item;
+    else
+	item->listNext->listPrev = item;
+    if (prev == NULL)
+	first = item;
+    else
+	prev->listNext = item;
+    size++;
+}
+
+template <class T> void
+IntrusiveList<T>::Prepend(T *item)
+{
+    item->listKey = 0;
+    InsertAfter(NULL, item);
+}
+
+template <class T> void
+IntrusiveList<T>::Append(T *item)
+{
+    item->listKey = 0;
+    InsertAfter(last, item);
+}
+
+template <class T> T *
+IntrusiveList<T>::Remove()
+{
+    return SortedRemove(NULL);
+}
+
+template <class T> void
+IntrusiveList<T>::Detach(T *item)
+{
+    if (item->listPrev == NULL)
+	first = item->listNext;
+    else
+	item->listPrev->listNext = item->listNext;
+    if (item->listNext == NULL)
+	last = item->listPrev;
+    else
+	item->listNext->listPrev = item->listPrev;
+    item->listNext = item->listPrev = NULL;
+    size--;
+}
+
+template <class T> void
+IntrusiveList<T>::Mapcar(VoidFunctionPtr func)
+{
+    for (T *ptr = first; ptr != NULL; ptr = ptr->listNext)
+	(*func)((int) ptr);
+}
+
+// Keep the list sorted by increasing key: walk back from the end, so 
+// that items with equal keys stay in the order they were inserted.
+
+template <class T> void
+IntrusiveList<T>::SortedInsert(T *item, int sortKey)
+{
+    T *ptr;
+
+    item->listKey = sortKey;
+    for (ptr = last; ptr != NULL && sortKey < ptr->listKey; ptr = ptr->listPrev)
+	;
+    InsertAfter(ptr, item);
+}
+
+template <class T> T *
+IntrusiveList<T>::SortedRemove(int *keyPtr)
+{
+    T *item = first;
+
+    if (item == NULL)
+	return NULL;
+    if (keyPtr != NULL)
+	*keyPtr = item->listKey;
+    Detach(item);
+    return item;
+}
+
+template <class T> bool
+IntrusiveList<T>::SortedPeek(int *keyPtr)
+{
+    if (first == NULL)
+	return FALSE;
+    *keyPtr = first->listKey;
+    return TRUE;
+}
+
 #endif // LIST_H
@@ -8,20 +8,98 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+// Usage: nachos -d <debugflags> -db -rs <random seed #> -sp <policy>
+//		-q <time slice> -cpus <number of CPUs> -cq <CPU quantum> -dy
+//		-tr <trace file> -rec <input log> -rep <input log>
+//		-js <stats file> -wq <workers> -tb <threads>
+//		-irq <events,ticks>
+//		-s -B -ic <cost file> -prof <ticks> -M <policy> -rt <file>
+//		-l1i <size,line,ways> -l1d <size,line,ways>
+//		-x <nachos file> -c <consoleIn> <consoleOut>
+//		-f -dm -ds <snapshot> -dw <snapshot>
+//		-dg <tracks,sectors> -ssd -nd <disks>
+//		-cp <unix file> <nachos file>
+//		-p <nachos file> -r <nachos file> -l -D -t -fst <threads,bytes>
 //              -n <network reliability> -m <machine id>
-//              -o <other machine id>
+//              -o <other machine id> -ro <other machine id> -w <window>
+//              -nc <ticks> -nf <fabric file>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
+//    -db buffers the debugging messages: faster, but they are no longer
+//	 in order with the program's output
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -sp sets the scheduling policy: 0 FIFO, 1 multilevel feedback
+//	 queue, 2 stride scheduling (both preempt threads on timer
+//	 interrupts)
+//    -q preempts the running thread every this many ticks (round 
+//	 robin under FIFO; the top level's quantum under MLFQ)
+//    -cpus simulates this many CPUs, each with its own ready queues
+//	 (cf. threads/scheduler.h)
+//    -cq lets each CPU run this many instructions before the next one
+//	 takes its turn (default 1, lock step); faster, but less exact
+//    -dy makes a thread that blocks right after waking another switch
+//	 straight to it, handing over the rest of its time slice
+//	 (directed yield; cf. threads/scheduler.h)
+//    -ts sets how many stacks of finished threads are kept for reuse
+//	 (default 16)
+//    -tb times forking, Yield, semaphores, and a lock and a condition
+//	 shared by that many threads, in ticks and host nanoseconds
+//	 (cf. ThreadBenchmark in threads/threadtest.cc)
+//    -wq sets how many kernel threads run deferred work, such as the
+//	 pageout daemon's (default 2; cf. threads/workqueue.h)
+//    -tr writes a binary trace of context switches, page faults,
+//	 system calls and disk requests to a file (see bin/tracedump)
+//    -rec logs every console character and network packet taken in,
+//	 with its tick, to a file; -rep replays a run from such a log,
+//	 instead of polling the host (cf. machine/replay.h)
+//    -irq coalesces console and network input interrupts: the devices
+//	 take in everything that has arrived, and interrupt once there
+//	 are "events" new characters or packets, or the first of them is
+//	 "ticks" old (cf. machine/console.h, machine/network.h)
+//    -js writes every statistic, as JSON, to a file when Nachos exits,
+//	 and again each time the process gets SIGUSR1 (cf. machine/stats.h)
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -B runs user programs a basic block at a time (same timing as usual)
+//    -ic reads what each class of user instruction costs, in ticks,
+//	 and the penalties for TLB misses and page table walks, from a
+//	 file (cf. Machine::ReadCosts); by default every instruction
+//	 costs one tick
+//    -rt writes every page user programs reference (process, page, and
+//	 read or write) to a file, for bin/refsim to replay against the
+//	 replacement policies
+//    -l1i and -l1d simulate an L1 instruction or data cache, given as
+//	 "size,line size,ways" in bytes (e.g. -l1d 1024,16,2); each
+//	 process reports its hits and misses when it exits (cf. 
+//	 machine/memcache.h)
+//    -V sets the page replacement policy: 0 none, 1 FIFO, 2 random,
+//	 3 LRU, 4 clock, 5 enhanced clock
+//    -M sets how free frames are handed out: 1 first fit (default),
+//	 2 best fit, 3 worst fit, 4 buddy (cf. userprog/framealloc.h)
+//    -np sets the number of physical pages (default 32)
+//    -ps sets the page size in bytes (default the disk sector size)
+//    -tlb sets the number of TLB entries (VM, with USE_TLB)
+//    -tp sets the TLB replacement policy: 0 FIFO, 1 LRU, 2 clock
+//    -sup lets one TLB entry map up to this many pages (a power of
+//	 two) held in consecutive frames, and moves groups of pages that
+//	 keep missing in the TLB into such frames (VM, with USE_TLB)
+//    -pff gives each process a frame quota, set by its page fault
+//	 frequency, and suspends processes when memory is overcommitted
+//    -pt2 uses two-level page tables, so unused parts of a large
+//	 address space cost no page table memory
+//    -po starts a pageout daemon that keeps this many frames free
+//    -ksm merges pages with the same contents (zero pages, say) into
+//	 one copy-on-write frame, scanning every this many ticks
+//    -zs gives this percent of the frames to a compressed cache of
+//	 swapped-out pages, in front of the swap area (cf. swapcache.h)
+//    -ra sets the most pages read ahead on sequential page faults
+//	 (0 turns read-ahead off)
+//    -prof samples the PC of the running user program every this many
+//	 ticks; each process writes its samples to prof.<pid> when it
+//	 exits (see bin/profsym to map them to functions)
 //    -x runs a user program
 //    -c tests the console
 //
@@ -29,15 +107,36 @@
 //    -f causes the physical disk to be formatted
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
-//    -r removes a Nachos file from the file system
+//    -r removes a Nachos file (or empty directory) from the file system
+//    -md makes a Nachos directory; file names can be paths, "dir/file"
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -fst stresses the file system with that many threads at once, each
+//	 reading and writing that many bytes at a time
+//    -dm maps the DISK file into memory, instead of a system call per
+//	 disk request (same simulated timing, less host time)
+//    -ds saves a snapshot of DISK in a UNIX file when Nachos exits
+//    -dw starts from such a snapshot instead of the current DISK, so a
+//	 disk formatted and loaded once can start any number of runs
+//    -dg sets the disk's geometry: tracks, and sectors per track (at
+//	 least 32 of each; a DISK of another size must be removed first)
+//    -ssd times the disk as flash: no seeks, and FlashChannels sectors
+//	 at a time (cf. machine/disk.h)
+//    -nd simulates that many disks (at most 8): the file system stays
+//	 on DISK, and the swap area is striped over it and DISK1, DISK2...
 //
 //  NETWORK
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
 //    -o runs a simple test of the Nachos network software
+//    -ro runs the same exchange, with longer messages, over a reliable
+//	 connection (cf. network/transport.h)
+//    -w sets the connection window for -ro (default 4 segments)
+//    -nc packs small messages to the same machine into one packet,
+//	 holding a packet back up to this many ticks for more
+//    -nf reads each link's reliability and latency from a file
+//	 (cf. machine/network.h, and network/launch to start N machines)
 //
 //  NOTE -- flags are ignored until the relevant assignment.
 //  Some of the flags are interpreted here; some in system.cc.
@@ -52,13 +151,19 @@
 
 #include "utility.h"
 #include "system.h"
+#ifdef NETWORK
+#include "transport.h"
+#endif
 
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
+extern void ThreadBenchmark(int numThreads);
 extern void Print(char *file), PerformanceTest(void);
+extern void StressTest(int numThreads, int ioSize);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
+extern void ReliableMailTest(int networkID, int window);
 
 //----------------------------------------------------------------------
 // main
@@ -79,6 +184,9 @@ main(int argc, char **argv)
 {
     int argCount;			// the number of arguments 
 					// for a particular command
+#ifdef NETWORK
+    int window = DefaultWindow;		// for -ro
+#endif
 
     DEBUG('t', "Entering main");
     (void) Initialize(argc, argv);
@@ -91,6 +199,13 @@ main(int argc, char **argv)
 	argCount = 1;
         if (!strcmp(*argv, "-z"))               // print copyright
             printf (copyright);
+#ifdef THREADS
+	if (!strcmp(*argv, "-tb")) {		// thread microbenchmarks
+	    ASSERT(argc > 1);
+	    ThreadBenchmark(atoi(*(argv + 1)));
+	    argCount = 2;
+	}
+#endif
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-x")) {        	// run a user program
 	    ASSERT(argc > 1);
@@ -122,12 +237,25 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    fileSystem->Remove(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-md")) {	// make Nachos directory
+	    ASSERT(argc > 1);
+	    if (!fileSystem->Mkdir(*(argv + 1)))
+		printf("Can't make directory %s\n", *(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-l")) {	// list Nachos directory
             fileSystem->List();
 	} else if (!strcmp(*argv, "-D")) {	// print entire filesystem
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-fst")) {	// concurrent stress test
+	    int numThreads, ioSize, parsed;
+
+	    ASSERT(argc > 1);
+	    parsed = sscanf(*(argv + 1), "%d,%d", &numThreads, &ioSize);
+	    ASSERT(parsed == 2);
+	    StressTest(numThreads, ioSize);
+	    argCount = 2;
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -138,6 +266,15 @@ main(int argc, char **argv)
 						// start up another nachos
             MailTest(atoi(*(argv + 1)));
             argCount = 2;
+        } else if (!strcmp(*argv, "-w")) {
+	    ASSERT(argc > 1);
+	    window = atoi(*(argv + 1));
+	    argCount = 2;
+        } else if (!strcmp(*argv, "-ro")) {
+	    ASSERT(argc > 1);
+            Delay(2); 				// as for -o
+            ReliableMailTest(atoi(*(argv + 1)), window);
+            argCount = 2;
         }
 #endif // NETWORK
     }
@@ -4,15 +4,16 @@
 //
 // 	These routines assume that interrupts are already disabled.
 //	If interrupts are disabled, we can assume mutual exclusion
-//	(since we are on a uniprocessor).
+//	(since we are on a uniprocessor -- or, with -cpus, since the 
+//	simulated CPUs only take turns between user instructions).
 //
 // 	NOTE: We can't use Locks to provide mutual exclusion here, since
 // 	if we needed to wait for a lock, and the lock was busy, we would 
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Three policies: straight FIFO, a multilevel feedback queue, or
+//	stride scheduling (see scheduler.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,28 +25,84 @@
 
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
-// 	Initialize the list of ready but not running threads to empty.
+// 	Initialize the lists of ready but not running threads to empty.
+//
+//	"how" -- the scheduling policy
+//	"slice" -- the time slice, in ticks; the timer interrupts this often
+//	"cpus" -- how many CPUs to simulate; the thread calling us is
+//		running on the first one, and the others start out idle
+//	"turn" -- instructions each CPU runs per turn
+//	"yieldToWoken" -- hand the CPU to the thread just woken when
+//		the waker blocks
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(SchedPolicy how, int slice, int cpus, int turn,
+		     bool yieldToWoken)
 { 
-    readyList = new List; 
+    ASSERT(cpus >= 1 && cpus <= MaxCPUs);
+    ASSERT(turn >= 1);
+    policy = how;
+    quantum = slice;
+    numCPUs = cpus;
+    for (int k = 0; k < numCPUs; k++) {
+	for (int i = 0; i < MLFQLevels; i++)
+	    readyList[k][i] = new IntrusiveList<Thread>; 
+	running[k] = NULL;
+	ipiPending[k] = FALSE;
+	cpuTicks[k] = 0;
+	directed[k] = NULL;
+    }
+    cpu = 0;
+    cpuQuantum = turn;
+    turnTicks = 0;
+    numSteals = numIPIs = 0;
+    stats->Register("sched.steals", &numSteals);
+    stats->Register("sched.ipis", &numIPIs);
+    directedYield = yieldToWoken;
+    donating = FALSE;
+    numDirected = 0;
+    stats->Register("sched.directed", &numDirected);
+    maxDeadlines = InitialDeadlines;
+    deadlines = new Thread *[maxDeadlines];
+    numDeadlines = rtLoad = 0;
+    numJobs = numMisses = totalLateness = maxLateness = 0;
+    numOverruns = numRejected = 0;
+    stats->Register("rt.jobs", &numJobs);
+    stats->Register("rt.misses", &numMisses);
+    stats->Register("rt.totalLateness", &totalLateness);
+    stats->Register("rt.maxLateness", &maxLateness);
+    stats->Register("rt.overruns", &numOverruns);
+    stats->Register("rt.rejected", &numRejected);
+    lastBoost = 0;
+    globalPass = 0;
+#ifdef USER_PROGRAM
+    switchedFrom = NULL;
+#endif
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
-// 	De-allocate the list of ready threads.
+// 	De-allocate the lists of ready threads.
 //----------------------------------------------------------------------
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    for (int k = 0; k < numCPUs; k++)
+	for (int i = 0; i < MLFQLevels; i++)
+	    delete readyList[k][i]; 
+    delete [] deadlines;
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
-//	Put it on the ready list, for later scheduling onto the CPU.
+//	Put it on the ready list (for its priority), for later scheduling
+//	onto the CPU -- the one it last ran on, or for a new thread, the
+//	least loaded one.  If that CPU is idle, wake it up.
+//
+//	A real-time thread goes on the deadline heap instead, with a new
+//	job if it was blocked, unless its job has been throttled.  If it 
+//	should run instead of what its CPU is running, preempt that.
 //
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
@@ -53,15 +110,66 @@ Scheduler::~Scheduler()
 void
 Scheduler::ReadyToRun (Thread *thread)
 {
+    ThreadStatus was = thread->getStatus();
+
     //DEBUG('t', "Putting thread %i on ready list.\n", thread->getID());
     thread->setStatus(READY);
-    readyList->Append((void *)thread);
+    if (thread->cpu < 0)
+	thread->cpu = LeastLoadedCPU();
+    if (thread->rtPeriod != 0) {
+	if (was == BLOCKED || was == JUST_CREATED)
+	    Release(thread);
+	if (!thread->rtThrottled) {
+	    PushDeadline(thread);
+	    NoteWakeup(thread);
+	    if (thread->cpu != cpu) {
+		if (running[thread->cpu] == NULL
+			|| Preempts(thread, running[thread->cpu]))
+		    SendIPI(thread->cpu);
+	    } else if (interrupt->InHandler() 
+			&& interrupt->getStatus() != IdleMode
+			&& Preempts(thread, currentThread))
+		interrupt->YieldOnReturn();
+	    return;
+	}
+    }
+    if (policy == SchedStride) {
+	if (thread == currentThread)	// yielding
+	    Charge(thread);
+	if (thread->pass < globalPass)	// don't let a thread that has
+	    thread->pass = globalPass;	// been blocked save up its share
+	readyList[thread->cpu][0]->SortedInsert(thread, thread->pass);
+    } else
+	readyList[thread->cpu][thread->priority]->Append(thread);
+    NoteWakeup(thread);
+    if (running[thread->cpu] == NULL && thread->cpu != cpu)
+	SendIPI(thread->cpu);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NoteWakeup
+// 	With directed yield, remember a thread the running thread has just
+//	made ready on this CPU, as the one to run if it blocks.  Not for
+//	the running thread itself (yielding), nor for threads woken by
+//	interrupt handlers, which aren't anyone's reply.
+//----------------------------------------------------------------------
+
+void
+Scheduler::NoteWakeup(Thread *thread)
+{
+    if (directedYield && thread != currentThread && thread->cpu == cpu
+		&& !interrupt->InHandler())
+	directed[cpu] = thread;
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
-// 	Return the next thread to be scheduled onto the CPU.
-//	If there are no ready threads, return NULL.
+// 	Return the next thread to be scheduled onto the CPU: the first one
+//	on the highest priority non-empty list (under stride scheduling,
+//	the one with the lowest pass), after any ready real-time thread,
+//	earliest deadline first.  If this CPU has no ready threads,
+//	steal one from another CPU; if there are none anywhere, return
+//	NULL.
 // Side effect:
 //	Thread is removed from the ready list.
 //----------------------------------------------------------------------
@@ -69,17 +177,394 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    if (policy == SchedMLFQ && stats->totalTicks - lastBoost >= MLFQBoostTicks)
+	Boost();
+    if (numDeadlines > 0)
+	return PopDeadline();
+    if (policy == SchedStride) {
+	if (!readyList[cpu][0]->IsEmpty())
+	    return (Thread *)readyList[cpu][0]->SortedRemove(&globalPass);
+    } else
+	for (int i = 0; i < MLFQLevels; i++)
+	    if (!readyList[cpu][i]->IsEmpty())
+		return (Thread *)readyList[cpu][i]->Remove();
+    return (numCPUs > 1) ? Steal() : NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::FindDirected
+// 	Called by a thread about to block: return the thread it last woke,
+//	taken off the ready list, if there is one and it is still waiting
+//	on this CPU.  The next Dispatch gives it the rest of the blocking
+//	thread's time slice.  Otherwise NULL: use FindNextToRun.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::FindDirected()
+{
+    Thread *thread = directed[cpu];
+
+    directed[cpu] = NULL;
+    if (thread == NULL || thread->getStatus() != READY || thread->cpu != cpu
+		|| thread->rtQueued)	// (that one goes by its deadline)
+	return NULL;
+    readyList[cpu][(policy == SchedStride) ? 0 : thread->priority]
+							->Detach(thread);
+    DEBUG('t', "Directed yield to thread \"%s\"\n", thread->getName());
+    numDirected++;
+    donating = TRUE;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Steal
+// 	This CPU has no ready threads: take the one that would run next
+//	on the CPU that has the most, and make it ours.  NULL if no CPU
+//	has any.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::Steal()
+{
+    int victim = -1, most = 0, n, i;
+    Thread *thread;
+
+    for (int k = 0; k < numCPUs; k++) {
+	for (n = 0, i = 0; i < MLFQLevels; i++)
+	    n += readyList[k][i]->getSize();
+	if (n > most) {
+	    most = n;
+	    victim = k;
+	}
+    }
+    if (victim == -1)
+	return NULL;
+    if (policy == SchedStride)
+	thread = (Thread *)readyList[victim][0]->SortedRemove(&globalPass);
+    else {
+	for (i = 0; readyList[victim][i]->IsEmpty(); i++)
+	    ;
+	thread = (Thread *)readyList[victim][i]->Remove();
+    }
+    DEBUG('t', "CPU %d steals thread \"%s\" from CPU %d\n", cpu, 
+	  thread->getName(), victim);
+    thread->cpu = cpu;
+    numSteals++;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LeastLoadedCPU
+// 	Pick a CPU for a thread that has never run: an idle one if there
+//	is one, and otherwise the one with the fewest ready threads.
+//----------------------------------------------------------------------
+
+int
+Scheduler::LeastLoadedCPU()
+{
+    int best = cpu, bestLoad = MaxCPUs * MaxCPUs, load;
+
+    for (int k = 0; k < numCPUs; k++) {
+	load = (running[k] != NULL || k == cpu) ? 1 : 0;
+	for (int i = 0; i < MLFQLevels; i++)
+	    load += readyList[k][i]->getSize();
+	if (load < bestLoad) {
+	    bestLoad = load;
+	    best = k;
+	}
+    }
+    return best;
 }
 
 void
 Scheduler::WakeUpFromJoin (Thread *thread)	// Wake up a thread, put it at the front of the ready list so it runs next.
 {
     //DEBUG('t', "Putting thread %i at front of ready list.\n", thread->getID());
-	thread->isJoined = false;
-
+    if (policy == SchedStride || thread->rtPeriod != 0) {
+	ReadyToRun(thread);		// the order is by pass, or deadline
+	return;
+    }
     thread->setStatus(READY);
-    readyList->Prepend((void *)thread);
+    if (thread->cpu < 0)
+	thread->cpu = LeastLoadedCPU();
+    readyList[thread->cpu][thread->priority]->Prepend(thread);
+    NoteWakeup(thread);
+    if (thread->cpu != cpu)		// idle, or running something else
+	SendIPI(thread->cpu);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetRealTime
+// 	Put a thread in the real-time class, or change its parameters, if
+//	admission control allows: the CPU shares of the real-time threads,
+//	each cost / deadline, can't add up to more than RTCapacity of
+//	every CPU.  Its first job is released now.
+//
+//	"thread" -- the thread, running
+//	"period" -- ticks between its jobs' releases, at least; 0 takes
+//		it out of the class
+//	"deadline" -- ticks after a release that its job must be done by,
+//		no more than "period"; 0 means the period
+//	"cost" -- CPU ticks its job needs
+//
+// Returns:
+//	FALSE if it was turned away, or the parameters make no sense
+//----------------------------------------------------------------------
+
+bool
+Scheduler::SetRealTime(Thread *thread, int period, int deadline, int cost)
+{
+    int share = 0;
+
+    if (deadline == 0)
+	deadline = period;
+    if (period != 0) {
+	if (period < 0 || deadline < 0 || deadline > period || cost <= 0 
+			|| cost > deadline)
+	    return FALSE;
+	share = (int) ((long long) cost * RTScale / deadline);
+	if (rtLoad - thread->rtShare + share > RTCapacity * numCPUs) {
+	    DEBUG('t', "Thread \"%s\" turned away from the real-time class\n",
+		  thread->getName());
+	    numRejected++;
+	    return FALSE;
+	}
+    }
+    if (thread->rtPeriod != 0)
+	EndJob(thread);			// the job under the old parameters
+    rtLoad += share - thread->rtShare;
+    thread->rtShare = share;
+    thread->rtPeriod = period;
+    thread->rtDeadline = deadline;
+    thread->rtCost = cost;
+    if (period != 0) {
+	thread->rtRelease = stats->totalTicks - period;	// so it's now
+	Release(thread);
+    }
+    DEBUG('t', "Thread \"%s\": period %d, deadline %d, cost %d; %d of %d promised\n",
+	  thread->getName(), period, deadline, cost, rtLoad, 
+	  RTCapacity * numCPUs);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Release
+// 	Start a real-time thread's next job: now, or a period after the
+//	last one if that is later, so that waking up early doesn't get a
+//	thread more than its share.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Release(Thread *thread)
+{
+    thread->rtRelease = max(stats->totalTicks, 
+			    thread->rtRelease + thread->rtPeriod);
+    thread->rtDue = thread->rtRelease + thread->rtDeadline;
+    thread->rtJobTicks = thread->userTicks + thread->systemTicks;
+    thread->rtThrottled = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::EndJob
+// 	A real-time thread's job is over (it is blocking, or leaving the
+//	class): count it, and whether it missed its deadline.
+//----------------------------------------------------------------------
+
+void
+Scheduler::EndJob(Thread *thread)
+{
+    long long late = stats->totalTicks - thread->rtDue;
+
+    numJobs++;
+    if (late > 0) {
+	DEBUG('t', "Real-time thread \"%s\" missed its deadline by %lld\n",
+	      thread->getName(), late);
+	numMisses++;
+	totalLateness += late;
+	if (late > maxLateness)
+	    maxLateness = late;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Preempts
+// 	Should real-time "thread" run instead of "other": is "other" not
+//	running at all, not real-time (or throttled), or due later?
+//----------------------------------------------------------------------
+
+bool
+Scheduler::Preempts(Thread *thread, Thread *other)
+{
+    if (other == NULL || other->rtPeriod == 0 || other->rtThrottled)
+	return TRUE;
+    return thread->rtDue < other->rtDue;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PushDeadline, Scheduler::PopDeadline
+// 	Add a ready real-time thread to the deadline heap (growing it if
+//	need be), or take off the one due first.  As with the pending
+//	interrupts, the heap is an array: element i's children are 2i+1
+//	and 2i+2, and neither is due before it.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PushDeadline(Thread *thread)
+{
+    int i, parent;
+
+    if (numDeadlines == maxDeadlines) {
+	Thread **old = deadlines;
+
+	maxDeadlines *= 2;
+	deadlines = new Thread *[maxDeadlines];
+	for (i = 0; i < numDeadlines; i++)
+	    deadlines[i] = old[i];
+	delete [] old;
+    }
+    for (i = numDeadlines++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (thread->rtDue >= deadlines[parent]->rtDue)
+	    break;
+	deadlines[i] = deadlines[parent];
+    }
+    deadlines[i] = thread;
+    thread->rtQueued = TRUE;
+}
+
+Thread *
+Scheduler::PopDeadline()
+{
+    Thread *first, *last;
+    int i, child;
+
+    ASSERT(numDeadlines > 0);
+    first = deadlines[0];
+    last = deadlines[--numDeadlines];
+    for (i = 0; (child = 2 * i + 1) < numDeadlines; i = child) {
+	if (child + 1 < numDeadlines 
+		&& deadlines[child + 1]->rtDue < deadlines[child]->rtDue)
+	    child++;
+	if (deadlines[child]->rtDue >= last->rtDue)
+	    break;
+	deadlines[i] = deadlines[child];
+    }
+    deadlines[i] = last;
+    first->rtQueued = FALSE;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::QuantumExpired
+// 	Called from the timer interrupt handler.  Under FIFO, the running
+//	thread is always preempted (round robin, one time slice each), and
+//	likewise under stride scheduling.  Under MLFQ, only once it
+//	has run for its level's whole quantum -- and then it drops a level.
+//
+// Returns:
+//	TRUE if the running thread should yield
+//----------------------------------------------------------------------
+
+bool
+Scheduler::QuantumExpired()
+{
+    return QuantumUsed(currentThread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::QuantumUsed
+// 	The body of QuantumExpired, for the thread running on any CPU.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::QuantumUsed(Thread *thread)
+{
+    if (thread->rtPeriod != 0 && !thread->rtThrottled
+	    && thread->userTicks + thread->systemTicks - thread->rtJobTicks 
+							>= thread->rtCost) {
+	DEBUG('t', "Real-time thread \"%s\" overran its job\n",
+	      thread->getName());
+	thread->rtThrottled = TRUE;	// until its next release
+	numOverruns++;
+	return TRUE;
+    }
+    if (numDeadlines > 0 && Preempts(deadlines[0], thread))
+	return TRUE;
+    if (thread->rtPeriod != 0 && !thread->rtThrottled)
+	return FALSE;			// it runs until it blocks
+    if (policy != SchedMLFQ)
+	return TRUE;
+    if (stats->totalTicks - thread->sliceStart < Quantum(thread->priority))
+	return FALSE;
+    if (thread->priority < MLFQLevels - 1) {
+	thread->priority++;
+	DEBUG('t', "Thread \"%s\" used its quantum, now at level %d\n",
+	      thread->getName(), thread->priority);
+    }
+    thread->sliceStart = stats->totalTicks;	// in case nothing else is
+    return TRUE;				// ready, and it runs on
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetPriority
+// 	Change a thread's priority (its MLFQ level), moving it to the
+//	right ready list if it is on one.  Used by PriorityLock.
+//
+//	"thread" -- the thread to change
+//	"priority" -- its new level
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetPriority(Thread *thread, int priority)
+{
+    ASSERT(priority >= 0 && priority < MLFQLevels);
+    if (thread->getStatus() == READY && policy != SchedStride 
+		&& !thread->rtQueued) {
+	readyList[thread->cpu][thread->priority]->Detach(thread);
+	readyList[thread->cpu][priority]->Append(thread);
+    }
+    thread->priority = priority;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Boost
+// 	Move every ready thread, and the running ones, back to the top
+//	queue, so that CPU-bound threads stuck at the bottom still get to
+//	run now and then.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Boost()
+{
+    Thread *thread;
+
+    for (int k = 0; k < numCPUs; k++) {
+	for (int i = 1; i < MLFQLevels; i++)
+	    while ((thread = (Thread *)readyList[k][i]->Remove()) != NULL) {
+		thread->priority = 0;
+		readyList[k][0]->Append(thread);
+	    }
+	if (running[k] != NULL)
+	    running[k]->priority = 0;
+    }
+    currentThread->priority = 0;
+    lastBoost = stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Charge
+// 	Stride scheduling: advance "thread"'s pass by its stride for each
+//	time slice of CPU it has used since it was last charged.  Uses the
+//	ticks charged to the thread, so time spent blocked doesn't count.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Charge(Thread *thread)
+{
+    int used = thread->userTicks + thread->systemTicks - thread->chargedTicks;
+
+    thread->chargedTicks += used;
+    thread->pass += (StrideOne / thread->tickets) * used / quantum;
 }
 
 //----------------------------------------------------------------------
@@ -90,8 +575,9 @@ Scheduler::WakeUpFromJoin (Thread *thread)	// Wake up a thread, put it at the fr
 //
 //      Note: we assume the state of the previously running thread has
 //	already been changed from running to blocked or ready (depending).
-// Side effect:
-//	The global variable currentThread becomes nextThread.
+//
+//	Nothing is saved if nextThread is the thread already running (it
+//	blocked, and was woken up while we were idle).
 //
 //	"nextThread" is the thread to be put into the CPU.
 //----------------------------------------------------------------------
@@ -101,18 +587,74 @@ Scheduler::Run (Thread *nextThread)
 {
     Thread *oldThread = currentThread;
     
+    if (policy == SchedStride)
+	Charge(oldThread);		    // (if it blocked, or is finishing)
+
+    if (nextThread == oldThread) {	    // no switch needed
+	currentThread->setStatus(RUNNING);
+	currentThread->sliceStart = stats->totalTicks;
+	running[cpu] = currentThread;
+	return;
+    }
+    Dispatch(nextThread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Dispatch
+// 	Make "nextThread" the thread this CPU runs, and switch to it.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Dispatch(Thread *nextThread)
+{
+    nextThread->setStatus(RUNNING);      // nextThread is now running
+    if (donating)			    // the rest of the old one's
+	nextThread->sliceStart = currentThread->sliceStart;
+    else				    // its quantum starts
+	nextThread->sliceStart = stats->totalTicks;
+    donating = FALSE;
+    directed[cpu] = NULL;		    // a new thread runs here now
+    for (int k = 0; k < numCPUs; k++)	    // and this one isn't waiting
+	if (directed[k] == nextThread)
+	    directed[k] = NULL;
+    nextThread->cpu = cpu;
+    running[cpu] = nextThread;
+    SwitchTo(nextThread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SwitchTo
+// 	Save the state of the running thread, and load the state of 
+//	"nextThread", by calling the machine dependent context switch 
+//	routine, SWITCH.  Used both to switch threads on a CPU, and to 
+//	give another CPU its turn; so the caller has already made the
+//	thread states, and "cpu", what they should be.
+//
+//	The address space state is only saved and reloaded if the two
+//	threads are in different address spaces.
+// Side effect:
+//	The global variable currentThread becomes nextThread.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchTo(Thread *nextThread)
+{
+    Thread *oldThread = currentThread;
+
 #ifdef USER_PROGRAM			// ignore until running user programs 
-    if (currentThread->space != NULL) {	// if this thread is a user program,
-        currentThread->SaveUserState(); // save the user's CPU registers
-	currentThread->space->SaveState();
+    if (oldThread->space != NULL) {	// if this thread is a user program,
+        oldThread->SaveUserState(); 	// save the user's CPU registers
+	if (nextThread->space != oldThread->space)
+	    oldThread->space->SaveState();
     }
+    switchedFrom = oldThread->space;    // for the thread we switch to
 #endif
-    
+
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
+    TRACE(TraceSwitch, TraceThreadID(oldThread), TraceThreadID(nextThread));
 
     currentThread = nextThread;		    // switch to the next thread
-    currentThread->setStatus(RUNNING);      // nextThread is now running
     
     //DEBUG('t', "Switching from thread \"%i\" to thread \"%i\"\n", oldThread->getID(), nextThread->getID());
     
@@ -137,11 +679,175 @@ Scheduler::Run (Thread *nextThread)
 #ifdef USER_PROGRAM
     if (currentThread->space != NULL) {		// if there is an address space
         currentThread->RestoreUserState();     // to restore, do it.
-	currentThread->space->RestoreState();
+	if (currentThread->space != switchedFrom)  // (unless it is still
+	    currentThread->space->RestoreState();  // loaded)
     }
 #endif
 }
 
+//----------------------------------------------------------------------
+// Scheduler::NextCPU
+// 	Called after each user instruction, with interrupts off, when
+//	there is more than one CPU: give the next CPU that has something
+//	to do its turn.  If "wrap" is FALSE, only CPUs after this one in
+//	the round are considered -- if there are none, the caller is the
+//	last, and advances the clock; with "wrap", the new round starts
+//	with the first CPU that has something to do.
+//
+// Returns:
+//	TRUE if another CPU took a turn; by the time we return, it is 
+//	our turn again
+//----------------------------------------------------------------------
+
+bool
+Scheduler::NextCPU(bool wrap)
+{
+    int from = wrap ? 0 : cpu + 1, to = wrap ? cpu : numCPUs;
+
+    running[cpu] = currentThread;	// (the main thread was never
+					// dispatched)
+    for (int k = from; k < to; k++)
+	if (TakeCPU(k))
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TurnOver
+// 	Called on each user instruction tick with several CPUs.  Count
+//	the instruction against the running CPU, and say whether it has
+//	now run its quantum of them, so the next CPU should take a turn.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::TurnOver()
+{
+    cpuTicks[cpu]++;
+    if (++turnTicks < cpuQuantum)
+	return FALSE;
+    turnTicks = 0;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::HandOff
+// 	Called from Thread::Sleep when this CPU has nothing left to run.
+//	If any other CPU has work, the CPU goes idle and the other one 
+//	carries on; otherwise the caller has to wait for an interrupt.
+//
+// Returns:
+//	TRUE if another CPU ran; by the time we return, the sleeping
+//	thread has been dispatched again, maybe on another CPU
+//----------------------------------------------------------------------
+
+bool
+Scheduler::HandOff()
+{
+    int self = cpu;
+
+    running[self] = NULL;
+    for (int i = 1; i < numCPUs; i++)
+	if (TakeCPU((self + i) % numCPUs))
+	    return TRUE;
+    running[self] = currentThread;	// we have the machine to ourselves
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TakeCPU
+// 	Give CPU "k" a turn, if it has something to do: carry on with the
+//	thread running on it, or if it is idle, dispatch a thread from its
+//	ready lists (or stolen from another CPU's), if there is one and 
+//	the CPU has been sent an IPI.  The thread we switch away from 
+//	keeps its state.
+//
+// Returns:
+//	TRUE if we switched, and have been switched back to since
+//----------------------------------------------------------------------
+
+bool
+Scheduler::TakeCPU(int k)
+{
+    int self = cpu;
+    Thread *thread;
+
+    turnTicks = 0;
+    if (running[k] != NULL) {
+	cpu = k;
+	SwitchTo(running[k]);
+	return TRUE;
+    }
+    if (!ipiPending[k])
+	return FALSE;
+    ipiPending[k] = FALSE;
+    cpu = k;
+    if ((thread = FindNextToRun()) == NULL) {
+	cpu = self;			// woken up for nothing
+	return FALSE;
+    }
+    DEBUG('t', "CPU %d starts running thread \"%s\"\n", k, thread->getName());
+    Dispatch(thread);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SendIPI, Scheduler::TakeIPI
+// 	Interrupt another CPU: it takes the IPI at its next turn, in
+//	TakeCPU if it is idle, or by calling TakeIPI (and yielding, if
+//	so) if it is not.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SendIPI(int target)
+{
+    if (!ipiPending[target]) {
+	ipiPending[target] = TRUE;
+	numIPIs++;
+    }
+}
+
+bool
+Scheduler::TakeIPI()
+{
+    if (!ipiPending[cpu])
+	return FALSE;
+    ipiPending[cpu] = FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PreemptOtherCPUs
+// 	Called from the timer interrupt handler.  The timer goes off in
+//	the turn of whichever CPU is last in the round, which deals with
+//	its own thread; tell every other busy CPU whose thread has used 
+//	its quantum to reschedule.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PreemptOtherCPUs()
+{
+    for (int k = 0; k < numCPUs; k++)
+	if (k != cpu && running[k] != NULL && QuantumUsed(running[k]))
+	    SendIPI(k);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintCPUs
+// 	Print how many user instructions each CPU ran, and how often the
+//	CPUs stole threads from one another, or sent IPIs.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintCPUs()
+{
+    if (numCPUs == 1)
+	return;
+    printf("CPUs: %d, quantum %d, steals %lld, IPIs %lld\n", numCPUs, 
+	cpuQuantum, numSteals, numIPIs);
+    for (int k = 0; k < numCPUs; k++)
+	printf("    CPU %d: user instructions %lld\n", k, cpuTicks[k]);
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Print
 // 	Print the scheduler state -- in other words, the contents of
@@ -151,5 +857,9 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < numDeadlines; i++)
+	ThreadPrint((int) deadlines[i]);
+    for (int k = 0; k < numCPUs; k++)
+	for (int i = 0; i < MLFQLevels; i++)
+	    readyList[k][i]->Mapcar((VoidFunctionPtr) ThreadPrint);
 }
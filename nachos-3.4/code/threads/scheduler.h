@@ -12,26 +12,215 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "stats.h"
+
+// How the scheduler picks the next thread to run (the -sp flag)
+
+enum SchedPolicy {
+    SchedFIFO,		// one ready list, first come first served
+    SchedMLFQ,		// multilevel feedback queue
+    SchedStride		// stride scheduling: CPU time in proportion
+			// to each thread's tickets
+};
+
+#define MLFQLevels	3	// ready queues; 0 is the highest priority
+#define MLFQBoostTicks	5000	// how often every thread is moved back
+				// to the top queue, so none starves
+
+#define StrideOne	10000	// a thread's stride is StrideOne / tickets
+#define DefaultTickets	100	// tickets of a thread not given any
+
+#define MaxCPUs		8	// simulated processors, at most (-cpus)
+
+#define RTScale		1000	// CPU shares are in thousandths of a CPU
+#define RTCapacity	900	// most of each CPU the real-time class may
+				// be promised; the rest is for the others
+#define InitialDeadlines 8	// starting size of the deadline heap
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
+//
+// Under MLFQ, a thread's priority is the queue it is on.  A thread
+// that runs for a whole quantum of its level is moved down a level
+// (the quantum doubles each level down, from the time slice); one that blocks or yields
+// first keeps its level, so interactive threads stay on top.
+//
+// Under stride scheduling, each thread's "pass" advances by its stride
+// for every time slice of CPU it uses, and the ready thread with the
+// lowest pass runs next -- so a thread with twice the tickets runs
+// twice as often.  The ready list is kept sorted by pass.
+//
+// With more than one CPU (-cpus), each CPU has ready lists of its own,
+// and runs the threads on them.  A thread goes back on the lists of
+// the CPU it last ran on; a new one goes to the least loaded CPU.  A
+// CPU with nothing of its own to run steals the first thread from the
+// CPU with the most ready threads.
+//
+// The simulation runs the CPUs in lock step: each user instruction 
+// tick, every busy CPU runs one instruction in turn, lowest number
+// first, and only the last one advances the clock.  A CPU's context 
+// is the thread running on it; taking turns is a context switch 
+// between those threads, which stay RUNNING.  Kernel code is never
+// interleaved with other CPUs, since turns are only taken between
+// user instructions: the whole kernel acts as if under one big lock,
+// so disabling interrupts still gives mutual exclusion, and kernel 
+// time holds up every CPU.
+//
+// With a CPU quantum (-cq) of more than one tick, each CPU runs that
+// many instructions in a row before the next one takes its turn, and 
+// the clock advances by the whole quantum at the end of the round.
+// Switching between CPUs less often makes the simulation much faster
+// (each switch is a context switch, and under USE_TLB a TLB flush),
+// at the price of precision: interrupts are only checked between
+// rounds, so one can be taken up to a quantum late, and CPUs only see
+// each other's memory writes at the end of their turns.
+//
+// One CPU interrupts another with an IPI (interprocessor interrupt),
+// which the other takes at its next turn: an idle CPU looks for a 
+// thread to run, and a busy one reschedules when its time slice is
+// up, or its thread was woken from Join to run next.
+//
+// With directed yield (-dy), a thread that blocks right after waking
+// another -- a V on a semaphore the other waits on, a Join, a reply
+// in SynchDisk or the PostOffice -- hands the CPU straight to the one
+// it woke, if that one is still ready on this CPU, instead of to the
+// head of the ready list.  The woken thread also gets what is left of
+// the blocker's time slice, rather than a fresh one, so ping-ponging
+// threads can't take more than their share.  Wakeups from interrupt
+// handlers don't count.
+//
+// Above whichever policy is in force there is a real-time class, run
+// earliest deadline first.  A thread joins it (RealTime) with a period,
+// a relative deadline no longer than the period, and the CPU time it
+// needs per period; admission control turns it away if the CPU shares
+// promised (cost over deadline, each) would come to more than 
+// RTCapacity of the CPUs.  Each time a real-time thread becomes ready
+// after blocking, a new job is released -- no sooner than a period
+// after the last one -- due "deadline" ticks after its release; the job
+// ends when the thread blocks again.  Ready real-time threads wait on
+// one binary heap, earliest absolute deadline first, which every CPU
+// looks at before its own ready lists.
+//
+// A real-time thread woken by an interrupt handler (an Alarm, or a
+// device) preempts a thread with a later deadline, or none, at once;
+// one woken by another thread does at the next timer interrupt.  A
+// job that uses up its cost is throttled, at a timer interrupt: it runs
+// in the normal class until the thread's next release, so an overrun
+// can't starve everyone else.  Jobs ending after their deadline are
+// counted as misses, with how late they were.
 
 class Scheduler {
   public:
-    Scheduler();			// Initialize list of ready threads 
+    Scheduler(SchedPolicy how, int slice, int cpus = 1, 
+		int turn = 1, bool yieldToWoken = FALSE);
+					// Initialize list of ready 
+					// threads
     ~Scheduler();			// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
     Thread* FindNextToRun();		// Dequeue first thread on the ready 
 					// list, if any, and return thread.
+    Thread* FindDirected();		// With -dy, the thread the one now
+					// running woke last, if still ready
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
 	void WakeUpFromJoin(Thread *thread);	// Wake up a thread and put it at the front of the list.
+
+    bool SetRealTime(Thread *thread, int period, int deadline, int cost);
+					// Put "thread" in the real-time class,
+					// or out of it (period 0); FALSE if
+					// that would promise too much CPU
+    void EndJob(Thread *thread);	// A real-time thread is blocking
+
+    bool QuantumExpired();		// Called on a timer interrupt: should
+					// the running thread be preempted?
+    void SetPriority(Thread *thread, int priority);
+					// Move "thread" to another queue
+    bool NeedsTimer() { return policy != SchedFIFO; }
+
+    int NumCPUs() { return numCPUs; }
+    int CurrentCPU() { return cpu; }
+    int CPUQuantum() { return cpuQuantum; }
+    bool TurnOver();			// Count a user instruction on this
+					// CPU; has its turn been used up?
+    bool NextCPU(bool wrap);		// Give another CPU its turn: one
+					// after this in the round, or if 
+					// "wrap", the first of the next
+    bool HandOff();			// This CPU has nothing to run: 
+					// let another one have the machine
+    void SendIPI(int target);		// Interrupt CPU "target"
+    bool TakeIPI();			// Has this CPU been told to 
+					// reschedule?  (clears it)
+    void PreemptOtherCPUs();		// On a timer interrupt, IPI the
+					// other CPUs whose quantum is up
+    void PrintCPUs();			// Print each CPU's statistics
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
-				// but not running
+    bool TakeCPU(int k);		// Switch to CPU "k", if it has a 
+					// thread to run
+    Thread *Steal();			// Take a ready thread from the 
+					// busiest other CPU
+    int LeastLoadedCPU();		// Where to put a new thread
+    void NoteWakeup(Thread *thread);	// Remember it for FindDirected,
+					// if the running thread woke it
+    void Release(Thread *thread);	// Start a real-time thread's next job
+    bool Preempts(Thread *thread, Thread *other);
+					// Should real-time "thread" run
+					// instead of "other" (NULL if idle)?
+    void PushDeadline(Thread *thread);	// Add to the deadline heap
+    Thread *PopDeadline();		// Take the earliest deadline off it
+    void Dispatch(Thread *nextThread);	// Make "nextThread" this CPU's,
+					// and switch to it
+    void SwitchTo(Thread *nextThread);	// Context switch, on any CPU
+    bool QuantumUsed(Thread *thread);	// Has it used up its time slice?
+
+    int Quantum(int level) { return quantum << level; }
+    void Boost();			// Move every thread to the top queue
+    void Charge(Thread *thread);	// Advance "thread"'s pass for the
+					// CPU time it has used
+
+    SchedPolicy policy;
+    int quantum;		// time slice, in ticks (the top level's,
+				// under MLFQ)
+    IntrusiveList<Thread> *readyList[MaxCPUs][MLFQLevels];
+				// each CPU's queues of threads that are 
+				// ready to run, but not running; FIFO 
+				// and stride only use the first
+    long long lastBoost;	// when Boost was last called
+    int globalPass;		// pass of the thread last dispatched
+
+    int numCPUs;
+    int cpu;			// the CPU whose turn it is
+    int cpuQuantum;		// instructions per CPU per turn
+    int turnTicks;		// how many it has run this turn
+    Thread *running[MaxCPUs];	// what each CPU runs; NULL if idle
+    bool ipiPending[MaxCPUs];	// IPIs not yet taken
+    long long cpuTicks[MaxCPUs];	// user instructions each CPU has run
+    long long numSteals, numIPIs;
+    bool directedYield;		// hand off to the thread just woken?
+    Thread *directed[MaxCPUs];	// the thread each CPU's running thread
+				// last woke, while it hasn't run
+    bool donating;		// the next Dispatch is a directed one:
+				// it inherits the time slice
+    long long numDirected;	// directed yields
+
+    Thread **deadlines;		// heap of ready real-time threads, the
+				// earliest absolute deadline first
+    int numDeadlines;		// threads on the heap
+    int maxDeadlines;		// size of the heap array
+    int rtLoad;			// CPU promised to real-time threads, in 
+				// RTScale units
+    long long numJobs;		// real-time jobs ended
+    long long numMisses;	// ... after their deadline
+    long long totalLateness;	// ticks late, over all the misses
+    long long maxLateness;	// the latest any job has been
+    long long numOverruns;	// jobs throttled for using up their cost
+    long long numRejected;	// RealTime calls turned away
+#ifdef USER_PROGRAM
+    AddrSpace *switchedFrom;	// address space of the thread that last
+				// gave up the CPU, still loaded
+#endif
 };
 
 #endif // SCHEDULER_H
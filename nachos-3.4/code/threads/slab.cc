@@ -0,0 +1,120 @@
+// slab.cc
+//	Routines to cache the memory of small kernel objects.  See slab.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "slab.h"
+
+// A free object: its first word links it to the next one.
+
+class FreeObject {
+  public:
+    FreeObject *next;
+};
+
+//----------------------------------------------------------------------
+// SlabCache::SlabCache
+// 	Initialize an empty cache.  Nothing is allocated until the first
+//	Alloc.
+//
+//	"debugName" -- for the statistics
+//	"size" -- bytes per object
+//	"count" -- objects to take from the host at a time
+//----------------------------------------------------------------------
+
+SlabCache::SlabCache(char *debugName, int size, int count)
+{
+    name = debugName;
+    objectSize = (max(size, (int) sizeof(FreeObject)) + 7) & ~7;
+    perSlab = count;
+    freeList = NULL;
+    registered = FALSE;
+    numAllocs = numSlabs = numInUse = 0;
+}
+
+//----------------------------------------------------------------------
+// SlabCache::Alloc
+// 	Take an object off the free list, carving a new slab first if it
+//	is empty.
+//----------------------------------------------------------------------
+
+void *
+SlabCache::Alloc(size_t size)
+{
+    FreeObject *object;
+
+    ASSERT((int) size <= objectSize);	// a subclass without a cache
+    if (!registered && stats != NULL)
+	Register();
+    if (freeList == NULL)
+	Grow();
+    object = freeList;
+    freeList = object->next;
+    numAllocs++;
+    numInUse++;
+    return (void *) object;
+}
+
+//----------------------------------------------------------------------
+// SlabCache::Free
+// 	Put an object back on the free list.  delete of NULL ends up
+//	here too, and does nothing.
+//----------------------------------------------------------------------
+
+void
+SlabCache::Free(void *object)
+{
+    FreeObject *o = (FreeObject *) object;
+
+    if (o == NULL)
+	return;
+    o->next = freeList;
+    freeList = o;
+    numInUse--;
+}
+
+//----------------------------------------------------------------------
+// SlabCache::Grow
+// 	Take a slab from the host, and put each of its objects on the
+//	free list.
+//----------------------------------------------------------------------
+
+void
+SlabCache::Grow()
+{
+    char *slab = new char[objectSize * perSlab];
+
+    for (int i = perSlab - 1; i >= 0; i--) {	// lowest address first out
+	FreeObject *o = (FreeObject *) (slab + i * objectSize);
+
+	o->next = freeList;
+	freeList = o;
+    }
+    numSlabs++;
+}
+
+//----------------------------------------------------------------------
+// SlabCache::Register
+// 	Export the counters as slab.<name>.allocs, .slabs and .inUse.
+//	Caches are static, made before the Statistics are, so this waits
+//	for the first Alloc after Nachos has started.
+//----------------------------------------------------------------------
+
+void
+SlabCache::Register()
+{
+    static char *suffix[] = { "allocs", "slabs", "inUse" };
+    long long *counter[] = { &numAllocs, &numSlabs, &numInUse };
+
+    registered = TRUE;
+    for (int i = 0; i < 3; i++) {
+	char *full = new char[strlen(name) + strlen(suffix[i]) + 7];
+
+	sprintf(full, "slab.%s.%s", name, suffix[i]);
+	stats->Register(full, counter[i]);
+    }
+}
@@ -0,0 +1,68 @@
+// slab.h
+//	Data structures for caching the memory of small kernel objects of
+//	one type: list elements, pending interrupts, work items, threads,
+//	and so on, which are made and thrown away on every system call or
+//	interrupt.
+//
+//	A SlabCache takes memory from the host a "slab" of objects at a
+//	time, and keeps freed objects on a free list for the next
+//	allocation, so most allocations never get as far as malloc.
+//	Slabs are never given back.  A class uses one by defining its own
+//	operator new and delete:
+//
+//	    static SlabCache elementCache("list", sizeof(ListElement));
+//
+//	    void *ListElement::operator new(size_t size)
+//	    { return elementCache.Alloc(size); }
+//	    void ListElement::operator delete(void *p)
+//	    { elementCache.Free(p); }
+//
+//	Only the memory is cached: C++ runs the constructor and destructor
+//	on each new and delete anyway.
+//
+//	Each cache's use is exported as "slab.<name>.*".
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "copyright.h"
+#include "utility.h"
+#include <stddef.h>
+
+#define SlabObjects	32		// objects per slab, by default
+
+class FreeObject;
+
+class SlabCache {
+  public:
+    SlabCache(char *debugName, int size, int count = SlabObjects);
+					// An empty cache; as static objects
+					// are made before Nachos starts,
+					// this only sets fields
+
+    void *Alloc(size_t size);		// Memory for one object of "size"
+					// bytes (no more than objectSize)
+    void Free(void *object);		// ... given back
+
+    // Statistics, registered (once Nachos has started) as "slab.*".
+    long long numAllocs;		// Alloc calls
+    long long numSlabs;			// slabs taken from the host
+    long long numInUse;			// objects allocated, not yet freed
+
+  private:
+    void Grow();			// Carve a new slab into free objects
+    void Register();			// Register the statistics
+
+    char *name;
+    int objectSize;			// bytes per object, rounded up to 
+					// a multiple of 8
+    int perSlab;
+    FreeObject *freeList;		// freed objects, most recent first
+    bool registered;
+};
+
+#endif // SLAB_H
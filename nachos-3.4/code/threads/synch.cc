@@ -1,8 +1,7 @@
 // synch.cc 
 //	Routines for synchronizing threads.  Three kinds of
 //	synchronization routines are defined here: semaphores, locks 
-//   	and condition variables (the implementation of the last two
-//	are left to the reader).
+//   	and condition variables.
 //
 // Any implementation of a synchronization routine needs some
 // primitive atomic operation.  We assume Nachos is running on
@@ -37,7 +36,7 @@ Semaphore::Semaphore(char* debugName, int initialValue)
 {
     name = debugName;
     value = initialValue;
-    queue = new List;
+    queue = new IntrusiveList<Thread>;
 }
 
 //----------------------------------------------------------------------
@@ -67,7 +66,7 @@ Semaphore::P()
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     
     while (value == 0) { 			// semaphore not available
-	queue->Append((void *)currentThread);	// so go to sleep
+	queue->Append(currentThread);	// so go to sleep
 	currentThread->Sleep();
     } 
     value--; 					// semaphore available, 
@@ -97,16 +96,423 @@ Semaphore::V()
     (void) interrupt->SetLevel(oldLevel);
 }
 
-// Dummy functions -- so we can compile our later assignments 
-// Note -- without a correct implementation of Condition::Wait(), 
-// the test case in the network assignment won't work!
-Lock::Lock(char* debugName) {}
-Lock::~Lock() {}
-void Lock::Acquire() {}
-void Lock::Release() {}
+//----------------------------------------------------------------------
+// Lock::Lock
+// 	Initialize a lock, so that it can be used for synchronization.
+//	It starts out FREE.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+Lock::Lock(char* debugName)
+{
+    name = debugName;
+    owner = NULL;
+    queue = new IntrusiveList<Thread>;
+}
+
+//----------------------------------------------------------------------
+// Lock::~Lock
+// 	De-allocate a lock, when no longer needed.  Assume no one
+//	is still waiting on it.
+//----------------------------------------------------------------------
+
+Lock::~Lock()
+{
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// Lock::Acquire
+// 	Wait until the lock is FREE, then take it.  A thread that has to
+//	wait is handed the lock by Release, so it owns it when it wakes up.
+//----------------------------------------------------------------------
+
+void
+Lock::Acquire()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(owner != currentThread);		// no recursive locking
+    if (owner == NULL)
+	owner = currentThread;
+    else {
+	queue->Append(currentThread);
+	currentThread->Sleep();
+	ASSERT(owner == currentThread);		// handed over by Release
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::Release
+// 	Give up the lock.  If anyone is waiting for it, it passes directly
+//	to the first of them; otherwise it becomes FREE.
+//----------------------------------------------------------------------
+
+void
+Lock::Release()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(isHeldByCurrentThread());
+    thread = (Thread *)queue->Remove();
+    owner = thread;
+    if (thread != NULL)
+	scheduler->ReadyToRun(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+bool
+Lock::isHeldByCurrentThread()
+{
+    return owner == currentThread;
+}
+
+//----------------------------------------------------------------------
+// Condition::Condition
+// 	Initialize a condition variable, with no one waiting.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+Condition::Condition(char* debugName)
+{
+    name = debugName;
+    queue = new IntrusiveList<Thread>;
+}
+
+Condition::~Condition()
+{
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// Condition::Wait
+// 	Release the lock, and wait to be signalled.  Signal moves us onto
+//	the lock's queue, so when we wake up we hold the lock again.
+//
+//	"conditionLock" -- the lock protecting the condition; must be held
+//----------------------------------------------------------------------
+
+void
+Condition::Wait(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    queue->Append(currentThread);
+    conditionLock->Release();			// atomic with going to sleep,
+    currentThread->Sleep();			// since interrupts are off
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Signal
+// 	Wake up the first waiter, if any: it waits for the lock we hold.
+//----------------------------------------------------------------------
+
+void
+Condition::Signal(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    thread = (Thread *)queue->Remove();
+    if (thread != NULL)
+	conditionLock->queue->Append(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Broadcast
+// 	Wake up every waiter, moving them all onto the lock's queue.
+//----------------------------------------------------------------------
+
+void
+Condition::Broadcast(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    while ((thread = (Thread *)queue->Remove()) != NULL)
+	conditionLock->queue->Append(thread);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a reader-writer lock, held by no one.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//	"writersFirst" -- make new readers wait while a writer is waiting
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName, bool writersFirst)
+{
+    name = debugName;
+    preferWriters = writersFirst;
+    readers = 0;
+    writer = NULL;
+    readQueue = new IntrusiveList<Thread>;
+    writeQueue = new IntrusiveList<Thread>;
+}
+
+RWLock::~RWLock()
+{
+    delete readQueue;
+    delete writeQueue;
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReadAcquire
+// 	Take the lock to read, waiting while a writer holds it (or, with
+//	writer preference, wants it).  WriteRelease counts us as a reader
+//	before waking us up.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReadAcquire()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (writer == NULL && !(preferWriters && !writeQueue->IsEmpty()))
+	readers++;
+    else {
+	readQueue->Append(currentThread);
+	currentThread->Sleep();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
 
-Condition::Condition(char* debugName) { }
-Condition::~Condition() { }
-void Condition::Wait(Lock* conditionLock) { ASSERT(FALSE); }
-void Condition::Signal(Lock* conditionLock) { }
-void Condition::Broadcast(Lock* conditionLock) { }
+//----------------------------------------------------------------------
+// RWLock::ReadRelease
+// 	Stop reading.  The last reader out hands the lock to a waiting
+//	writer.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReadRelease()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(readers > 0);
+    readers--;
+    if (readers == 0) {
+	writer = (Thread *)writeQueue->Remove();
+	if (writer != NULL)
+	    scheduler->ReadyToRun(writer);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::WriteAcquire
+// 	Take the lock to write, waiting until no one else holds it.
+//----------------------------------------------------------------------
+
+void
+RWLock::WriteAcquire()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (writer == NULL && readers == 0)
+	writer = currentThread;
+    else {
+	writeQueue->Append(currentThread);
+	currentThread->Sleep();
+	ASSERT(writer == currentThread);	// handed over
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::WriteRelease
+// 	Stop writing.  Waiting readers go first, unless writers are
+//	preferred and one is waiting.
+//----------------------------------------------------------------------
+
+void
+RWLock::WriteRelease()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(writer == currentThread);
+    writer = NULL;
+    if (preferWriters || readQueue->IsEmpty())
+	writer = (Thread *)writeQueue->Remove();
+    if (writer != NULL)
+	scheduler->ReadyToRun(writer);
+    else
+	WakeReaders();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+bool
+RWLock::isWriteHeldByCurrentThread()
+{
+    return writer == currentThread;
+}
+
+void
+RWLock::WakeReaders()
+{
+    Thread *thread;
+
+    while ((thread = (Thread *)readQueue->Remove()) != NULL) {
+	readers++;
+	scheduler->ReadyToRun(thread);
+    }
+}
+
+//----------------------------------------------------------------------
+// PriorityLock::PriorityLock
+// 	Initialize a priority inheritance lock, held by no one.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+PriorityLock::PriorityLock(char* debugName)
+{
+    name = debugName;
+    owner = NULL;
+    ownerPriority = donated = waitingTickets = 0;
+    inherited = FALSE;
+    queue = new IntrusiveList<Thread>;
+}
+
+PriorityLock::~PriorityLock()
+{
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// PriorityLock::Acquire
+// 	Take the lock, or lend our priority and tickets to its holder and
+//	wait for Release to hand it to us.
+//----------------------------------------------------------------------
+
+void
+PriorityLock::Acquire()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(owner != currentThread);		// no recursive locking
+    if (owner == NULL) {
+	owner = currentThread;
+	ownerPriority = owner->priority;
+    } else {
+	queue->SortedInsert(currentThread, currentThread->priority);
+	waitingTickets += currentThread->tickets;
+	owner->tickets += currentThread->tickets;
+	donated += currentThread->tickets;
+	Inherit();
+	currentThread->Sleep();
+	ASSERT(owner == currentThread);		// handed over by Release
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PriorityLock::Release
+// 	Give back what we inherited, and hand the lock to the highest
+//	priority waiter, which inherits from the rest.
+//----------------------------------------------------------------------
+
+void
+PriorityLock::Release()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(isHeldByCurrentThread());
+    owner->tickets -= donated;
+    if (inherited)
+	scheduler->SetPriority(owner, ownerPriority);
+    inherited = FALSE;
+    donated = 0;
+    owner = (Thread *)queue->SortedRemove(NULL);
+    if (owner != NULL) {
+	ownerPriority = owner->priority;
+	waitingTickets -= owner->tickets;
+	owner->tickets += waitingTickets;
+	donated = waitingTickets;
+	Inherit();
+	scheduler->ReadyToRun(owner);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PriorityLock::Inherit
+// 	Raise the holder to the priority of the first waiter, if that is
+//	higher (a lower level) than its own.
+//----------------------------------------------------------------------
+
+void
+PriorityLock::Inherit()
+{
+    int best;
+
+    if (queue->SortedPeek(&best) && best < owner->priority) {
+	DEBUG('t', "Thread \"%s\" inherits level %d through lock \"%s\"\n",
+	      owner->getName(), best, name);
+	scheduler->SetPriority(owner, best);
+	inherited = TRUE;
+    }
+}
+
+bool
+PriorityLock::isHeldByCurrentThread()
+{
+    return owner == currentThread;
+}
+
+//----------------------------------------------------------------------
+// SpinLock::SpinLock, SpinLock::~SpinLock
+// 	Initialize a spin lock to FREE, and deallocate it.
+//----------------------------------------------------------------------
+
+SpinLock::SpinLock(char* debugName)
+{
+    name = debugName;
+    ownerCPU = -1;
+}
+
+SpinLock::~SpinLock()
+{
+    ASSERT(ownerCPU == -1);
+}
+
+//----------------------------------------------------------------------
+// SpinLock::Acquire, SpinLock::Release
+// 	Turn interrupts off and mark the lock as held by this CPU; then
+//	give it back and restore the interrupt level.  Doesn't nest.
+//----------------------------------------------------------------------
+
+void
+SpinLock::Acquire()
+{
+    IntStatus level = interrupt->SetLevel(IntOff);
+
+    ASSERT(ownerCPU == -1);		// held across a Sleep?
+    ownerCPU = scheduler->CurrentCPU();
+    oldLevel = level;
+}
+
+void
+SpinLock::Release()
+{
+    ASSERT(isHeldByCurrentCPU());
+    ownerCPU = -1;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+bool
+SpinLock::isHeldByCurrentCPU()
+{
+    return ownerCPU == scheduler->CurrentCPU();
+}
@@ -2,10 +2,7 @@
 //	Data structures for synchronizing threads.
 //
 //	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
-//	semaphores is given; for the latter two, only the procedure
-//	interface is given -- they are to be implemented as part of 
-//	the first assignment.
+//	locks, and condition variables.
 //
 //	Note that all the synchronization objects take a "name" as
 //	part of the initialization.  This is solely for debugging purposes.
@@ -20,6 +17,7 @@
 #include "copyright.h"
 #include "thread.h"
 #include "list.h"
+#include "interrupt.h"
 
 // The following class defines a "semaphore" whose value is a non-negative
 // integer.  The semaphore has only two operations P() and V():
@@ -48,7 +46,7 @@ class Semaphore {
   private:
     char* name;        // useful for debugging
     int value;         // semaphore value, always >= 0
-    List *queue;       // threads waiting in P() for the value to be > 0
+    IntrusiveList<Thread> *queue;       // threads waiting in P() for the value to be > 0
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -62,6 +60,10 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// Release hands the lock straight to the first waiting thread, if
+// there is one, so it never goes FREE in between: the woken thread
+// doesn't have to race anyone else to re-acquire it.
 
 class Lock {
   public:
@@ -78,8 +80,12 @@ class Lock {
 					// Condition variable ops below.
 
   private:
+    friend class Condition;		// Signal moves threads onto "queue"
+
     char* name;				// for debugging
-    // plus some other stuff you'll need to define
+    Thread *owner;			// the thread holding the lock, NULL
+					// if it is FREE
+    IntrusiveList<Thread> *queue;			// threads waiting in Acquire
 };
 
 // The following class defines a "condition variable".  A condition
@@ -113,6 +119,11 @@ class Lock {
 // The consequence of using Mesa-style semantics is that some other thread
 // can acquire the lock, and change data structures, before the woken
 // thread gets a chance to run.
+//
+// Since the signaller holds the lock, woken threads are not made ready
+// at all: they are moved onto the lock's own queue, and are handed the
+// lock, one at a time, as it is released.  Broadcast moves all of them
+// at once.
 
 class Condition {
   public:
@@ -131,6 +142,97 @@ class Condition {
 
   private:
     char* name;
-    // plus some other stuff you'll need to define
+    IntrusiveList<Thread> *queue;			// threads waiting in Wait()
+};
+
+// The following class defines a "reader-writer lock": any number of
+// threads may hold it to read, or one thread to write.
+//
+// If "preferWriters" is set, a reader arriving while a writer waits
+// waits too, so a stream of readers can't keep writers out; otherwise
+// readers get in whenever no writer holds the lock.  Either way, as
+// with Lock, the lock is handed directly to the threads it wakes up:
+// a writer, or every waiting reader at once.
+
+class RWLock {
+  public:
+    RWLock(char* debugName, bool writersFirst);
+    ~RWLock();
+    char* getName() { return name; }
+
+    void ReadAcquire();			// wait until no one is writing
+    void ReadRelease();
+    void WriteAcquire();		// wait until no one holds the lock
+    void WriteRelease();
+    bool isWriteHeldByCurrentThread();	// true if the current thread
+					// holds it to write
+
+  private:
+    void WakeReaders();			// let in every waiting reader
+
+    char* name;
+    bool preferWriters;
+    int readers;			// threads holding it to read
+    Thread *writer;			// thread holding it to write, or NULL
+    IntrusiveList<Thread> *readQueue;			// threads waiting to read
+    IntrusiveList<Thread> *writeQueue;			// threads waiting to write
+};
+
+// The following class defines a lock with "priority inheritance", for
+// the priority schedulers.  While a thread waits for the lock, the 
+// holder runs at the waiter's priority (MLFQ level), if that is higher,
+// and with the waiter's tickets added to its own (stride scheduling);
+// so a low priority holder can't keep a high priority thread waiting
+// behind everything else that is ready.  Waiters get the lock in 
+// priority order.
+//
+// Only the holder of this lock is boosted: if it is itself waiting for
+// another lock, that lock's holder is not.
+
+class PriorityLock {
+  public:
+    PriorityLock(char* debugName);
+    ~PriorityLock();
+    char* getName() { return name; }
+
+    void Acquire();
+    void Release();
+    bool isHeldByCurrentThread();
+
+  private:
+    void Inherit();			// give the holder the best priority
+					// among the waiters
+
+    char* name;
+    Thread *owner;			// the holder, or NULL
+    int ownerPriority;			// its priority before inheriting
+    bool inherited;			// has Inherit changed it?
+    int donated;			// tickets lent to the holder
+    int waitingTickets;			// total tickets of the waiters
+    IntrusiveList<Thread> *queue;			// waiters, by priority
+};
+
+// The following class defines a "spin lock", for short critical
+// sections in the kernel when several CPUs are simulated (cf.
+// scheduler.h).  Acquire turns interrupts off, and Release restores
+// them.  Since the simulated CPUs only take turns while running user
+// code, no other CPU can run while the lock is held, so it can never be
+// found BUSY unless its holder went to sleep with it -- which is a bug,
+// and is caught by an ASSERT rather than spun on forever.
+
+class SpinLock {
+  public:
+    SpinLock(char* debugName);
+    ~SpinLock();
+    char* getName() { return name; }
+
+    void Acquire();			// interrupts off, lock BUSY
+    void Release();			// lock FREE, interrupts as they were
+    bool isHeldByCurrentCPU();
+
+  private:
+    char* name;
+    int ownerCPU;			// CPU holding it, or -1 if FREE
+    IntStatus oldLevel;			// interrupt level before Acquire
 };
 #endif // SYNCH_H
@@ -20,13 +20,19 @@
 //	Allocate and initialize the data structures needed for a 
 //	synchronized list, empty to start with.
 //	Elements can now be added to the list.
+//
+//	"maxItems" -- the most items it may hold, or 0 for no limit
 //----------------------------------------------------------------------
 
-SynchList::SynchList()
+SynchList::SynchList(int maxItems)
 {
+    ASSERT(maxItems >= 0);
     list = new List();
     lock = new Lock("list lock"); 
     listEmpty = new Condition("list empty cond");
+    listFull = new Condition("list full cond");
+    capacity = maxItems;
+    size = removers = appenders = 0;
 }
 
 //----------------------------------------------------------------------
@@ -39,12 +45,40 @@ SynchList::~SynchList()
     delete list; 
     delete lock;
     delete listEmpty;
+    delete listFull;
+}
+
+//----------------------------------------------------------------------
+// SynchList::Added, SynchList::Removed
+//	With the lock held, wake up as many waiting removers as items were
+//	just added, or appenders as items were removed -- and nothing, if 
+//	nobody is waiting.  A thread woken is no longer counted as waiting,
+//	so a second batch doesn't signal it again.
+//----------------------------------------------------------------------
+
+void
+SynchList::Added(int count)
+{
+    for (; count > 0 && removers > 0; count--) {
+	removers--;
+	listEmpty->Signal(lock);
+    }
+}
+
+void
+SynchList::Removed(int count)
+{
+    for (; count > 0 && appenders > 0; count--) {
+	appenders--;
+	listFull->Signal(lock);
+    }
 }
 
 //----------------------------------------------------------------------
 // SynchList::Append
-//      Append an "item" to the end of the list.  Wake up anyone
-//	waiting for an element to be appended.
+//      Append an "item" to the end of the list, waiting for room if the
+//	list is bounded and full.  Wake up anyone waiting for an element
+//	to be appended.
 //
 //	"item" is the thing to put on the list, it can be a pointer to 
 //		anything.
@@ -54,8 +88,82 @@ void
 SynchList::Append(void *item)
 {
     lock->Acquire();		// enforce mutual exclusive access to the list 
+    while (capacity > 0 && size == capacity) {
+	appenders++;
+	listFull->Wait(lock);
+    }
     list->Append(item);
-    listEmpty->Signal(lock);	// wake up a waiter, if any
+    size++;
+    Added(1);			// wake up a waiter, if any
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchList::TryAppend
+//      Append an "item", unless the list is full.
+// Returns:
+//	FALSE if it was full, and "item" wasn't appended.
+//----------------------------------------------------------------------
+
+bool
+SynchList::TryAppend(void *item)
+{
+    bool room;
+
+    lock->Acquire();
+    room = (capacity == 0 || size < capacity);
+    if (room) {
+	list->Append(item);
+	size++;
+	Added(1);
+    }
+    lock->Release();
+    return room;
+}
+
+//----------------------------------------------------------------------
+// SynchList::AppendBatch
+//      Append "count" items, in order, holding the lock throughout
+//	unless the list fills up; then wait for room, and go on.
+//----------------------------------------------------------------------
+
+void
+SynchList::AppendBatch(void **items, int count)
+{
+    int i = 0, added = 0;
+
+    lock->Acquire();
+    while (i < count) {
+	if (capacity > 0 && size == capacity) {
+	    Added(added);		// let them make room
+	    added = 0;
+	    appenders++;
+	    listFull->Wait(lock);
+	    continue;
+	}
+	list->Append(items[i++]);
+	size++;
+	added++;
+    }
+    Added(added);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchList::SortedAppend
+//      Like Append, but keep the list sorted by "sortKey", lowest first;
+//	an item goes after those with the same key.  Only for lists that
+//	are never Appended to, and aren't bounded.
+//----------------------------------------------------------------------
+
+void
+SynchList::SortedAppend(void *item, int sortKey)
+{
+    ASSERT(capacity == 0);
+    lock->Acquire();
+    list->SortedInsert(item, sortKey);
+    size++;
+    Added(1);
     lock->Release();
 }
 
@@ -73,14 +181,71 @@ SynchList::Remove()
     void *item;
 
     lock->Acquire();			// enforce mutual exclusion
-    while (list->IsEmpty())
+    while (list->IsEmpty()) {
+	removers++;
 	listEmpty->Wait(lock);		// wait until list isn't empty
+    }
     item = list->Remove();
     ASSERT(item != NULL);
+    size--;
+    Removed(1);
+    lock->Release();
+    return item;
+}
+
+//----------------------------------------------------------------------
+// SynchList::TryRemove
+//      Remove an "item" from the beginning of the list, without waiting.
+// Returns:
+//	The removed item, or NULL if the list is empty.
+//----------------------------------------------------------------------
+
+void *
+SynchList::TryRemove()
+{
+    void *item;
+
+    lock->Acquire();			// enforce mutual exclusion
+    item = list->Remove();		// NULL if empty
+    if (item != NULL) {
+	size--;
+	Removed(1);
+    }
     lock->Release();
     return item;
 }
 
+//----------------------------------------------------------------------
+// SynchList::RemoveBatch
+//      Remove up to "max" items from the beginning of the list, in
+//	order, with one lock acquisition.  Waits until there is at least
+//	one, unless "wait" is FALSE.
+//
+//	"items" -- where to put them
+// Returns:
+//	How many were removed; 0 only if "wait" is FALSE and the list
+//	is empty.
+//----------------------------------------------------------------------
+
+int
+SynchList::RemoveBatch(void **items, int max, bool wait)
+{
+    int count = 0;
+
+    ASSERT(max > 0);
+    lock->Acquire();
+    while (wait && list->IsEmpty()) {
+	removers++;
+	listEmpty->Wait(lock);
+    }
+    while (count < max && !list->IsEmpty())
+	items[count++] = list->Remove();
+    size -= count;
+    Removed(count);
+    lock->Release();
+    return count;
+}
+
 //----------------------------------------------------------------------
 // SynchList::Mapcar
 //      Apply function to every item on the list.  Obey mutual exclusion
@@ -20,23 +20,53 @@
 //	1. Threads trying to remove an item from a list will
 //	wait until the list has an element on it.
 //	2. One thread at a time can access list data structures
+//	3. If the list is bounded, threads trying to append to a full
+//	list wait until there is room.
+//
+// A producer/consumer pipeline may move several items per lock
+// acquisition with AppendBatch and RemoveBatch.  Waiters are counted,
+// so a list nobody is waiting on is never signalled.
 
 class SynchList {
   public:
-    SynchList();		// initialize a synchronized list
+    SynchList(int maxItems = 0);	// initialize a synchronized list,
+				// holding at most "maxItems" items
+				// (0: any number)
     ~SynchList();		// de-allocate a synchronized list
 
     void Append(void *item);	// append item to the end of the list,
-				// and wake up any thread waiting in remove
+				// and wake up any thread waiting in remove;
+				// waits for room in a full bounded list
+    bool TryAppend(void *item);	// append item, if there is room; FALSE
+				// if the list is full
+    void AppendBatch(void **items, int count);
+				// append "count" items, in order, waiting
+				// for room as need be
+    void SortedAppend(void *item, int sortKey);
+				// put item on the list, sorted by
+				// "sortKey", lowest first
     void *Remove();		// remove the first item from the front of
 				// the list, waiting if the list is empty
+    void *TryRemove();		// remove the first item, if there is
+				// one; NULL if the list is empty
+    int RemoveBatch(void **items, int max, bool wait = TRUE);
+				// remove up to "max" items into "items";
+				// waits for the first, unless "wait" is
+				// FALSE.  Returns how many it got.
 				// apply function to every item in the list
     void Mapcar(VoidFunctionPtr func);
 
   private:
+    void Added(int count);	// Wake removers, after adding "count"
+    void Removed(int count);	// Wake appenders, after removing "count"
+
     List *list;			// the unsynchronized list
     Lock *lock;			// enforce mutual exclusive access to the list
     Condition *listEmpty;	// wait in Remove if the list is empty
+    Condition *listFull;	// wait in Append if the list is full
+    int capacity;		// most items it may hold; 0 if unbounded
+    int size;			// items on it
+    int removers, appenders;	// threads waiting on each condition
 };
 
 #endif // SYNCHLIST_H
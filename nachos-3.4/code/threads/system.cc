@@ -7,6 +7,13 @@
 
 #include "copyright.h"
 #include "system.h"
+#ifdef FILESYS
+#include "filehdr.h"
+#include "journal.h"
+#endif
+#ifdef USER_PROGRAM
+#include "swaparea.h"
+#endif
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -18,24 +25,51 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+Alarm *alarmClock;			// threads sleeping until some tick
+EventTrace *eventTrace = NULL;		// kernel event trace, if -tr
+InputLog *inputLog = NULL;		// outside input log, if -rec or -rep
+WorkQueue *workQueue;			// background work, run by a pool
+					// of -wq threads
+static char *statsFile = NULL;		// where to export statistics (-js)
 int threadChoice;
 int memChoice;
+int stackPoolMax = 16;			// stacks of dead threads to keep
+int coalesceEvents = 1;			// input interrupt coalescing (-irq):
+int coalesceTicks = 0;			// interrupt after this many events,
+					// or once the first is this old
 bool pageFlag;
 
-BitMap * memMap;
-
 #ifdef FILESYS_NEEDED
 FileSystem  *fileSystem;
 #endif
 
 #ifdef USER_PROGRAM
 Machine *machine;	// user program memory and registers
-List* activeThreads;
-int threadID;
+RefTrace *refTrace = NULL;	// page reference trace, if -rt
+ProcessTable *processTable;
+int swapMode;
+int readAheadMax = 4;
+bool pffEnabled = FALSE;
+bool twoLevelPageTables = FALSE;
+int profileInterval = 0;
+static Timer *profiler = NULL;		// samples user PCs, with -prof
+FrameReplacer *frameReplacer;
+CoreMap *coreMap;
+SwapArea *swapArea;
+FrameAllocator *frameAllocator = NULL;
+#endif
+
+#ifdef USE_TLB
+TLBManager *tlbManager;
 #endif
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+SynchDisk   *synchDisks[MaxDisks];
+int numDisks = 1;
+FileHeaderTable *headerTable;
+Journal *journal;
+static char *snapshotFile = NULL;	// where to save DISK at exit (-ds)
 #endif
 
 #ifdef NETWORK
@@ -47,12 +81,32 @@ PostOffice *postOffice;
 extern void Cleanup();
 
 
+//----------------------------------------------------------------------
+// ExportStats
+// 	Write every registered statistic to the -js file, from the
+//	SIGUSR1 handler, so a long run can be looked at while it goes on.
+//	The counters may be a tick apart from one another, which doesn't
+//	matter for this.
+//----------------------------------------------------------------------
+
+static void
+ExportStats()
+{
+#ifdef USER_PROGRAM
+    if (frameAllocator != NULL)
+	frameAllocator->Measure();
+#endif
+    stats->Export(statsFile);
+}
+
+
 //----------------------------------------------------------------------
 // TimerInterruptHandler
 // 	Interrupt handler for the timer device.  The timer device is
 //	set up to interrupt the CPU periodically (once every TimerTicks).
 //	This routine is called each time there is a timer interrupt,
-//	with interrupts disabled.
+//	with interrupts disabled.  It first wakes up threads whose
+//	Alarm sleep is over.
 //
 //	Note that instead of calling Yield() directly (which would
 //	suspend the interrupt handler, not the interrupted thread
@@ -67,10 +121,32 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(int dummy)
 {
-    if (interrupt->getStatus() != IdleMode)
+    alarmClock->WakeDue();
+    if (scheduler->NumCPUs() > 1)
+	scheduler->PreemptOtherCPUs();
+    if (interrupt->getStatus() != IdleMode && scheduler->QuantumExpired())
 	interrupt->YieldOnReturn();
 }
 
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// ProfileInterruptHandler
+// 	Interrupt handler for the profiler's timer (-prof): if the timer
+//	went off in the middle of a user program, charge one sample to
+//	the instruction it is about to run.  Time in the kernel, or idle,
+//	isn't sampled.
+//
+//	"dummy" is because every interrupt handler takes one argument.
+//----------------------------------------------------------------------
+static void
+ProfileInterruptHandler(int dummy)
+{
+    if (interrupt->getInterruptedStatus() == UserMode && 
+		currentThread->space != NULL)
+	currentThread->space->Sample(machine->ReadRegister(PCReg));
+}
+#endif
+
 //----------------------------------------------------------------------
 // Initialize
 // 	Initialize Nachos global data structures.  Interpret command
@@ -86,18 +162,47 @@ Initialize(int argc, char **argv)
 {
     int argCount;
     char* debugArgs = "";
+    bool debugBuffered = FALSE;	// buffer DEBUG output? (-db)
     bool randomYield = FALSE;
+    char *traceFile = NULL;	// where to write an event trace
+    char *inputFile = NULL;	// where to record or replay input
+    bool replay = FALSE;	// ... which of the two
+    SchedPolicy schedPolicy = SchedFIFO;
+    int timeSlice = 0;		// preempt every this many ticks (0: don't)
+    int numCPUs = 1;		// simulated processors
+    int cpuQuantum = 1;		// instructions per CPU per turn
+    bool directedYield = FALSE;	// hand off to the thread just woken
+    int numWorkers = DefaultWorkers;	// work queue threads
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool blockExec = FALSE;	// advance the clock once per basic block
+    int numTLB = TLBSize;	// TLB entries, if there is a TLB
+    int pageoutFree = 0;	// frames the pageout daemon keeps free
+    int swapCacheShare = 0;	// percent of memory for compressed swap
+    int mergeInterval = 0;	// ticks between same-page merging scans
+    char *costFile = NULL;	// what each class of instruction costs
+    char *refFile = NULL;	// where to write a page reference trace
+    int cacheShape[NumCacheKinds][3];	// L1 size, line size, ways; size
+    cacheShape[ICache][0] = cacheShape[DCache][0] = 0;	// 0: no cache
 	pageFlag = false;
 #endif
+#ifdef USE_TLB
+    TLBPolicy tlbPolicy = TLBFifo;	// how to pick a TLB entry to replace
+    int superpages = 1;			// most pages one TLB entry may map
+#endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    bool mapDisk = FALSE;	// mmap the DISK file
+    char *warmFile = NULL;	// snapshot to start DISK from
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
+    int coalesceDelay = 0;	// ticks to hold a packet for more mail
+    char *fabricFile = NULL;	// per-link reliability and latency
 #endif
     
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
@@ -109,6 +214,8 @@ Initialize(int argc, char **argv)
 	    	debugArgs = *(argv + 1);
 	    	argCount = 2;
 	    }
+	} else if (!strcmp(*argv, "-db")) {	// buffer debug output
+	    debugBuffered = TRUE;
 	} else if (!strcmp(*argv, "-rs")) {
 	    ASSERT(argc > 1);
 	    RandomInit(atoi(*(argv + 1)));	// initialize pseudo-random
@@ -127,17 +234,191 @@ Initialize(int argc, char **argv)
 	    else
 			memChoice = atoi(*(argv+1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-sp")) {	// 0 FIFO, 1 MLFQ, 2 stride
+	    ASSERT(argc > 1);
+	    schedPolicy = (SchedPolicy) atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ts")) {	// thread stacks to keep
+	    ASSERT(argc > 1);
+	    stackPoolMax = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tr")) {	// event trace file
+	    ASSERT(argc > 1);
+	    traceFile = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-js")) {	// statistics, as JSON
+	    ASSERT(argc > 1);
+	    statsFile = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-irq")) {	// coalesce input interrupts
+	    int parsed;
+
+	    ASSERT(argc > 1);
+	    parsed = sscanf(*(argv + 1), "%d,%d", &coalesceEvents,
+			&coalesceTicks);
+	    ASSERT(parsed == 2);
+	    ASSERT(coalesceEvents > 0 && coalesceTicks > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-rec") || !strcmp(*argv, "-rep")) {
+	    ASSERT(argc > 1);			// record or replay input
+	    inputFile = *(argv + 1);
+	    replay = !strcmp(*argv, "-rep");
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-q")) {	// time slice, in ticks
+	    ASSERT(argc > 1);
+	    timeSlice = atoi(*(argv + 1));
+	    ASSERT(timeSlice > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cpus")) {	// simulated processors
+	    ASSERT(argc > 1);
+	    numCPUs = atoi(*(argv + 1));
+	    ASSERT(numCPUs >= 1 && numCPUs <= MaxCPUs);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cq")) {	// CPU turn, in ticks
+	    ASSERT(argc > 1);
+	    cpuQuantum = atoi(*(argv + 1));
+	    ASSERT(cpuQuantum >= 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dy")) {	// directed yield
+	    directedYield = TRUE;
+	} else if (!strcmp(*argv, "-wq")) {	// work queue threads
+	    ASSERT(argc > 1);
+	    numWorkers = atoi(*(argv + 1));
+	    ASSERT(numWorkers >= 1);
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
 	if(!strcmp(*argv, "-E"))
 		pageFlag = true;
+	if (!strcmp(*argv, "-B"))
+	    blockExec = TRUE;
+	if (!strcmp(*argv, "-V")) {		// page replacement policy
+	    ASSERT(argc > 1);
+	    swapMode = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-pff"))		// per-process frame quotas
+	    pffEnabled = TRUE;
+	if (!strcmp(*argv, "-pt2"))		// two-level page tables
+	    twoLevelPageTables = TRUE;
+	if (!strcmp(*argv, "-po")) {		// run the pageout daemon
+	    ASSERT(argc > 1);
+	    pageoutFree = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-ksm")) {		// merge identical pages
+	    ASSERT(argc > 1);
+	    mergeInterval = atoi(*(argv + 1));
+	    ASSERT(mergeInterval > 0);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-zs")) {		// compressed swap cache
+	    ASSERT(argc > 1);
+	    swapCacheShare = atoi(*(argv + 1));
+	    ASSERT(swapCacheShare >= 0 && swapCacheShare < 100);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-ra")) {		// longest read-ahead, in pages
+	    ASSERT(argc > 1);
+	    readAheadMax = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-np")) {		// frames of physical memory
+	    ASSERT(argc > 1);
+	    numPhysPages = atoi(*(argv + 1));
+	    ASSERT(numPhysPages > 0);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-ps")) {		// page size, in bytes
+	    ASSERT(argc > 1);
+	    pageSize = atoi(*(argv + 1));
+	    ASSERT((pageSize > 0) && (pageSize % 4 == 0));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-l1i") || !strcmp(*argv, "-l1d")) {
+	    int *shape = cacheShape[strcmp(*argv, "-l1i") ? DCache : ICache];
+	    int parsed;
+
+	    ASSERT(argc > 1);			// size,line size,ways
+	    parsed = sscanf(*(argv + 1), "%d,%d,%d", &shape[0], &shape[1],
+			&shape[2]);
+	    ASSERT(parsed == 3);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-ic")) {		// instruction cost file
+	    ASSERT(argc > 1);
+	    costFile = *(argv + 1);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-rt")) {		// page reference trace file
+	    ASSERT(argc > 1);
+	    refFile = *(argv + 1);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-prof")) {		// sample user PCs, every n ticks
+	    ASSERT(argc > 1);
+	    profileInterval = atoi(*(argv + 1));
+	    ASSERT(profileInterval > 0);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    numTLB = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+#endif
+#ifdef USE_TLB
+	if (!strcmp(*argv, "-tp")) {		// 0 FIFO, 1 LRU, 2 clock
+	    ASSERT(argc > 1);
+	    tlbPolicy = (TLBPolicy) atoi(*(argv + 1));
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-sup")) {		// superpages of up to n pages
+	    ASSERT(argc > 1);
+	    superpages = atoi(*(argv + 1));
+	    ASSERT(superpages > 0 && (superpages & (superpages - 1)) == 0
+			&& superpages <= PageTableChunk);
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-dm"))		// memory-mapped DISK file
+	    mapDisk = TRUE;
+	if (!strcmp(*argv, "-nd")) {		// disks to stripe swap on
+	    ASSERT(argc > 1);
+	    numDisks = atoi(*(argv + 1));
+	    ASSERT(numDisks > 0 && numDisks <= MaxDisks);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-ssd"))		// time the disk as flash
+	    diskModel = DiskFlash;
+	if (!strcmp(*argv, "-dg")) {		// tracks,sectors per track
+	    int parsed;
+
+	    ASSERT(argc > 1);
+	    parsed = sscanf(*(argv + 1), "%d,%d", &numTracks,
+			&sectorsPerTrack);
+	    ASSERT(parsed == 2);
+	    ASSERT(numTracks >= DefaultNumTracks &&
+			sectorsPerTrack >= DefaultSectorsPerTrack);
+	    argCount = 2;
+	}
+	if (!strcmp(*argv, "-ds")) {		// snapshot DISK at exit
+	    ASSERT(argc > 1);
+	    snapshotFile = *(argv + 1);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dw")) {	// start from a snapshot
+	    ASSERT(argc > 1);
+	    warmFile = *(argv + 1);
+	    argCount = 2;
+	}
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -147,16 +428,33 @@ Initialize(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    netname = atoi(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-nc")) {
+	    ASSERT(argc > 1);
+	    coalesceDelay = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-nf")) {
+	    ASSERT(argc > 1);
+	    fabricFile = *(argv + 1);
+	    argCount = 2;
 	}
 #endif
     }
 
-    DebugInit(debugArgs);			// initialize DEBUG messages
+    DebugInit(debugArgs, debugBuffered);	// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
+    if (traceFile != NULL)
+	eventTrace = new EventTrace(traceFile, TraceSlots);
+    if (inputFile != NULL)
+	inputLog = new InputLog(inputFile, replay);
     interrupt = new Interrupt;			// start up interrupt handling
-    scheduler = new Scheduler();		// initialize the ready queue
-    if (randomYield)				// start the timer (if needed)
-	timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    scheduler = new Scheduler(schedPolicy,	// initialize the ready queue
+		(timeSlice > 0) ? timeSlice : TimerTicks, numCPUs, cpuQuantum,
+		directedYield);
+    if (randomYield || timeSlice > 0 || scheduler->NeedsTimer())
+	timer = new Timer(TimerInterruptHandler, 0, randomYield,  // start the
+		(timeSlice > 0) ? timeSlice : TimerTicks);	  // timer
+							// (if needed)
+    alarmClock = new Alarm;
 
     threadToBeDestroyed = NULL;
 	
@@ -169,26 +467,62 @@ Initialize(int argc, char **argv)
     currentThread->setStatus(RUNNING);
 
     interrupt->Enable();
+    workQueue = new WorkQueue("kernel", numWorkers);	// (no threads yet)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
+    if (statsFile != NULL)
+	CallOnStatsRequest(ExportStats);	// if someone sends SIGUSR1
 	
 #ifdef USER_PROGRAM
-	memMap = new BitMap(NumPhysPages);
-	machine = new Machine(debugUserProg);
+	frameAllocator = new FrameAllocator(memChoice, NumPhysPages);
+	machine = new Machine(debugUserProg, blockExec, numTLB);
+	if (refFile != NULL)
+	    refTrace = new RefTrace(refFile);
+	if (costFile != NULL)
+	    machine->ReadCosts(costFile);
+	for (int k = 0; k < NumCacheKinds; k++)
+	    if (cacheShape[k][0] > 0)
+		machine->cache[k] = new MemoryCache(cacheShape[k][0],
+				cacheShape[k][1], cacheShape[k][2]);
+	frameReplacer = new FrameReplacer(swapMode, NumPhysPages);
+	coreMap = new CoreMap(NumPhysPages);
+#ifdef USE_TLB
+	tlbManager = new TLBManager(tlbPolicy, superpages);
+#endif
 
 
-	activeThreads = new List();	// Make the active threads list.
-	threadID = 1; // Initialize our total number of active threads.
+	processTable = new ProcessTable();
+	if (profileInterval > 0)
+	    profiler = new Timer(ProfileInterruptHandler, 0, FALSE,
+				profileInterval, ProfileInt);
+	if (pageoutFree > 0 && swapMode != ReplaceNone)
+	    AddrSpace::StartPageout(pageoutFree);
+	if (mergeInterval > 0)
+	    AddrSpace::StartMerging(mergeInterval);
 #endif
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    if (warmFile != NULL)
+	CopyDiskImage(warmFile, "DISK");
+    synchDisk = synchDisks[0] = new SynchDisk("DISK", mapDisk);
+    for (int i = 1; i < numDisks; i++) {
+	char diskName[16];
+
+	sprintf(diskName, "DISK%d", i);
+	synchDisks[i] = new SynchDisk(diskName, mapDisk);
+    }
+    journal = new Journal;
+    headerTable = new FileHeaderTable;
 #endif
 
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
+#ifdef USER_PROGRAM
+    swapArea = new SwapArea(NumPhysPages * swapCacheShare / 100);
+					// (on the file system's disk)
+#endif
 
 #ifdef NETWORK
-    postOffice = new PostOffice(netname, rely, 10);
+    postOffice = new PostOffice(netname, rely, 10, coalesceDelay, fabricFile);
 #endif
 }
 
@@ -199,15 +533,26 @@ Initialize(int argc, char **argv)
 void
 Cleanup()
 {
+    DebugFlush();
     printf("\nCleaning up...\n");
+    if (statsFile != NULL)
+	stats->Export(statsFile);
 #ifdef NETWORK
     delete postOffice;
 #endif
     
+#ifdef USE_TLB
+    delete tlbManager;
+#endif
 #ifdef USER_PROGRAM
+    delete profiler;
+    delete swapArea;
+    delete frameReplacer;
+    delete coreMap;
+    delete refTrace;
     delete machine;
-	delete activeThreads;
-	delete memMap;
+	delete processTable;
+	delete frameAllocator;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -215,12 +560,22 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
-    delete synchDisk;
+    delete headerTable;
+    journal->Commit();			// whatever it is still holding
+    delete journal;
+    for (int i = numDisks - 1; i > 0; i--)
+	delete synchDisks[i];
+    delete synchDisk;			// (writes back the cache)
+    if (snapshotFile != NULL)
+	CopyDiskImage("DISK", snapshotFile);
 #endif
     
     delete timer;
+    delete alarmClock;
     delete scheduler;
     delete interrupt;
+    delete eventTrace;
+    delete inputLog;
     
     Exit(0);
 }
@@ -15,8 +15,12 @@
 #include "interrupt.h"
 #include "stats.h"
 #include "timer.h"
+#include "trace.h"
+#include "replay.h"
 #include "bitmap.h"
 #include "synch.h"
+#include "workqueue.h"
+#include "alarm.h"
 
 // Initialization and cleanup routines
 extern void Initialize(int argc, char **argv); 	// Initialization,
@@ -30,17 +34,41 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern Alarm *alarmClock;			// sleeping threads
+extern EventTrace *eventTrace;			// binary event trace, or NULL
+extern InputLog *inputLog;			// input record/replay, or NULL
+extern WorkQueue *workQueue;			// deferred kernel work
 extern int threadChoice;
 extern int memChoice;
+extern int stackPoolMax;			// most free thread stacks kept
+extern int coalesceEvents, coalesceTicks;	// console and network input
+						// interrupt coalescing
 extern bool pageFlag;
 
-extern BitMap *memMap;				//Bitmap to keep track of memory use
-
 #ifdef USER_PROGRAM
 #include "machine.h"
 extern Machine* machine;	// user program memory and registers
-extern List* activeThreads;	// active thread list for process management
-extern int threadID;	// unique process id
+extern RefTrace *refTrace;	// page reference trace, or NULL
+#include "proctable.h"
+extern ProcessTable *processTable;	// user processes, by ID
+extern int swapMode;	// page replacement policy (see framemgr.h)
+extern int readAheadMax;	// most pages to prefetch on a page fault
+extern bool pffEnabled;		// manage resident sets by fault frequency
+extern bool twoLevelPageTables;	// allocate page tables in chunks
+extern int profileInterval;	// ticks between PC samples (0: don't)
+#include "framemgr.h"
+extern FrameReplacer *frameReplacer;	// picks frames to evict
+#include "coremap.h"
+extern CoreMap *coreMap;	// who owns each frame
+#include "framealloc.h"
+extern FrameAllocator *frameAllocator;	// which frames are free
+class SwapArea;
+extern SwapArea *swapArea;	// backing store for modified pages
+#endif
+
+#ifdef USE_TLB
+#include "tlbmgr.h"
+extern TLBManager *tlbManager;	// refills the TLB on a TLB miss
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -51,6 +79,12 @@ extern FileSystem  *fileSystem;
 #ifdef FILESYS
 #include "synchdisk.h"
 extern SynchDisk   *synchDisk;
+extern SynchDisk   *synchDisks[];	// every disk; synchDisk is the first
+extern int numDisks;			// how many (-nd)
+class FileHeaderTable;
+extern FileHeaderTable *headerTable;	// headers of the open files
+class Journal;
+extern Journal *journal;		// log of metadata changes
 #endif
 
 #ifdef NETWORK
@@ -19,11 +19,27 @@
 #include "switch.h"
 #include "synch.h"
 #include "system.h"
+#include "slab.h"
 
 #define STACK_FENCEPOST 0xdeadbeef	// this is put at the top of the
 					// execution stack, for detecting 
 					// stack overflows
 
+// Stacks of deleted threads, kept for the next Fork instead of going
+// back to the host (up to stackPoolMax of them).  The first word of
+// each one points to the next.
+
+static int *freeStacks = NULL;
+static int numFreeStacks = 0;
+
+// The control blocks themselves are cached the same way, whatever
+// stackPoolMax says.
+
+static SlabCache threadCache("thread", sizeof(Thread));
+
+void *Thread::operator new(size_t size) { return threadCache.Alloc(size); }
+void Thread::operator delete(void *p) { threadCache.Free(p); }
+
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -38,12 +54,24 @@ Thread::Thread(char* threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    priority = 0;
+    sliceStart = 0;
+    userTicks = systemTicks = 0;
+    tickets = DefaultTickets;
+    pass = chargedTicks = 0;
+    cpu = -1;
+    rtPeriod = rtDeadline = rtCost = rtShare = rtJobTicks = 0;
+    rtRelease = rtDue = 0;
+    rtThrottled = rtQueued = FALSE;
+    listNext = listPrev = NULL;
+    listKey = 0;
 #ifdef USER_PROGRAM
     space = NULL;
-	parent = NULL;
 	ID = 0;
 	killNewChild = false;
-	isJoined = false;
+	joinStatus = 0;
+	for (int k = 0; k < NumCacheKinds; k++)
+		cacheRefs[k] = cacheMisses[k] = 0;
 #endif
 }
 
@@ -64,7 +92,13 @@ Thread::~Thread()
     //DEBUG('t', "Deleting thread \"%i\"\n", ID);
 
     ASSERT(this != currentThread);
-    if (stack != NULL)
+    if (stack == NULL)
+	return;
+    if (numFreeStacks < stackPoolMax) {		// keep it for the next Fork
+	*(int **) stack = freeStacks;
+	freeStacks = stack;
+	numFreeStacks++;
+    } else
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
 }
 
@@ -152,21 +186,11 @@ Thread::Finish ()
     //DEBUG('t', "Finishing thread \"%i\"\n", getID());
     
     threadToBeDestroyed = currentThread;
+    if (rtPeriod != 0)
+	(void) scheduler->SetRealTime(this, 0, 0, 0);	// give back its share
 #ifdef USER_PROGRAM
-	if(parent != NULL)	// Wake up the joined parent, if it exists.
-	{
-		//printf("Waking up thread %i\n", currentThread->getParent()->getID());
-		scheduler->WakeUpFromJoin(parent);
-	}
-
-	Thread * tempThread = new Thread("bleh!");
-	tempThread->setID(-1);
-	for (int i = 0; i < activeThreads->getSize(); i++)
-	{
-		tempThread = (Thread*)activeThreads->Remove();
-		if(tempThread != currentThread)
-			activeThreads->Append(tempThread);
-	}
+	processTable->Exit(ID, -1);	// Wake up any joiners, unless SC_Exit
+					// already did, with the real status
 #endif
     Sleep();					// invokes SWITCH
     // not reached
@@ -240,8 +264,18 @@ Thread::Sleep ()
     //DEBUG('t', "Sleeping thread \"%i\"\n", getID());
 
     status = BLOCKED;
-    while ((nextThread = scheduler->FindNextToRun()) == NULL)
+    if (rtPeriod != 0)
+	scheduler->EndJob(this);	// its job is done
+    if ((nextThread = scheduler->FindDirected()) != NULL) {
+	scheduler->Run(nextThread);	// straight to the thread we woke
+	return;
+    }
+    while ((nextThread = scheduler->FindNextToRun()) == NULL) {
+	if (scheduler->NumCPUs() > 1 && scheduler->HandOff())
+	    return;		// another CPU ran meanwhile, and someone
+				// has dispatched us again
 	interrupt->Idle();	// no one to run, wait for an interrupt
+    }
 
     scheduler->Run(nextThread); // returns when we've been signalled
 }
@@ -273,7 +307,12 @@ void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 void
 Thread::StackAllocate (VoidFunctionPtr func, int arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    if (freeStacks != NULL) {			// reuse a dead thread's
+	stack = freeStacks;
+	freeStacks = *(int **) stack;
+	numFreeStacks--;
+    } else
+	stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
@@ -314,14 +353,14 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 //
 //	Note that a user program thread has *two* sets of CPU registers -- 
 //	one for its state while executing user code, one for its state 
-//	while executing kernel code.  This routine saves the former.
+//	while executing kernel code.  This routine saves the former,
+//	in one copy of the whole register file.
 //----------------------------------------------------------------------
 
 void
 Thread::SaveUserState()
 {
-    for (int i = 0; i < NumTotalRegs; i++)
-	userRegisters[i] = machine->ReadRegister(i);
+    bcopy(machine->registers, userRegisters, sizeof(userRegisters));
 }
 
 //----------------------------------------------------------------------
@@ -336,13 +375,11 @@ Thread::SaveUserState()
 void
 Thread::RestoreUserState()
 {
-    for (int i = 0; i < NumTotalRegs; i++)
-	machine->WriteRegister(i, userRegisters[i]);
+    bcopy(userRegisters, machine->registers, sizeof(userRegisters));
+    machine->BreakLink();	// another thread may have stored meanwhile
 }
 
 void Thread::setID(int newID) {ID = newID;}	// Set a new ID.
 int Thread::getID() {return ID;}	// Return the ID.
-Thread* Thread::getParent() {return parent;}	// Return the parent.
-void Thread::setParent(Thread * newParent) {parent = newParent;}	// Set a new parent.
 
 #endif
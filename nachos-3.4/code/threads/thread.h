@@ -87,6 +87,8 @@ class Thread {
 					// NOTE -- thread being deleted
 					// must not be running when delete 
 					// is called
+    void *operator new(size_t size);	// Thread control blocks come
+    void operator delete(void *p);	// from a SlabCache
 
     // basic thread operations
 
@@ -100,11 +102,34 @@ class Thread {
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
     char* getName() { return (name); }
     void Print() { printf("%s, ", name); }
 	
 	void setID(int ID);	// Set a new ID.
-	bool isJoined;	// Used to determine if we've already joined to a child process.
+	int joinStatus;	// Exit status of the process we Joined, handed over by ProcessTable::Exit.
+	int priority;	// Ready queue to go on: 0 is the highest (see scheduler.h)
+	long long sliceStart;	// When it was last dispatched, for quanta
+	int userTicks;	// CPU time it has used running user code,
+	int systemTicks;	// and in the kernel
+	int tickets;	// Its share of the CPU, under stride scheduling
+	int pass;	// When it should run next, under stride scheduling
+	int chargedTicks;	// CPU time already added to "pass"
+	int cpu;	// CPU it last ran on, whose ready lists it goes on;
+			// -1 until it first runs (see scheduler.h)
+	int rtPeriod;	// In the real-time class (see scheduler.h) unless 0:
+	int rtDeadline;	// its period, its relative deadline, and the CPU
+	int rtCost;	// time it may use per job, in ticks
+	int rtShare;	// rtCost / rtDeadline, in RTScale units
+	long long rtRelease;	// When its current job was released,
+	long long rtDue;	// and when it must be done by
+	int rtJobTicks;	// Its CPU time (user and system) at the release
+	bool rtThrottled;	// Has the job used up rtCost?  Then it runs in
+			// the normal class until its next release
+	bool rtQueued;	// Is it on the scheduler's deadline heap?
+
+	Thread *listNext, *listPrev;	// Links for the ready list, or the
+	int listKey;			// queue it is waiting in (see list.h)
   private:
     // some of the private data for this class is listed above
     
@@ -124,19 +149,17 @@ class Thread {
 // while executing kernel code.
 
     int userRegisters[NumTotalRegs];	// user-level CPU register state
-	Thread * parent;	// The parent of this thread.  Used for Join.
-	
 	int ID;	// The unique ID of the thread.  Used for process management.
   public:
     void SaveUserState();		// save user-level register state
     void RestoreUserState();		// restore user-level register state
 	
-	void setParent(Thread * newParent);	// Set a new parent.
-	Thread * getParent();	// Return the parent.
 	int getID();	// Return the ID.
 
     AddrSpace *space;			// User code this thread is running.
 	bool killNewChild;	// Bool variable used in process initialization, saying if we should kill the child we just made.
+	long long cacheRefs[NumCacheKinds];	// Its accesses through the L1 caches (-l1i, -l1d),
+	long long cacheMisses[NumCacheKinds];	// and how many of them missed
 	
 	
 #endif
@@ -5,6 +5,8 @@
 //	back and forth between themselves by calling Thread::Yield, 
 //	to illustrate the inner workings of the thread system.
 //
+//	ThreadBenchmark (-tb) times the thread system's primitives.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -54,6 +56,10 @@ int numMeals;
 int philoAte;
 Semaphore ** chopsticks;
 bool * chops;
+
+// Ticks a thread sleeps for each round it used to spend Yielding, when
+// it is eating, thinking, hiding or getting its breath back.
+#define MealTicks	(10 * SystemTick)
 //----------------------------------------------------------------------
 // SimpleThread
 // 	Loop 5 times, yielding the CPU to another ready thread 
@@ -97,11 +103,7 @@ PhiloSema(int phID)
 			++philoAte;
 			printf("     %d Philosoraptor(s) has/have nommed so far.\n", philoAte);
 
-			while(timesToLoop > 0)
-			{
-				timesToLoop--;
-				currentThread->Yield();
-			}
+			alarmClock->Pause(timesToLoop * MealTicks);	// nom
 
 			timesToLoop = Random()%5 + 1;
 			}// end else
@@ -111,12 +113,8 @@ PhiloSema(int phID)
 		chopsticks[right]->V();
 		printf("   Philosoraptor %d has put down his right chopstick(#%d).\n", phID, right);
 
-		while(timesToLoop > 0)
-		{
-			printf("Philosoraptor %d is thinking, oddly enough.\n", phID);
-			--timesToLoop;
-			currentThread->Yield();
-		}
+		printf("Philosoraptor %d is thinking, oddly enough.\n", phID);
+		alarmClock->Pause(timesToLoop * MealTicks);
 		timesToLoop = Random()%5 + 1;
 	}// end big while
 
@@ -161,11 +159,7 @@ PhiloBusy(int phID)
 			++philoAte;
 			printf("     %d Philosoraptor(s) has/have nommed so far.\n", philoAte);
 
-			while(timesToLoop > 0)
-			{
-				timesToLoop--;
-				currentThread->Yield();
-			}
+			alarmClock->Pause(timesToLoop * MealTicks);	// nom
 
 			timesToLoop = Random()%5 + 1;
 			}// end else
@@ -175,12 +169,8 @@ PhiloBusy(int phID)
 		chops[right] = true;
 		printf("   Philosoraptor %d has put down his right chopstick(#%d).\n", phID, right);
 
-		while(timesToLoop > 0)
-		{
-			printf("Philosoraptor %d is thinking, oddly enough.\n", phID);
-			--timesToLoop;
-			currentThread->Yield();
-		}
+		printf("Philosoraptor %d is thinking, oddly enough.\n", phID);
+		alarmClock->Pause(timesToLoop * MealTicks);
 		timesToLoop = Random()%5 + 1;
 	}// end big while
 
@@ -234,10 +224,7 @@ humanStuff(int which)
 			if (choice==HIDE)
 			{
 				printf("Human %i is hiding!\n",which);
-				while(waitTime>0){
-					waitTime--;
-					currentThread->Yield();
-					}
+				alarmClock->Pause(waitTime * MealTicks);
 			}
 			else if (choice==RUN)
 			{
@@ -273,10 +260,7 @@ shoutingThreads(int threadNum)
 		
 		timesShouted++;
 		toShout = Random()%5+1;
-		while(toShout > 0) {
-			currentThread->Yield();
-			toShout--;
-		}
+		alarmClock->Pause(toShout * MealTicks);	// catch our breath
 	}
 }
 
@@ -563,12 +547,183 @@ ThreadTest()
 		
 		getInstrument = new Semaphore("Blah!",1);
 		
-		Thread *t = new Thread("bleh!");
 		for(int k = 0; k < numPlayers; k++){
-			t = new Thread("rock!");
+			Thread *t = new Thread("rock!");
 			t->Fork(RockBand, k);
 			}
 	}
 	else
 		printf("Invalid -A option.  Try again.\n");
 }
+
+//----------------------------------------------------------------------
+// ThreadBenchmark
+// 	Time the thread system's basic operations, without any prompts,
+//	to compare the scheduler and the synchronization primitives
+//	before and after a change:
+//	  fork -- fork a thread that finishes at once, and wait for it
+//	  yield -- two threads Yield back and forth
+//	  semaphore -- two threads hand a semaphore back and forth
+//	  lock -- "numThreads" threads take turns with one lock,
+//		yielding while they hold it, so that the others wait
+//	  broadcast -- "numThreads" threads wait on a condition, and
+//		are woken together by Broadcast
+//	Each runs BenchRounds rounds.  For each, print a line giving the
+//	operations done, and the simulated ticks and host nanoseconds
+//	they took, in columns: a sort of file for scripts to compare.
+//
+//	Each benchmark is forked in turn by a driver thread, which
+//	waits for its threads on "benchDone".
+//----------------------------------------------------------------------
+
+#define BenchRounds	1000		// rounds of each benchmark
+
+static Semaphore *benchDone;		// V'ed as each thread finishes
+static Semaphore *ping, *pong;		// (semaphore)
+static Lock *benchLock;			// (lock, broadcast)
+static Condition *wakeUp, *allWaiting;	// (broadcast)
+static int numBenchThreads, numWaiting;
+static long long startTicks, startNanos;
+
+static void
+BenchStart()
+{
+    startTicks = stats->totalTicks;
+    startNanos = HostNanoseconds();
+}
+
+static void
+BenchReport(char *name, int ops)
+{
+    long long ticks = stats->totalTicks - startTicks;
+    long long nanos = HostNanoseconds() - startNanos;
+
+    printf("%-10s %8d %10lld %12lld %10.2f %10.1f\n", name, ops, ticks, 
+		nanos, (double) ticks / ops, (double) nanos / ops);
+}
+
+static void
+BenchNothing(int arg)
+{
+    benchDone->V();
+}
+
+static void
+BenchYield(int arg)
+{
+    for (int i = 0; i < BenchRounds; i++)
+	currentThread->Yield();
+    benchDone->V();
+}
+
+static void
+BenchPing(int arg)
+{
+    for (int i = 0; i < BenchRounds; i++) {
+	if (arg == 0) {
+	    ping->V();
+	    pong->P();
+	} else {
+	    ping->P();
+	    pong->V();
+	}
+    }
+    benchDone->V();
+}
+
+static void
+BenchLock(int arg)
+{
+    for (int i = 0; i < BenchRounds; i++) {
+	benchLock->Acquire();
+	currentThread->Yield();
+	benchLock->Release();
+    }
+    benchDone->V();
+}
+
+static void
+BenchWaiter(int arg)
+{
+    for (int i = 0; i < BenchRounds; i++) {
+	benchLock->Acquire();
+	if (++numWaiting == numBenchThreads)
+	    allWaiting->Signal(benchLock);
+	wakeUp->Wait(benchLock);
+	benchLock->Release();
+    }
+    benchDone->V();
+}
+
+static void
+BenchDriver(int arg)
+{
+    int i;
+
+    printf("%-10s %8s %10s %12s %10s %10s\n", "#benchmark", "ops", "ticks",
+		"ns", "ticks/op", "ns/op");
+
+    BenchStart();
+    for (i = 0; i < BenchRounds; i++) {
+	(new Thread("bench fork"))->Fork(BenchNothing, 0);
+	benchDone->P();
+    }
+    BenchReport("fork", BenchRounds);
+
+    BenchStart();
+    for (i = 0; i < 2; i++)
+	(new Thread("bench yield"))->Fork(BenchYield, i);
+    for (i = 0; i < 2; i++)
+	benchDone->P();
+    BenchReport("yield", 2 * BenchRounds);
+
+    ping = new Semaphore("bench ping", 0);
+    pong = new Semaphore("bench pong", 0);
+    BenchStart();
+    for (i = 0; i < 2; i++)
+	(new Thread("bench semaphore"))->Fork(BenchPing, i);
+    for (i = 0; i < 2; i++)
+	benchDone->P();
+    BenchReport("semaphore", 2 * BenchRounds);
+    delete ping;
+    delete pong;
+
+    benchLock = new Lock("bench lock");
+    BenchStart();
+    for (i = 0; i < numBenchThreads; i++)
+	(new Thread("bench lock"))->Fork(BenchLock, i);
+    for (i = 0; i < numBenchThreads; i++)
+	benchDone->P();
+    BenchReport("lock", numBenchThreads * BenchRounds);
+
+    wakeUp = new Condition("bench wake up");
+    allWaiting = new Condition("bench all waiting");
+    numWaiting = 0;
+    BenchStart();
+    for (i = 0; i < numBenchThreads; i++)
+	(new Thread("bench waiter"))->Fork(BenchWaiter, i);
+    for (i = 0; i < BenchRounds; i++) {
+	benchLock->Acquire();
+	while (numWaiting < numBenchThreads)
+	    allWaiting->Wait(benchLock);
+	numWaiting = 0;
+	wakeUp->Broadcast(benchLock);
+	benchLock->Release();
+    }
+    for (i = 0; i < numBenchThreads; i++)
+	benchDone->P();
+    BenchReport("broadcast", BenchRounds);
+    delete wakeUp;
+    delete allWaiting;
+    delete benchLock;
+    delete benchDone;
+}
+
+void
+ThreadBenchmark(int numThreads)
+{
+    ASSERT(numThreads > 0);
+    numBenchThreads = numThreads;
+    benchDone = new Semaphore("bench done", 0);
+    (new Thread("bench driver"))->Fork(BenchDriver, 0);
+}
@@ -21,7 +21,13 @@
 #endif
 #endif
 
-static char *enableFlags = NULL; // controls which DEBUG messages are printed 
+unsigned int debugMask = 0;	// controls which DEBUG messages are printed 
+
+#define DebugBufferSize	16384		// debug output held before writing
+
+static bool debugBuffered = FALSE;	// hold messages in debugBuffer?
+static char debugBuffer[DebugBufferSize];
+static int debugUsed = 0;		// bytes of debugBuffer in use
 
 //----------------------------------------------------------------------
 // DebugInit
@@ -32,44 +38,76 @@ static char *enableFlags = NULL; // controls which DEBUG messages are printed
 //
 // 	"flagList" is a string of characters for whose DEBUG messages are 
 //		to be enabled.
+//	"buffered" -- collect the messages in a buffer, rather than
+//		writing each one out at once (-db)
 //----------------------------------------------------------------------
 
 void
-DebugInit(char *flagList)
+DebugInit(char *flagList, bool buffered)
 {
-    enableFlags = flagList;
+    debugBuffered = buffered;
+    debugMask = 0;
+    if (flagList == NULL)
+	return;
+    for (char *f = flagList; *f != '\0'; f++)
+	if (*f == '+')
+	    debugMask = DebugAll;
+	else
+	    debugMask |= DebugBit(*f);
 }
 
 //----------------------------------------------------------------------
-// DebugIsEnabled
-//      Return TRUE if DEBUG messages with "flag" are to be printed.
+// DebugPrint
+//      Print a debug message; or, when buffering, add it to the buffer,
+//	writing the buffer out first if the message won't fit.  Like 
+//	printf.  Called by DEBUG, once it has checked the message's flag.
 //----------------------------------------------------------------------
 
-bool
-DebugIsEnabled(char flag)
+void 
+DebugPrint(char *format, ...)
 {
-    if (enableFlags != NULL)
-       return (strchr(enableFlags, flag) != 0) 
-		|| (strchr(enableFlags, '+') != 0);
-    else
-      return FALSE;
+    va_list ap;
+    int len;
+
+    va_start(ap, format);
+    if (!debugBuffered) {
+	vfprintf(stdout, format, ap);
+	va_end(ap);
+	fflush(stdout);
+	return;
+    }
+    len = vsnprintf(debugBuffer + debugUsed, DebugBufferSize - debugUsed,
+			format, ap);
+    va_end(ap);
+    if (len < 0)
+	return;
+    if (debugUsed + len < DebugBufferSize) {	// it fit
+	debugUsed += len;
+	return;
+    }
+    DebugFlush();			// make room, and try again
+    va_start(ap, format);
+    if (len < DebugBufferSize)
+	debugUsed = vsnprintf(debugBuffer, DebugBufferSize, format, ap);
+    else {
+	vfprintf(stdout, format, ap);	// too big to buffer at all
+	fflush(stdout);
+    }
+    va_end(ap);
 }
 
 //----------------------------------------------------------------------
-// DEBUG
-//      Print a debug message, if flag is enabled.  Like printf,
-//	only with an extra argument on the front.
+// DebugFlush
+//      Write out the debug messages buffered so far.
 //----------------------------------------------------------------------
 
-void 
-DEBUG(char flag, char *format, ...)
+void
+DebugFlush()
 {
-    if (DebugIsEnabled(flag)) {
-	va_list ap;
-	// You will get an unused variable message here -- ignore it.
-	va_start(ap, format);
-	vfprintf(stdout, format, ap);
-	va_end(ap);
+    if (debugUsed > 0) {
+	fflush(stdout);			// keep our own output in order
+	fwrite(debugBuffer, 1, debugUsed, stdout);
 	fflush(stdout);
+	debugUsed = 0;
     }
 }
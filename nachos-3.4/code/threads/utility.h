@@ -14,6 +14,7 @@
 //   	'd' -- disk emulation (FILESYS)
 //   	'f' -- file system (FILESYS)
 //   	'a' -- address spaces (USER_PROGRAM)
+//   	'c' -- system calls (USER_PROGRAM)
 //   	'n' -- network emulation (NETWORK)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -57,13 +58,47 @@ typedef void (*VoidNoArgFunctionPtr)();
 #include "sysdep.h"				
 
 // Interface to debugging routines.
+//
+// Each debug flag is a bit in "debugMask", so testing one is a couple
+// of instructions, in line -- DEBUG sits on the simulator's hottest
+// paths.  Only the flags in DEBUG_COMPILED are compiled in at all; a
+// release build can add -DDEBUG_COMPILED=0 to CFLAGS to compile every
+// DEBUG out, or -DDEBUG_COMPILED="DebugBit('a')" to keep just one.
+//
+// Messages are written out at once, so they stay in order with the
+// program's own output.  With -db they are collected in a buffer
+// instead, and only written out when it fills up, at exit, or when an
+// ASSERT fails: much faster for a long trace, but the two no longer
+// interleave.
+
+#define DebugBit(flag)	(1u << ((flag) & 31))	// 'a'..'z' are all distinct
+#define DebugAll	(~0u)
+
+#ifndef DEBUG_COMPILED
+#define DEBUG_COMPILED	DebugAll	// flags that can be turned on with -d
+#endif
+
+extern unsigned int debugMask;		// flags turned on with -d
+
+extern void DebugInit(char* flags, bool buffered = FALSE);
+					// enable printing debug messages
 
-extern void DebugInit(char* flags);	// enable printing debug messages
+inline bool 
+DebugIsEnabled(char flag) 		// Is this debug flag enabled?
+{
+    return ((DEBUG_COMPILED & debugMask) & DebugBit(flag)) != 0;
+}
 
-extern bool DebugIsEnabled(char flag); 	// Is this debug flag enabled?
+extern void DebugPrint(char* format, ...);	// Print a debug message
+extern void DebugFlush();		// Write out the buffered messages
 
-extern void DEBUG (char flag, char* format, ...);  	// Print debug message 
-							// if flag is enabled
+// Print debug message if flag is enabled.  The arguments are only
+// evaluated if it is.
+#define DEBUG(flag, ...)						      \
+    do {								      \
+	if (DebugIsEnabled(flag))					      \
+	    DebugPrint(__VA_ARGS__);					      \
+    } while (0)
 
 //----------------------------------------------------------------------
 // ASSERT
@@ -77,6 +112,7 @@ extern void DEBUG (char flag, char* format, ...);  	// Print debug message
     if (!(condition)) {                                                       \
         fprintf(stderr, "Assertion failed: line %d, file \"%s\"\n",           \
                 __LINE__, __FILE__);                                          \
+	DebugFlush();							      \
 	fflush(stderr);							      \
         Abort();                                                              \
     }
@@ -0,0 +1,217 @@
+// workqueue.cc
+//	Routines for deferred kernel work.  See workqueue.h.
+//
+//	"idle" and "pending" are only touched with interrupts off, which
+//	is all it takes on a uniprocessor; the items themselves are
+//	protected by the SynchList.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "workqueue.h"
+#include "slab.h"
+
+// One piece of deferred work.
+
+class WorkItem {
+  public:
+    void *operator new(size_t size);	// From itemCache
+    void operator delete(void *p);
+
+    VoidFunctionPtr func;
+    int arg;
+    int priority;
+    WorkQueue *queue;			// for a delayed item's timer
+};
+
+static SlabCache itemCache("work", sizeof(WorkItem));
+
+void *WorkItem::operator new(size_t size) { return itemCache.Alloc(size); }
+void WorkItem::operator delete(void *p) { itemCache.Free(p); }
+
+//----------------------------------------------------------------------
+// WorkerHelper, TimerHelper, DelayTimer
+// 	Dummy functions because C++ can't indirectly invoke member
+//	functions.  The first two are forked as the queue's threads; the
+//	last is a delayed item's interrupt handler.
+//
+//	"arg" -- pointer to the WorkQueue, or to the WorkItem
+//----------------------------------------------------------------------
+
+static void WorkerHelper(int arg)
+{ WorkQueue *q = (WorkQueue *) arg; q->WorkerLoop(); }
+static void TimerHelper(int arg)
+{ WorkQueue *q = (WorkQueue *) arg; q->TimerLoop(); }
+static void DelayTimer(int arg)
+{ WorkItem *item = (WorkItem *) arg; item->queue->TimerExpired(item); }
+
+//----------------------------------------------------------------------
+// WorkQueue::WorkQueue
+// 	Initialize an empty work queue.  Its threads are forked as work
+//	comes in.
+//
+//	"debugName" -- for debugging
+//	"poolSize" -- the most items that run at once
+//----------------------------------------------------------------------
+
+WorkQueue::WorkQueue(char *debugName, int poolSize)
+{
+    ASSERT(poolSize > 0);
+    name = debugName;
+    maxWorkers = poolSize;
+    idle = pending = 0;
+    ready = new SynchList;
+    expired = new List;
+    numExpired = new Semaphore("work expired", 0);
+    timerStarted = FALSE;
+
+    numQueued = numDelayed = numRun = numWorkers = 0;
+    stats->Register("work.queued", &numQueued);
+    stats->Register("work.delayed", &numDelayed);
+    stats->Register("work.run", &numRun);
+    stats->Register("work.workers", &numWorkers);
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::Queue
+// 	Have func(arg) called by a worker thread, after every item of
+//	higher priority and every one of the same priority queued so far.
+//	Never waits, so it may be called with locks held -- though not
+//	from an interrupt handler.
+//----------------------------------------------------------------------
+
+void
+WorkQueue::Queue(VoidFunctionPtr func, int arg, int priority)
+{
+    WorkItem *item = new WorkItem;
+
+    item->func = func;
+    item->arg = arg;
+    item->priority = priority;
+    item->queue = this;
+    numQueued++;
+    Ready(item);
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::QueueDelayed
+// 	Like Queue, but the item only becomes ready "ticks" ticks from now
+//	(and may then wait behind others).
+//----------------------------------------------------------------------
+
+void
+WorkQueue::QueueDelayed(VoidFunctionPtr func, int arg, int ticks,
+			int priority)
+{
+    WorkItem *item;
+
+    if (ticks <= 0) {
+	Queue(func, arg, priority);
+	return;
+    }
+    if (!timerStarted) {
+	timerStarted = TRUE;
+	(new Thread("work timer"))->Fork(TimerHelper, (int) this);
+    }
+    item = new WorkItem;
+    item->func = func;
+    item->arg = arg;
+    item->priority = priority;
+    item->queue = this;
+    numQueued++;
+    numDelayed++;
+    interrupt->Schedule(DelayTimer, (int) item, ticks, WorkInt);
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::Ready
+// 	Put "item" on the ready list, highest priority first.  If there
+//	are more items than idle workers to take them, and the pool isn't
+//	full yet, start another worker.
+//----------------------------------------------------------------------
+
+void
+WorkQueue::Ready(WorkItem *item)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    bool start = FALSE;
+
+    pending++;
+    if (pending > idle && numWorkers < maxWorkers) {
+	numWorkers++;
+	idle++;				// it will be, soon
+	start = TRUE;
+    }
+    (void) interrupt->SetLevel(oldLevel);
+
+    if (start) {
+	DEBUG('t', "Work queue %s: starting worker %lld\n", name, numWorkers);
+	(new Thread("worker"))->Fork(WorkerHelper, (int) this);
+    }
+    ready->SortedAppend((void *) item, WorkHigh - item->priority);
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::WorkerLoop
+// 	A worker thread: run ready items, one at a time, forever.
+//----------------------------------------------------------------------
+
+void
+WorkQueue::WorkerLoop()
+{
+    WorkItem *item;
+    IntStatus oldLevel;
+
+    for (;;) {
+	item = (WorkItem *) ready->Remove();
+	oldLevel = interrupt->SetLevel(IntOff);
+	idle--;
+	pending--;
+	(void) interrupt->SetLevel(oldLevel);
+
+	numRun++;
+	(*item->func)(item->arg);
+	delete item;
+
+	oldLevel = interrupt->SetLevel(IntOff);
+	idle++;
+	(void) interrupt->SetLevel(oldLevel);
+    }
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::TimerExpired
+// 	Delayed item interrupt handler: hand the item to the work timer.
+//	Runs with interrupts off.
+//----------------------------------------------------------------------
+
+void
+WorkQueue::TimerExpired(WorkItem *item)
+{
+    expired->Append((void *) item);
+    numExpired->V();
+}
+
+//----------------------------------------------------------------------
+// WorkQueue::TimerLoop
+// 	The work timer thread: put each delayed item whose time has come
+//	on the ready list.
+//----------------------------------------------------------------------
+
+void
+WorkQueue::TimerLoop()
+{
+    WorkItem *item;
+    IntStatus oldLevel;
+
+    for (;;) {
+	numExpired->P();
+	oldLevel = interrupt->SetLevel(IntOff);
+	item = (WorkItem *) expired->Remove();
+	(void) interrupt->SetLevel(oldLevel);
+	Ready(item);
+    }
+}
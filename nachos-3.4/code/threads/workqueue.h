@@ -0,0 +1,79 @@
+// workqueue.h
+//	Data structures for deferred kernel work.  Instead of forking a
+//	thread of its own, a part of the kernel with something to do in
+//	the background hands it to the work queue as a "work item": a
+//	function and its argument.  A pool of worker threads runs the
+//	items, highest priority first, and in the order they were queued
+//	within a priority.
+//
+//	An item may also be queued to become ready some ticks from now,
+//	on a one-shot timer interrupt.  The interrupt handler can't take
+//	the queue's lock, so it only hands the item to a "work timer"
+//	thread, which queues it.
+//
+//	Workers are started as they are needed, up to the size of the
+//	pool (-wq), and are never stopped; an item that waits holds its
+//	worker meanwhile.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "copyright.h"
+#include "list.h"
+#include "synchlist.h"
+
+#define WorkLow		0		// work item priorities
+#define WorkNormal	1
+#define WorkHigh	2
+
+#define DefaultWorkers	2		// pool size, by default
+
+class WorkItem;
+
+// The following class defines a queue of work items and the threads
+// that run them.
+
+class WorkQueue {
+  public:
+    WorkQueue(char *debugName, int poolSize = DefaultWorkers);
+					// An empty queue; no threads yet
+
+    void Queue(VoidFunctionPtr func, int arg, int priority = WorkNormal);
+					// Run func(arg) in a worker soon
+    void QueueDelayed(VoidFunctionPtr func, int arg, int ticks,
+		      int priority = WorkNormal);
+					// ... but not for "ticks" ticks
+
+    void WorkerLoop();			// A worker thread's work
+    void TimerLoop();			// The work timer thread's work
+    void TimerExpired(WorkItem *item);	// Called by a delayed item's
+					// timer interrupt handler
+
+    // Statistics, registered as "work.*".
+    long long numQueued;		// items queued, delayed or not
+    long long numDelayed;		// ... of them delayed
+    long long numRun;			// items run
+    long long numWorkers;		// worker threads started
+
+  private:
+    void Ready(WorkItem *item);		// Put an item on "ready", and
+					// start a worker for it if need be
+
+    char *name;
+    int maxWorkers;			// size of the pool
+    int idle;				// workers waiting in WorkerLoop for
+					// an item, counting ones about to
+    int pending;			// items on "ready"
+
+    SynchList *ready;			// items to run, by priority
+    List *expired;			// delayed items whose time has come,
+					// for the work timer; interrupts off
+    Semaphore *numExpired;		// ... how many there are
+    bool timerStarted;			// has the work timer been forked?
+};
+
+#endif // WORKQUEUE_H
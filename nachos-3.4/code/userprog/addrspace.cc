@@ -18,7 +18,10 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
-#include "noff.h"
+#include "swaparea.h"
+#include "pipe.h"
+#include "aio.h"
+#include "syscall.h"
 #include <stdio.h>
 
 //----------------------------------------------------------------------
@@ -43,6 +46,41 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// SegmentEnd, CodePages, Covers
+// 	The layout of a NOFF file's segments in the address space.
+//	SegmentEnd is the first virtual address past a segment.
+//	CodePages is how many pages from 0 on hold nothing but code: if
+//	the data starts on a fresh page (coff2noff -a), that includes the
+//	last, partly filled, code page.  Covers says whether a segment
+//	fills the whole page at "pageAddr".
+//----------------------------------------------------------------------
+
+static unsigned int
+SegmentEnd(Segment *seg)
+{
+    return (seg->size > 0) ? seg->virtualAddr + seg->size : 0;
+}
+
+static int
+CodePages(NoffHeader *noffH)
+{
+    int pages = divRoundUp(SegmentEnd(&noffH->code), PageSize);
+
+    if (noffH->initData.size > 0)
+	pages = min(pages, noffH->initData.virtualAddr / PageSize);
+    if (noffH->uninitData.size > 0)
+	pages = min(pages, noffH->uninitData.virtualAddr / PageSize);
+    return pages;
+}
+
+static bool
+Covers(Segment *seg, int pageAddr)
+{
+    return seg->size > 0 && seg->virtualAddr <= pageAddr
+		&& pageAddr + PageSize <= seg->virtualAddr + seg->size;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -55,68 +93,341 @@ SwapHeader (NoffHeader *noffH)
 //	memory.  For now, this is really simple (1:1), since we are
 //	only uniprogramming, and we have a single unsegmented page table
 //
-//	"executable" is the file containing the object code to load into memory
+//	"executable" is the file containing the object code to load into memory;
+//	the address space keeps it open to load pages on demand, and closes
+//	it when the address space is deleted.
+//
+//	"name" is the file name of the executable; every address space
+//	started from the same name shares one copy of the code pages.
+//	NULL means don't share.
+//
+//	"sibling", if not NULL, is an address space made from "executable"
+//	already; we take its copy of the header instead of reading it
+//	again, and share the open file with it.
 //----------------------------------------------------------------------
 
-extern int swapMode;
-static Semaphore invPageTableSemaphore("Inverted Page Table", 1);
+// invPageTableLock protects the core map and every page table.
+// It is not held across disk I/O: a frame whose contents are being read 
+// or written is marked busy instead, so it can't be chosen as a victim,
+// and a fault on a page in transit waits for that frame alone.  It
+// lends the priority of a faulting thread to whoever holds it, so a
+// fault doesn't wait on a low priority thread that can't get the CPU.
+
+static PriorityLock invPageTableLock("Inverted Page Table");
+
+// The code pages of an executable, shared read-only by every address
+// space running it.  Only pages lying entirely inside the code segment
+// are shared; a page that also holds initialized data is private.
+// Entry "i" here describes virtual page "i" in each user's page table.
+
+class SharedText {
+  public:
+    char *name;				// executable the pages came from
+    int numPages;			// number of shared pages
+    int *frame;				// frame holding each page, or -1
+    TranslationEntry *entry;		// what the frame replacer sees for
+					// each resident page
+    AddrSpace **users;			// spaces mapping these pages
+    int numUsers, maxUsers;
+    SharedText *next;			// next executable in textCache
+};
+
+static SharedText *textCache = NULL;	// every executable now running
+
+// A shared memory segment (ShmAttach).  Its frames are taken when it is
+// made, and stay in memory until the last address space using it exits:
+// the frame replacer never sees them, so their physical addresses don't
+// change, and the futex wait queues can be keyed by them.
+
+class SharedSegment {
+  public:
+    int key;				// what ShmAttach calls it
+    int numPages;
+    int *frame;				// the frame holding each page
+    int refs;				// address spaces attached to it
+    SharedSegment *next;		// next one in segmentList
+};
+
+static SharedSegment *segmentList = NULL;	// every segment in use
+
+// Threads sleeping in FutexWait, hashed by the physical address of the
+// word they wait on, which is kept in their listKey.
+static IntrusiveList<Thread> futexQueues[FutexBuckets];
+
+#define MaxReadAhead	16		// longest read-ahead, in pages
+
+// Resident set management (-pff).  Each address space may own up to
+// "quota" frames; past that, its faults replace its own pages.  Faults 
+// closer together than PFFGrowTicks raise the quota, faults further apart 
+// than PFFShrinkTicks lower it.  If the quotas add up to more than 
+// physical memory, the faulting process is swapped out until someone 
+// exits or shrinks.
+
+#define PFFGrowTicks	500
+#define PFFShrinkTicks	5000
+#define PFFMinQuota	2
+#define PFFInitialQuota	4
+
+// The pageout daemon (-po) evicts pages ahead of demand, writing back
+// the dirty ones, so that faults usually find a free frame and only 
+// have to read.  It is woken when fewer than pageoutLow frames are free, 
+// and works until pageoutHigh are.
+
+static int pageoutLow = 0, pageoutHigh = 0;	// 0: no daemon
+static bool pageoutPending = FALSE;	// is the daemon queued?
+
+// Same-page merging (-ksm).  Every mergeInterval ticks while processes
+// are running, a work item hashes the contents of the frames holding
+// private pages, and maps pages with the same contents to one frame,
+// copy-on-write, as if they had been shared by a Fork; the others are
+// freed.  All the zero pages end up in one shared zero frame this way.
+
+static int mergeInterval = 0;		// 0: no merging
+static bool mergePending = FALSE;	// is a scan queued?
+static long long numMergeScans = 0, numMerged = 0, numZeroMerged = 0;
+
+static int totalQuota = 0;		// quotas of the running spaces
+static int runningSpaces = 0;		// spaces that aren't suspended
+static List suspendedThreads;		// threads waiting for memory
 
-static struct {
-	int time;
-	int process;
-	Thread* processThread;
-	int page;
-} invPageTable[32];
+//----------------------------------------------------------------------
+// NotBusy
+// 	FrameFilter for global replacement: frames with I/O in progress
+//	can't be taken.
+//----------------------------------------------------------------------
 
-AddrSpace::AddrSpace(OpenFile *executable)
+static bool
+NotBusy(int frame, int)
 {
-	static int invPageTableNotYetLoaded = 1;
-	if(invPageTableNotYetLoaded) {
-		
-		invPageTableSemaphore.P();
+    return !coreMap->entry[frame].busy;
+}
 
-		for(int i = 0; i < 32; i++) {
-			invPageTable[i].time = 0;
-			invPageTable[i].process = -1;
-			invPageTable[i].page = -1;
-			invPageTable[i].processThread = NULL;
-		}
+//----------------------------------------------------------------------
+// OwnedBy
+// 	FrameFilter for local replacement: is "frame" a private page of 
+//	the address space "space"?
+//----------------------------------------------------------------------
 
-		invPageTableNotYetLoaded = 0;
-		
-		invPageTableSemaphore.V();
-	}
+static bool
+OwnedBy(int frame, int space)
+{
+    return !coreMap->entry[frame].busy && 
+	coreMap->entry[frame].space == (AddrSpace *) space;
+}
 
+AddrSpace::AddrSpace(OpenFile *executable, char *name, AddrSpace *sibling)
+{
 	pageTable = NULL;
+	pageDir = NULL;
+	swapReserved = FALSE;
+	exeFile = executable;
+	args = NULL;
+	argSize = argCount = 0;
+	nextFault = -1;
+	readAhead = 0;
+	resident = 0;
+	quota = PFFInitialQuota;
+	lastFaultTick = stats->totalTicks;
+	suspended = FALSE;
+	refs = 1;			// the process's
+	exiting = FALSE;
+	for (int fd = 0; fd < MaxOpenFiles; fd++) {
+		openFiles[fd] = NULL;
+		openPipes[fd] = NULL;
+	}
+	for (int r = 0; r < MaxAioRequests; r++)
+		aio[r] = NULL;
+	totalQuota += quota;
+	runningSpaces++;
+	ScheduleMerge();
+	for (int m = 0; m < MaxMappings; m++) {
+		mappings[m].file = NULL;
+		mappings[m].name = NULL;
+	}
+	for (int s = 0; s < MaxSegments; s++)
+		segments[s] = NULL;
+	exeName = NULL;
+	if (name != NULL) {
+		exeName = new char[strlen(name) + 1];
+		strcpy(exeName, name);
+	}
+	text = NULL;
 
-    NoffHeader noffH;
     unsigned int i, size;
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
+    if (sibling != NULL) {
+	ASSERT(sibling->exeFile == executable);
+	noffH = sibling->noffH;
+	exeUsers = sibling->exeUsers;
+	(*exeUsers)++;
+    } else {
+	executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
+	if ((noffH.noffMagic != NOFFMAGIC) && 
 		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+	    SwapHeader(&noffH);
+	ASSERT(noffH.noffMagic == NOFFMAGIC);
+	exeUsers = new int(1);
+    }
 
-// how big is address space?
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size + UserStackSize;
+// how big is address space?  (with "coff2noff -a", there may be a gap
+// between the code and the data)
+    size = max(SegmentEnd(&noffH.code), SegmentEnd(&noffH.initData));
+    size = max(size, SegmentEnd(&noffH.uninitData)) + UserStackSize;
 
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
+    heapStart = heapEnd = size;		// Sbrk grows the space from here
+    mapNext = heapStart + MaxHeapSize;
 
 	// first, set up the translation
-    pageTable = new TranslationEntry[numPages];
+    AllocatePageTable();
+    swapSlot = new int[numPages];
+    inSwap = new bool[numPages];
+    copyOnWrite = new bool[numPages];
+    inTransit = new int[numPages];
     for (i = 0; i < numPages; i++) {
-		pageTable[i].virtualPage = i;
-		//pageTable[i].physicalPage = i + startPage;
-		pageTable[i].valid = FALSE;
-		pageTable[i].use = FALSE;
-		pageTable[i].dirty = FALSE;
-		pageTable[i].readOnly = FALSE;  // if the code segment was entirely on 
-						// a separate page, we could set its 
-						// pages to be read-only
+		swapSlot[i] = -1;
+		inSwap[i] = FALSE;
+		copyOnWrite[i] = FALSE;
+		inTransit[i] = -1;
     }
 
+	// pages that hold nothing but code can be shared with other
+	// instances of this program; the code segment starts at 0
+	if (noffH.code.virtualAddr == 0 && name != NULL)
+		AttachText(name, CodePages(&noffH));
+	InitProfile();
+#ifdef USE_TLB
+	InitSuperpages();
+	asid = 0;
+	asidGeneration = -1;
+#endif
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create a duplicate of another address space, for Fork.  Nothing is
+//	copied up front: every page the parent has in memory is shared,
+//	read-only, until one of the two writes it (see CopyOnWrite).  Pages
+//	the parent has swapped out are copied into swap slots of our own,
+//	and the rest come from the executable, just as for the parent.
+//
+//	"parent" -- the address space to duplicate
+//	"ID" -- the child's process id
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent, int ID)
+{
+    unsigned int i;
+
+    ASSERT(parent->exeName != NULL);
+    exeName = new char[strlen(parent->exeName) + 1];
+    strcpy(exeName, parent->exeName);
+    exeFile = fileSystem->Open(exeName);
+    ASSERT(exeFile != NULL);
+    exeUsers = new int(1);
+    noffH = parent->noffH;
+    args = NULL;			// the child goes on from Fork, with
+    argSize = argCount = 0;		// the parent's stack
+    numPages = parent->numPages;
+    heapStart = parent->heapStart;
+    heapEnd = parent->heapEnd;
+    mapNext = parent->mapNext;
+    for (i = 0; i < MaxMappings; i++) {	// the child maps the same files,
+	mappings[i] = parent->mappings[i];	// with its own OpenFiles
+	if (mappings[i].file == NULL)
+	    continue;
+	mappings[i].name = new char[strlen(parent->mappings[i].name) + 1];
+	strcpy(mappings[i].name, parent->mappings[i].name);
+	mappings[i].file = fileSystem->Open(mappings[i].name);
+    }
+    swapReserved = FALSE;
+    text = NULL;
+    nextFault = -1;
+    readAhead = 0;
+    resident = 0;
+    quota = PFFInitialQuota;
+    lastFaultTick = stats->totalTicks;
+    suspended = FALSE;
+    refs = 1;
+    exiting = FALSE;
+    for (i = 0; i < MaxOpenFiles; i++) {	// the child starts with just
+	openFiles[i] = NULL;		// the console, wherever the
+	openPipes[i] = NULL;		// parent's goes
+    }
+    for (i = 0; i < MaxAioRequests; i++)	// nor the parent's requests
+	aio[i] = NULL;
+    InheritConsole(parent, ConsoleInput, ConsoleOutput);
+    totalQuota += quota;
+    runningSpaces++;
+    ScheduleMerge();
+
+    AllocatePageTable();
+    swapSlot = new int[numPages];
+    inSwap = new bool[numPages];
+    copyOnWrite = new bool[numPages];
+    inTransit = new int[numPages];
+    if (parent->text != NULL)
+	AttachText(exeName, parent->text->numPages);
+    InitProfile();			// the child's samples are its own
+#ifdef USE_TLB
+    InitSuperpages();
+    asid = 0;
+    asidGeneration = -1;
+#endif
+
+    invPageTableLock.Acquire();
+    for (i = 0; i < MaxSegments; i++) {	// shared memory stays shared
+	segments[i] = parent->segments[i];
+	segmentPage[i] = parent->segmentPage[i];
+	if (segments[i] != NULL)
+	    segments[i]->refs++;
+    }
+    parent->WaitForTransit();		// its swap slots must be up to date
+#ifdef USE_TLB
+    tlbManager->FlushSpace(parent->asid, parent->asidGeneration);
+					// get the parent's dirty bits, and
+					// drop its writable TLB entries
+#endif
+    for (i = 0; i < numPages; i++) {
+	TranslationEntry *pte = parent->FindEntry(i);
+
+	swapSlot[i] = -1;
+	inSwap[i] = FALSE;
+	copyOnWrite[i] = FALSE;
+	inTransit[i] = -1;
+	if (pte == NULL && !parent->inSwap[i])
+	    continue;			// never touched by the parent
+	if (pte != NULL) {
+	    *Entry(i) = *pte;
+	    Entry(i)->use = FALSE;
+	}
+	if (IsSharedPage(i) || IsSegmentPage(i))
+	    continue;			// already shared
+	if (pte != NULL && pte->valid) {
+	    FrameOwner *o = new FrameOwner;
+
+	    o->space = this;
+	    o->page = i;
+	    o->next = coreMap->entry[pte->physicalPage].sharers;
+	    coreMap->entry[pte->physicalPage].sharers = o;
+
+	    // our backing copy is the executable, so the page is dirty
+	    // for us if the parent has changed it at all
+	    Entry(i)->dirty = pte->dirty || parent->inSwap[i];
+	    pte->readOnly = Entry(i)->readOnly = TRUE;
+	    parent->copyOnWrite[i] = copyOnWrite[i] = TRUE;
+	} else if (parent->inSwap[i]) {
+	    char *buffer = new char[PageSize];
+
+	    swapArea->Read(parent->swapSlot[i], buffer, 1);
+	    swapArea->Write(SwapSlot(i), buffer);
+	    inSwap[i] = TRUE;
+	    delete [] buffer;
+	}
+    }
+    machine->FlushXlateCache();
+    invPageTableLock.Release();
 }
  
 
@@ -124,30 +435,121 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
 
 //----------------------------------------------------------------------
-// AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// AddrSpace::Exit
+// 	The process is done with this address space: give back its frames
+//	and its share of the code pages, and drop the process's reference.
+//	Evictions still writing our pages to swap hold references of their
+//	own, so the address space (and its swap slots) goes away once the 
+//	last of them finishes, not before.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Exit()
+{
+#ifdef USE_TLB
+	tlbManager->FlushSpace(asid, asidGeneration);
+				// the TLB may point into our page table
+#endif
+	for (int id = 0; id < MaxOpenFiles; id++)
+		(void) CloseFile(id);	// waits for their requests
+	for (int r = 0; r < MaxAioRequests; r++)
+		if (aio[r] != NULL)
+			RemoveAio(r);
+
+	invPageTableLock.Acquire();
+	for (int m = 0; m < MaxMappings; m++)
+		if (mappings[m].file != NULL)
+			Unmap(&mappings[m]);	// before we stop writing pages
+	exiting = TRUE;
+	for(unsigned i = 0; i < numPages; i++) {
+		TranslationEntry *pte = FindEntry(i);
+
+		if (pte == NULL)
+			continue;
+		if(pte->valid == 1 && copyOnWrite[i] && UnmapCow(i))
+			;	// someone else still has the frame
+		else if(pte->valid == 1 && !IsSharedPage(i) && !IsSegmentPage(i)) {
+			frameAllocator->Free(pte->physicalPage);
+			frameReplacer->Freed(pte->physicalPage);
+			coreMap->ClearOwner(pte->physicalPage);
+		}
+		pte->valid = 0;
+		pte->dirty = 0;
+	}
+	if (text != NULL)
+		DetachText();
+	DetachSegments();
+	if (!suspended) {
+		totalQuota -= quota;
+		runningSpaces--;
+	}
+	if (DebugIsEnabled('a'))
+		frameAllocator->Print();
+	machine->FlushXlateCache();
+	Drop();
+	invPageTableLock.Release();
+	ResumeSuspended();		// our frames are free now
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Hold, AddrSpace::Drop
+// 	Count the references to this address space: one for the process,
+//	plus one for each eviction in the middle of writing one of our 
+//	pages.  The last Drop deletes it.  Both are called holding 
+//	invPageTableLock, which Drop lets go of while deleting.
 //----------------------------------------------------------------------
 
-//Because the initialization already zeroes out the memory to be used,
-//is it even necessary to clear out any garbage data during deallocation?
+void
+AddrSpace::Hold()
+{
+	refs++;
+}
+
+void
+AddrSpace::Drop()
+{
+	ASSERT(refs > 0);
+	if (--refs > 0)
+		return;
+	invPageTableLock.Release();
+	delete this;
+	invPageTableLock.Acquire();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::~AddrSpace
+// 	Deallocate an address space, once everyone has dropped it (see 
+//	Exit).  Its frames are already free; free its swap slots.
+//----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-	if(pageTable != NULL){
-		for(unsigned i = 0; i < numPages; i++) {
-			if(pageTable[i].valid == 1) {
-				memMap->Clear(pageTable[i].physicalPage);
-				invPageTable[pageTable[i].physicalPage].processThread = NULL;
-				invPageTable[pageTable[i].physicalPage].time = 0;
-				invPageTable[pageTable[i].physicalPage].process = -1;
-				invPageTable[pageTable[i].physicalPage].page = -1;
-				
-			}
-			pageTable[i].valid = 0;
-			pageTable[i].dirty = 0;
-		}
-		delete pageTable, pageTable = 0;
-		memMap->Print();
+	ASSERT(refs == 0);
+	if (pageDir != NULL) {
+		for (unsigned i = 0; i < divRoundUp(numPages, PageTableChunk); i++)
+			delete [] pageDir[i];
+		delete [] pageDir;
+	}
+	delete [] pageTable;
+	FreeSwap();
+	delete [] swapSlot;
+	delete [] inSwap;
+	delete [] copyOnWrite;
+	delete [] inTransit;
+	delete [] profile;
+#ifdef USE_TLB
+	tlbManager->FlushSpace(asid, asidGeneration);	// (if Exit didn't)
+	delete [] groupMisses;
+#endif
+	for (int m = 0; m < MaxMappings; m++) {
+		delete mappings[m].file;
+		delete [] mappings[m].name;
+	}
+	delete [] exeName;
+	delete [] args;
+	if (--(*exeUsers) == 0) {
+		delete exeFile;
+		delete exeUsers;
 	}
 }
 
@@ -163,7 +565,15 @@ AddrSpace::~AddrSpace()
 
 void AddrSpace::InitRegisters()
 {
-    int i;
+    int i, top = numPages * PageSize - 16, argv = -1;
+
+    // push the arguments first: their pages may fault in, and
+    // others may run meanwhile
+    if (args != NULL) {
+	argv = PushArguments(top);
+	delete [] args;
+	args = NULL;
+    }
 
     for (i = 0; i < NumTotalRegs; i++)
 	machine->WriteRegister(i, 0);
@@ -177,9 +587,70 @@ void AddrSpace::InitRegisters()
 
    // Set the stack register to the end of the address space, where we
    // allocated the stack; but subtract off a bit, to make sure we don't
-   // accidentally reference off the end!
-    machine->WriteRegister(StackReg, numPages * PageSize - 16);
-    DEBUG('a', "Initializing stack register to %d\n", numPages * PageSize - 16);
+   // accidentally reference off the end!  With arguments, the stack 
+   // starts under them, leaving main the 16 bytes a MIPS callee may 
+   // store its argument registers in.
+    if (argv != -1) {
+	machine->WriteRegister(4, argCount);
+	machine->WriteRegister(5, argv);
+	top = argv - 16;
+    }
+    machine->WriteRegister(StackReg, top);
+    DEBUG('a', "Initializing stack register to %d\n", top);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SetArguments
+// 	Keep arguments for the program's main, for InitRegisters to pass.
+//
+//	"strings" -- the arguments, each ending in a null, end to end
+//	"size" -- how many bytes they take, nulls included; at most
+//		MaxArgBytes
+//	"count" -- how many there are; at most MaxArgs
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SetArguments(char *strings, int size, int count)
+{
+	ASSERT(size <= MaxArgBytes && count <= MaxArgs);
+	delete [] args;
+	args = new char[size];
+	bcopy(strings, args, size);
+	argSize = size;
+	argCount = count;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PushArguments
+// 	Copy the arguments onto the top of the stack, as main expects
+//	them: the strings, and under them (word-aligned) the argv array
+//	of pointers to them, ending with a null pointer.  Called by the
+//	new process itself, before it starts, so the pages can fault in.
+//
+//	"top" -- the first byte past where they may go
+//
+// Returns:
+//	the address of argv, or -1 if the stack couldn't be written
+//----------------------------------------------------------------------
+
+int
+AddrSpace::PushArguments(int top)
+{
+	int strings = (top - argSize) & ~3;
+	int argv = strings - (argCount + 1) * 4;
+	int *pointers = new int[argCount + 1];
+	int i, offset = 0;
+
+	for (i = 0; i < argCount; i++) {
+		pointers[i] = WordToMachine(strings + offset);
+		offset += strlen(&args[offset]) + 1;
+	}
+	pointers[argCount] = 0;
+	if (CopyOut(strings, args, argSize) < 0
+		|| CopyOut(argv, (char *) pointers, (argCount + 1) * 4) < 0)
+		argv = -1;
+	delete [] pointers;
+	return argv;
 }
 
 //----------------------------------------------------------------------
@@ -187,249 +658,2202 @@ void AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	With a TLB, copy the TLB's use and dirty bits back into our page 
+//	table; our entries stay, tagged with our address space ID, for
+//	when we run again.  Otherwise, nothing!
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+#ifdef USE_TLB
+    tlbManager->Deactivate();
+#endif
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table.  With
+//	a TLB, the hardware never sees the page table; just switch the
+//	TLB to our address space ID, dropping any of our entries that went
+//	stale while others ran, so it is refilled from our page table.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
+#ifdef USE_TLB
+    tlbManager->Activate(&asid, &asidGeneration);
+#else
     machine->pageTable = pageTable;
+    machine->pageDirectory = pageDir;
     machine->pageTableSize = numPages;
+    machine->FlushXlateCache();
+#endif
 }
 
-void AddrSpace::GenerateSWAP(OpenFile *executable, int ID)  {
+//----------------------------------------------------------------------
+// AddrSpace::PageEntry
+// 	Return the page table entry covering a virtual address, for the
+//	TLB miss handler, or NULL if the address is not in this space.
+//
+//	"virtAddr" -- the virtual address that missed in the TLB
+//----------------------------------------------------------------------
 
+TranslationEntry *
+AddrSpace::PageEntry(int virtAddr)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
 
-    NoffHeader noffH;
-    unsigned int size;
+    if (vpn >= numPages)
+	return NULL;
+    return Entry(vpn);
+}
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+//----------------------------------------------------------------------
+// AddrSpace::Sbrk
+// 	Move the end of the heap "increment" bytes up.  The heap starts
+//	just above the stack, at the initial top of the address space,
+//	and nothing is put in its pages: like the bss, they are zeroed
+//	the first time they are touched (see ReadPageImage).
+//
+// Returns:
+//	the old end of the heap, which is the start of the new bytes, or
+//	-1 if "increment" is negative or the heap would get bigger than
+//	MaxHeapSize
+//----------------------------------------------------------------------
 
-// how big is address space?
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size + UserStackSize;
+int
+AddrSpace::Sbrk(int increment)
+{
+    int oldEnd = heapEnd;
+    unsigned int pages;
+
+    if (increment < 0 || increment > MaxHeapSize - (heapEnd - heapStart))
+	return -1;
+    heapEnd += increment;
+    pages = divRoundUp(heapEnd, PageSize);
+    if (pages > numPages)
+	Grow(pages - numPages);
+    return oldEnd;
+}
 
-    numPages = divRoundUp(size, PageSize);
-    size = numPages * PageSize;
+//----------------------------------------------------------------------
+// InitEntries
+// 	Mark a run of page table entries as not in memory.
+//
+//	"entries" -- the first entry
+//	"count" -- how many entries
+//----------------------------------------------------------------------
 
-	char filename[100];
-	sprintf(filename, "%d.swap", ID);
-	//printf("\nfileSystem->Create(\"%s\")", filename);
-	fileSystem->Create(filename, size);
-	OpenFile* swapFile = fileSystem->Open(filename);
-	
-	char swapData[size];
+static void
+InitEntries(TranslationEntry *entries, int count)
+{
+    for (int i = 0; i < count; i++) {
+	entries[i].physicalPage = -1;
+	entries[i].valid = FALSE;
+	entries[i].use = FALSE;
+	entries[i].dirty = FALSE;
+	entries[i].readOnly = FALSE;
+    }
+}
 
-	bzero((void*)swapData, size);
+//----------------------------------------------------------------------
+// Extend
+// 	Return a copy of the per-page array "old" with "count" more
+//	elements, all "fill", and delete the old one.
+//----------------------------------------------------------------------
 
-	if (noffH.code.size > 0)
-        executable->ReadAt(&swapData[noffH.code.virtualAddr], noffH.code.size, noffH.code.inFileAddr);
+template <class T> static T *
+Extend(T *old, int oldCount, int count, T fill)
+{
+    T *bigger = new T[oldCount + count];
+
+    for (int i = 0; i < oldCount; i++)
+	bigger[i] = old[i];
+    for (int i = oldCount; i < oldCount + count; i++)
+	bigger[i] = fill;
+    delete [] old;
+    return bigger;
+}
 
-	if (noffH.initData.size > 0)
-		executable->ReadAt(&swapData[noffH.initData.virtualAddr], noffH.initData.size, noffH.initData.inFileAddr);
+//----------------------------------------------------------------------
+// AddrSpace::Grow
+// 	Add "count" pages, not in memory yet, at the end of the address
+//	space.  The per-page arrays are copied into bigger ones.  A linear
+//	page table moves too, so the replacement policy is told about the
+//	new place of each entry it knows of, the TLB (which has copies of
+//	entries) is emptied, and the machine gets the new table if it is
+//	running us.
+//----------------------------------------------------------------------
 
-	//printf("SWAPFILE\n");
+void
+AddrSpace::Grow(int count)
+{
+    unsigned int i, oldPages = numPages;
+
+    invPageTableLock.Acquire();
+    WaitForTransit();		// nobody may be filling in an old entry
+#ifdef USE_TLB
+    tlbManager->FlushSpace(asid, asidGeneration);
+#endif
+    if (pageDir != NULL) {
+	unsigned int oldChunks = divRoundUp(oldPages, PageTableChunk);
+
+	pageDir = Extend(pageDir, oldChunks,
+		divRoundUp(oldPages + count, PageTableChunk) - oldChunks,
+		(TranslationEntry *) NULL);
+    } else {
+	TranslationEntry *old = pageTable;
+
+	pageTable = new TranslationEntry[oldPages + count];
+	for (i = 0; i < oldPages; i++)
+	    pageTable[i] = old[i];
+	InitEntries(&pageTable[oldPages], count);
+	for (i = 0; i < oldPages; i++) {
+	    int frame = pageTable[i].physicalPage;
+
+	    if (pageTable[i].valid && coreMap->entry[frame].space == this
+			&& coreMap->entry[frame].page == (int) i)
+		frameReplacer->Retarget(frame, &pageTable[i]);
+	}
+	delete [] old;
+    }
+    swapSlot = Extend(swapSlot, oldPages, count, -1);
+    inSwap = Extend(inSwap, oldPages, count, (bool) FALSE);
+    copyOnWrite = Extend(copyOnWrite, oldPages, count, (bool) FALSE);
+    inTransit = Extend(inTransit, oldPages, count, -1);
+#ifdef USE_TLB
+    unsigned int oldGroups = divRoundUp(oldPages, tlbManager->MaxPages());
+
+    groupMisses = Extend(groupMisses, oldGroups,
+		divRoundUp(oldPages + count, tlbManager->MaxPages()) - oldGroups,
+		0);
+#endif
+    numPages += count;
+    if (currentThread->space == this)
+	RestoreState();
+    invPageTableLock.Release();
+    DEBUG('a', "Heap grown to %d pages\n", numPages);
+}
 
-	//for(int i = 0; i < size; i++) printf("%x", swapData[i]);
+//----------------------------------------------------------------------
+// AddrSpace::Mmap
+// 	Map the first "length" bytes of the Nachos file "name" into the
+//	address space, at the end, above everything the heap may grow
+//	into.  Nothing is read now: a fault on one of the pages reads it
+//	from the file (see ReadPageImage), and a modified page is written
+//	back to the file when it is evicted (see SwapOut), so it never
+//	takes a swap slot.  Bytes past the end of the file read as zeroes.
+//
+// Returns:
+//	the address of the first byte, or -1 if the file can't be opened,
+//	"length" isn't positive, or MaxMappings files are already mapped
+//----------------------------------------------------------------------
 
-	swapFile->Write(swapData, size);
+int
+AddrSpace::Mmap(char *name, int length)
+{
+    Mapping *m = NULL;
+    unsigned int pages;
+
+    for (int i = 0; i < MaxMappings && m == NULL; i++)
+	if (mappings[i].file == NULL)
+	    m = &mappings[i];
+    if (m == NULL || length <= 0 || (m->file = fileSystem->Open(name)) == NULL)
+	return -1;
+    delete [] m->name;		// left over from a mapping Fork couldn't open
+    m->name = new char[strlen(name) + 1];
+    strcpy(m->name, name);
+    m->firstPage = mapNext / PageSize;
+    m->numPages = divRoundUp(length, PageSize);
+    m->length = length;
+    mapNext += m->numPages * PageSize;
+
+    pages = divRoundUp(mapNext, PageSize);
+    if (pages > numPages)
+	Grow(pages - numPages);
+    DEBUG('a', "Mapped %d bytes of %s at 0x%x\n", length, name,
+		m->firstPage * PageSize);
+    return m->firstPage * PageSize;
+}
 
-	delete swapFile;
+//----------------------------------------------------------------------
+// AddrSpace::Munmap
+// 	Undo the Mmap that returned "virtAddr": write its modified pages
+//	back to the file, and close it.  The pages stay in the address
+//	space, but read as zeroes from now on; their addresses are not
+//	used again.
+//
+// Returns:
+//	FALSE if no mapping starts at "virtAddr"
+//----------------------------------------------------------------------
 
-	/*printf("READFILE\n");
+bool
+AddrSpace::Munmap(int virtAddr)
+{
+    for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file != NULL
+		&& mappings[i].firstPage * PageSize == virtAddr) {
+	    invPageTableLock.Acquire();
+	    Unmap(&mappings[i]);
+	    invPageTableLock.Release();
+	    return TRUE;
+	}
+    return FALSE;
+}
 
-	OpenFile* readFile = fileSystem->Open("1.swap");
-	char readData[readFile->Length()];
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+// 	Evict every page of mapping "m" that is in memory, which writes
+//	back the modified ones (a frame shared copy-on-write is evicted
+//	from everyone sharing it), then close the file.  Called holding
+//	invPageTableLock, which is let go of during the writes.
+//----------------------------------------------------------------------
 
-	readFile->Read(readData, readFile->Length());
-	
-	for(int i = 0; i < size; i++) printf("%x", readData[i]);
-
-	delete readFile;*/
-/*
-// zero out the entire address space, to zero the unitialized data segment
-// and the stack segment
-    //bzero(machine->mainMemory, size); rm for Solaris
-	//Edited version adds startPage * PageSize to the address. Hopefully this is proper.
-	//Either way, it appears to zero out only however much memory is needed,
-	//so zeroing out all memory doesn't seem to be an issue. - Devin
-
-	pAddr = startPage * PageSize;
-
-    memset(machine->mainMemory + pAddr, 0, size);
-//then, copy in the code and data segments into memory
-//Change these too since they assume virtual page = physical page
-	  //Fix this by adding startPage times page size as an offset
-    if (noffH.code.size > 0) {
-        DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
-			noffH.code.virtualAddr + (startPage * PageSize), noffH.code.size);
-        executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr + pAddr]),
-			noffH.code.size, noffH.code.inFileAddr);
-    }
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
-			noffH.initData.virtualAddr + (startPage * PageSize), noffH.initData.size);
-        executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr + pAddr]),
-			noffH.initData.size, noffH.initData.inFileAddr);
+void
+AddrSpace::Unmap(Mapping *m)
+{
+    for (int page = m->firstPage; page < m->firstPage + m->numPages; ) {
+	TranslationEntry *pte = FindEntry(page);
+
+	if (inTransit[page] != -1)
+	    WaitFrame(inTransit[page]);
+	else if (pte == NULL || !pte->valid)
+	    page++;
+	else if (coreMap->entry[pte->physicalPage].busy)
+	    WaitFrame(pte->physicalPage);
+	else
+	    ReclaimFrame(pte->physicalPage);	// then look at it again
     }
+    delete m->file;
+    m->file = NULL;
+}
 
-	*/
+//----------------------------------------------------------------------
+// AddrSpace::MappingOf
+// 	Return the mapping virtual page "page" is in, or NULL if it isn't
+//	in a mapped file.
+//----------------------------------------------------------------------
 
+Mapping *
+AddrSpace::MappingOf(int page)
+{
+    for (int i = 0; i < MaxMappings; i++)
+	if (mappings[i].file != NULL && page >= mappings[i].firstPage
+		&& page < mappings[i].firstPage + mappings[i].numPages)
+	    return &mappings[i];
+    return NULL;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::ReadMapped, AddrSpace::WriteMapped
+// 	Read page "page" of mapping "m" from its file into "into", or
+//	write it back from "frame".  Only the mapped bytes are read or
+//	written; the rest of the last page is zero-filled, and so is
+//	anything past the end of the file.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReadMapped(Mapping *m, int page, char *into)
+{
+    int offset = (page - m->firstPage) * PageSize;
+    int n = m->file->ReadAt(into, min(PageSize, m->length - offset), offset);
 
+    if (n < 0)
+	n = 0;
+    bzero(into + n, PageSize - n);
+    stats->numMapReads++;
+}
 
+void
+AddrSpace::WriteMapped(Mapping *m, int page, int frame)
+{
+    int offset = (page - m->firstPage) * PageSize;
 
+    m->file->WriteAt(&machine->mainMemory[frame * PageSize],
+		min(PageSize, m->length - offset), offset);
+    stats->numMapWrites++;
+}
 
+#ifdef USE_TLB
+//----------------------------------------------------------------------
+// AddrSpace::InitSuperpages
+// 	Start counting TLB misses in each aligned group of as many pages
+//	as the biggest superpage (-sup).
+//----------------------------------------------------------------------
 
+void
+AddrSpace::InitSuperpages()
+{
+    int groups = divRoundUp(numPages, tlbManager->MaxPages());
 
-int FrameSearch() {
-	int finalAns = -1;
-	int O = 0;
-	int ans = -1;
-	//invPageTableSemaphore.P();
-	switch(swapMode) {
-		case 0:
-			printf("\nBorking NachOS by Process %d\n", currentThread->getID());
-			break;
-		case 1:
-	
-			for(int i = 0; i < 32; i++) {
-				if(invPageTable[i].time > O) {
-					O = invPageTable[i].time;
-					ans = i;
-				}
-			}
-			finalAns = ans;
+    groupMisses = new int[groups];
+    for (int i = 0; i < groups; i++)
+	groupMisses[i] = 0;
+}
 
-			break;
-		case 2:
-			finalAns = Random() % 32;
-			break;
-	}
-	//invPageTableSemaphore.V();
-	return finalAns;
+//----------------------------------------------------------------------
+// AddrSpace::LoadTLB
+// 	Load the translation for "page", which is in memory, into the TLB,
+//	after a TLB miss.  It goes in as part of the biggest superpage
+//	around it that one TLB entry can map.  If a group of pages keeps
+//	missing anyway, try to move it into aligned consecutive frames,
+//	so that it can become a superpage next time round.
+//
+//	"page" -- the virtual page that missed
+//----------------------------------------------------------------------
+
+void
+AddrSpace::LoadTLB(int page)
+{
+    int maxPages = tlbManager->MaxPages(), pages;
+
+    if (maxPages > 1 && !CanMapSuperpage(page & ~(maxPages - 1), maxPages)
+		&& ++groupMisses[page / maxPages] >= PromoteMisses) {
+	groupMisses[page / maxPages] = 0;
+	Promote(page & ~(maxPages - 1), maxPages);
+	if (!FindEntry(page)->valid)
+	    return;		// evicted while we waited for the lock; the
+				// retried access will fault it back in
+    }
+    for (pages = maxPages; pages > 1; pages /= 2)
+	if (CanMapSuperpage(page & ~(pages - 1), pages))
+	    break;
+    page &= ~(pages - 1);
+    tlbManager->Load(FindEntry(page), page, pages);
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::CanMapSuperpage
+// 	Could one TLB entry map the "count" pages from "first" (a
+//	multiple of "count")?  They must all be in memory, in aligned
+//	consecutive frames, and equally protected.  Writable pages must
+//	also be dirty already: the TLB keeps a single dirty bit for the
+//	whole superpage, and we don't want a write to one page to make 
+//	all of them look modified.
+//
+//	An aligned group of at most PageTableChunk pages has its entries
+//	next to each other, within one second-level table.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CanMapSuperpage(int first, int count)
+{
+    TranslationEntry *base = FindEntry(first), *e;
+
+    if (first + count > (int) numPages || base == NULL || !base->valid
+		|| base->physicalPage % count != 0)
+	return FALSE;
+    for (int i = 0; i < count; i++) {
+	e = &base[i];
+	if (!e->valid || e->physicalPage != base->physicalPage + i
+		|| e->readOnly != base->readOnly
+		|| (!e->readOnly && !e->dirty))
+	    return FALSE;
+    }
+    return TRUE;
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::Promote
+// 	Move the "count" pages from "first" into aligned consecutive 
+//	frames, if frameAllocator has them free, so that one TLB entry
+//	can map them all.  Only our own pages, all in memory and not in
+//	the middle of any I/O, are moved: shared code and copy-on-write
+//	pages stay where the other spaces expect them.  Each page is
+//	copied, and its old frame freed.
+//
+// Returns:
+//	TRUE if the pages are now in aligned consecutive frames
+//----------------------------------------------------------------------
 
+bool
+AddrSpace::Promote(int first, int count)
+{
+    TranslationEntry *base, *e;
+    bool movable, inPlace;
+    int frame, old, i;
+
+    if (first + count > (int) numPages)
+	return FALSE;
+    invPageTableLock.Acquire();
+    base = FindEntry(first);
+    movable = (base != NULL);
+    inPlace = movable && (base->physicalPage % count == 0);
+    for (i = 0; movable && i < count; i++) {
+	e = &base[i];
+	movable = e->valid && !IsSharedPage(first + i) && 
+		  !IsSegmentPage(first + i) && 
+		  !copyOnWrite[first + i] && inTransit[first + i] == -1 &&
+		  !coreMap->entry[e->physicalPage].busy &&
+		  e->readOnly == base->readOnly;
+	if (movable && e->physicalPage != base->physicalPage + i)
+	    inPlace = FALSE;
+    }
+    if (!movable || inPlace) {
+	invPageTableLock.Release();
+	return movable;
+    }
+    frame = frameAllocator->Allocate(count, count);
+    if (frame == -1) {
+	stats->numPromotionFailures++;
+	invPageTableLock.Release();
+	return FALSE;
+    }
 
+    DEBUG('a', "Promoting pages %d-%d to frames %d-%d\n", first, 
+		first + count - 1, frame, frame + count - 1);
+    tlbManager->Invalidate(first, count);
+    machine->FlushXlateCache();
+    for (i = 0; i < count; i++) {
+	e = &base[i];
+	old = e->physicalPage;
+	bcopy(&machine->mainMemory[old * PageSize],
+		&machine->mainMemory[(frame + i) * PageSize], PageSize);
+	frameReplacer->Freed(old);
+	coreMap->ClearOwner(old);
+	machine->InvalidateDecodedPage(old);
+	frameAllocator->Free(old);
+
+	machine->InvalidateDecodedPage(frame + i);
+	e->physicalPage = frame + i;
+	coreMap->SetOwner(frame + i, this, first + i);
+	frameReplacer->Loaded(frame + i, e);
+    }
+    stats->numPromotions++;
+    invPageTableLock.Release();
+    return TRUE;
+}
+#endif
 
+//----------------------------------------------------------------------
+// AddrSpace::AllocatePageTable
+// 	Set up an empty page table: one flat array, or with -pt2, just the
+//	first level, each second-level table of PageTableChunk entries 
+//	being allocated when a page in it is first touched.
+//----------------------------------------------------------------------
 
-void AddrSpace::KillSWAP(int theThreadID)
+void
+AddrSpace::AllocatePageTable()
 {
-	char filename[100];
-	sprintf(filename, "%d.swap", theThreadID);
+    unsigned int i, numChunks = divRoundUp(numPages, PageTableChunk);
+
+    pageTable = NULL;
+    pageDir = NULL;
+    if (twoLevelPageTables) {
+	pageDir = new TranslationEntry *[numChunks];
+	for (i = 0; i < numChunks; i++)
+	    pageDir[i] = NULL;
+    } else {
+	pageTable = new TranslationEntry[numPages];
+	InitEntries(pageTable, numPages);
+    }
+}
 
-	
+//----------------------------------------------------------------------
+// AddrSpace::Entry
+// 	Return the page table entry for virtual page "page", allocating
+//	its second-level table if need be.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::Entry(int page)
+{
+    TranslationEntry **chunk;
+
+    if (pageDir == NULL)
+	return &pageTable[page];
+    chunk = &pageDir[page / PageTableChunk];
+    if (*chunk == NULL) {
+	*chunk = new TranslationEntry[PageTableChunk];
+	InitEntries(*chunk, PageTableChunk);
+    }
+    return &(*chunk)[page % PageTableChunk];
+}
 
-	//printf("\nfileSystem->Remove(\"%s\")", filename);
-	fileSystem->Remove(filename);
+//----------------------------------------------------------------------
+// AddrSpace::FindEntry
+// 	Return the page table entry for virtual page "page", or NULL if
+//	nothing near it has been touched (so it is certainly not in 
+//	memory).
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::FindEntry(int page)
+{
+    if (pageDir == NULL)
+	return &pageTable[page];
+    if (pageDir[page / PageTableChunk] == NULL)
+	return NULL;
+    return &pageDir[page / PageTableChunk][page % PageTableChunk];
 }
 
+//----------------------------------------------------------------------
+// ReadSegmentPart
+// 	Copy the part of a NOFF segment that overlaps one page (if any)
+//	from the executable into the page buffer.
+//
+//	"executable" -- the file containing the object code
+//	"seg" -- the code or initialized data segment
+//	"pageAddr" -- virtual address of the start of the page
+//	"into" -- the page buffer
+//----------------------------------------------------------------------
 
+static void
+ReadSegmentPart(OpenFile *executable, Segment *seg, int pageAddr, char *into)
+{
+    int start = max(pageAddr, seg->virtualAddr);
+    int end = min(pageAddr + PageSize, seg->virtualAddr + seg->size);
 
+    if ((seg->size > 0) && (start < end))
+	executable->ReadAt(&into[start - pageAddr], end - start,
+			seg->inFileAddr + (start - seg->virtualAddr));
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::ReadPageImage
+// 	Fill in the initial contents of one virtual page: whatever parts of
+//	the code and initialized data segments fall in the page are read
+//	from the executable, and the rest (uninitialized data, stack) is
+//	zero.  A page of a mapped file is read from the file.
+//
+//	Pages entirely in the uninitialized data or the stack need no I/O,
+//	and pages entirely in one segment need no zeroing.
+//
+//	"page" -- the virtual page number
+//	"into" -- where to put the PageSize bytes of the page
+//----------------------------------------------------------------------
 
+void
+AddrSpace::ReadPageImage(int page, char *into)
+{
+    Mapping *m = MappingOf(page);
 
+    if (m != NULL) {
+	ReadMapped(m, page, into);
+	return;
+    }
+    if (!Covers(&noffH.code, page * PageSize)
+		&& !Covers(&noffH.initData, page * PageSize))
+	bzero(into, PageSize);
+    ReadSegmentPart(exeFile, &noffH.code, page * PageSize, into);
+    ReadSegmentPart(exeFile, &noffH.initData, page * PageSize, into);
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::GenerateSWAP
+// 	Set up the backing store for this address space.  Nothing is
+//	copied: pages are loaded from the executable (or zero-filled) on
+//	their first fault, and swap slots are only taken when a modified
+//	page is first evicted (see SwapSlot).
+//
+//	"executable" -- the file containing the object code (unused; the
+//		constructor already kept it)
+//	"ID" -- the process id (unused)
+//----------------------------------------------------------------------
 
+void AddrSpace::GenerateSWAP(OpenFile *executable, int ID)  {
+	ASSERT(executable == exeFile);
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::SwapSlot
+// 	Return the swap slot of "page", taking one if it has none.  The
+//	first time, we try to reserve consecutive slots for the whole 
+//	space, so that runs of pages can be read back with one request;
+//	if the swap area has no such run free, each page gets a slot of
+//	its own.  Called holding invPageTableLock.
+//----------------------------------------------------------------------
 
-int AddrSpace::PageFaultLoadPage(int pageFaultAddr, int theThreadID) {
-	invPageTableSemaphore.P();
-	memMap->Print();
-	int page = pageFaultAddr / PageSize;
-	int pageOffset = page * PageSize;
+int
+AddrSpace::SwapSlot(int page)
+{
+	if (swapSlot[page] == -1 && !swapReserved) {
+		int first = swapArea->Reserve(numPages);
 
-	int frame = memMap->Find();
-	int frameOffset = frame * PageSize;
-		
-	//printf("\tpage: %d\tframe: %d\tPageSize: %d\tframeOffset: %d\t", page, frame, PageSize, frameOffset);
+		swapReserved = TRUE;
+		if (first != -1)
+			for (unsigned i = 0; i < numPages; i++)
+				swapSlot[i] = first + i;
+	}
+	if (swapSlot[page] == -1) {
+		swapSlot[page] = swapArea->Allocate();
+		ASSERT(swapSlot[page] != -1);	// the swap area is full
+	}
+	return swapSlot[page];
+}
 
-	if(-1 == frame)
-	{
-		printf("\nNo open Frames\n");
-		frame = FrameSearch();
-		//printf("frame: %d, process: %d, %d\n", frame, invPageTable[frame].process, invPageTable[frame].processThread->getID());
-		
-		if(-1 != frame) {
-			
-			frameOffset = frame * PageSize;
-
-			int physicalOffset = frame * PageSize;
-			int virtualOffset = invPageTable[frame].page * PageSize;
-			
-			char filename[100];
-			sprintf(filename, "%d.swap", invPageTable[frame].process);
-			
-			OpenFile* writeFile = fileSystem->Open(filename);
-			
-			char writeData[PageSize];
-			
-			for(int i = 0; i < PageSize; i++)
-				writeData[i] = machine->mainMemory[physicalOffset + i];
-			
-			writeFile->WriteAt(writeData, PageSize, virtualOffset);
-
-			invPageTable[frame].processThread->space->pageTable[invPageTable[frame].page].valid = FALSE;
-
-			delete writeFile;
+//----------------------------------------------------------------------
+// AddrSpace::FreeSwap
+// 	Give our swap slots back; the pages in them are lost.
+//----------------------------------------------------------------------
 
+void
+AddrSpace::FreeSwap()
+{
+	for (unsigned i = 0; i < numPages; i++)
+		if (swapSlot[i] != -1) {
+			swapArea->Free(swapSlot[i]);
+			swapSlot[i] = -1;
+			inSwap[i] = FALSE;
 		}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SwapOut
+// 	Write a modified page to its swap slot.  From now on the page is 
+//	loaded from swap.  A page of a mapped file is written back to the
+//	file instead.
+//
+//	"page" -- the virtual page being evicted
+//	"frame" -- the physical page it is in
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SwapOut(int page, int frame)
+{
+	long long start = stats->totalTicks;
+	Mapping *m = MappingOf(page);
+
+	if (m != NULL) {
+		WriteMapped(m, page, frame);	// the file is its backing copy
+		return;
 	}
-	if(-1 == frame) {
-		return 1;
-	}
-	//empty frame found
-	char filename[100];
-	sprintf(filename, "%d.swap", theThreadID);
+	swapArea->Write(SwapSlot(page), &machine->mainMemory[frame * PageSize]);
+	inSwap[page] = TRUE;
+	paging.dirtyWrites++;
+	paging.swapWriteTicks += stats->totalTicks - start;
+	stats->paging.dirtyWrites++;
+	stats->paging.swapWriteTicks += stats->totalTicks - start;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SwapRead
+// 	Read a run of pages back from swap, with one request.  Their swap
+//	slots must be consecutive too.
+//
+//	"into" -- where to put them
+//	"count" -- how many pages
+//	"page" -- the first virtual page of the run
+//----------------------------------------------------------------------
 
+void
+AddrSpace::SwapRead(char *into, int count, int page)
+{
+	long long start = stats->totalTicks;
 
-	//printf("\nfileSystem->Open(\"%s\")", filename);
+	swapArea->Read(swapSlot[page], into, count);
+	paging.swapReads += count;
+	paging.swapReadTicks += stats->totalTicks - start;
+	stats->paging.swapReads += count;
+	stats->paging.swapReadTicks += stats->totalTicks - start;
+}
 
-	OpenFile* readFile = fileSystem->Open(filename);
-	char readData[PageSize];
 
-	readFile->ReadAt(readData, PageSize, pageOffset);
-	
-	//printf("\nREADFILE:\n");
-	//for(int i = 0; i < PageSize; i++) printf("%x", readData[i]);
 
-	delete readFile;
-	//printf("frameOffset=%d.", frameOffset);
-	for(int i = 0; i < PageSize; i++)
-		machine->mainMemory[frameOffset + i] = readData[i];
 
-	
-	pageTable[page].valid = TRUE;
-	pageTable[page].virtualPage = page;
-	pageTable[page].physicalPage = frame;
-		
-	for(int i = 0; i < 32; i++)
-		invPageTable[i].time++;
-	invPageTable[frame].time = 0;
-	invPageTable[frame].process = theThreadID;
-	invPageTable[frame].processThread = currentThread;
-	invPageTable[frame].page = page;
-		
-	memMap->Print();
-	invPageTableSemaphore.V();
 
-	return 0;
-	
-}	
 
+
+void AddrSpace::KillSWAP(int theThreadID)
+{
+	invPageTableLock.Acquire();
+	exiting = TRUE;			// so nothing more is written to swap
+	WaitForTransit();
+	FreeSwap();
+	invPageTableLock.Release();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PrintPagingStats
+// 	Report this address space's paging activity, when it exits.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PrintPagingStats(int ID)
+{
+	printf("Process %i paging: faults %lld\n", ID, paging.faults);
+	if (paging.faults > 0)
+		paging.Print();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::InitProfile, AddrSpace::Sample
+// 	With -prof, keep a count of samples for each word of the code
+//	segment.  The profiler's timer interrupt (see system.cc) calls
+//	Sample with the PC of the instruction the process was about to
+//	run; a PC outside the code only counts towards the total.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::InitProfile()
+{
+	profile = NULL;
+	profileSamples = 0;
+	if (profileInterval > 0) {
+		int words = divRoundUp(noffH.code.size, 4);
+
+		profile = new int[max(words, 1)];
+		bzero(profile, max(words, 1) * sizeof(int));
+	}
+}
+
+void
+AddrSpace::Sample(int pc)
+{
+	int word = (pc - noffH.code.virtualAddr) / 4;
+
+	profileSamples++;
+	if (profile != NULL && pc >= noffH.code.virtualAddr && 
+			word < divRoundUp(noffH.code.size, 4))
+		profile[word]++;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::WriteProfile
+// 	Write the samples to the UNIX file prof.<ID>, as text: a line
+//	"# program samples interval", then "pc count" for each instruction
+//	that was sampled at least once, in address order.  bin/profsym 
+//	maps the PCs back to the functions of the program's COFF file.
+//
+//	"ID" -- our process id
+//----------------------------------------------------------------------
+
+void
+AddrSpace::WriteProfile(int ID)
+{
+	char fileName[32];
+	FILE *fp;
+
+	if (profile == NULL)
+		return;
+	sprintf(fileName, "prof.%d", ID);
+	if ((fp = fopen(fileName, "w")) == NULL) {
+		printf("Can't write the profile of process %i to %s\n", ID, fileName);
+		return;
+	}
+	fprintf(fp, "# %s %d %d\n", (exeName != NULL) ? exeName : "?",
+			profileSamples, profileInterval);
+	for (int i = 0; i < divRoundUp(noffH.code.size, 4); i++)
+		if (profile[i] > 0)
+			fprintf(fp, "0x%x %d\n", noffH.code.virtualAddr + 4 * i, 
+					profile[i]);
+	fclose(fp);
+	delete [] profile;			// only once, even if we also
+	profile = NULL;				// get to Halt
+}
+
+
+
+
+
+
+
+
+
+
+
+//----------------------------------------------------------------------
+// AddrSpace::AttachText
+// 	Find (or start) the shared copy of our executable's code pages,
+//	and join its users.  The shared pages are mapped read-only.
+//
+//	"name" -- the executable's file name, which identifies it
+//	"numText" -- how many pages are entirely code
+//----------------------------------------------------------------------
+
+void
+AddrSpace::AttachText(char *name, int numText)
+{
+    SharedText *t;
+    int i;
+
+    if (numText <= 0)
+	return;
+    for (t = textCache; t != NULL; t = t->next)
+	if (!strcmp(t->name, name) && t->numPages == numText)
+	    break;
+    if (t == NULL) {			// first instance of this program
+	t = new SharedText;
+	t->name = new char[strlen(name) + 1];
+	strcpy(t->name, name);
+	t->numPages = numText;
+	t->frame = new int[numText];
+	t->entry = new TranslationEntry[numText];
+	for (i = 0; i < numText; i++) {
+	    t->frame[i] = -1;
+	    t->entry[i].valid = FALSE;
+	    t->entry[i].use = FALSE;
+	    t->entry[i].dirty = FALSE;
+	    t->entry[i].readOnly = TRUE;
+	}
+	t->maxUsers = 4;
+	t->users = new AddrSpace *[t->maxUsers];
+	t->numUsers = 0;
+	t->next = textCache;
+	textCache = t;
+    }
+    if (t->numUsers == t->maxUsers) {	// grow the user array
+	AddrSpace **bigger = new AddrSpace *[2 * t->maxUsers];
+
+	for (i = 0; i < t->numUsers; i++)
+	    bigger[i] = t->users[i];
+	delete [] t->users;
+	t->users = bigger;
+	t->maxUsers *= 2;
+    }
+    t->users[t->numUsers++] = this;
+    text = t;
+    for (i = 0; i < numText; i++)
+	Entry(i)->readOnly = TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::DetachText
+// 	Stop using the shared code pages.  The last user out frees the
+//	frames holding them.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::DetachText()
+{
+    SharedText *t = text, **prevp;
+    int i;
+
+    for (i = 0; i < t->numUsers; i++)
+	if (t->users[i] == this) {
+	    t->users[i] = t->users[--t->numUsers];
+	    break;
+	}
+    text = NULL;
+    if (t->numUsers > 0)
+	return;
+
+    for (i = 0; i < t->numPages; i++)
+	if (t->frame[i] != -1) {
+	    frameAllocator->Free(t->frame[i]);
+	    frameReplacer->Freed(t->frame[i]);
+	    coreMap->entry[t->frame[i]].text = NULL;
+	    coreMap->ClearOwner(t->frame[i]);
+	}
+    for (prevp = &textCache; *prevp != t; prevp = &(*prevp)->next)
+	;
+    *prevp = t->next;
+    delete [] t->name;
+    delete [] t->frame;
+    delete [] t->entry;
+    delete [] t->users;
+    delete t;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsSharedPage
+// 	Return TRUE if virtual page "page" lives in our SharedText.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsSharedPage(int page)
+{
+    return text != NULL && page < text->numPages;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::EvictShared
+// 	Take a shared code page out of "frame", unmapping it from every
+//	address space using it.  The page is never modified, so there is
+//	nothing to write back.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::EvictShared(int frame)
+{
+    SharedText *t = coreMap->entry[frame].text;
+    int page = coreMap->entry[frame].page;
+
+    for (int i = 0; i < t->numUsers; i++) {
+	TranslationEntry *pte = t->users[i]->FindEntry(page);
+
+	if (pte != NULL && pte->valid && pte->physicalPage == frame)
+	    pte->valid = FALSE;
+    }
+#ifdef USE_TLB
+    if (currentThread->space != NULL && currentThread->space->text == t)
+	tlbManager->Invalidate(page);
+#endif
+    t->frame[page] = -1;
+    t->entry[page].valid = FALSE;
+    stats->paging.evictions++;		// code is never dirty
+    stats->paging.cleanEvictions++;
+    TRACE(TraceEvict, frame, page);
+    coreMap->entry[frame].text = NULL;
+    coreMap->ClearOwner(frame);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GetFrame
+// 	Find a physical page to load a page into.  If none is free, ask 
+//	frameReplacer for a victim and take it away from every address 
+//	space mapping it, saving it in their swap slots if it was modified.
+//
+//	The frame comes back marked busy; the caller fills it in and then
+//	calls ReleaseFrame.  The caller holds invPageTableLock, which
+//	is let go of while waiting for I/O.
+//
+//	Returns the frame, or -1 if memory is full and nothing can be
+//	replaced.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::GetFrame()
+{
+	bool local = pffEnabled && resident >= quota && resident > 0;
+	int frame = -1, busyFrame;
+	bool evict = FALSE;
+
+	for (;;) {
+		if (!local)
+			frame = frameAllocator->Allocate();
+		if (pageoutLow > 0 && !pageoutPending && 
+		    frameAllocator->NumFree() < pageoutLow) {
+			pageoutPending = TRUE;
+			workQueue->Queue(PageoutDaemon, 0, WorkHigh);
+		}
+		if (-1 != frame)
+			break;
+		evict = TRUE;
+		if (local)		// over quota: replace one of our own
+			frame = frameReplacer->Victim(OwnedBy, (int) this);
+		if (-1 == frame) {
+			printf("\nNo open Frames\n");
+			frame = frameReplacer->Victim(NotBusy, 0);
+		}
+		if (-1 != frame)
+			break;
+
+		// Everything may just be tied up in I/O; if so, wait for
+		// some of it to finish, and try again.
+		for (busyFrame = 0; busyFrame < NumPhysPages; busyFrame++)
+			if (coreMap->entry[busyFrame].busy)
+				break;
+		if (busyFrame == NumPhysPages)
+			return -1;
+		WaitFrame(busyFrame);
+		local = pffEnabled && resident >= quota && resident > 0;
+	}
+
+	coreMap->entry[frame].busy = TRUE;	// ours until ReleaseFrame
+	if (evict)
+		EvictFrame(frame);
+	return frame;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::WaitFrame
+// 	Sleep until the I/O on "frame" is done.  Called holding 
+//	invPageTableLock, which is let go of meanwhile; anything 
+//	looked at before may have changed by the time we return.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::WaitFrame(int frame)
+{
+	ASSERT(coreMap->entry[frame].busy);
+	coreMap->entry[frame].waiters++;
+	invPageTableLock.Release();
+	coreMap->entry[frame].ioDone->P();
+	invPageTableLock.Acquire();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReleaseFrame
+// 	The I/O on "frame" is done: clear its busy mark, and wake up 
+//	everyone waiting for it.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReleaseFrame(int frame)
+{
+	coreMap->entry[frame].busy = FALSE;
+	for (; coreMap->entry[frame].waiters > 0; coreMap->entry[frame].waiters--)
+		coreMap->entry[frame].ioDone->V();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::StartMerging
+// 	Turn on same-page merging.
+//
+//	"interval" -- ticks between scans
+//----------------------------------------------------------------------
+
+void
+AddrSpace::StartMerging(int interval)
+{
+	ASSERT(interval > 0);
+	mergeInterval = interval;
+	stats->Register("merge.scans", &numMergeScans);
+	stats->Register("merge.pages", &numMerged);
+	stats->Register("merge.zeroPages", &numZeroMerged);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ScheduleMerge
+// 	Queue the next merging scan, unless one is queued already, or 
+//	merging is off.  Only done while processes are running, so that
+//	the scan's timer doesn't keep an idle Nachos from halting.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ScheduleMerge()
+{
+	if (mergeInterval == 0 || mergePending)
+		return;
+	mergePending = TRUE;
+	workQueue->QueueDelayed(MergeDaemon, 0, mergeInterval, WorkLow);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MergeDaemon
+// 	One merging scan, run by workQueue at low priority, then queue
+//	the next.  Like the pageout daemon, it has no address space.  The
+//	TLB may still hold entries for the pages it merges, but no user
+//	code runs until an address space is switched back to, and
+//	Revalidate then drops any whose frame or protection no longer
+//	matches the page table.
+//
+//	Frames are hashed into chains; a frame whose contents match an
+//	earlier one on its chain is merged into it.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::MergeDaemon(int)
+{
+	int *first = new int[NumPhysPages], *next = new int[NumPhysPages];
+	int frame, keeper, bucket, zero = -1;
+	unsigned int hash;
+	char *data;
+	bool isZero;
+
+	invPageTableLock.Acquire();
+	numMergeScans++;
+	for (bucket = 0; bucket < NumPhysPages; bucket++)
+		first[bucket] = -1;
+	for (frame = 0; frame < NumPhysPages; frame++) {
+		if (!CanMerge(frame, TRUE))
+			continue;
+		data = &machine->mainMemory[frame * PageSize];
+		hash = 0;
+		isZero = TRUE;
+		for (int i = 0; i < PageSize; i++) {
+			hash = hash * 31 + (unsigned char) data[i];
+			isZero = isZero && data[i] == 0;
+		}
+		if (isZero && zero != -1 && CanMerge(frame, FALSE)) {
+			MergeFrame(frame, zero);
+			numZeroMerged++;
+			continue;
+		}
+		bucket = hash % NumPhysPages;
+		for (keeper = first[bucket]; keeper != -1; keeper = next[keeper])
+			if (!memcmp(data, &machine->mainMemory[keeper * PageSize],
+					PageSize))
+				break;
+		if (keeper != -1 && CanMerge(frame, FALSE)) {
+			MergeFrame(frame, keeper);
+			continue;
+		}
+		if (keeper == -1) {
+			next[frame] = first[bucket];
+			first[bucket] = frame;
+		}
+		if (isZero && zero == -1)
+			zero = frame;
+	}
+	mergePending = FALSE;
+	if (runningSpaces > 0)
+		ScheduleMerge();
+	invPageTableLock.Release();
+	delete [] first;
+	delete [] next;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CanMerge
+// 	Can the page in "frame" be shared with others that have the same
+//	contents?  It must be an ordinary page of an address space that
+//	isn't going away: no shared code or memory, no mapped file, no
+//	I/O in progress, and not truly read-only (copy-on-write would make
+//	it writable).  To be merged away into another frame, it must also
+//	have just the one owner.
+//
+//	"keeper" -- TRUE to check only that others can be merged into it
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CanMerge(int frame, bool keeper)
+{
+	CoreMapEntry *c = &coreMap->entry[frame];
+	AddrSpace *space = c->space;
+	TranslationEntry *pte;
+
+	if (space == NULL || c->text != NULL || c->busy || space->exiting)
+		return FALSE;
+	pte = space->FindEntry(c->page);
+	if (pte == NULL || !pte->valid || pte->physicalPage != frame
+			|| space->IsSharedPage(c->page)
+			|| space->IsSegmentPage(c->page)
+			|| space->MappingOf(c->page) != NULL
+			|| space->inTransit[c->page] != -1
+			|| (pte->readOnly && !space->copyOnWrite[c->page]))
+		return FALSE;
+	return keeper || (c->sharers == NULL && !space->copyOnWrite[c->page]);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MergeFrame
+// 	Map the page in "frame" to "keeper", which has the same contents,
+//	copy-on-write for everyone, and free "frame".  The page keeps its
+//	dirty bit: its backing copy is as up to date as before.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::MergeFrame(int frame, int keeper)
+{
+	CoreMapEntry *k = &coreMap->entry[keeper];
+	AddrSpace *space = coreMap->entry[frame].space;
+	int page = coreMap->entry[frame].page;
+	TranslationEntry *pte = space->FindEntry(page);
+	FrameOwner *o = new FrameOwner;
+
+	DEBUG('a', "Merging frame %d into frame %d\n", frame, keeper);
+	k->space->FindEntry(k->page)->readOnly = TRUE;
+	k->space->copyOnWrite[k->page] = TRUE;
+
+	frameReplacer->Freed(frame);
+	coreMap->ClearOwner(frame);
+	machine->InvalidateDecodedPage(frame);
+	frameAllocator->Free(frame);
+	space->resident--;
+
+	pte->physicalPage = keeper;
+	pte->readOnly = TRUE;
+	space->copyOnWrite[page] = TRUE;
+	o->space = space;
+	o->page = page;
+	o->next = k->sharers;
+	k->sharers = o;
+	machine->FlushXlateCache();
+	numMerged++;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReclaimFrame
+// 	Evict the page in "frame" and put the frame back on the free list,
+//	for the pageout daemon and the resident set manager.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReclaimFrame(int frame)
+{
+	coreMap->entry[frame].busy = TRUE;
+	EvictFrame(frame);
+	frameAllocator->Free(frame);
+	frameReplacer->Freed(frame);
+	ReleaseFrame(frame);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::WaitForTransit
+// 	Wait until no page of ours is being read or written, so that our
+//	swap slots and page table can safely be looked at or deleted.
+//	Called holding invPageTableLock.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::WaitForTransit()
+{
+	for (unsigned int i = 0; i < numPages; i++)
+		while (inTransit[i] != -1)
+			WaitFrame(inTransit[i]);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::StartPageout
+// 	Turn on the pageout daemon.
+//
+//	"lowWater" -- the daemon runs when fewer frames than this are free,
+//		and frees twice as many (but at most half of memory)
+//----------------------------------------------------------------------
+
+void
+AddrSpace::StartPageout(int lowWater)
+{
+	pageoutLow = lowWater;
+	pageoutHigh = 2 * lowWater;
+	if (pageoutHigh > NumPhysPages / 2)
+		pageoutHigh = NumPhysPages / 2;
+	if (pageoutHigh < pageoutLow)
+		pageoutHigh = pageoutLow;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageoutDaemon
+// 	Queued, at high priority, by a page fault that found memory nearly
+//	full: evict pages chosen by frameReplacer until pageoutHigh frames 
+//	are free.  Runs in a work queue thread, with no address space, so 
+//	the TLB is always empty while it works.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageoutDaemon(int)
+{
+	int frame;
+
+	invPageTableLock.Acquire();
+	DEBUG('a', "Pageout: %d frames free\n", frameAllocator->NumFree());
+	while (frameAllocator->NumFree() < pageoutHigh && 
+	       (frame = frameReplacer->Victim(NotBusy, 0)) != -1)
+		ReclaimFrame(frame);
+	pageoutPending = FALSE;
+	invPageTableLock.Release();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::EvictFrame
+// 	Take the page in "frame" away from every address space mapping 
+//	it, saving it in their swap slots if it was modified.  The frame
+//	stays allocated in frameAllocator, for the caller to reuse.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::EvictFrame(int frame)
+{
+	FrameOwner first, *o, *next, *writers = NULL;
+
+	ASSERT(coreMap->entry[frame].busy);
+	if (coreMap->entry[frame].text != NULL) {
+		EvictShared(frame);
+		return;
+	}
+	first.space = coreMap->entry[frame].space;
+	first.page = coreMap->entry[frame].page;
+	first.next = coreMap->entry[frame].sharers;
+	coreMap->entry[frame].sharers = NULL;
+	coreMap->ClearOwner(frame);
+	first.space->resident--;
+	stats->paging.evictions++;
+	TRACE(TraceEvict, frame, first.page);
+	for (o = &first; o != NULL; o = next) {
+		AddrSpace *space = o->space;
+		TranslationEntry *victim = space->Entry(o->page);
+
+		next = o->next;
+		space->paging.evictions++;
+#ifdef USE_TLB
+		// the TLB copy has the up to date dirty bit
+		if (space == currentThread->space)
+			tlbManager->Invalidate(o->page);
+#endif
+		// Only modified pages go to swap; a clean page can be
+		// loaded again from wherever it came from.  Until the 
+		// write is done, a fault on the page waits for this frame
+		// (and the address space can't go away).
+		if (victim->dirty && !space->exiting) {
+			FrameOwner *w = new FrameOwner;
+
+			w->space = space;
+			w->page = o->page;
+			w->next = writers;
+			writers = w;
+			space->inTransit[o->page] = frame;
+			space->Hold();		// until the write is done
+			victim->dirty = FALSE;
+		} else
+			space->paging.cleanEvictions++;
+		victim->valid = FALSE;
+		if (space->copyOnWrite[o->page]) {	// private from now on
+			space->copyOnWrite[o->page] = FALSE;
+			victim->readOnly = FALSE;
+		}
+		if (o != &first)
+			delete o;
+	}
+	machine->FlushXlateCache();
+
+	if (writers == NULL) {
+		stats->paging.cleanEvictions++;
+		return;
+	}
+	for (o = writers; o != NULL; o = o->next)
+		if (o->space->MappingOf(o->page) == NULL)
+			(void) o->space->SwapSlot(o->page);	// while we hold the lock
+	invPageTableLock.Release();
+	for (o = writers; o != NULL; o = o->next)
+		o->space->SwapOut(o->page, frame);
+	invPageTableLock.Acquire();
+	for (o = writers; o != NULL; o = o->next)
+		o->space->inTransit[o->page] = -1;
+	// let the owners fault the page back in; the frame itself stays busy
+	// until our caller has filled it
+	for (; coreMap->entry[frame].waiters > 0; coreMap->entry[frame].waiters--)
+		coreMap->entry[frame].ioDone->V();
+	for (o = writers; o != NULL; o = next) {
+		next = o->next;
+		o->space->Drop();	// it may have exited meanwhile
+		delete o;
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AdjustQuota
+// 	Page fault frequency control: called on every page fault, with
+//	-pff.  A process faulting often gets another frame; one faulting
+//	rarely gives one back, which may let a suspended process run.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::AdjustQuota()
+{
+	int interval = stats->totalTicks - lastFaultTick;
+	int frame;
+
+	lastFaultTick = stats->totalTicks;
+	if (interval < PFFGrowTicks && quota < (int) numPages) {
+		quota++;
+		totalQuota++;
+	} else if (interval > PFFShrinkTicks && quota > PFFMinQuota) {
+		quota--;
+		totalQuota--;
+		if (resident > quota && 
+		    (frame = frameReplacer->Victim(OwnedBy, (int) this)) != -1)
+			ReclaimFrame(frame);
+		ResumeSuspended();
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Suspend
+// 	Memory is overcommitted: rather than have every process thrash, 
+//	swap this one out completely and put it to sleep until the others
+//	leave room for it.  Called by the faulting thread, holding 
+//	invPageTableLock, which we let go of while we sleep.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Suspend()
+{
+	IntStatus oldLevel;
+
+	DEBUG('a', "Suspending process %d, %d frames wanted\n", 
+		currentThread->getID(), totalQuota);
+	for (unsigned int page = 0; page < numPages; page++) {
+		int frame = coreMap->Lookup(this, page);
+
+		if (frame != -1 && !coreMap->entry[frame].busy)
+			ReclaimFrame(frame);
+	}
+	suspended = TRUE;
+	totalQuota -= quota;
+	runningSpaces--;
+	invPageTableLock.Release();
+
+	oldLevel = interrupt->SetLevel(IntOff);
+	ResumeSuspended();		// someone else may fit in our place
+	suspendedThreads.Append((void *) currentThread);
+	currentThread->Sleep();
+	(void) interrupt->SetLevel(oldLevel);
+
+	invPageTableLock.Acquire();
+	lastFaultTick = stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ResumeSuspended
+// 	Put suspended processes back on the ready list, oldest first, as 
+//	long as their quotas fit in physical memory.  If nothing else is 
+//	running, the first one is resumed regardless.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ResumeSuspended()
+{
+	IntStatus oldLevel = interrupt->SetLevel(IntOff);
+	Thread *thread;
+
+	while ((thread = (Thread *) suspendedThreads.Remove()) != NULL) {
+		AddrSpace *space = thread->space;
+
+		if (runningSpaces > 0 && 
+		    totalQuota + space->quota > NumPhysPages) {
+			suspendedThreads.Prepend((void *) thread);
+			break;
+		}
+		DEBUG('a', "Resuming process %d\n", thread->getID());
+		space->suspended = FALSE;
+		totalQuota += space->quota;
+		runningSpaces++;
+		scheduler->ReadyToRun(thread);
+	}
+	(void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UnmapCow
+// 	Take this address space off the owners of the frame holding 
+//	copy-on-write page "page".  The page stays mapped; the caller 
+//	decides what to do with it.
+//
+// Returns:
+//	TRUE if another address space still maps the frame, FALSE if we
+//	were the only one left (so the frame is ours to write or free).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::UnmapCow(int page)
+{
+	int frame = Entry(page)->physicalPage;
+	FrameOwner **op, *o;
+
+	copyOnWrite[page] = FALSE;
+	if (coreMap->entry[frame].space == this &&
+	    coreMap->entry[frame].page == page) {
+		if ((o = coreMap->entry[frame].sharers) == NULL)
+			return FALSE;
+		// hand the frame to the next owner
+		resident--;
+		o->space->resident++;
+		coreMap->SetOwner(frame, o->space, o->page);
+		coreMap->entry[frame].sharers = o->next;
+		frameReplacer->Retarget(frame, 
+				o->space->PageEntry(o->page * PageSize));
+		delete o;
+		return TRUE;
+	}
+	// (after merging, we may map the frame at more than one page)
+	for (op = &coreMap->entry[frame].sharers; 
+			(*op)->space != this || (*op)->page != page; 
+			op = &(*op)->next)
+		;
+	o = *op;
+	*op = o->next;
+	delete o;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOnWrite
+// 	Handle a ReadOnlyException.  If the page is shared copy-on-write
+//	with a Fork parent or child, give this address space a private, 
+//	writable copy of it (or just make it writable, if no one else is
+//	sharing it any more), so the write can be retried.
+//
+//	"virtAddr" -- the address that was written
+//
+// Returns:
+//	FALSE if the page really is read-only (or there is no memory left
+//	to copy it into).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOnWrite(int virtAddr)
+{
+	unsigned int page = (unsigned) virtAddr / PageSize;
+	char *buffer;
+	int frame;
+
+	if (page >= numPages)
+		return FALSE;
+	invPageTableLock.Acquire();
+	if (!copyOnWrite[page]) {
+		// if it was evicted while we waited, just retry the write
+		bool retry = !Entry(page)->valid || !Entry(page)->readOnly;
+
+		invPageTableLock.Release();
+		return retry;
+	}
+#ifdef USE_TLB
+	tlbManager->Invalidate(page);
+#endif
+	if (UnmapCow(page)) {
+		// the others keep the frame; copy the page before looking for
+		// a frame, which may evict the one we were sharing
+		buffer = new char[PageSize];	// pages may be too big for
+						// a thread stack
+		bcopy(&machine->mainMemory[Entry(page)->physicalPage * PageSize],
+			buffer, PageSize);
+		Entry(page)->valid = FALSE;
+		frame = GetFrame();
+		if (-1 == frame) {
+			delete [] buffer;
+			invPageTableLock.Release();
+			return FALSE;
+		}
+		bcopy(buffer, &machine->mainMemory[frame * PageSize], PageSize);
+		delete [] buffer;
+		MapFrame(page, frame);
+		Entry(page)->dirty = TRUE;
+		ReleaseFrame(frame);
+	}
+	Entry(page)->readOnly = FALSE;
+	machine->FlushXlateCache();
+#ifdef USE_TLB
+	tlbManager->Load(Entry(page), page);
+#endif
+	invPageTableLock.Release();
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MapFrame
+// 	Finish loading a page: map it in our page table, and record who
+//	owns the frame.  The frame's contents have been filled in already.
+//
+//	"page" -- the virtual page
+//	"frame" -- the physical page now holding it
+//----------------------------------------------------------------------
+
+void
+AddrSpace::MapFrame(int page, int frame)
+{
+	machine->InvalidateDecodedPage(frame);
+
+	Entry(page)->valid = TRUE;
+	Entry(page)->dirty = FALSE;		// same as its backing copy
+	Entry(page)->physicalPage = frame;
+		
+	if (IsSharedPage(page)) {
+		// the frame outlives us if other instances are using it, so
+		// the replacer watches the shared entry, not our own
+		coreMap->SetOwner(frame, NULL, page);
+		text->frame[page] = frame;
+		text->entry[page] = *Entry(page);
+		coreMap->entry[frame].text = text;
+		frameReplacer->Loaded(frame, &text->entry[page]);
+	} else {
+		coreMap->SetOwner(frame, this, page);
+		frameReplacer->Loaded(frame, Entry(page));
+		resident++;
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReadAhead
+// 	Called after a fault on "page" has been serviced.  If the faults
+//	are running sequentially through the address space, bring in the
+//	next few pages too, doubling the window (up to readAheadMax) each 
+//	time the run continues.  A fault on the page just past the window
+//	means the program used what we prefetched, so it continues the run.
+//
+//	Only free frames are used, so read-ahead never evicts anything.
+//	Pages in consecutive swap slots are read with one request, straight
+//	into memory if frameAllocator could give us consecutive frames.
+//	Called holding invPageTableLock, which is let go of during 
+//	the reads.
+//
+//	"page" -- the page that just faulted
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReadAhead(int page)
+{
+	int count, first, i, frames[MaxReadAhead];
+
+	if (page == nextFault)
+		readAhead = (readAhead == 0) ? 1 : 2 * readAhead;
+	else
+		readAhead = 0;
+	if (readAhead > readAheadMax)
+		readAhead = readAheadMax;
+	if (readAhead > MaxReadAhead)
+		readAhead = MaxReadAhead;
+	if (pffEnabled && readAhead > quota - resident)
+		readAhead = quota - resident;	// stay within our quota
+	if (readAhead < 0)
+		readAhead = 0;
+
+	count = 0;
+	for (i = page + 1; i < (int) numPages && count < readAhead && 
+	     count < frameAllocator->NumFree(); i++, count++)
+		if ((FindEntry(i) != NULL && FindEntry(i)->valid) || 
+		    inTransit[i] != -1 || 
+		    (IsSharedPage(i) && text->frame[i] != -1))
+			break;
+
+	// consecutive frames if we can get them, so that pages in
+	// consecutive swap slots can be read straight into memory
+	first = (count > 1) ? frameAllocator->Allocate(count) : -1;
+	for (i = 0; i < count; i++) {
+		frames[i] = (first != -1) ? first + i : frameAllocator->Allocate();
+		coreMap->entry[frames[i]].busy = TRUE;
+		inTransit[page + 1 + i] = frames[i];
+		if (IsSharedPage(page + 1 + i))
+			text->frame[page + 1 + i] = frames[i];
+	}
+	nextFault = page + count + 1;
+	if (count == 0)
+		return;
+
+	invPageTableLock.Release();
+	for (first = 0; first < count; first = i) {
+		int vpn = page + 1 + first;
+
+		if (!inSwap[vpn]) {
+			ReadPageImage(vpn, &machine->mainMemory[frames[first] * PageSize]);
+			i = first + 1;
+		} else {		// one read for the whole run in swap
+			char *buffer;
+			bool inOrder = TRUE;	// in consecutive frames?
+
+			for (i = first + 1; i < count && inSwap[page + 1 + i] &&
+			     swapSlot[page + 1 + i] == swapSlot[vpn] + i - first; i++)
+				if (frames[i] != frames[first] + i - first)
+					inOrder = FALSE;
+			if (inOrder) {
+				SwapRead(&machine->mainMemory[frames[first] * PageSize],
+					 i - first, vpn);
+				continue;
+			}
+			buffer = new char[(i - first) * PageSize];
+			SwapRead(buffer, i - first, vpn);
+			for (int j = first; j < i; j++)
+				bcopy(&buffer[(j - first) * PageSize], 
+				      &machine->mainMemory[frames[j] * PageSize], PageSize);
+			delete [] buffer;
+		}
+	}
+	invPageTableLock.Acquire();
+
+	for (i = 0; i < count; i++) {
+		MapFrame(page + 1 + i, frames[i]);
+		Entry(page + 1 + i)->use = FALSE;	// not used yet
+		inTransit[page + 1 + i] = -1;
+		ReleaseFrame(frames[i]);
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageFaultLoadPage
+// 	Bring in the page containing "pageFaultAddr", evicting another page
+//	if memory is full.  The disk I/O is done without holding 
+//	invPageTableLock, with the frame marked busy.
+//
+// Returns:
+//	0 if the page is now in memory, 1 if there was no frame to put it 
+//	in.
+//----------------------------------------------------------------------
+
+int AddrSpace::PageFaultLoadPage(int pageFaultAddr, int theThreadID) {
+	long long start = stats->totalTicks;
+
+	invPageTableLock.Acquire();
+	stats->numPageFaults++;
+	if (DebugIsEnabled('a'))
+		frameAllocator->Print();
+	int page = pageFaultAddr / PageSize;
+
+	TRACE(TracePageFault, page, theThreadID);
+	if (pffEnabled) {
+		AdjustQuota();
+		if (totalQuota > NumPhysPages && runningSpaces > 1)
+			Suspend();
+	}
+
+	for (;;) {
+		// still being written out, or already being read in?
+		if (inTransit[page] != -1) {
+			WaitFrame(inTransit[page]);
+			continue;
+		}
+		if (Entry(page)->valid)		// read ahead meanwhile
+			break;
+		// another instance may already have this code page in memory
+		if (IsSharedPage(page) && text->frame[page] != -1) {
+			if (coreMap->entry[text->frame[page]].busy) {
+				WaitFrame(text->frame[page]);
+				continue;
+			}
+			Entry(page)->physicalPage = text->frame[page];
+			Entry(page)->valid = TRUE;
+			text->entry[page].use = TRUE;
+			break;
+		}
+
+		int frame = GetFrame();
+		int frameOffset = frame * PageSize;
+		
+		//printf("\tpage: %d\tframe: %d\tPageSize: %d\tframeOffset: %d\t", page, frame, PageSize, frameOffset);
+
+		if(-1 == frame) {
+			invPageTableLock.Release();
+			return 1;
+		}
+		if (inTransit[page] != -1 || 
+		    (IsSharedPage(page) && text->frame[page] != -1)) {
+			// someone else got to this page while we were evicting
+			frameAllocator->Free(frame);
+			frameReplacer->Freed(frame);
+			ReleaseFrame(frame);
+			continue;
+		}
+
+		//empty frame found
+		inTransit[page] = frame;
+		if (IsSharedPage(page))
+			text->frame[page] = frame;	// others wait for us
+		invPageTableLock.Release();
+		if (inSwap[page])
+			SwapRead(&machine->mainMemory[frameOffset], 1, page);
+		else
+			ReadPageImage(page, &machine->mainMemory[frameOffset]);
+		invPageTableLock.Acquire();
+		MapFrame(page, frame);
+		inTransit[page] = -1;
+		ReleaseFrame(frame);
+		ReadAhead(page);
+		break;
+	}
+		
+	paging.RecordFault(stats->totalTicks - start);
+	stats->paging.RecordFault(stats->totalTicks - start);
+	if (DebugIsEnabled('a'))
+		frameAllocator->Print();
+	invPageTableLock.Release();
+
+	return 0;
+}
+	
+
+
+//----------------------------------------------------------------------
+// AddrSpace::ShmAttach
+// 	Map the shared memory segment called "key" at the end of the 
+//	address space, making it first if no one has it yet: "size" bytes,
+//	zeroed, in frames of its own, which stay in memory (evicting other
+//	pages to make room, if need be).  A Fork child shares its parent's
+//	segments.  A segment goes away when the last space using it exits.
+//
+// Returns:
+//	the address of the segment, or -1 if "size" isn't positive, is 
+//	bigger than a quarter of physical memory, or is bigger than an
+//	existing segment "key"; or if there is no memory for it, or we 
+//	have MaxSegments already
+//----------------------------------------------------------------------
+
+int
+AddrSpace::ShmAttach(int key, int size)
+{
+    SharedSegment *seg;
+    int slot, i, first;
+    unsigned int pages = divRoundUp(size, PageSize);
+
+    for (slot = 0; slot < MaxSegments && segments[slot] != NULL; slot++)
+	;
+    if (slot == MaxSegments || size <= 0 || (int) pages > NumPhysPages / 4)
+	return -1;
+    invPageTableLock.Acquire();
+    for (seg = segmentList; seg != NULL && seg->key != key; seg = seg->next)
+	;
+    if (seg != NULL && (int) pages > seg->numPages) {
+	invPageTableLock.Release();
+	return -1;
+    }
+    if (seg == NULL) {
+	seg = new SharedSegment;
+	seg->key = key;
+	seg->numPages = pages;
+	seg->frame = new int[pages];
+	for (i = 0; i < (int) pages; i++) {
+	    if ((seg->frame[i] = GetFrame()) == -1) {
+		while (--i >= 0)
+		    frameAllocator->Free(seg->frame[i]);
+		delete [] seg->frame;
+		delete seg;
+		invPageTableLock.Release();
+		return -1;
+	    }
+	    frameReplacer->Freed(seg->frame[i]);	// and never Loaded
+	    machine->InvalidateDecodedPage(seg->frame[i]);
+	    bzero(&machine->mainMemory[seg->frame[i] * PageSize], PageSize);
+	    ReleaseFrame(seg->frame[i]);
+	}
+	seg->refs = 0;
+	seg->next = segmentList;
+	segmentList = seg;
+    }
+    seg->refs++;			// it can't go away while we grow
+    invPageTableLock.Release();
+
+    first = mapNext / PageSize;
+    mapNext += seg->numPages * PageSize;
+    if ((unsigned) divRoundUp(mapNext, PageSize) > numPages)
+	Grow(divRoundUp(mapNext, PageSize) - numPages);
+    invPageTableLock.Acquire();
+    for (i = 0; i < seg->numPages; i++) {
+	TranslationEntry *pte = Entry(first + i);
+
+	pte->physicalPage = seg->frame[i];
+	pte->valid = TRUE;
+	pte->dirty = TRUE;		// it has no other copy
+    }
+    segments[slot] = seg;
+    segmentPage[slot] = first;
+    invPageTableLock.Release();
+    DEBUG('a', "Attached shared segment %d (%d pages) at 0x%x\n", key,
+		seg->numPages, first * PageSize);
+    return first * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::DetachSegments
+// 	Unmap our shared memory segments, freeing each one's frames if we 
+//	were its last user.  Called holding invPageTableLock.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::DetachSegments()
+{
+    SharedSegment **sp, *seg;
+
+    for (int s = 0; s < MaxSegments; s++) {
+	if ((seg = segments[s]) == NULL)
+	    continue;
+	for (int i = 0; i < seg->numPages; i++)
+	    Entry(segmentPage[s] + i)->valid = FALSE;
+	segments[s] = NULL;
+	if (--seg->refs > 0)
+	    continue;
+	for (sp = &segmentList; *sp != seg; sp = &(*sp)->next)
+	    ;
+	*sp = seg->next;
+	for (int i = 0; i < seg->numPages; i++)
+	    frameAllocator->Free(seg->frame[i]);
+	delete [] seg->frame;
+	delete seg;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsSegmentPage, AddrSpace::PhysicalWord
+// 	Is virtual page "page" in one of our shared memory segments?  And
+//	where is the word at "virtAddr" in physical memory, if it is in a
+//	segment (and word aligned)?  Otherwise -1.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsSegmentPage(int page)
+{
+    for (int s = 0; s < MaxSegments; s++)
+	if (segments[s] != NULL && page >= segmentPage[s]
+		&& page < segmentPage[s] + segments[s]->numPages)
+	    return TRUE;
+    return FALSE;
+}
+
+int
+AddrSpace::PhysicalWord(int virtAddr)
+{
+    int page = (unsigned) virtAddr / PageSize;
+
+    if ((virtAddr & 0x3) != 0 || !IsSegmentPage(page))
+	return -1;
+    return FindEntry(page)->physicalPage * PageSize + virtAddr % PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FutexWait, AddrSpace::FutexWake
+// 	Sleeping and waking for synchronization in shared memory: a user
+//	program's lock or condition is a word in a segment, changed with
+//	LL/SC (see start.s) without the kernel, which is only called when
+//	someone has to wait.  FutexWait sleeps only if the word still holds
+//	"value", checked with interrupts off, so a FutexWake that comes
+//	after the word changed can't be missed.  Waiters are queued by 
+//	the word's physical address, so processes that attached the 
+//	segment at different addresses still meet.
+//
+// Returns:
+//	FutexWait: 0 once woken, -1 if the word didn't hold "value", or
+//	isn't in a segment
+//	FutexWake: how many threads were woken (at most "count", oldest
+//	first)
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FutexWait(int virtAddr, int value)
+{
+    int addr = PhysicalWord(virtAddr);
+    IntStatus oldLevel;
+
+    if (addr == -1)
+	return -1;
+    oldLevel = interrupt->SetLevel(IntOff);
+    if ((int) WordToHost(*(int *) &machine->mainMemory[addr]) != value) {
+	(void) interrupt->SetLevel(oldLevel);
+	return -1;
+    }
+    currentThread->listKey = addr;
+    futexQueues[(addr / 4) % FutexBuckets].Append(currentThread);
+    currentThread->Sleep();
+    (void) interrupt->SetLevel(oldLevel);
+    return 0;
+}
+
+int
+AddrSpace::FutexWake(int virtAddr, int count)
+{
+    int addr = PhysicalWord(virtAddr), woken = 0, n;
+    IntrusiveList<Thread> *queue;
+    IntStatus oldLevel;
+    Thread *t;
+
+    if (addr == -1)
+	return 0;
+    queue = &futexQueues[(addr / 4) % FutexBuckets];
+    oldLevel = interrupt->SetLevel(IntOff);
+    for (n = queue->getSize(); n > 0; n--) {	// keep the others in order
+	t = queue->Remove();
+	if (t->listKey == addr && woken < count) {
+	    scheduler->ReadyToRun(t);
+	    woken++;
+	} else
+	    queue->Append(t);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    return woken;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddFile, AddrSpace::GetFile, AddrSpace::CloseFile
+// 	The process's open file table, mapping the OpenFileIds handed out
+//	by Open to Nachos OpenFile objects.  ConsoleInput and ConsoleOutput
+//	are never in the table.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddFile(OpenFile *file)
+{
+	for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+		if (openFiles[id] == NULL && openPipes[id] == NULL) {
+			openFiles[id] = file;
+			return id;
+		}
+	return -1;
+}
+
+int
+AddrSpace::AddPipe(PipeBuffer *pipe, bool writing)
+{
+	for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+		if (openFiles[id] == NULL && openPipes[id] == NULL) {
+			openPipes[id] = pipe;
+			pipeWrites[id] = writing;
+			return id;
+		}
+	return -1;
+}
+
+OpenFile *
+AddrSpace::GetFile(int id)
+{
+	if (id <= ConsoleOutput || id >= MaxOpenFiles)
+		return NULL;
+	return openFiles[id];
+}
+
+PipeBuffer *
+AddrSpace::GetPipe(int id, bool writing)
+{
+	if (id < 0 || id >= MaxOpenFiles || openPipes[id] == NULL ||
+	    pipeWrites[id] != writing)
+		return NULL;
+	return openPipes[id];
+}
+
+bool
+AddrSpace::CloseFile(int id)
+{
+	OpenFile *file = GetFile(id);
+
+	if (id >= 0 && id < MaxOpenFiles && openPipes[id] != NULL) {
+		if (openPipes[id]->CloseEnd(pipeWrites[id]))
+			delete openPipes[id];
+		openPipes[id] = NULL;
+		return TRUE;
+	}
+	if (file == NULL)
+		return FALSE;
+	for (int r = 0; r < MaxAioRequests; r++)
+		if (aio[r] != NULL && aio[r]->file == file)
+			(void) aio[r]->Wait();	// it must not outlive the file
+	delete file;
+	openFiles[id] = NULL;
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddAio, AddrSpace::GetAio, AddrSpace::RemoveAio
+// 	The process's asynchronous I/O requests (see aio.h), by the ids
+//	AioRead and AioWrite return, from when they are made until 
+//	AioWait.  CloseFile waits for those on the file it closes.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddAio(AioRequest *request)
+{
+	for (int id = 0; id < MaxAioRequests; id++)
+		if (aio[id] == NULL) {
+			aio[id] = request;
+			return id;
+		}
+	return -1;
+}
+
+AioRequest *
+AddrSpace::GetAio(int id)
+{
+	if (id < 0 || id >= MaxAioRequests)
+		return NULL;
+	return aio[id];
+}
+
+void
+AddrSpace::RemoveAio(int id)
+{
+	ASSERT(GetAio(id) != NULL);
+	(void) aio[id]->Wait();
+	delete aio[id];
+	aio[id] = NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::InheritConsole
+// 	Start a new process's ConsoleInput and ConsoleOutput off as the
+//	ends of pipes that "input" and "output" are in "parent", which
+//	may be the parent's own ConsoleInput and ConsoleOutput.  A 
+//	console id that means the real console stays the console.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::InheritConsole(AddrSpace *parent, int input, int output)
+{
+	PipeBuffer *in = parent->GetPipe(input, FALSE);
+	PipeBuffer *out = parent->GetPipe(output, TRUE);
+
+	if (in != NULL) {
+		in->OpenEnd(FALSE);
+		openPipes[ConsoleInput] = in;
+		pipeWrites[ConsoleInput] = FALSE;
+	}
+	if (out != NULL) {
+		out->OpenEnd(TRUE);
+		openPipes[ConsoleOutput] = out;
+		pipeWrites[ConsoleOutput] = TRUE;
+	}
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyUser
+// 	Copy between a kernel buffer and this address space, a page at a
+//	time: each page is translated once and copied with bcopy, rather
+//	than going through machine->ReadMem or WriteMem for every byte.  
+//	Pages that are not in memory are faulted in, and copy-on-write 
+//	pages copied, as if the program had touched them itself.
+//
+//	Called by the process that owns the address space, not holding
+//	invPageTableLock.
+//
+//	"virtAddr" -- where the data is, or goes, in user space
+//	"buffer" -- the kernel buffer
+//	"size" -- how many bytes
+//	"writing" -- TRUE to copy into user space
+//	"string" -- stop after copying a '\0' (only when reading)
+//
+// Returns:
+//	the number of bytes copied (not counting a '\0' that ended a
+//	string), or -1 if part of the range is not in the address space,
+//	is read-only, or could not be paged in.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::CopyUser(int virtAddr, char *buffer, int size, bool writing,
+			bool string)
+{
+	int done = 0;
+
+	while (done < size) {
+		int addr = virtAddr + done;
+		int offset = (unsigned) addr % PageSize;
+		int count = PageSize - offset;
+		TranslationEntry *pte = PageEntry(addr);
+		char *user;
+
+		if (addr < 0 || pte == NULL)
+			return -1;
+		if (!pte->valid) {
+			if (PageFaultLoadPage(addr, currentThread->getID()))
+				return -1;
+			continue;	// it may be gone again; check
+		}
+		if (writing && pte->readOnly) {
+			if (!CopyOnWrite(addr))
+				return -1;
+			continue;
+		}
+
+		// nothing below can switch threads, so the page stays put
+		if (count > size - done)
+			count = size - done;
+		user = &machine->mainMemory[pte->physicalPage * PageSize + offset];
+		pte->use = TRUE;
+		if (machine->frameRefHook != NULL)
+			(*machine->frameRefHook)(pte->physicalPage);
+		if (writing) {
+			bcopy(buffer + done, user, count);
+			pte->dirty = TRUE;
+			machine->InvalidateDecodedPage(pte->physicalPage);
+		} else if (string) {
+			for (int i = 0; i < count; i++)
+				if ((buffer[done + i] = user[i]) == '\0')
+					return done + i;
+		} else
+			bcopy(user, buffer + done, count);
+		done += count;
+	}
+	return done;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyIn, CopyOut, CopyInString
+// 	Move system call arguments between user space and the kernel (see
+//	CopyUser).
+//
+//	CopyInString copies a '\0'-terminated string of at most 
+//	"size" - 1 characters, and always terminates the copy.  It returns
+//	the string's length; -1 on bad addresses, or if there is no '\0' 
+//	in the first "size" bytes.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::CopyIn(int virtAddr, char *into, int size)
+{
+	return CopyUser(virtAddr, into, size, FALSE, FALSE);
+}
+
+int
+AddrSpace::CopyOut(int virtAddr, char *from, int size)
+{
+	return CopyUser(virtAddr, from, size, TRUE, FALSE);
+}
+
+int
+AddrSpace::CopyInString(int virtAddr, char *into, int size)
+{
+	int length = CopyUser(virtAddr, into, size, FALSE, TRUE);
+
+	if (length < 0 || length == size) {	// bad address, or too long
+		if (size > 0)
+			into[size - 1] = '\0';
+		return -1;
+	}
+	return length;
+}
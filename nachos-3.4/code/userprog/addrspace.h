@@ -15,40 +15,317 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "noff.h"
+#include "stats.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		16	// size of each process's open 
+					// file table; ids 0 and 1 are the
+					// console
+#define MaxHeapSize		(256 * 1024)	// most bytes Sbrk may add
+					// to an address space
+#define MaxMappings		4	// files a process may have mapped
+					// at once (Mmap)
+#define MaxSegments		4	// shared memory segments a process
+					// may attach (ShmAttach)
+#define MaxAioRequests		8	// AioRead and AioWrite requests a
+					// process may have, until AioWait
+#define MaxArgs			16	// most arguments ExecV may pass,
+#define MaxArgBytes		256	// ... and most bytes of them; they
+					// come out of the stack
+#define FutexBuckets		16	// hash chains of threads waiting
+					// in FutexWait
+#define PromoteMisses		8	// TLB misses in a group of pages
+					// (with -sup) before we try to
+					// make it a superpage
+
+class SharedText;
+class SharedSegment;
+class PipeBuffer;
+class AioRequest;
+
+// A file mapped into an address space by Mmap: the first "length" bytes
+// of the file are the backing store of the pages from "firstPage" on,
+// in place of swap.
+
+class Mapping {
+  public:
+    OpenFile *file;			// NULL if the slot is unused
+    char *name;				// so that Fork can open it again
+    int firstPage;
+    int numPages;
+    int length;
+};
 
 class AddrSpace {
   public:
-    AddrSpace(OpenFile *executable);
+    AddrSpace(OpenFile *executable, char *name,
+	      AddrSpace *sibling = NULL);
 					// Create an address space,
 					// initializing it with the program
-					// stored in the file "executable"
-    ~AddrSpace();			// De-allocate an address space
+					// stored in the file "executable".
+					// Pages are loaded from the file on
+					// demand, so we keep (and eventually
+					// delete) it.  Code pages are shared
+					// with other spaces running "name".
+					// A "sibling" already running from
+					// "executable" lends us its header
+					// and the file (SpawnMany)
+    AddrSpace(AddrSpace *parent, int ID);
+					// Make a copy-on-write duplicate of
+					// "parent" (Fork); "ID" is its
+					// process id
+    ~AddrSpace();			// De-allocate (by the last Drop)
 
     void InitRegisters();
 					// Initialize user-level CPU registers,
 					// before jumping to user code
+    void SetArguments(char *strings, int size, int count);
+					// Have InitRegisters pass "count"
+					// strings, end to end in "size" 
+					// bytes, to main as argc and argv
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
 	int PageFaultLoadPage(int pageFault, int threadID);
+    bool CopyOnWrite(int virtAddr);	// Handle a write to a copy-on-write
+					// page; FALSE if it really is
+					// read-only
+
+    TranslationEntry *PageEntry(int virtAddr);
+					// Page table entry for "virtAddr",
+					// NULL if it is outside the space
+#ifdef USE_TLB
+    void LoadTLB(int page);		// Put "page" (in memory) into the
+					// TLB, in a superpage if we can
+#endif
+
+    int Sbrk(int increment);		// Grow the heap by "increment"
+					// bytes of zeroes; returns the old
+					// end of the heap, or -1
+    int Mmap(char *name, int length);	// Map "length" bytes of the file
+					// "name"; returns their address, or
+					// -1
+    bool Munmap(int virtAddr);		// Write back and unmap the mapping
+					// at "virtAddr"; FALSE if none
+    int ShmAttach(int key, int size);	// Map the shared memory segment
+					// "key", made "size" bytes long if
+					// it is new; returns its address, 
+					// or -1
+    int FutexWait(int virtAddr, int value);
+					// Sleep if the word at "virtAddr" (in
+					// a segment) holds "value"; -1 if not
+    int FutexWake(int virtAddr, int count);
+					// Wake up to "count" threads sleeping
+					// on it; returns how many
+
+    int AddFile(OpenFile *file);	// Give "file" an OpenFileId; -1
+					// if the table is full
+    OpenFile *GetFile(int id);		// The file for "id", or NULL
+    bool CloseFile(int id);		// Close "id"; FALSE if not open
+    int AddPipe(PipeBuffer *pipe, bool writing);
+					// Give one end of "pipe" an 
+					// OpenFileId; -1 if the table is full
+    PipeBuffer *GetPipe(int id, bool writing);
+					// The pipe "id" is the read (or 
+					// write) end of, or NULL; ids 0 and 1
+					// too, if they aren't the console
+    void InheritConsole(AddrSpace *parent, int input, int output);
+					// Read and write our ConsoleInput and
+					// ConsoleOutput where "parent" does
+					// with "input" and "output"
+    int AddAio(AioRequest *request);	// Give "request" an id; -1 if we
+					// have too many
+    AioRequest *GetAio(int id);		// The request "id", or NULL
+    void RemoveAio(int id);		// Delete request "id", once done
+
+    int CopyIn(int virtAddr, char *into, int size);
+    int CopyOut(int virtAddr, char *from, int size);
+    int CopyInString(int virtAddr, char *into, int size);
+					// Copy system call arguments in and
+					// out of user memory, paging in as
+					// needed; -1 on a bad address
 
 	
 	void GenerateSWAP(OpenFile *executable, int);
+					// Set up our backing store; swap
+					// slots are only taken once needed
   
-	void KillSWAP(int ID);
+	void KillSWAP(int ID);		// Free our swap slots now (at Halt)
+
+    void Exit();			// The process is done with us
+    void Hold();			// Count another reference
+    void Drop();			// ... and drop one; the last one
+					// deletes the address space
+
+    void PrintPagingStats(int ID);	// Report our paging activity
+
+    void Sample(int pc);		// Count a profiler sample at "pc"
+    void WriteProfile(int ID);		// Write our samples to prof.<ID>
+
+    static void StartMerging(int interval);
+					// Merge pages with the same contents
+					// every "interval" ticks
+    static void StartPageout(int lowWater);
+					// Start a kernel thread that evicts
+					// pages whenever fewer than 
+					// "lowWater" frames are free
 
 	private:
+    void AllocatePageTable();		// Empty pageTable or pageDir
+    TranslationEntry *Entry(int page);	// Entry for "page", allocating
+					// its second-level table if need be
+    TranslationEntry *FindEntry(int page);
+					// Same, but NULL if it has no table
 
 
-    TranslationEntry *pageTable;	// Assume linear page table translation
-					// for now!
+    TranslationEntry *pageTable;	// Linear page table, or NULL if
+					// we use pageDir instead
+    TranslationEntry **pageDir;		// With -pt2, second-level tables of
+					// PageTableChunk entries, each
+					// allocated when first needed
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
 	unsigned int startPage;		//Page number that the program starts at
 								//in physical memory
+    int *swapSlot;			// For each page, its slot in the swap
+					// area, or -1; taken on the first
+					// dirty eviction
+    bool swapReserved;			// Have we tried to reserve a run of 
+					// slots for the whole space yet?
+    bool *inSwap;			// For each page, is there a copy in
+					// its swap slot?  If not, the page
+					// comes from the executable or is 
+					// zero-filled
+    OpenFile *exeFile;			// The executable we page from
+    int *exeUsers;			// ... how many spaces page from it;
+					// the last one closes it
+    char *exeName;			// ... and its name, so Fork can 
+					// open it again; NULL if unknown
+    int *inTransit;			// For each page, the frame whose disk
+					// I/O it is waiting for, or -1
+    bool *copyOnWrite;			// For each page, is it shared with
+					// a Fork parent or child, until one 
+					// of us writes it?
+    NoffHeader noffH;			// Layout of the executable, as read
+					// by the constructor
+    char *args;				// Arguments from SetArguments, until
+    int argSize, argCount;		// InitRegisters pushes them; NULL if
+					// there are none
+    int PushArguments(int top);		// Put them on the stack, under "top";
+					// returns argv, or -1
+    int heapStart;			// The heap, past the top of the
+    int heapEnd;			// stack: its first and last+1 bytes
+    void Grow(int count);		// Add "count" pages at the end
+
+    Mapping mappings[MaxMappings];	// Files mapped by Mmap
+    int mapNext;			// Where the next mapping goes, above
+					// the most the heap can grow to
+    Mapping *MappingOf(int page);	// The mapping "page" is in, or NULL
+    void Unmap(Mapping *m);		// Write back and evict its pages
+    void ReadMapped(Mapping *m, int page, char *into);
+    void WriteMapped(Mapping *m, int page, int frame);
+					// Move a page from or to its file
+
+    SharedSegment *segments[MaxSegments];	// Attached by ShmAttach,
+    int segmentPage[MaxSegments];	// ... at these first pages
+    bool IsSegmentPage(int page);	// Is "page" in one of them?
+    int PhysicalWord(int virtAddr);	// Where the word at "virtAddr" is in
+					// mainMemory; -1 unless it is in a
+					// segment
+    void DetachSegments();		// Let go of all of them (Exit)
+
+    void ReadPageImage(int page, char *into);
+					// Build the initial contents of 
+					// virtual page "page"
+    int CopyUser(int virtAddr, char *buffer, int size, bool writing,
+		 bool string);		// Body of CopyIn, CopyOut...
+    void SwapOut(int page, int frame);	// Save a modified page in swap
+    void SwapRead(char *into, int count, int page);
+					// Read "count" pages back from swap
+    int SwapSlot(int page);		// The slot for "page", taken if 
+					// need be
+    void FreeSwap();			// Give back all our slots
+    OpenFile *openFiles[MaxOpenFiles];	// Opened by Open, by OpenFileId
+    PipeBuffer *openPipes[MaxOpenFiles];	// ... or made by Pipe, NULL if
+					// none; ConsoleInput and 
+					// ConsoleOutput may be pipes too
+    bool pipeWrites[MaxOpenFiles];	// Is openPipes[id] the write end?
+    AioRequest *aio[MaxAioRequests];	// AioRead and AioWrite requests,
+					// until AioWait; NULL if none
+
+    int refs;				// the process, and evictions writing
+					// our pages (see Hold)
+    bool exiting;			// no more swap writes: we are going
+					// away
+    PagingStats paging;			// Our share of stats->paging
+
+    int *profile;			// With -prof, samples taken at each
+					// instruction of the code segment;
+					// otherwise NULL
+    int profileSamples;			// all of them, in the code or not
+    void InitProfile();			// Start with no samples
+
+    int nextFault;			// the fault that would continue the
+					// last sequential run
+    int readAhead;			// pages to prefetch on the next
+					// sequential fault
+    void ReadAhead(int page);		// Prefetch the pages after "page"
+    void MapFrame(int page, int frame);	// "frame" now holds "page"
+
+    int resident;			// frames we own (not counting shared
+					// code)
+    int quota;				// frames we may own (with -pff)
+    long long lastFaultTick;		// when we last took a page fault
+    bool suspended;			// swapped out to relieve thrashing?
+    void AdjustQuota();			// Grow or shrink the quota by the
+					// page fault frequency
+    void Suspend();			// Give up all our frames, and wait
+					// until there is room for us
+    static void ResumeSuspended();	// Restart whoever fits now
+    static void EvictFrame(int frame);	// Take a page away from whoever
+					// maps it, saving it if need be
+    static void PageoutDaemon(int);	// The pageout work, run by workQueue
+    static void ScheduleMerge();	// Queue the next merging scan
+    static void MergeDaemon(int);	// A merging scan, run by workQueue
+    static bool CanMerge(int frame, bool keeper);
+					// May this frame be merged?
+    static void MergeFrame(int frame, int keeper);
+					// Share "keeper" instead of "frame"
+    static void WaitFrame(int frame);	// Wait for "frame"'s I/O to finish
+    static void ReleaseFrame(int frame);	// ... and announce that it has
+    static void ReclaimFrame(int frame);	// Evict a page and free its frame
+    void WaitForTransit();		// Wait until none of our pages has
+					// I/O in progress
+    int GetFrame();			// Find a free frame, evicting a page
+					// if need be; -1 if there is none
+    bool UnmapCow(int page);		// Stop sharing the frame holding 
+					// copy-on-write page "page"; FALSE
+					// if no one else was using it
+
+#ifdef USE_TLB
+    int *groupMisses;			// TLB misses in each aligned group
+					// of tlbManager->MaxPages() pages,
+					// since we last tried to promote it
+    void InitSuperpages();		// No misses yet
+    int asid;				// Our address space ID in the TLB,
+    int asidGeneration;			// and the generation it is from;
+					// -1 until we first run (see tlbmgr.h)
+    bool CanMapSuperpage(int first, int count);
+					// Could one TLB entry map these?
+    bool Promote(int first, int count);	// Move pages into aligned
+					// consecutive frames
+#endif
+
+    SharedText *text;			// Our code pages, shared by every 
+					// space running the same executable;
+					// NULL if we have no whole code pages
+    bool IsSharedPage(int page);	// Is "page" one of the shared ones?
+    void AttachText(char *name, int numText);
+    void DetachText();			// Let go of the shared code pages
+    static void EvictShared(int frame);	// Unmap a shared code page from
+					// every space using it
 };
 
 #endif // ADDRSPACE_H
@@ -0,0 +1,123 @@
+// aio.cc
+//	Routines for asynchronous file I/O.  See aio.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "aio.h"
+
+static long long numRequests = 0, numBytes = 0, numBlocked = 0;
+static bool registered = FALSE;
+
+//----------------------------------------------------------------------
+// AioTransfer
+// 	Work item: do the transfer of the AioRequest "arg".
+//----------------------------------------------------------------------
+
+static void
+AioTransfer(int arg)
+{
+    AioRequest *request = (AioRequest *) arg;
+
+    request->Transfer();
+}
+
+//----------------------------------------------------------------------
+// AioRequest::AioRequest
+// 	Set up a transfer, with a kernel buffer for its data.  The
+//	counters are registered with the first one, as "aio.*".
+//
+//	"f" -- the open file; it must stay open until we are done
+//	"pos" -- the byte in the file to start at
+//	"bytes" -- how many bytes, at most MaxAioBytes
+//	"isWrite" -- write the buffer to the file, rather than read it
+//----------------------------------------------------------------------
+
+AioRequest::AioRequest(OpenFile *f, int pos, int bytes, bool isWrite)
+{
+    ASSERT(bytes >= 0 && bytes <= MaxAioBytes);
+    file = f;
+    position = pos;
+    size = bytes;
+    writing = isWrite;
+    userAddr = 0;
+    buffer = new char[size > 0 ? size : 1];
+    result = 0;
+    done = FALSE;
+    finished = new Semaphore("aio finished", 0);
+
+    if (!registered) {
+	registered = TRUE;
+	stats->Register("aio.requests", &numRequests);
+	stats->Register("aio.bytes", &numBytes);
+	stats->Register("aio.blocked", &numBlocked);
+    }
+}
+
+//----------------------------------------------------------------------
+// AioRequest::~AioRequest
+// 	Free the buffer.  A request that was started must be done.
+//----------------------------------------------------------------------
+
+AioRequest::~AioRequest()
+{
+    delete finished;
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// AioRequest::Start
+// 	Queue the transfer for a kernel worker, and return at once.
+//----------------------------------------------------------------------
+
+void
+AioRequest::Start()
+{
+    numRequests++;
+    workQueue->Queue(AioTransfer, (int) this);
+}
+
+//----------------------------------------------------------------------
+// AioRequest::Transfer
+// 	Read or write the file, through the buffer cache and the disk
+//	scheduler like any other file I/O, and let the waiter know.
+//----------------------------------------------------------------------
+
+void
+AioRequest::Transfer()
+{
+    if (writing)
+	result = file->WriteAt(buffer, size, position);
+    else
+	result = file->ReadAt(buffer, size, position);
+    if (result > 0)
+	numBytes += result;
+    DEBUG('c', "Aio %s of %d bytes at %d: %d\n", writing ? "write" : "read",
+	  size, position, result);
+    done = TRUE;
+    finished->V();
+}
+
+//----------------------------------------------------------------------
+// AioRequest::Wait
+// 	Wait until the transfer is done, unless it is already.  Only the
+//	process that made the request waits for it, so "finished" is 
+//	only ever P'd once.
+//
+// Returns:
+//	the bytes transferred (fewer than asked at the end of the file),
+//	or -1
+//----------------------------------------------------------------------
+
+int
+AioRequest::Wait()
+{
+    if (!done) {
+	numBlocked++;
+	finished->P();
+    }
+    return (result < 0) ? -1 : result;
+}
@@ -0,0 +1,57 @@
+// aio.h
+//	Data structures for asynchronous file I/O (AioRead and AioWrite).
+//	A request reads or writes a Nachos file at a given position, while
+//	the process that made it goes on running; AioWait waits for it to
+//	finish, and AioPoll says whether it has.
+//
+//	The data goes through a buffer in the kernel: a write's is copied
+//	in when the request is made, and a read's is only copied out to 
+//	the process by AioWait, since the transfer itself is done by a 
+//	kernel worker thread (see workqueue.h), which can't touch user 
+//	memory.  How many requests are in flight at once is up to the size
+//	of the work queue's pool (-wq); the disk scheduler can reorder the
+//	ones that are.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef AIO_H
+#define AIO_H
+
+#include "copyright.h"
+#include "openfile.h"
+#include "synch.h"
+
+#define MaxAioBytes	4096		// longest transfer; a process may
+					// have MaxAioRequests (addrspace.h)
+
+class AioRequest {
+  public:
+    AioRequest(OpenFile *f, int pos, int bytes, bool isWrite);
+					// A transfer of "size" bytes at 
+					// "position" in "file"; not started
+    ~AioRequest();
+
+    char *Data() { return buffer; }	// The kernel buffer: fill it in
+					// before starting a write, and copy
+					// a read out once it is done
+    void Start();			// Hand it to the work queue
+    void Transfer();			// Do it; called by the worker
+    int Wait();				// Wait for it to finish; returns the
+					// bytes it transferred, or -1
+    bool IsDone() { return done; }
+
+    OpenFile *file;
+    int userAddr;			// the process's buffer
+    bool writing;
+
+  private:
+    char *buffer;
+    int position, size;
+    int result;				// what ReadAt or WriteAt returned
+    bool done;				// has Transfer finished?
+    Semaphore *finished;		// ... V'd when it has
+};
+
+#endif // AIO_H
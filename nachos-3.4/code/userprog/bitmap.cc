@@ -2,6 +2,10 @@
 //	Routines to manage a bitmap -- an array of bits each of which
 //	can be either on or off.  Represented as an array of integers.
 //
+//	Searches work a word at a time: count-trailing-zeroes finds the
+//	first clear (or set) bit in a word, and the "full" bitmap lets us
+//	skip 32 words that have no clear bits by looking at one.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -9,6 +13,13 @@
 #include "copyright.h"
 #include "bitmap.h"
 
+// The lowest clear bit in "word", which must not be all ones.
+#define LowestClear(word)	(__builtin_ctz(~(word)))
+#define BitCount(word)		(__builtin_popcount(word))
+
+// Bits "from" to 31 of a word.
+#define BitsFrom(from)		(~0u << (from))
+
 //----------------------------------------------------------------------
 // BitMap::BitMap
 // 	Initialize a bitmap with "nitems" bits, so that every bit is clear.
@@ -22,8 +33,12 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    numFullWords = divRoundUp(numWords, BitsInWord);
+    full = new unsigned int[numFullWords];
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    nextFit = 0;
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +48,8 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
+    delete [] full;
 }
 
 //----------------------------------------------------------------------
@@ -47,7 +63,7 @@ void
 BitMap::Mark(int which) 
 { 
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    SetBits(which / BitsInWord, 1u << (which % BitsInWord));
 }
     
 //----------------------------------------------------------------------
@@ -60,8 +76,15 @@ BitMap::Mark(int which)
 void 
 BitMap::Clear(int which) 
 {
+    int word = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (map[word] & bit) {
+	map[word] &= ~bit;
+	full[word / BitsInWord] &= ~(1u << (word % BitsInWord));
+	numClear++;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -76,7 +99,7 @@ BitMap::Test(int which)
 {
     ASSERT(which >= 0 && which < numBits);
     
-    if (map[which / BitsInWord] & (1 << (which % BitsInWord)))
+    if (map[which / BitsInWord] & (1u << (which % BitsInWord)))
 	return TRUE;
     else
 	return FALSE;
@@ -84,8 +107,9 @@ BitMap::Test(int which)
 
 //----------------------------------------------------------------------
 // BitMap::Find
-// 	Return the number of the first bit which is clear.
-//	As a side effect, set the bit (mark it as in use).
+// 	Return the number of the first clear bit after the one the last
+//	Find returned, wrapping around to the start (next fit).  As a side
+//	effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
 //	If no bits are clear, return -1.
@@ -94,28 +118,201 @@ BitMap::Test(int which)
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
-	}
+    int which = NextClear(nextFit);
+
+    if (which == -1)
+	which = NextClear(0);
+    if (which == -1)
+	return -1;
+    Mark(which);
+    nextFit = (which + 1) % numBits;
+    return which;
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextClear
+// 	Return the number of the first clear bit at or after "from", 
+//	or -1 if there is none.
+//
+//	"from" is the first bit to look at.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int from)
+{
+    int word;
+    unsigned int bits;
+
+    if (from < 0 || from >= numBits)
+	return -1;
+    word = from / BitsInWord;
+    bits = map[word] | ~BitsFrom(from % BitsInWord);	// ignore those
+							// before "from"
+    if (bits == ~0u) {
+	word = NextNotFull(word + 1);
+	if (word == -1)
+	    return -1;
+	bits = map[word];
+    }
+    return word * BitsInWord + LowestClear(bits);   // not past numBits,
+						    // those are set
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextNotFull
+// 	Return the first word of the bitmap at or after "word" that has
+//	a clear bit, or -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextNotFull(int word)
+{
+    int i = word / BitsInWord;
+    unsigned int bits;
+
+    if (word >= numWords)
+	return -1;
+    bits = full[i] | ~BitsFrom(word % BitsInWord);
+    while (bits == ~0u) {
+	if (++i == numFullWords)
+	    return -1;
+	bits = full[i];
+    }
+    return i * BitsInWord + LowestClear(bits);	// the "full" bits past
+						// numWords are set
+}
+
+//----------------------------------------------------------------------
+// BitMap::ClearRun
+// 	Return the number of clear bits in a row starting at "from", 
+//	counting no more than "max" of them.
+//
+//	"from" is the first bit of the run.
+//	"max" is the longest run we care about.
+//----------------------------------------------------------------------
+
+int
+BitMap::ClearRun(int from, int max)
+{
+    int which = from, count = 0;
+
+    while (count < max && which < numBits) {
+	int offset = which % BitsInWord;
+	unsigned int bits = map[which / BitsInWord] >> offset;
+	int run = (bits == 0) ? BitsInWord - offset : __builtin_ctz(bits);
+
+	count += run;
+	which += run;
+	if (run < BitsInWord - offset)
+	    break;			// stopped by a set bit
+    }
+    return min(count, max);
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Return the first bit of the first run of "count" clear bits at or
+//	after "from", or -1 if there is no such run.  The bits are left
+//	clear.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int from, int count)
+{
+    int start, length;
+
+    for (start = NextClear(from); start != -1; 
+				start = NextClear(start + length)) {
+	length = ClearRun(start, count);
+	if (length == count)
+	    return start;
+    }
     return -1;
 }
 
 //----------------------------------------------------------------------
-// BitMap::NumClear
-// 	Return the number of clear bits in the bitmap.
-//	(In other words, how many bits are unallocated?)
+// BitMap::MarkRun
+// 	Set "count" bits in a row, starting at "from".
 //----------------------------------------------------------------------
 
-int 
-BitMap::NumClear() 
+void
+BitMap::MarkRun(int from, int count)
 {
-    int count = 0;
+    int which = from;
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
-    return count;
+    ASSERT(from >= 0 && from + count <= numBits);
+    while (which < from + count) {
+	int offset = which % BitsInWord;
+	int n = min(BitsInWord - offset, from + count - which);
+	unsigned int bits = (n == BitsInWord) ? ~0u : ((1u << n) - 1) << offset;
+
+	SetBits(which / BitsInWord, bits);
+	which += n;
+    }
+}
+
+//----------------------------------------------------------------------
+// BitMap::CountClear
+// 	Return the number of clear bits among "count" bits starting at 
+//	"from".
+//----------------------------------------------------------------------
+
+int
+BitMap::CountClear(int from, int count)
+{
+    int which = from, clear = 0;
+
+    ASSERT(from >= 0 && from + count <= numBits);
+    while (which < from + count) {
+	int offset = which % BitsInWord;
+	int n = min(BitsInWord - offset, from + count - which);
+	unsigned int bits = (n == BitsInWord) ? ~0u : ((1u << n) - 1) << offset;
+
+	clear += BitCount(bits & ~map[which / BitsInWord]);
+	which += n;
+    }
+    return clear;
+}
+
+//----------------------------------------------------------------------
+// BitMap::SetBits
+// 	Set "bits" in word "word" of the bitmap, keeping the count of 
+//	clear bits, and the map of full words, up to date.
+//----------------------------------------------------------------------
+
+void
+BitMap::SetBits(int word, unsigned int bits)
+{
+    numClear -= BitCount(bits & ~map[word]);
+    map[word] |= bits;
+    if (map[word] == ~0u)
+	full[word / BitsInWord] |= 1u << (word % BitsInWord);
+}
+
+//----------------------------------------------------------------------
+// BitMap::Recount
+// 	Set the bits past the end of the bitmap (so that searches never
+//	find them), then work out the map of full words, and the number
+//	of clear bits, from scratch.
+//----------------------------------------------------------------------
+
+void
+BitMap::Recount()
+{
+    int i;
+
+    if (numBits % BitsInWord != 0)
+	map[numWords - 1] |= BitsFrom(numBits % BitsInWord);
+    for (i = 0; i < numFullWords; i++)
+	full[i] = 0;
+    if (numWords % BitsInWord != 0)
+	full[numFullWords - 1] = BitsFrom(numWords % BitsInWord);
+    numClear = 0;
+    for (i = 0; i < numWords; i++) {
+	numClear += BitsInWord - BitCount(map[i]);
+	if (map[i] == ~0u)
+	    full[i / BitsInWord] |= 1u << (i % BitsInWord);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -151,6 +348,8 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    nextFit = 0;
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -3,7 +3,9 @@
 //	can be either on or off.
 //
 //	Represented as an array of unsigned integers, on which we do
-//	modulo arithmetic to find the bit we are interested in.
+//	modulo arithmetic to find the bit we are interested in.  Searches
+//	look at a word at a time, and skip words with every bit set using
+//	a second, smaller bitmap with one bit per word.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -41,9 +43,22 @@ class BitMap {
     void Clear(int which);  	// Clear the "nth" bit
     bool Test(int which);   	// Is the "nth" bit set?
     int Find();            	// Return the # of a clear bit, and as a side
-				// effect, set the bit. 
+				// effect, set the bit.  Searches carry on 
+				// from where the last one left off.
 				// If no bits are clear, return -1.
-    int NumClear();		// Return the number of clear bits
+    int NumClear() { return numClear; }	// Return the number of clear bits
+
+    // Runs of bits, for allocating consecutive disk sectors.
+    int NextClear(int from);	// The first clear bit at or after "from",
+				// or -1 if there is none
+    int ClearRun(int from, int max);	// How many clear bits in a row,
+				// starting at "from" (at most "max")
+    int FindRun(int from, int count);	// The first bit of the first run 
+				// of "count" clear bits at or after 
+				// "from", or -1; none are set
+    void MarkRun(int from, int count);	// Set "count" bits, from "from"
+    int CountClear(int from, int count);  // The number of clear bits among
+				// "count" bits, from "from"
 
     void Print();		// Print contents of bitmap
     
@@ -58,7 +73,19 @@ class BitMap {
 					// (rounded up if numBits is not a
 					//  multiple of the number of bits in
 					//  a word)
-    unsigned int *map;			// bit storage
+    unsigned int *map;			// bit storage; the bits past 
+					// numBits are kept set
+    unsigned int *full;			// bit i set if word i of "map" has
+					// every bit set
+    int numFullWords;			// words of "full" storage
+    int numClear;			// clear bits in "map"
+    int nextFit;			// where the next Find starts looking
+
+    void SetBits(int word, unsigned int bits);	// Set "bits" in one word
+    int NextNotFull(int word);		// The first word at or after "word"
+					// with a clear bit, or -1
+    void Recount();			// Recompute "full" and "numClear"
+					// from "map"
 };
 
 #endif // BITMAP_H
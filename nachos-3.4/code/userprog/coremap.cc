@@ -0,0 +1,125 @@
+// coremap.cc 
+//	Routines to keep track of the owner of each physical page frame.
+//	See coremap.h.
+//
+//	Each hash chain is threaded through the entries themselves, so
+//	updating the hash never allocates anything.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "coremap.h"
+
+//----------------------------------------------------------------------
+// CoreMap::CoreMap
+// 	Initialize the core map, with every frame free.
+//
+//	"frames" -- the number of physical page frames
+//----------------------------------------------------------------------
+
+CoreMap::CoreMap(int frames)
+{
+    numFrames = frames;
+    entry = new CoreMapEntry[numFrames];
+    buckets = new int[numFrames];
+    for (int i = 0; i < numFrames; i++) {
+	entry[i].space = NULL;
+	entry[i].page = -1;
+	entry[i].text = NULL;
+	entry[i].sharers = NULL;
+	entry[i].busy = FALSE;
+	entry[i].waiters = 0;
+	entry[i].ioDone = new Semaphore("frame I/O", 0);
+	entry[i].hashNext = -1;
+	buckets[i] = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::~CoreMap
+// 	De-allocate the core map.
+//----------------------------------------------------------------------
+
+CoreMap::~CoreMap()
+{
+    for (int i = 0; i < numFrames; i++)
+	delete entry[i].ioDone;
+    delete [] entry;
+    delete [] buckets;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Hash
+// 	Pick the hash chain for a virtual page of an address space.
+//----------------------------------------------------------------------
+
+int
+CoreMap::Hash(AddrSpace *space, int page)
+{
+    unsigned int key = ((unsigned int) space >> 3) * 31 + page;
+
+    return key % numFrames;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::SetOwner
+// 	Record that "frame" holds virtual page "page" of "space".  
+//	"space" may be NULL, for a frame with no single owner (shared 
+//	code); such frames aren't hashed.
+//----------------------------------------------------------------------
+
+void
+CoreMap::SetOwner(int frame, AddrSpace *space, int page)
+{
+    int b;
+
+    ClearOwner(frame);
+    entry[frame].space = space;
+    entry[frame].page = page;
+    if (space != NULL) {
+	b = Hash(space, page);
+	entry[frame].hashNext = buckets[b];
+	buckets[b] = frame;
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ClearOwner
+// 	Forget who owns "frame", taking it out of the hash.
+//----------------------------------------------------------------------
+
+void
+CoreMap::ClearOwner(int frame)
+{
+    int *f;
+
+    if (entry[frame].space != NULL) {
+	for (f = &buckets[Hash(entry[frame].space, entry[frame].page)];
+			*f != frame; f = &entry[*f].hashNext)
+	    ASSERT(*f != -1);
+	*f = entry[frame].hashNext;
+    }
+    entry[frame].space = NULL;
+    entry[frame].page = -1;
+    entry[frame].hashNext = -1;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Lookup
+// 	Return the frame holding virtual page "page" of "space", or -1 if
+//	"space" owns no frame for it.
+//----------------------------------------------------------------------
+
+int
+CoreMap::Lookup(AddrSpace *space, int page)
+{
+    int f;
+
+    for (f = buckets[Hash(space, page)]; f != -1; f = entry[f].hashNext)
+	if (entry[f].space == space && entry[f].page == page)
+	    return f;
+    return -1;
+}
@@ -0,0 +1,78 @@
+// coremap.h 
+//	Data structures to keep track of what is in each physical page 
+//	frame: the inverted page table, or "core map".
+//
+//	Besides the owner of each frame, the core map keeps a hash of the
+//	(address space, virtual page) pairs in memory, so finding the frame
+//	holding a given page never means scanning every frame.
+//
+//	The core map is sized at startup to the number of physical pages.
+//	It is not synchronized itself; addrspace.cc guards it with its
+//	page table lock.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COREMAP_H
+#define COREMAP_H
+
+#include "copyright.h"
+#include "synch.h"
+
+class AddrSpace;
+class SharedText;
+
+// After a Fork, a frame can be mapped copy-on-write by several address
+// spaces.  The first owner is kept in the frame's CoreMapEntry; the 
+// others are chained off it.
+
+class FrameOwner {
+  public:
+    AddrSpace *space;			// an address space mapping the frame
+    int page;				// ... at this virtual page
+    FrameOwner *next;
+};
+
+// What the core map knows about one frame.
+
+class CoreMapEntry {
+  public:
+    AddrSpace *space;			// owner, NULL if the frame is free
+					// or holds shared code
+    int page;				// virtual page in the owner (or in
+					// the shared code)
+    SharedText *text;			// shared code the frame belongs to
+    FrameOwner *sharers;		// other copy-on-write owners
+    bool busy;				// disk I/O in progress?
+    int waiters;			// threads waiting for it to finish
+    Semaphore *ioDone;			// ... which sleep here
+    int hashNext;			// next frame in the same hash chain
+};
+
+// The following class defines the core map.
+
+class CoreMap {
+  public:
+    CoreMap(int frames);		// Initialize, all frames free
+    ~CoreMap();
+
+    CoreMapEntry *entry;		// one per frame; the owner fields 
+					// are changed only with SetOwner
+					// and ClearOwner
+
+    void SetOwner(int frame, AddrSpace *space, int page);
+					// "frame" now holds "page" of "space"
+    void ClearOwner(int frame);		// "frame" is free, or holds a page
+					// with no single owner
+    int Lookup(AddrSpace *space, int page);
+					// Return the frame owned by "space"
+					// at virtual page "page", or -1
+
+  private:
+    int Hash(AddrSpace *space, int page);
+    int numFrames;
+    int *buckets;			// first frame in each hash chain
+};
+
+#endif // COREMAP_H
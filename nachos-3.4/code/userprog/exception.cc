@@ -28,15 +28,739 @@
 #include "syscall.h"
 #include "addrspace.h"   // FA98
 #include "sysdep.h"   // FA98
+#include "synchconsole.h"
+#include "pipe.h"
+#include "aio.h"
+#include "slab.h"
 
 // begin FA98
 
 static int SRead(int addr, int size, int id);
-static void SWrite(char *buffer, int size, int id);
-Thread * getID(int toGet);
+static int SWrite(int addr, int size, int id);
+static OpenFile *SOpen(int nameAddr, bool create);
 
 // end FA98
 
+// The console, for user programs.  It is only started by the first 
+// console Read: once it is polling the keyboard, Nachos no longer halts
+// by itself when every process has exited.  Until then, output just 
+// goes to stdout.
+static SynchConsole *synchConsole = NULL;
+
+// Page-sized buffers for Read and Write, which want one per call.  The
+// cache is made by the first of them, as -ps may have changed PageSize.
+static SlabCache *chunkCache = NULL;
+
+static char *getChunk()
+{
+	if (chunkCache == NULL)
+		chunkCache = new SlabCache("chunk", PageSize, 4);
+	return (char *) chunkCache->Alloc(PageSize);
+}
+
+static void killSwap(int arg)	// Used at Halt, to free every process's swap slots.
+ {
+	Thread *thread = (Thread *) arg;
+
+	if (thread->space)
+		thread->space->KillSWAP(thread->getID());
+ }
+
+static void recordTimes(int arg)	// Used at Halt, so Statistics reports the CPU time of processes still running.
+ {
+	Thread *thread = (Thread *) arg;
+
+	stats->RecordProcess(thread->getID(), thread->userTicks, thread->systemTicks);
+ }
+
+static void printCaches(int arg)	// Used at Exit and Halt, to report a process's L1 cache hits and misses.
+ {
+	Thread *thread = (Thread *) arg;
+
+	if (machine->cache[ICache] != NULL)
+		printf("Process %i L1 instruction cache: references %lld, misses %lld\n",
+			thread->getID(), thread->cacheRefs[ICache], thread->cacheMisses[ICache]);
+	if (machine->cache[DCache] != NULL)
+		printf("Process %i L1 data cache: references %lld, misses %lld\n",
+			thread->getID(), thread->cacheRefs[DCache], thread->cacheMisses[DCache]);
+ }
+
+static void writeProfile(int arg)	// Used at Halt, so processes still running write their -prof samples too.
+ {
+	Thread *thread = (Thread *) arg;
+
+	if (thread->space)
+		thread->space->WriteProfile(thread->getID());
+ }
+
+void processCreator(int arg)	// Used when a process first actually runs, not when it is created.
+ {
+	currentThread->space->InitRegisters();		// set the initial register values
+    currentThread->space->RestoreState();		// load page table register
+	
+	if (threadToBeDestroyed != NULL){
+		delete threadToBeDestroyed;
+		threadToBeDestroyed = NULL;
+	}
+
+    machine->Run();			// jump to the user progam
+    ASSERT(FALSE);			// machine->Run never returns;
+ }
+
+void forkedCreator(int func)	// Used when a forked process first runs.
+ {
+	currentThread->RestoreUserState();	// the parent's registers, saved by Fork
+	currentThread->space->RestoreState();	// load page table register
+
+	if (threadToBeDestroyed != NULL){
+		delete threadToBeDestroyed;
+		threadToBeDestroyed = NULL;
+	}
+
+	machine->WriteRegister(2, 0);	// Fork returns 0 in the child
+	machine->WriteRegister(PCReg, func);	// and the child starts at "func"
+	machine->WriteRegister(NextPCReg, func + 4);
+	machine->Run();
+	ASSERT(FALSE);
+ }
+
+//----------------------------------------------------------------------
+// System call handlers
+// 	One routine per system call, called from ExceptionHandler through
+//	syscallTable with the call's arguments (r4, r5 and r6).  Results
+//	go back in r2.
+//
+//	Nothing here is printed unless the 'c' debug flag is on, except
+//	for real errors.
+//----------------------------------------------------------------------
+
+typedef void (*SyscallHandler)(int arg1, int arg2, int arg3);
+
+static void
+SysHalt(int arg1, int arg2, int arg3)
+{
+	DEBUG('c', "Halt, called by thread %i.\n", currentThread->getID());
+	processTable->Apply(recordTimes);
+	processTable->Apply(writeProfile);
+	processTable->Apply(printCaches);
+	interrupt->Halt();
+}
+
+static void
+SysExit(int arg1, int arg2, int arg3)
+{
+	DEBUG('c', "Exit(%d), called by thread %i.\n", arg1, currentThread->getID());
+	if(arg1 != 0)	// Did we exit properly?  If not, show an error message.
+		printf("ERROR: Process %i exited abnormally!\n", currentThread->getID());
+
+	processTable->Exit(currentThread->getID(), arg1);	// Keep the status for Join.
+	printCaches((int) currentThread);
+	if(currentThread->space){
+		if (DebugIsEnabled('c'))
+			currentThread->space->PrintPagingStats(currentThread->getID());
+		currentThread->space->WriteProfile(currentThread->getID());
+		// Delete the used memory from the process.
+		currentThread->space->Exit();
+		currentThread->space = NULL;
+	}
+	currentThread->Finish();	// Delete the thread.
+}
+
+#define MaxSpawn	64	// most processes one SpawnMany may start
+
+static int
+copyInArguments(int argvAddr, char *into, int *size)	// Copy the user's null-terminated argv array into "into", the strings end to end, at most MaxArgBytes.  Returns argc, or -1 if it is bad or too big.
+{
+	AddrSpace *space = currentThread->space;
+	int argc, pointer, length;
+
+	*size = 0;
+	for (argc = 0; ; argc++) {
+		if (space->CopyIn(argvAddr + 4 * argc, (char *) &pointer, 4) < 0)
+			return -1;
+		pointer = WordToHost(pointer);
+		if (pointer == 0)
+			return argc;
+		if (argc == MaxArgs)
+			return -1;
+		length = space->CopyInString(pointer, into + *size, MaxArgBytes - *size);
+		if (length < 0)
+			return -1;
+		*size += length + 1;
+	}
+}
+
+static void
+execProcess(int nameAddr, int argvAddr, int tickets, int input, int output)	// Executes a user process inside another user process, with "tickets" CPU shares, reading "input" and writing "output" as its console.  "argvAddr" is its argv, or 0 for none.
+{
+	char filename[100], args[MaxArgBytes];
+	OpenFile *executable;
+	AddrSpace *space;
+	int argc = 0, argSize = 0;
+
+	// Read file name into the kernel space
+	if (currentThread->space->CopyInString(nameAddr, filename, 100) < 0)
+	{
+		printf("Bad file name for Exec\n");
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	// ... and the arguments, before anything is made
+	if (argvAddr != 0 && (argc = copyInArguments(argvAddr, args, &argSize)) < 0)
+	{
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	// Open File
+	executable = fileSystem->Open(filename);
+	if (executable == NULL) 
+	{
+		printf("Unable to open file %s\n", filename);
+		machine->WriteRegister(2, -1);
+		return;
+	}
+
+	// Calculate needed memory space
+	space = new AddrSpace(executable, filename);
+	space->InheritConsole(currentThread->space, input, output);
+	if (argc > 0)
+		space->SetArguments(args, argSize, argc);
+
+	if(!currentThread->killNewChild)	// If so...
+	{
+		Thread* execThread = new Thread("thrad!");	// Make a new thread for the process.
+		execThread->space = space;	// Set the address space to the new space.
+		execThread->tickets = tickets;
+		int id = processTable->Add(execThread);	// Give it the next unique ID
+		space->GenerateSWAP(executable, id);
+		machine->WriteRegister(2, id);	// Return the thread ID as our Exec return variable.
+		execThread->Fork(processCreator, 0);	// Fork it.
+	}
+	else	// If not...
+	{
+		machine->WriteRegister(2, -1 * (processTable->NextID() + 1));	// Return an error code
+		currentThread->killNewChild = false;	// Reset our variable
+		space->Exit();	// also closes the executable
+	}
+}
+
+static void
+SysExec(int arg1, int arg2, int arg3)
+{
+	DEBUG('c', "Exec, called by thread %i.\n", currentThread->getID());
+	execProcess(arg1, 0, currentThread->tickets, ConsoleInput, ConsoleOutput);	// The child gets the caller's share, and console.
+}
+
+static void
+SysExecTickets(int arg1, int arg2, int arg3)
+{
+	DEBUG('c', "ExecTickets(%d), called by thread %i.\n", arg2, currentThread->getID());
+	if (arg2 <= 0 || arg2 > StrideOne) {	// The stride must be at least 1.
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	execProcess(arg1, 0, arg2, ConsoleInput, ConsoleOutput);
+}
+
+static void
+SysExecPiped(int arg1, int arg2, int arg3)	// Exec, with "arg2" and "arg3" as the child's console.
+{
+	AddrSpace *space = currentThread->space;
+
+	DEBUG('c', "ExecPiped(%d, %d), called by thread %i.\n", arg2, arg3, currentThread->getID());
+	if ((arg2 != ConsoleInput && space->GetPipe(arg2, FALSE) == NULL) ||
+	    (arg3 != ConsoleOutput && space->GetPipe(arg3, TRUE) == NULL)) {
+		machine->WriteRegister(2, -1);	// not the console, nor a pipe end the right way round
+		return;
+	}
+	execProcess(arg1, 0, currentThread->tickets, arg2, arg3);
+}
+
+static void
+SysExecV(int arg1, int arg2, int arg3)	// Exec, passing the argv array at "arg2" to the child's main.
+{
+	DEBUG('c', "ExecV, called by thread %i.\n", currentThread->getID());
+	execProcess(arg1, arg2, currentThread->tickets, ConsoleInput, ConsoleOutput);
+}
+
+static void
+SysSpawnMany(int arg1, int arg2, int arg3)	// Start "arg2" processes running one program, from one open of it; their ids go in the array at "arg3".
+{
+	char filename[100], args[MaxArgBytes];
+	OpenFile *executable;
+	AddrSpace *spaces[MaxSpawn];
+	Thread *thread;
+	int i, id, nameSize, argSize;
+
+	DEBUG('c', "SpawnMany(%d), called by thread %i.\n", arg2, currentThread->getID());
+	if (arg2 <= 0 || arg2 > MaxSpawn
+	    || (nameSize = currentThread->space->CopyInString(arg1, filename, 100)) < 0
+	    || nameSize + 1 + 12 > MaxArgBytes) {
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	executable = fileSystem->Open(filename);
+	if (executable == NULL) {
+		printf("Unable to open file %s\n", filename);
+		machine->WriteRegister(2, -1);
+		return;
+	}
+
+	// Make every space before any child runs, so the first, which the
+	// others take the header from, can't exit in the meantime.  They
+	// all share the file, and the text pages through "filename".
+	for (i = 0; i < arg2; i++) {
+		spaces[i] = new AddrSpace(executable, filename,
+					  (i > 0) ? spaces[0] : NULL);
+		spaces[i]->InheritConsole(currentThread->space, ConsoleInput, ConsoleOutput);
+		strcpy(args, filename);		// argv is { name, "i" }
+		argSize = nameSize + 1;
+		argSize += sprintf(args + argSize, "%d", i) + 1;
+		spaces[i]->SetArguments(args, argSize, 2);
+	}
+	for (i = 0; i < arg2; i++) {
+		thread = new Thread("spawned");
+		thread->space = spaces[i];
+		thread->tickets = currentThread->tickets;
+		id = processTable->Add(thread);
+		spaces[i]->GenerateSWAP(executable, id);
+		if (arg3 != 0) {
+			int word = WordToMachine(id);
+
+			currentThread->space->CopyOut(arg3 + 4 * i, (char *) &word, 4);
+		}
+		thread->Fork(processCreator, 0);
+	}
+	machine->WriteRegister(2, arg2);
+}
+
+static void
+SysJoin(int arg1, int arg2, int arg3)	// Wait for a process to exit, and return its exit status.
+{
+	int status;
+
+	DEBUG('c', "Join(%d), called by thread %i.\n", arg1, currentThread->getID());
+	if(arg1 < 0)	// If the thread was not properly created...
+	{
+		printf("ERROR: Trying to join process %i to process %i, which was not created successfully! Process %i continuing normally.\n", currentThread->getID(), -arg1, currentThread->getID());	// Return an error message, continue as normal.
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	if(arg1 == currentThread->getID())	// We would wait forever.
+	{
+		printf("ERROR: Process %i trying to join itself! Continuing normally.\n", currentThread->getID());
+		machine->WriteRegister(2, -1);
+		return;
+	}
+
+	// Returns at once if it has already exited; any number
+	// of processes may wait for the same one.
+	if(processTable->Join(arg1, &status))
+	{
+		DEBUG('c', "Process %i joined process %i, exit status %i.\n", currentThread->getID(), arg1, status);
+		machine->WriteRegister(2, status);
+	}
+	else
+	{
+		printf("ERROR: Trying to a join process %i to nonexistant process %i! Process %i continuing normally.\n", currentThread->getID(), arg1, currentThread->getID());	// Error message if the thread we're trying to join to doesn't exist for some reason.
+		machine->WriteRegister(2, -1);
+	}
+}
+
+static void
+SysCreate(int arg1, int arg2, int arg3)	// Make an empty Nachos file.
+{
+	OpenFile *file = SOpen(arg1, TRUE);
+
+	DEBUG('c', "Create, called by thread %i.\n", currentThread->getID());
+	if (file == NULL)
+		printf("ERROR: Create failed, called by thread %i.\n", currentThread->getID());
+	delete file;
+}
+
+static void
+SysOpen(int arg1, int arg2, int arg3)	// Open a Nachos file, and return its OpenFileId.
+{
+	OpenFile *file = SOpen(arg1, FALSE);
+	int id = -1;
+
+	if (file != NULL && (id = currentThread->space->AddFile(file)) == -1)
+		delete file;	// too many open files
+	machine->WriteRegister(2, id);
+	DEBUG('c', "Opened OpenFileId %d\n", id);
+}
+
+static void
+SysRead(int arg1, int arg2, int arg3)
+{
+	int result = SRead(arg1, arg2, arg3);
+
+	machine->WriteRegister(2, result);
+	DEBUG('c', "Read %d of %d bytes from OpenFileId %d\n", result, arg2, arg3);
+}
+
+static void
+SysWrite(int arg1, int arg2, int arg3)
+{
+	char buffer[500];
+	int length;
+
+	if (arg3 != ConsoleOutput || currentThread->space->GetPipe(arg3, TRUE) != NULL) {	// a Nachos file or a pipe
+		int result = SWrite(arg1, arg2, arg3);
+
+		machine->WriteRegister(2, result);
+		DEBUG('c', "Wrote %d bytes to OpenFileId %d\n", result, arg3);
+		return;
+	}
+	length = currentThread->space->CopyInString(arg1, buffer, 500);
+	DEBUG('c', "Write %d bytes to the console\n", length);
+	if (length <= 0)
+		return;
+	if (synchConsole != NULL)
+		synchConsole->Write(buffer, length);
+	else
+		printf("%s", buffer);
+}
+
+static void
+SysClose(int arg1, int arg2, int arg3)
+{
+	if (!currentThread->space->CloseFile(arg1))
+		DEBUG('c', "Close of OpenFileId %d, which is not open\n", arg1);
+}
+
+static int
+startAio(int blockAddr, bool writing)	// Start the transfer described by the user's AioBlock at "blockAddr"; returns its id, or -1.
+{
+	AddrSpace *space = currentThread->space;
+	int block[4], i, id;	// file, position, buffer, size
+	OpenFile *file;
+	AioRequest *request;
+
+	if (space->CopyIn(blockAddr, (char *) block, sizeof(block)) < 0)
+		return -1;
+	for (i = 0; i < 4; i++)
+		block[i] = WordToHost(block[i]);
+	file = space->GetFile(block[0]);
+	if (file == NULL || block[1] < 0 || block[3] < 0 || block[3] > MaxAioBytes)
+		return -1;
+	request = new AioRequest(file, block[1], block[3], writing);
+	request->userAddr = block[2];
+	if ((writing && space->CopyIn(block[2], request->Data(), block[3]) < 0)
+	    || (id = space->AddAio(request)) < 0) {
+		delete request;		// never started
+		return -1;
+	}
+	request->Start();
+	return id;
+}
+
+static void
+SysAioRead(int arg1, int arg2, int arg3)	// Start reading a file as the AioBlock at "arg1" says; returns the request id.
+{
+	machine->WriteRegister(2, startAio(arg1, FALSE));
+	DEBUG('c', "AioRead, called by thread %i.\n", currentThread->getID());
+}
+
+static void
+SysAioWrite(int arg1, int arg2, int arg3)	// Start writing a file as the AioBlock at "arg1" says; returns the request id.
+{
+	machine->WriteRegister(2, startAio(arg1, TRUE));
+	DEBUG('c', "AioWrite, called by thread %i.\n", currentThread->getID());
+}
+
+static void
+SysAioWait(int arg1, int arg2, int arg3)	// Wait for request "arg1" to finish; returns the bytes it transferred.
+{
+	AddrSpace *space = currentThread->space;
+	AioRequest *request = space->GetAio(arg1);
+	int result;
+
+	DEBUG('c', "AioWait(%d), called by thread %i.\n", arg1, currentThread->getID());
+	if (request == NULL) {
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	result = request->Wait();
+	if (!request->writing && result > 0
+	    && space->CopyOut(request->userAddr, request->Data(), result) < 0)
+		result = -1;
+	space->RemoveAio(arg1);
+	machine->WriteRegister(2, result);
+}
+
+static void
+SysAioPoll(int arg1, int arg2, int arg3)	// Has request "arg1" finished?  1 if so, 0 if not, -1 if there is no such request.
+{
+	AioRequest *request = currentThread->space->GetAio(arg1);
+
+	machine->WriteRegister(2, (request == NULL) ? -1 : request->IsDone());
+}
+
+static void
+SysFork(int arg1, int arg2, int arg3)	// Start a copy of this process running "func".
+{
+	Thread* forkThread = new Thread("forked thread");
+
+	DEBUG('c', "Fork, called by thread %i.\n", currentThread->getID());
+	// The child shares our pages copy-on-write
+	int id = processTable->Add(forkThread);
+	forkThread->space = new AddrSpace(currentThread->space, id);
+	forkThread->SaveUserState();	// Start from a copy of our registers.
+	machine->WriteRegister(2, id);	// Return the child's ID.
+	forkThread->Fork(forkedCreator, arg1);
+}
+
+static void
+SysYield(int arg1, int arg2, int arg3)	// Yield to a new process.
+{
+	DEBUG('c', "Yield, called by thread %i.\n", currentThread->getID());
+
+	currentThread->Yield();	// Scheduler::Run saves and restores our state, if anyone else runs.
+}
+
+static void
+SysSleep(int arg1, int arg2, int arg3)	// Sleep for "arg1" ticks.
+{
+	DEBUG('c', "Sleep(%d), called by thread %i.\n", arg1, currentThread->getID());
+	alarmClock->Pause(arg1);
+	machine->WriteRegister(2, 0);
+}
+
+static void
+SysRealTime(int arg1, int arg2, int arg3)	// Join the real-time class: period "arg1", deadline "arg2", cost "arg3".
+{
+	IntStatus oldLevel = interrupt->SetLevel(IntOff);
+	bool admitted = scheduler->SetRealTime(currentThread, arg1, arg2, arg3);
+
+	(void) interrupt->SetLevel(oldLevel);
+	DEBUG('c', "RealTime(%d, %d, %d), called by thread %i: %s.\n", arg1, arg2, arg3, currentThread->getID(), admitted ? "admitted" : "turned away");
+	machine->WriteRegister(2, admitted ? 0 : -1);
+}
+
+static void
+SysSbrk(int arg1, int arg2, int arg3)	// Grow the heap by "arg1" bytes.
+{
+	int oldEnd = currentThread->space->Sbrk(arg1);
+
+	DEBUG('c', "Sbrk %d bytes at 0x%x, called by thread %i.\n", arg1, oldEnd, currentThread->getID());
+	machine->WriteRegister(2, oldEnd);
+}
+
+static void
+SysMmap(int arg1, int arg2, int arg3)	// Map "arg2" bytes of the file named at "arg1".
+{
+	char name[100];
+	int addr = -1;
+
+	if (currentThread->space->CopyInString(arg1, name, 100) >= 0)
+		addr = currentThread->space->Mmap(name, arg2);
+	DEBUG('c', "Mmap %d bytes at 0x%x, called by thread %i.\n", arg2, addr, currentThread->getID());
+	machine->WriteRegister(2, addr);
+}
+
+static void
+SysMunmap(int arg1, int arg2, int arg3)
+{
+	machine->WriteRegister(2, currentThread->space->Munmap(arg1) ? 0 : -1);
+}
+
+static void
+SysShmAttach(int arg1, int arg2, int arg3)	// Map shared segment "arg1", of "arg2" bytes.
+{
+	int addr = currentThread->space->ShmAttach(arg1, arg2);
+
+	DEBUG('c', "ShmAttach %d (%d bytes) at 0x%x, called by thread %i.\n", arg1, arg2, addr, currentThread->getID());
+	machine->WriteRegister(2, addr);
+}
+
+static void
+SysPipe(int arg1, int arg2, int arg3)	// Make a pipe, and put its read and write ends at "arg1".
+{
+	AddrSpace *space = currentThread->space;
+	PipeBuffer *pipe = new PipeBuffer;
+	int readEnd, writeEnd, ends[2];
+
+	readEnd = space->AddPipe(pipe, FALSE);
+	writeEnd = (readEnd == -1) ? -1 : space->AddPipe(pipe, TRUE);
+	if (writeEnd == -1) {	// too many open files
+		if (readEnd != -1)
+			space->CloseFile(readEnd);	// leaves the write end
+		delete pipe;
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	DEBUG('c', "Pipe %d -> %d, called by thread %i.\n", writeEnd, readEnd, currentThread->getID());
+	ends[0] = WordToMachine(readEnd);
+	ends[1] = WordToMachine(writeEnd);
+	if (space->CopyOut(arg1, (char *) ends, sizeof(ends)) < 0) {
+		space->CloseFile(readEnd);
+		space->CloseFile(writeEnd);	// the last end; deletes the pipe
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	machine->WriteRegister(2, 0);
+}
+
+static void
+SysWait(int arg1, int arg2, int arg3)	// Sleep on the word at "arg1", if it holds "arg2".
+{
+	machine->WriteRegister(2, currentThread->space->FutexWait(arg1, arg2));
+}
+
+static void
+SysWake(int arg1, int arg2, int arg3)	// Wake up to "arg2" sleepers on the word at "arg1".
+{
+	machine->WriteRegister(2, currentThread->space->FutexWake(arg1, arg2));
+}
+
+#ifdef NETWORK
+static void
+netSend(int toAddr, int replyBox, int bufAddr, int size, bool wait)	// Send for user programs: "toAddr" points to a MailAddress.
+{
+	PacketHeader pktHdr;
+	MailHeader mailHdr;
+	int to[2];
+	char data[MaxMailSize];
+	int numBoxes = postOffice->NumBoxes();
+
+	if (size < 0 || size > (int) MaxMailSize || replyBox < 0 || replyBox >= numBoxes ||
+	    currentThread->space->CopyIn(toAddr, (char *) to, sizeof(to)) < 0 ||
+	    currentThread->space->CopyIn(bufAddr, data, size) < 0) {
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	pktHdr.to = WordToHost(to[0]);
+	mailHdr.to = WordToHost(to[1]);
+	mailHdr.from = replyBox;
+	mailHdr.length = size;
+	if (pktHdr.to < 0 || mailHdr.to < 0 || mailHdr.to >= numBoxes) {
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	DEBUG('c', "Send %d bytes to (%d, %d), called by thread %i.\n", size, pktHdr.to, mailHdr.to, currentThread->getID());
+	machine->WriteRegister(2, postOffice->Send(pktHdr, mailHdr, data, wait) ? 0 : -1);
+}
+
+static void
+netReceive(int box, int fromAddr, int bufAddr, int size, bool wait)	// Receive for user programs: the sender goes in the MailAddress at "fromAddr".
+{
+	PacketHeader pktHdr;
+	MailHeader mailHdr;
+	int from[2];
+	char data[MaxMailSize];
+	int num;
+
+	if (box < 0 || box >= postOffice->NumBoxes() || size < 0 ||
+	    !postOffice->Receive(box, &pktHdr, &mailHdr, data, wait)) {
+		machine->WriteRegister(2, -1);
+		return;
+	}
+	num = min(size, (int) mailHdr.length);	// the rest is lost
+	from[0] = WordToMachine(pktHdr.from);
+	from[1] = WordToMachine(mailHdr.from);
+	if ((fromAddr != 0 && currentThread->space->CopyOut(fromAddr, (char *) from, sizeof(from)) < 0) ||
+	    currentThread->space->CopyOut(bufAddr, data, num) < 0)
+		num = -1;
+	DEBUG('c', "Received %d bytes in mailbox %d, called by thread %i.\n", num, box, currentThread->getID());
+	machine->WriteRegister(2, num);
+}
+
+// The network calls have a fourth argument, in r7.
+static void
+SysSend(int arg1, int arg2, int arg3)
+{
+	netSend(arg1, arg2, arg3, machine->ReadRegister(7), TRUE);
+}
+
+static void
+SysReceive(int arg1, int arg2, int arg3)
+{
+	netReceive(arg1, arg2, arg3, machine->ReadRegister(7), TRUE);
+}
+
+static void
+SysSendNB(int arg1, int arg2, int arg3)
+{
+	netSend(arg1, arg2, arg3, machine->ReadRegister(7), FALSE);
+}
+
+static void
+SysReceiveNB(int arg1, int arg2, int arg3)
+{
+	netReceive(arg1, arg2, arg3, machine->ReadRegister(7), FALSE);
+}
+#else
+static void
+SysNoNetwork(int arg1, int arg2, int arg3)	// Send and Receive, without a network.
+{
+	DEBUG('c', "Network call, called by thread %i, but there is no network.\n", currentThread->getID());
+	machine->WriteRegister(2, -1);
+}
+#endif
+
+// Indexed by the SC_ codes in syscall.h.
+static SyscallHandler syscallTable[] = {
+	SysHalt,	// SC_Halt
+	SysExit,	// SC_Exit
+	SysExec,	// SC_Exec
+	SysJoin,	// SC_Join
+	SysCreate,	// SC_Create
+	SysOpen,	// SC_Open
+	SysRead,	// SC_Read
+	SysWrite,	// SC_Write
+	SysClose,	// SC_Close
+	SysFork,	// SC_Fork
+	SysYield,	// SC_Yield
+	SysExecTickets,	// SC_ExecTickets
+#ifdef NETWORK
+	SysSend,	// SC_Send
+	SysReceive,	// SC_Receive
+	SysSendNB,	// SC_SendNB
+	SysReceiveNB,	// SC_ReceiveNB
+#else
+	SysNoNetwork,	// SC_Send
+	SysNoNetwork,	// SC_Receive
+	SysNoNetwork,	// SC_SendNB
+	SysNoNetwork,	// SC_ReceiveNB
+#endif
+	SysSbrk,	// SC_Sbrk
+	SysMmap,	// SC_Mmap
+	SysMunmap,	// SC_Munmap
+	SysShmAttach,	// SC_ShmAttach
+	SysWait,	// SC_Wait
+	SysWake,	// SC_Wake
+	SysPipe,	// SC_Pipe
+	SysExecPiped,	// SC_ExecPiped
+	SysSleep,	// SC_Sleep
+	SysExecV,	// SC_ExecV
+	SysSpawnMany,	// SC_SpawnMany
+	SysAioRead,	// SC_AioRead
+	SysAioWrite,	// SC_AioWrite
+	SysAioWait,	// SC_AioWait
+	SysAioPoll,	// SC_AioPoll
+	SysRealTime,	// SC_RealTime
+};
+
+#define NumSyscalls	((int) (sizeof(syscallTable) / sizeof(SyscallHandler)))
+
+// How often each system call was made, for Statistics::Export, which
+// knows them as "syscall.Halt" and so on.  Registered at the first one.
+static char *syscallNames[] = {
+	"syscall.Halt", "syscall.Exit", "syscall.Exec", "syscall.Join",
+	"syscall.Create", "syscall.Open", "syscall.Read", "syscall.Write",
+	"syscall.Close", "syscall.Fork", "syscall.Yield", "syscall.ExecTickets",
+	"syscall.Send", "syscall.Receive", "syscall.SendNB", "syscall.ReceiveNB",
+	"syscall.Sbrk", "syscall.Mmap", "syscall.Munmap",
+	"syscall.ShmAttach", "syscall.Wait", "syscall.Wake",
+	"syscall.Pipe", "syscall.ExecPiped", "syscall.Sleep",
+	"syscall.ExecV", "syscall.SpawnMany",
+	"syscall.AioRead", "syscall.AioWrite", "syscall.AioWait", "syscall.AioPoll",
+	"syscall.RealTime",
+};
+static long long syscallCounts[NumSyscalls];
+static bool syscallsRegistered = FALSE;
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -60,41 +784,6 @@ Thread * getID(int toGet);
 //	are in machine.h.
 //----------------------------------------------------------------------
 
-Thread* getID(int toGet)	// Goes through the list of active threads and returns one linked with the passed-in ID.
-{
-	Thread * tempThread = NULL;
-	Thread * toReturn = NULL;
-	bool found = false;
-	int size = activeThreads->getSize();
-	for(int i = 0; i < size; i++)
-	{
-		tempThread = (Thread*)activeThreads->Remove();	// Pop the top thread off.
-		if (tempThread->getID() == toGet)	// If it's what we're looking for...
-		{
-			toReturn = tempThread;
-			found = true;	// Trip the flag variable, and store the pointer of the thread.
-		}
-		activeThreads->Append(tempThread);	// Put it back onto the active list.
-	}
-	if (!found)
-		return NULL;
-	else return toReturn;
-}
-	
-void processCreator(int arg)	// Used when a process first actually runs, not when it is created.
- {
-	currentThread->space->InitRegisters();		// set the initial register values
-    currentThread->space->RestoreState();		// load page table register
-	
-	if (threadToBeDestroyed != NULL){
-		delete threadToBeDestroyed;
-		threadToBeDestroyed = NULL;
-	}
-
-    machine->Run();			// jump to the user progam
-    ASSERT(FALSE);			// machine->Run never returns;
- }
-
 void
 ExceptionHandler(ExceptionType which)
 {
@@ -104,9 +793,6 @@ ExceptionHandler(ExceptionType which)
 	int arg2 = machine->ReadRegister(5);
 	int arg3 = machine->ReadRegister(6);
 	int badVirtualAddress = machine->ReadRegister(39);
-	int Result;
-	int i, j;
-	char *ch = new char [500];
 
 	switch ( which )
 	{
@@ -120,177 +806,32 @@ ExceptionHandler(ExceptionType which)
 		machine->registers[PCReg] = machine->registers[NextPCReg];
 		machine->registers[NextPCReg] = machine->registers[NextPCReg] + 4;
 
-		switch ( type )
-		{
-
-		case SC_Halt :
-			printf("SYSTEM CALL: Halt, called by thread %i.\n",currentThread->getID());
-			DEBUG('t', "Shutdown, initiated by user program.\n");
-			interrupt->Halt();
-			break;
-
-			
-		case SC_Read :
-			if (arg2 <= 0 || arg3 < 0){
-				printf("\nRead 0 byte.\n");
-			}
-			Result = SRead(arg1, arg2, arg3);
-			machine->WriteRegister(2, Result);
-			DEBUG('t',"Read %d bytes from the open file(OpenFileId is %d)",
-			arg2, arg3);
-			break;
-
-		case SC_Write :
-			for (j = 0; ; j++) {
-				if(!machine->ReadMem((arg1+j), 1, &i))
-					j=j-1;
-				else{
-					ch[j] = (char) i;
-					if (ch[j] == '\0') 
-						break;
-				}
-			}
-			if (j == 0){
-				printf("\nWrite 0 byte.\n");
-				// SExit(1);
-			} else {
-				DEBUG('t', "\nWrite %d bytes from %s to the open file(OpenFileId is %d).", arg2, ch, arg3);
-				SWrite(ch, j, arg3);
-			}
-			break;
-		case SC_Exec :	// Executes a user process inside another user process.
-		   {
-				printf("SYSTEM CALL: Exec, called by thread %i.\n",currentThread->getID());
-
-				// Retrieve the address of the filename
-				int fileAddress = arg1; // retrieve argument stored in register r4
-
-				// Read file name into the kernel space
-				char *filename = new char[100];
-				
-				for(int m = 0; m < 100; m++)
-					filename[m] = NULL;
-
-				// Free up allocation space and get the file name
-				if(!machine->ReadMem(fileAddress,1,&j))return;
-				i = 0;
-
-				while(j != 0)
-				{
-					filename[i]=(char)j;
-					fileAddress += 1;
-					i++;
-					if(!machine->ReadMem(fileAddress,1,&j))return;
-				}
-				// Open File
-				OpenFile *executable = fileSystem->Open(filename);
-				
-				if (executable == NULL) 
-				{
-					printf("Unable to open file %s\n", filename);
-					delete filename;
-					break;
-				}
-				delete filename;
-
-				// Calculate needed memory space
-				AddrSpace *space;
-				space = new AddrSpace(executable);
-
-				
-
-				if(!currentThread->killNewChild)	// If so...
-				{
-					Thread* execThread = new Thread("thrad!");	// Make a new thread for the process.
-					execThread->space = space;	// Set the address space to the new space.
-					execThread->setID(threadID);	// Set the unique thread ID
-					space->GenerateSWAP(executable, threadID);
-					activeThreads->Append(execThread);	// Put it on the active list.
-					machine->WriteRegister(2, threadID);	// Return the thread ID as our Exec return variable.
-					threadID++;	// Increment the total number of threads.
-					execThread->Fork(processCreator, 0);	// Fork it.
-				}
-				else	// If not...
-				{
-					machine->WriteRegister(2, -1 * (threadID + 1));	// Return an error code
-					currentThread->killNewChild = false;	// Reset our variable
-				}
-				delete executable;
-				break;	// Get out.
-			}
-			case SC_Join :	// Join one process to another.
-			{
-				printf("SYSTEM CALL: Joined, called by thread %i.\n",currentThread->getID());
-				if(arg1 < 0)	// If the thread was not properly created...
-				{
-					printf("ERROR: Trying to join process %i to process %i, which was not created successfully! Process %i continuing normally.\n", currentThread->getID(), -arg1, currentThread->getID());	// Return an error message, continue as normal.
-					break;
-				}
-				
-				if(getID(arg1) != NULL)	// If the thread exists...
-				{
-					if(!currentThread->isJoined)	// And it's not already joined...
-					{
-						printf("Joining process %i with process %i.  Thread %i now shutting down.\n", getID(arg1)->getID(), currentThread->getID(), currentThread->getID());	// Inform the user.
-						getID(arg1)->setParent(currentThread);	// Set the process' parent to the current thread.
-						currentThread->isJoined = true;	// Let the parent know it has a child
-						(void) interrupt->SetLevel(IntOff);	// Disable interrupts for Sleep();
-						currentThread->Sleep();	// Put the current thread to sleep.
-						break;
-					}
-					else{	// We've got an error message.
-						printf("ERROR: Trying to join process %i, which is already joined! Continuing normally.", currentThread->getID());
-						break;
-						}
-				}
-				else printf("ERROR: Trying to a join process %i to nonexistant process %i! Process %i continuing normally.\n", currentThread->getID(), -arg1, currentThread->getID());	// Error message if the thread we're trying to join to doesn't exist for some reason.
-				break;
-			}
-			case SC_Exit :	// Exit a process.
-			{
-				printf("SYSTEM CALL: Exit, called by thread %i.\n",currentThread->getID());
-				if(arg1 == 0)	// Did we exit properly?  If not, show an error message.
-					printf("Process %i exited normally!\n", currentThread->getID());
-				else
-					printf("ERROR: Process %i exited abnormally!\n", currentThread->getID());
-				
-				
-	
-				if(currentThread->space){
-					// Delete the used memory from the process.
-					currentThread->space->KillSWAP(currentThread->getID());
-					delete currentThread->space;
-				}
-				currentThread->Finish();	// Delete the thread.
-
-				break;
-			}
-           case SC_Yield :	// Yield to a new process.
-		   {
-			   printf("SYSTEM CALL: Yield, called by thread %i.\n",currentThread->getID());
-
-			   //Save the registers and yield CPU control.
-			   currentThread->space->SaveState();
-			   currentThread->Yield();
-			   //When the thread comes back, restore its registers.
-			   currentThread->space->RestoreState();
-
-               break;
-			}
-           default :
-	       //Unprogrammed system calls end up here
-			   printf("SYSTEM CALL: Unknown, called by thread %i.\n",currentThread->getID());
-               break;
-           }         // Advance program counters, ends syscall switch
-           break;
+		if (!syscallsRegistered) {
+			for (int i = 0; i < NumSyscalls; i++)
+				stats->Register(syscallNames[i], &syscallCounts[i]);
+			syscallsRegistered = TRUE;
+		}
+		if (type >= 0 && type < NumSyscalls) {
+			syscallCounts[type]++;
+			TRACE(TraceSyscall, type, 0);
+			(*syscallTable[type])(arg1, arg2, arg3);
+			TRACE(TraceSysret, type, machine->ReadRegister(2));
+		} else	//Unprogrammed system calls end up here
+			printf("SYSTEM CALL: Unknown (%d), called by thread %i.\n", type, currentThread->getID());
+		break;
 
 	case ReadOnlyException :
+		// Writes to pages shared with a Fork parent or child get a 
+		// private copy, and the instruction is retried.
+		if (currentThread->space && 
+		    currentThread->space->CopyOnWrite(badVirtualAddress))
+			break;
 		printf("ERROR: ReadOnlyException, called by thread %i.\n",currentThread->getID());
 		if (currentThread->getName() == "main")
 			ASSERT(FALSE);  //Not the way of handling an exception.
 		if(currentThread->space){
-			currentThread->space->KillSWAP(currentThread->getID());
-			delete currentThread->space;
+			currentThread->space->Exit();
+			currentThread->space = NULL;
 		}
 		currentThread->Finish();	// Delete the thread.
 		break;
@@ -299,8 +840,8 @@ ExceptionHandler(ExceptionType which)
 		if (currentThread->getName() == "main")
 			ASSERT(FALSE);  //Not the way of handling an exception.
 		if(currentThread->space){
-			currentThread->space->KillSWAP(currentThread->getID());
-			delete currentThread->space;
+			currentThread->space->Exit();
+			currentThread->space = NULL;
 		}
 		currentThread->Finish();	// Delete the thread.
 		break;
@@ -309,8 +850,8 @@ ExceptionHandler(ExceptionType which)
 		if (currentThread->getName() == "main")
 			ASSERT(FALSE);  //Not the way of handling an exception.
 		if(currentThread->space){
-			currentThread->space->KillSWAP(currentThread->getID());
-			delete currentThread->space;
+			currentThread->space->Exit();
+			currentThread->space = NULL;
 		}
 		currentThread->Finish();	// Delete the thread.
 		break;
@@ -319,8 +860,8 @@ ExceptionHandler(ExceptionType which)
 		if (currentThread->getName() == "main")
 			ASSERT(FALSE);  //Not the way of handling an exception.
 		if(currentThread->space){
-			currentThread->space->KillSWAP(currentThread->getID());
-			delete currentThread->space;
+			currentThread->space->Exit();
+			currentThread->space = NULL;
 		}
 		currentThread->Finish();	// Delete the thread.
 		break;
@@ -329,8 +870,8 @@ ExceptionHandler(ExceptionType which)
 		if (currentThread->getName() == "main")
 			ASSERT(FALSE);  //Not the way of handling an exception.
 		if(currentThread->space){
-			currentThread->space->KillSWAP(currentThread->getID());
-			delete currentThread->space;
+			currentThread->space->Exit();
+			currentThread->space = NULL;
 		}
 		currentThread->Finish();	// Delete the thread.
 		break;
@@ -339,30 +880,43 @@ ExceptionHandler(ExceptionType which)
 		if (currentThread->getName() == "main")
 			ASSERT(FALSE);  //Not the way of handling an exception.
 		if(currentThread->space){
-			currentThread->space->KillSWAP(currentThread->getID());
-			delete currentThread->space;
+			currentThread->space->Exit();
+			currentThread->space = NULL;
 		}
 		currentThread->Finish();	// Delete the thread.
 		break;
 	case PageFaultException :
 		//printf("\nERROR: PageFaultException, called by thread %i.", currentThread->getID());
+#ifdef USE_TLB
+	{
+		// With a TLB, most of these are just TLB misses: if the page 
+		// is already in memory, reload the TLB and retry.
+		TranslationEntry *entry = currentThread->space->PageEntry(badVirtualAddress);
+
+		if (entry == NULL) {
+			printf("ERROR: AddressErrorException, called by thread %i.\n",currentThread->getID());
+			currentThread->space->Exit();
+			currentThread->space = NULL;
+			currentThread->Finish();	// Delete the thread.
+			break;
+		}
+		if (entry->valid) {
+			currentThread->space->LoadTLB(badVirtualAddress / PageSize);
+			break;
+		}
+	}
+#endif
 
 		if(currentThread->space->PageFaultLoadPage(badVirtualAddress, currentThread->getID())) {
 			printf("\nHalt, called by thread %i.\n",currentThread->getID());
 			
-			int size = activeThreads->getSize();
-			for(int i = 0; i < size; i++) {
-				Thread* deadThread = (Thread*)activeThreads->Remove();
-
-				if(deadThread->space) {
-					deadThread->space->KillSWAP(deadThread->getID());
-					//delete deadThread->space;
-				}
-				activeThreads->Append(deadThread);
-				//deadThread->Finish();
- 			}
+			processTable->Apply(killSwap);	// free every swap slot
+			processTable->Apply(recordTimes);
 			interrupt->Halt();
 		}
+#ifdef USE_TLB
+		currentThread->space->LoadTLB(badVirtualAddress / PageSize);
+#endif
 
 		break;
 		default :
@@ -372,60 +926,131 @@ ExceptionHandler(ExceptionType which)
 		//      SExit(1);
 		break;
 	}
-	delete [] ch;
 }
 
 
 static int SRead(int addr, int size, int id)  //input 0  output 1
 {
-	char buffer[size+10];
-	int num,Result;
+	int num;
+
+	PipeBuffer *pipe = currentThread->space->GetPipe(id, FALSE);
 
-	//read from keyboard, try writing your own code using console class.
-	if (id == 0)
+	//read what is in a pipe (ConsoleInput too, if it was piped),
+	//a page-sized chunk at a time, stopping when it runs dry
+	if (pipe != NULL)
 	{
-		scanf("%s",buffer);
+		char *chunk;
+		int count;
 
-		num=strlen(buffer);
-		if(num>(size+1)) {
+		if (size < 0)
+			return -1;
+		chunk = getChunk();
+		for (num = 0; num < size; num += count) {
+			int want = min(PageSize, size - num);
 
-			buffer[size+1] = '\0';
-			Result = size+1;
-		}
-		else {
-			buffer[num+1]='\0';
-			Result = num + 1;
+			count = pipe->Read(chunk, want);
+			if (count <= 0)
+				break;		// end of file
+			if (currentThread->space->CopyOut(addr + num, chunk, count) < 0) {
+				num = -1;
+				break;
+			}
+			if (count < want) {	// don't wait for more
+				num += count;
+				break;
+			}
 		}
-
-		for (num=0; num<Result; num++)
-		{  machine->WriteMem((addr+num), 1, (int) buffer[num]);
-			if (buffer[num] == '\0')
-			break; }
+		chunkCache->Free(chunk);
 		return num;
+	}
+	//read a line from the keyboard; only this thread waits for it
+	else if (id == 0)
+	{
+		char *line;
 
+		if (size <= 0)
+			return 0;
+		if (synchConsole == NULL) {
+			fflush(stdout);		// keep earlier output first
+			synchConsole = new SynchConsole(NULL, NULL);
+		}
+		line = new char[min(size, ConsoleBufferSize)];
+		num = synchConsole->Read(line, min(size, ConsoleBufferSize));
+		if (currentThread->space->CopyOut(addr, line, num) < 0)
+			num = -1;
+		delete [] line;
+		return num;
 	}
-	//read from a unix file, later you need change to nachos file system.
+	//read from a Nachos file, a page-sized chunk at a time
 	else
 	{
-		for(num=0;num<size;num++){
-			Read(id,&buffer[num],1);
-			machine->WriteMem((addr+num), 1, (int) buffer[num]);
-			if(buffer[num]=='\0') break;
+		OpenFile *file = currentThread->space->GetFile(id);
+		char *chunk;
+		int count;
+
+		if (file == NULL)
+			return -1;
+		chunk = getChunk();
+		for (num = 0; num < size; num += count) {
+			count = file->Read(chunk, min(PageSize, size - num));
+			if (count <= 0)
+				break;		// end of file
+			if (currentThread->space->CopyOut(addr + num, chunk, count) < 0) {
+				num = -1;
+				break;
+			}
 		}
+		chunkCache->Free(chunk);
 		return num;
 	}
 }
 
 
 
-static void SWrite(char *buffer, int size, int id)
+static int SWrite(int addr, int size, int id)
 {
-	//write to terminal, try writting your own code using console class.
-	if (id == 1)
-	printf("%s", buffer);
-	//write to a unix file, later you need change to nachos file system.
-	if (id >= 2)
-	WriteFile(id,buffer,size);
+	//write "size" bytes to a Nachos file or a pipe, a page-sized chunk at a time
+	OpenFile *file = currentThread->space->GetFile(id);
+	PipeBuffer *pipe = currentThread->space->GetPipe(id, TRUE);
+	char *chunk;
+	int num, count;
+
+	if ((file == NULL && pipe == NULL) || size < 0)
+		return -1;
+	chunk = getChunk();
+	for (num = 0; num < size; num += count) {
+		count = min(PageSize, size - num);
+		if (currentThread->space->CopyIn(addr + num, chunk, count) < 0) {
+			num = -1;
+			break;
+		}
+		if (pipe != NULL) {
+			int want = count;
+
+			if ((count = pipe->Write(chunk, want)) < want) {
+				if (count > 0)
+					num += count;
+				else if (num == 0)
+					num = -1;	// nobody can read it
+				break;
+			}
+		} else if ((count = file->Write(chunk, count)) <= 0)
+			break;		// the file can't grow any more
+	}
+	chunkCache->Free(chunk);
+	return num;
+}
+
+static OpenFile *SOpen(int nameAddr, bool create)
+{
+	//open (or first create) the Nachos file named at "nameAddr"
+	char name[100];
+
+	if (currentThread->space->CopyInString(nameAddr, name, 100) < 0)
+		return NULL;
+	if (create && !fileSystem->Create(name, 0))
+		return NULL;
+	return fileSystem->Open(name);
 }
 // end FA98
 
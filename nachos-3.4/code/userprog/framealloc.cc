@@ -0,0 +1,312 @@
+// framealloc.cc
+//	Routines to hand out physical page frames.  See framealloc.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "framealloc.h"
+
+//----------------------------------------------------------------------
+// FrameAllocator::FrameAllocator
+// 	Initialize the allocator, with every frame free.  An unknown
+//	policy number means first fit.
+//
+//	"choice" -- the memChoice number (see framealloc.h)
+//	"frames" -- how many frames there are
+//----------------------------------------------------------------------
+
+FrameAllocator::FrameAllocator(int choice, int frames)
+{
+    int i;
+
+    if (choice < FitFirst || choice > FitBuddy)
+	choice = FitFirst;
+    policy = (FitPolicy) choice;
+    numFrames = frames;
+    map = new BitMap(frames);
+    next = prev = NULL;
+    order = NULL;
+    if (policy == FitBuddy) {
+	for (i = 0; i <= MaxBuddyOrder; i++)
+	    freeList[i] = -1;
+	next = new int[frames];
+	prev = new int[frames];
+	order = new char[frames];
+	for (i = 0; i < frames; i++)
+	    order[i] = -1;
+	Carve(0, frames);
+    }
+
+    numAllocs = numFrees = numFailures = numFragFailures = 0;
+    numHoles = 1;
+    largestHole = frames;
+    stats->Register("frames.allocs", &numAllocs);
+    stats->Register("frames.frees", &numFrees);
+    stats->Register("frames.failures", &numFailures);
+    stats->Register("frames.fragFailures", &numFragFailures);
+    stats->Register("frames.holes", &numHoles);
+    stats->Register("frames.largestHole", &largestHole);
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    delete map;
+    delete [] next;
+    delete [] prev;
+    delete [] order;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::Allocate
+// 	Take "count" consecutive free frames, chosen by the policy.  With
+//	"align", the first one's number must be a multiple of it (for a
+//	superpage, say).
+//
+// Returns:
+//	the first of them, or -1 if there is no free run that long
+//----------------------------------------------------------------------
+
+int
+FrameAllocator::Allocate(int count, int align)
+{
+    int first = -1;
+
+    ASSERT(count > 0 && align > 0 && (align & (align - 1)) == 0);
+    if (count <= map->NumClear()) {
+	if (policy == FitBuddy)
+	    first = BuddyAllocate(count, align);
+	else
+	    first = FitRun(count, align);
+    }
+    if (first == -1) {
+	numFailures++;
+	if (count <= map->NumClear())
+	    numFragFailures++;
+	return -1;
+    }
+    map->MarkRun(first, count);
+    numAllocs++;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::Free
+// 	Give back "count" frames in a row, starting at "first".  They
+//	must all be in use, but needn't be a whole run from Allocate.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::Free(int first, int count)
+{
+    ASSERT(first >= 0 && count > 0 && first + count <= numFrames);
+    for (int i = first; i < first + count; i++) {
+	ASSERT(map->Test(i));
+	map->Clear(i);
+    }
+    if (policy == FitBuddy)
+	Carve(first, count);
+    numFrees++;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::FitRun
+// 	Find a run of "count" free frames for first, best or worst fit,
+//	starting at a multiple of "align".  The run is judged by the
+//	length of the free run it is taken from.  Frames are marked by
+//	the caller.
+//----------------------------------------------------------------------
+
+int
+FrameAllocator::FitRun(int count, int align)
+{
+    int start, length, first, best = -1, bestLength = 0;
+
+    if (policy == FitFirst && align == 1)
+	return map->FindRun(0, count);
+    for (start = map->NextClear(0); start != -1;
+				start = map->NextClear(start + length)) {
+	length = map->ClearRun(start, numFrames);
+	first = (start + align - 1) & ~(align - 1);
+	if (first + count > start + length)
+	    continue;
+	if (policy == FitFirst)
+	    return first;
+	if (best == -1 || ((policy == FitBest) ? (length < bestLength)
+					      : (length > bestLength))) {
+	    best = first;
+	    bestLength = length;
+	}
+	if (policy == FitBest && length == count)
+	    break;			// can't do better than that
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::BuddyAllocate
+// 	Take the smallest free block of at least "count" frames (and at
+//	least "align", so that it starts at a multiple of "align"),
+//	splitting a bigger one if there is none that size.  The block's first
+//	"count" frames are returned; the rest go back on the free lists
+//	at once, so nothing is lost to rounding up.  Frames are marked by
+//	the caller.
+//----------------------------------------------------------------------
+
+int
+FrameAllocator::BuddyAllocate(int count, int align)
+{
+    int want = 0, k, block;
+
+    while ((1 << want) < max(count, align))
+	want++;
+    for (k = want; k <= MaxBuddyOrder && freeList[k] == -1; k++)
+	;
+    if (k > MaxBuddyOrder)
+	return -1;
+    block = freeList[k];
+    RemoveBlock(block);
+    while (k > want) {			// split off the upper halves
+	k--;
+	PushBlock(block + (1 << k), k);
+    }
+    if (count < (1 << want))		// give back the unused tail
+	Carve(block + count, (1 << want) - count);
+    return block;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::Carve
+// 	Put a run of free frames back on the buddy free lists, as the
+//	fewest blocks that each start at a multiple of their size.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::Carve(int first, int count)
+{
+    while (count > 0) {
+	int k = 0;
+
+	while (k < MaxBuddyOrder && (first & ((2 << k) - 1)) == 0
+				&& (2 << k) <= count)
+	    k++;
+	BuddyFree(first, k);
+	first += 1 << k;
+	count -= 1 << k;
+    }
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::BuddyFree
+// 	Free the block of 2^k frames at "first", merging it with its buddy
+//	as long as the buddy is a free block of the same size.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::BuddyFree(int first, int k)
+{
+    while (k < MaxBuddyOrder) {
+	int buddy = first ^ (1 << k);
+
+	if (buddy >= numFrames || order[buddy] != k)
+	    break;
+	RemoveBlock(buddy);
+	first = min(first, buddy);
+	k++;
+    }
+    PushBlock(first, k);
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::PushBlock, FrameAllocator::RemoveBlock
+// 	Put a free block of 2^k frames on the front of its free list, or
+//	take one off its list.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::PushBlock(int first, int k)
+{
+    order[first] = k;
+    prev[first] = -1;
+    next[first] = freeList[k];
+    if (freeList[k] != -1)
+	prev[freeList[k]] = first;
+    freeList[k] = first;
+}
+
+void
+FrameAllocator::RemoveBlock(int first)
+{
+    int k = order[first];
+
+    ASSERT(k >= 0);
+    if (prev[first] != -1)
+	next[prev[first]] = next[first];
+    else
+	freeList[k] = next[first];
+    if (next[first] != -1)
+	prev[next[first]] = prev[first];
+    order[first] = -1;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::PolicyName
+// 	Return the name of the allocation policy, for messages.
+//----------------------------------------------------------------------
+
+char *
+FrameAllocator::PolicyName()
+{
+    switch (policy) {
+      case FitBest:
+	return "Best-fit";
+      case FitWorst:
+	return "Worst-fit";
+      case FitBuddy:
+	return "Buddy";
+      default:
+	return "First-fit";
+    }
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::Measure
+// 	Count the runs of free frames, and find the longest.  Free memory
+//	is "externally" fragmented when the longest run is much shorter
+//	than the number of free frames.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::Measure()
+{
+    int start, length;
+
+    numHoles = 0;
+    largestHole = 0;
+    for (start = map->NextClear(0); start != -1;
+				start = map->NextClear(start + length)) {
+	length = map->ClearRun(start, numFrames);
+	numHoles++;
+	if (length > largestHole)
+	    largestHole = length;
+    }
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::Print
+// 	Print how fragmented free memory is, then which frames are free.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::Print()
+{
+    int free = map->NumClear();
+
+    Measure();
+    printf("Frames (%s): %d of %d free, in %lld runs, the longest %lld; "
+	   "%d%% fragmented\n", PolicyName(), free, numFrames, numHoles,
+	   largestHole, (free > 0) ? (int) (100 - 100 * largestHole / free) : 0);
+    map->Print();
+}
@@ -0,0 +1,90 @@
+// framealloc.h
+//	Data structures for handing out free physical page frames, one at
+//	a time or as runs of consecutive frames (for read-ahead straight
+//	into memory, and anything else that wants contiguous memory).
+//
+//	The policy is picked with "-M <memChoice>":
+//	    1 -- first fit: the lowest run that is big enough (the default)
+//	    2 -- best fit: the smallest free run that is big enough
+//	    3 -- worst fit: the biggest free run
+//	    4 -- buddy: free memory is kept as blocks of 2^k frames, each
+//		 starting at a multiple of its size, on one free list per
+//		 k.  A request takes the smallest block that is big enough,
+//		 splitting bigger ones in half as needed, and gives back
+//		 what it doesn't use; a freed block is merged with its
+//		 "buddy" (the other half of the block it was split from)
+//		 if that is free too.  Both are O(log n).
+//
+//	The fit policies search the bitmap of free frames, a word at a
+//	time.  The bitmap is kept for the buddy policy too, for the
+//	fragmentation statistics and for checking frees.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FRAMEALLOC_H
+#define FRAMEALLOC_H
+
+#include "copyright.h"
+#include "bitmap.h"
+
+// Allocation policies; the values are the "memChoice" numbers.
+enum FitPolicy { FitFirst = 1, FitBest, FitWorst, FitBuddy };
+
+#define MaxBuddyOrder	24		// biggest buddy block: 2^24 frames
+
+// The following class keeps track of which frames are free.
+
+class FrameAllocator {
+  public:
+    FrameAllocator(int choice, int frames);	// Initialize, all frames free
+    ~FrameAllocator();
+
+    int Allocate(int count = 1, int align = 1);
+				// Take "count" consecutive frames, the
+				// first a multiple of "align" (a power
+				// of two); returns the first, or -1 if
+				// there is no such free run
+    void Free(int first, int count = 1);
+				// Give back frames from Allocate (any of
+				// them, not necessarily a whole run)
+    bool IsFree(int frame) { return !map->Test(frame); }
+    int NumFree() { return map->NumClear(); }
+
+    char *PolicyName();		// For messages
+    void Measure();		// Bring the fragmentation statistics
+				// up to date
+    void Print();		// Print the free frames, and how
+				// fragmented they are
+
+    // Statistics, registered as "frames.*".
+    long long numAllocs;	// successful Allocate calls
+    long long numFrees;		// Free calls
+    long long numFailures;	// Allocate calls that found no run,
+    long long numFragFailures;	// ... though enough frames were free
+    long long numHoles;		// runs of free frames, as of Measure
+    long long largestHole;	// frames in the longest one
+
+  private:
+    int FitRun(int count, int align);	// Allocate for first/best/worst
+    int BuddyAllocate(int count, int align);	// fit, and for buddy
+    void BuddyFree(int first, int order);	// Free one aligned block,
+				// merging it with its buddy while possible
+    void Carve(int first, int count);	// Free a run as aligned blocks
+    void PushBlock(int first, int order);	// Put a block on its free
+    void RemoveBlock(int first);		// list, or take it off
+
+    FitPolicy policy;
+    int numFrames;
+    BitMap *map;		// frames in use
+
+    // buddy free lists, linked through per-frame arrays
+    int freeList[MaxBuddyOrder + 1];	// first free block of each order,
+					// -1 if none
+    int *next, *prev;		// links, indexed by a block's first frame
+    char *order;		// order of the free block starting at
+				// a frame, -1 if none starts there
+};
+
+#endif // FRAMEALLOC_H
@@ -0,0 +1,249 @@
+// framemgr.cc 
+//	Routines to choose a frame to replace when physical memory is 
+//	full.  See framemgr.h for the policies.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "framemgr.h"
+
+//----------------------------------------------------------------------
+// FrameReferenced
+// 	Called by the machine on every successful translation, if we 
+//	asked it to (LRU); moves the frame to the young end of the list.
+//----------------------------------------------------------------------
+
+static void
+FrameReferenced(int frame)
+{
+    frameReplacer->Referenced(frame);
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::FrameReplacer
+// 	Initialize the replacement policy.  All frames start out free.
+//
+//	"mode" -- the swapMode, one of ReplacePolicy
+//	"frames" -- the number of physical page frames
+//----------------------------------------------------------------------
+
+FrameReplacer::FrameReplacer(int mode, int frames)
+{
+    ASSERT((mode >= ReplaceNone) && (mode <= ReplaceEnhancedClock));
+    policy = (ReplacePolicy) mode;
+    numFrames = frames;
+    owner = new TranslationEntry *[numFrames];
+    prev = new int[numFrames];
+    next = new int[numFrames];
+    for (int i = 0; i < numFrames; i++) {
+	owner[i] = NULL;
+	prev[i] = next[i] = -1;
+    }
+    head = tail = -1;
+    hand = 0;
+
+    if (policy == ReplaceLRU)
+	machine->frameRefHook = FrameReferenced;
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::~FrameReplacer
+// 	De-allocate the replacement policy's data.
+//----------------------------------------------------------------------
+
+FrameReplacer::~FrameReplacer()
+{
+    if (machine->frameRefHook == FrameReferenced)
+	machine->frameRefHook = NULL;
+    delete [] owner;
+    delete [] prev;
+    delete [] next;
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::Unlink, Append
+// 	Maintain the list of resident frames, oldest first.
+//----------------------------------------------------------------------
+
+void
+FrameReplacer::Unlink(int frame)
+{
+    if (prev[frame] != -1)
+	next[prev[frame]] = next[frame];
+    else
+	head = next[frame];
+    if (next[frame] != -1)
+	prev[next[frame]] = prev[frame];
+    else
+	tail = prev[frame];
+    prev[frame] = next[frame] = -1;
+}
+
+void
+FrameReplacer::Append(int frame)
+{
+    prev[frame] = tail;
+    next[frame] = -1;
+    if (tail != -1)
+	next[tail] = frame;
+    else
+	head = frame;
+    tail = frame;
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::Loaded
+// 	Record that a page has just been brought into a frame.  It becomes
+//	the youngest page.
+//
+//	"frame" -- the frame that was filled
+//	"pte" -- the page table entry that now maps it
+//----------------------------------------------------------------------
+
+void
+FrameReplacer::Loaded(int frame, TranslationEntry *pte)
+{
+    if (owner[frame] != NULL)
+	Unlink(frame);
+    owner[frame] = pte;
+    Append(frame);
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::Retarget
+// 	A frame shared by several page tables changed hands: watch the
+//	new owner's page table entry from now on.
+//----------------------------------------------------------------------
+
+void
+FrameReplacer::Retarget(int frame, TranslationEntry *pte)
+{
+    ASSERT(owner[frame] != NULL);
+    owner[frame] = pte;
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::Freed
+// 	Record that a frame is no longer in use (its address space has
+//	gone away).
+//----------------------------------------------------------------------
+
+void
+FrameReplacer::Freed(int frame)
+{
+    if (owner[frame] == NULL)
+	return;
+    Unlink(frame);
+    owner[frame] = NULL;
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::Referenced
+// 	For LRU, move a frame to the young end of the list whenever the
+//	user program uses it.  This is called on every memory reference,
+//	so do nothing if it is already there.
+//----------------------------------------------------------------------
+
+void
+FrameReplacer::Referenced(int frame)
+{
+    if ((frame == tail) || (owner[frame] == NULL))
+	return;
+    Unlink(frame);
+    Append(frame);
+}
+
+//----------------------------------------------------------------------
+// FrameReplacer::Victim
+// 	Choose a resident frame to be replaced.  The caller is responsible
+//	for writing the old page out and calling Loaded for the new one.
+//
+//	"canTake" -- if not NULL, only frames for which canTake(frame, arg)
+//		is TRUE are considered (for local replacement)
+//	"arg" -- passed to canTake
+//
+// Returns:
+//	The frame number, or -1 if no frame can be replaced.
+//----------------------------------------------------------------------
+
+int
+FrameReplacer::Victim()
+{
+    return Victim(NULL, 0);
+}
+
+int
+FrameReplacer::Victim(FrameFilter canTake, int arg)
+{
+    TranslationEntry *pte;
+    int frame, i, pass;
+
+#define ELIGIBLE(f) \
+    (owner[f] != NULL && (canTake == NULL || (*canTake)(f, arg)))
+
+    switch (policy) {
+      case ReplaceFIFO:
+      case ReplaceLRU:
+	for (frame = head; frame != -1; frame = next[frame])
+	    if (ELIGIBLE(frame))
+		return frame;
+	return -1;
+
+      case ReplaceRandom:
+	if (head == -1)
+	    return -1;
+	for (i = 0; i < numFrames; i++) {
+	    frame = Random() % numFrames;
+	    if (ELIGIBLE(frame))
+		return frame;
+	}
+	for (i = 0; i < numFrames; i++)		// unlucky; look at them all
+	    if (ELIGIBLE((frame + i) % numFrames))
+		return (frame + i) % numFrames;
+	return -1;
+
+      case ReplaceClock:
+	for (i = 0; i < 2 * numFrames; i++) {	// at most two sweeps
+	    frame = hand;
+	    hand = (hand + 1) % numFrames;
+	    if (!ELIGIBLE(frame))
+		continue;
+	    pte = owner[frame];
+	    if (!pte->use)
+		return frame;
+	    pte->use = FALSE;			// second chance
+	}
+	return -1;
+
+      case ReplaceEnhancedClock:
+	// Even passes look for (not used, clean) without touching
+	// anything, odd passes for (not used, dirty), clearing use bits 
+	// as they go; four passes always find something.
+	for (pass = 0; pass < 4; pass++)
+	    for (i = 0; i < numFrames; i++) {
+		frame = hand;
+		hand = (hand + 1) % numFrames;
+		if (!ELIGIBLE(frame))
+		    continue;
+		pte = owner[frame];
+		if (pass % 2 == 0) {
+		    if (!pte->use && !pte->dirty)
+			return frame;
+		} else {
+		    if (!pte->use && pte->dirty)
+			return frame;
+		    pte->use = FALSE;
+		}
+	    }
+	return -1;
+
+      case ReplaceNone:
+      default:
+	printf("\nBorking NachOS by Process %d\n", currentThread->getID());
+	return -1;
+    }
+#undef ELIGIBLE
+}
@@ -0,0 +1,70 @@
+// framemgr.h 
+//	Data structures for choosing which physical page frame to take 
+//	away from its owner when memory is full.
+//
+//	The policy is picked with "-V <swapMode>":
+//	    0 -- no replacement; running out of frames halts Nachos
+//	    1 -- FIFO: evict the page that was loaded longest ago
+//	    2 -- random
+//	    3 -- LRU: evict the page referenced longest ago
+//	    4 -- clock (second chance), using the page table use bit
+//	    5 -- enhanced clock, using both the use and the dirty bits,
+//		 preferring pages that need no write-back
+//
+//	Every operation is O(1), except the clock sweeps, which stop at
+//	the first suitable frame.  FIFO and LRU keep the resident frames
+//	on a doubly-linked list threaded through per-frame arrays, so 
+//	nothing is allocated or scanned on a fault.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FRAMEMGR_H
+#define FRAMEMGR_H
+
+#include "copyright.h"
+#include "translate.h"
+
+// Page replacement policies; the values are the "swapMode" numbers.
+enum ReplacePolicy { ReplaceNone, ReplaceFIFO, ReplaceRandom, ReplaceLRU,
+		     ReplaceClock, ReplaceEnhancedClock };
+
+// Used to restrict the choice of victim to some of the frames.
+typedef bool (*FrameFilter)(int frame, int arg);
+
+// The following class keeps track of what is in each frame, in the
+// order the policy needs, and picks a victim on demand.
+
+class FrameReplacer {
+  public:
+    FrameReplacer(int mode, int frames);	// Initialize, all frames free
+    ~FrameReplacer();
+
+    void Loaded(int frame, TranslationEntry *pte);
+				// "frame" now holds the page mapped by "pte"
+    void Freed(int frame);	// "frame" no longer holds a page
+    void Retarget(int frame, TranslationEntry *pte);
+				// "pte" now maps "frame", which keeps
+				// its place in the replacement order
+    void Referenced(int frame);	// The user program touched "frame" (the
+				// machine calls this for LRU only)
+    int Victim();		// Return the frame to evict, or -1
+    int Victim(FrameFilter canTake, int arg);
+				// ... choosing only among frames for
+				// which canTake(frame, arg) is TRUE
+
+  private:
+    void Unlink(int frame);	// Take a frame off the FIFO/LRU list
+    void Append(int frame);	// Put a frame on the end of the list
+
+    ReplacePolicy policy;
+    int numFrames;
+    TranslationEntry **owner;	// the page table entry mapping each
+				// frame, NULL if the frame is free
+    int *prev, *next;		// FIFO/LRU list links, indexed by frame
+    int head, tail;		// oldest and newest frame, -1 if none
+    int hand;			// clock hand
+};
+
+#endif // FRAMEMGR_H
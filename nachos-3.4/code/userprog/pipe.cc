@@ -0,0 +1,133 @@
+// pipe.cc
+//	Routines for pipes between processes.  See pipe.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "pipe.h"
+
+PipeBuffer::PipeBuffer()
+{
+    head = count = 0;
+    readers = writers = 1;
+    lock = new Lock("pipe");
+    notEmpty = new Condition("pipe not empty");
+    notFull = new Condition("pipe not full");
+}
+
+PipeBuffer::~PipeBuffer()
+{
+    delete notFull;
+    delete notEmpty;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Read
+// 	Wait until the pipe has something in it, or can't get anything
+//	any more, and copy out what is there, up to "size" bytes.  The
+//	ring buffer wraps at most once, so it takes at most two copies.
+//
+// Returns:
+//	the number of bytes copied; 0 means end of file
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Read(char *into, int size)
+{
+    int n, first;
+
+    lock->Acquire();
+    while (count == 0 && writers > 0)
+	notEmpty->Wait(lock);
+    n = min(size, count);
+    first = min(n, PipeSize - head);
+    bcopy(&buffer[head], into, first);
+    bcopy(buffer, &into[first], n - first);
+    head = (head + n) % PipeSize;
+    count -= n;
+    if (n > 0)
+	notFull->Broadcast(lock);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::Write
+// 	Copy "size" bytes into the pipe, as much at a time as there is
+//	room for, waiting for readers to make more.  A reader can take
+//	part of it before the rest has gone in.
+//
+// Returns:
+//	"size", or less if the last reader went away meanwhile; -1 if 
+//	there was no reader to begin with
+//----------------------------------------------------------------------
+
+int
+PipeBuffer::Write(char *from, int size)
+{
+    int done = 0, n, tail, first;
+
+    lock->Acquire();
+    if (readers == 0) {
+	lock->Release();
+	return -1;
+    }
+    while (done < size && readers > 0) {
+	while (count == PipeSize && readers > 0)
+	    notFull->Wait(lock);
+	tail = (head + count) % PipeSize;
+	n = min(size - done, PipeSize - count);
+	first = min(n, PipeSize - tail);
+	bcopy(&from[done], &buffer[tail], first);
+	bcopy(&from[done + first], buffer, n - first);
+	count += n;
+	done += n;
+	notEmpty->Broadcast(lock);
+    }
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// PipeBuffer::OpenEnd, PipeBuffer::CloseEnd
+// 	Count the ends of the pipe open in open file tables.  Closing the
+//	last writer wakes the readers, for end of file, and closing the
+//	last reader wakes the writers, so that they fail.
+//
+//	"writing" -- is it a write end?
+//----------------------------------------------------------------------
+
+void
+PipeBuffer::OpenEnd(bool writing)
+{
+    lock->Acquire();
+    if (writing)
+	writers++;
+    else
+	readers++;
+    lock->Release();
+}
+
+bool
+PipeBuffer::CloseEnd(bool writing)
+{
+    bool last;
+
+    lock->Acquire();
+    if (writing) {
+	ASSERT(writers > 0);
+	if (--writers == 0)
+	    notEmpty->Broadcast(lock);
+    } else {
+	ASSERT(readers > 0);
+	if (--readers == 0)
+	    notFull->Broadcast(lock);
+    }
+    last = (readers == 0 && writers == 0);
+    lock->Release();
+    return last;
+}
@@ -0,0 +1,55 @@
+// pipe.h
+//	Data structures for pipes: one-way byte streams between processes,
+//	made by the Pipe system call.  The bytes written to a pipe wait in
+//	its PipeBuffer, a ring of PipeSize bytes in the kernel, until they
+//	are read.
+//
+//	A writer waits while the buffer is full, and a reader while it is
+//	empty.  Once every write end is closed, a read of an empty pipe
+//	returns 0 (end of file); once every read end is closed, writing
+//	fails.  The pipe itself goes away with its last end.
+//
+//	Each end is counted once for every open file table slot holding
+//	it, so a pipe can be handed down to children (ExecPiped) and
+//	closed by each of them.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "synch.h"
+
+#define PipeSize	512		// bytes a pipe can hold
+
+class PipeBuffer {
+  public:
+    PipeBuffer();			// An empty pipe, with one end of 
+					// each kind open
+    ~PipeBuffer();
+
+    int Read(char *into, int size);	// Wait for bytes, and copy up to
+					// "size" of them; 0 at end of file
+    int Write(char *from, int size);	// Copy all of "from" in, waiting
+					// for room; returns how much went
+					// in, -1 if no one can read it
+    void OpenEnd(bool writing);		// Count another reader or writer
+    bool CloseEnd(bool writing);	// ... and drop one; TRUE if that
+					// was the last end of the pipe
+
+  private:
+    char buffer[PipeSize];		// the ring buffer
+    int head;				// where the next byte is read
+    int count;				// bytes in the buffer
+    int readers, writers;		// open ends of each kind
+
+    Lock *lock;				// Protects all of the above
+    Condition *notEmpty;		// Signalled when bytes are written,
+    Condition *notFull;			// when bytes are read, and when an
+					// end is closed
+};
+
+#endif // PIPE_H
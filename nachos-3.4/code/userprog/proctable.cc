@@ -0,0 +1,220 @@
+// proctable.cc
+//	Routines to keep track of the user processes by ID.  See
+//	proctable.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "proctable.h"
+
+//----------------------------------------------------------------------
+// ClearSlots
+// 	Mark "count" process table slots free.
+//----------------------------------------------------------------------
+
+static void
+ClearSlots(Process *slots, int count)
+{
+    for (int i = 0; i < count; i++) {
+	slots[i].id = 0;
+	slots[i].thread = NULL;
+	slots[i].exitStatus = 0;
+	slots[i].waiters = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::ProcessTable
+// 	Initialize an empty process table.  IDs start at 1.
+//----------------------------------------------------------------------
+
+ProcessTable::ProcessTable()
+{
+    size = InitialProcesses;
+    live = 0;
+    nextID = 1;
+    slots = new Process[size];
+    ClearSlots(slots, size);
+}
+
+ProcessTable::~ProcessTable()
+{
+    for (int i = 0; i < size; i++)
+	delete slots[i].waiters;
+    delete [] slots;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Add
+// 	Enter a new process in the table, giving it the next ID whose slot
+//	is free -- or failing that, the next ID whose slot only holds a
+//	zombie, which is forgotten.
+//
+//	"thread" -- the thread running the process; its ID is set
+//
+// Returns:
+//	the process's ID
+//----------------------------------------------------------------------
+
+int
+ProcessTable::Add(Thread *thread)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int id, tries;
+    Process *p;
+
+    if (live == size)
+	Grow();
+    for (id = nextID, tries = 0; tries < size; id++, tries++)
+	if (slots[id % size].id == 0)
+	    break;			// a free slot
+    if (tries == size)
+	for (id = nextID; slots[id % size].thread != NULL; id++)
+	    ;				// a zombie's slot
+    p = &slots[id % size];
+    p->id = id;
+    p->thread = thread;
+    p->exitStatus = 0;
+    live++;
+    nextID = id + 1;
+    thread->setID(id);
+    (void) interrupt->SetLevel(oldLevel);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Exit
+// 	Process "id" has exited.  Keep its exit status for later Joins, 
+//	and hand it to every thread already waiting in Join.  Does nothing
+//	if the process has already exited.
+//
+//	"id" -- the process
+//	"status" -- its exit status
+//----------------------------------------------------------------------
+
+void
+ProcessTable::Exit(int id, int status)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Process *p = Find(id);
+    Thread *waiter;
+
+    if (p != NULL && p->thread != NULL) {
+	stats->RecordProcess(id, p->thread->userTicks, p->thread->systemTicks);
+	p->thread = NULL;
+	p->exitStatus = status;
+	live--;
+	if (p->waiters != NULL)
+	    while ((waiter = (Thread *) p->waiters->Remove()) != NULL) {
+		waiter->joinStatus = status;
+		scheduler->WakeUpFromJoin(waiter);
+	    }
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Join
+// 	Wait for process "id" to exit, and return its exit status.  If it
+//	already has, return at once.
+//
+//	"id" -- the process to wait for
+//	"status" -- where to put its exit status
+//
+// Returns:
+//	FALSE if there is no such process, or it exited so long ago that it
+//	has been forgotten.
+//----------------------------------------------------------------------
+
+bool
+ProcessTable::Join(int id, int *status)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Process *p = Find(id);
+
+    if (p == NULL) {
+	(void) interrupt->SetLevel(oldLevel);
+	return FALSE;
+    }
+    if (p->thread == NULL)		// a zombie: no need to wait
+	*status = p->exitStatus;
+    else {
+	if (p->waiters == NULL)
+	    p->waiters = new List;
+	p->waiters->Append((void *) currentThread);
+	currentThread->Sleep();		// the slot may be reused once we
+	*status = currentThread->joinStatus;	// are woken up
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Lookup
+// 	Return the thread running process "id", or NULL if there is no
+//	such process (any more).
+//----------------------------------------------------------------------
+
+Thread *
+ProcessTable::Lookup(int id)
+{
+    Process *p = Find(id);
+
+    return (p == NULL) ? NULL : p->thread;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Find
+// 	Return the slot of process "id", live or zombie, or NULL.
+//----------------------------------------------------------------------
+
+Process *
+ProcessTable::Find(int id)
+{
+    Process *p;
+
+    if (id <= 0)
+	return NULL;
+    p = &slots[id % size];
+    if (p->id != id)
+	return NULL;		// free, or a later process
+    return p;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Apply
+// 	Call "func" on each live process's thread.  "func" must not add to
+//	the table.
+//----------------------------------------------------------------------
+
+void
+ProcessTable::Apply(VoidFunctionPtr func)
+{
+    for (int i = 0; i < size; i++)
+	if (slots[i].thread != NULL)
+	    (*func)((int) slots[i].thread);
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Grow
+// 	Double the table.  IDs that differ mod size also differ mod
+//	2 * size, so every process (and zombie) still has a slot to itself.
+//----------------------------------------------------------------------
+
+void
+ProcessTable::Grow()
+{
+    Process *old = slots;
+    int oldSize = size;
+
+    size *= 2;
+    slots = new Process[size];
+    ClearSlots(slots, size);
+    for (int i = 0; i < oldSize; i++)
+	if (old[i].id != 0)
+	    slots[old[i].id % size] = old[i];
+    delete [] old;
+}
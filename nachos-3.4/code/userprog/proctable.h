@@ -0,0 +1,70 @@
+// proctable.h
+//	Data structures to find user processes by their ID, and to wait
+//	for them to exit.
+//
+//	IDs are handed out in increasing order, and never reused.  A
+//	process with ID "id" lives in slot id % size of the table, so
+//	looking one up never searches.
+//
+//	When a process exits, its slot keeps its exit status (it becomes
+//	a "zombie"), so that a later Join still gets it without waiting.
+//	A zombie's slot is only given to a new process when there is no
+//	free one; the table doubles when every slot holds a live process.
+//
+//	The table is only changed with interrupts off, or by the running 
+//	thread between context switches.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROCTABLE_H
+#define PROCTABLE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "list.h"
+
+class Thread;
+
+#define InitialProcesses	16	// starting size of the table
+
+// One slot of the table.
+
+class Process {
+  public:
+    int id;				// 0 if the slot is free
+    Thread *thread;			// running it; NULL once it has exited
+    int exitStatus;			// (once it has exited)
+    List *waiters;			// threads in Join, waiting for it
+};
+
+class ProcessTable {
+  public:
+    ProcessTable();			// An empty table
+    ~ProcessTable();
+
+    int Add(Thread *thread);		// Give "thread" the next free ID,
+					// and return it
+    void Exit(int id, int status);	// The process has exited, with
+					// "status"; wake up its joiners
+    bool Join(int id, int *status);	// Wait for process "id" to exit;
+					// FALSE if there is no such process
+    Thread *Lookup(int id);		// The live process with "id", or 
+					// NULL
+    int NextID() { return nextID; }	// The ID the next Add will try
+
+    void Apply(VoidFunctionPtr func);	// Call "func" on every live
+					// process
+
+  private:
+    Process *Find(int id);		// The slot for "id", or NULL
+    void Grow();			// Double the number of slots
+
+    Process *slots;			// each process, by ID % size
+    int size;				// number of slots
+    int live;				// slots holding running processes
+    int nextID;				// first ID to try in Add
+};
+
+#endif // PROCTABLE_H
@@ -32,19 +32,12 @@ StartProcess(char *filename)
 		return;
     }
 	
-	printf("Memory allocation method chosen: ");
-	if(memChoice == 1)
-		printf("First-fit.\n");
-	else if (memChoice == 2)
-		printf("Best-fit.\n");
-	else
-		printf("Worst-fit.\n");
+	printf("Memory allocation method chosen: %s.\n", 
+		frameAllocator->PolicyName());
 	
-    space = new AddrSpace(executable);    
+    space = new AddrSpace(executable, filename);    
 	space->GenerateSWAP(executable, 0);
-    currentThread->space = space;
-
-    delete executable;			// close file
+    currentThread->space = space;	// "space" closes the file
 
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
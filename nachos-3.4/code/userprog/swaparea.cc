@@ -0,0 +1,230 @@
+// swaparea.cc
+//	Routines to manage the swap area.  See swaparea.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "swaparea.h"
+
+//----------------------------------------------------------------------
+// SwapMigrate
+// 	Work item to write cold pages from the compressed cache to disk.
+//----------------------------------------------------------------------
+
+static void
+SwapMigrate(int arg)
+{
+    swapArea->Migrate();
+}
+
+//----------------------------------------------------------------------
+// SwapArea::SwapArea
+// 	Initialize a swap area with every slot free.  Its old contents
+//	don't matter: nothing survives across runs of Nachos.
+//
+//	"cacheFrames" -- frames of memory to give the compressed cache;
+//		0 for none
+//----------------------------------------------------------------------
+
+SwapArea::SwapArea(int cacheFrames)
+{
+#ifdef FILESYS_STUB
+    numSlots = SwapSlots;
+    ASSERT(fileSystem->Create("SWAP", 0));
+    file = fileSystem->Open("SWAP");
+    ASSERT(file != NULL);
+#else
+    slotSectors = divRoundUp(PageSize, SectorSize);
+    numSlots = numDisks * (SwapSectors / slotSectors);
+    stripe = new StripeSet(synchDisks, numDisks, SwapStart, slotSectors);
+#endif
+    slots = new BitMap(numSlots);
+    cache = NULL;
+    if (cacheFrames > 0) {
+	ASSERT(frameAllocator->Allocate(cacheFrames) != -1);
+	cache = new SwapCache(cacheFrames, numSlots);
+    }
+}
+
+SwapArea::~SwapArea()
+{
+    delete cache;
+    delete slots;
+#ifdef FILESYS_STUB
+    delete file;
+    fileSystem->Remove("SWAP");
+#else
+    delete stripe;
+#endif
+}
+
+//----------------------------------------------------------------------
+// SwapArea::Reserve
+// 	Allocate a run of "count" consecutive slots, so that an address
+//	space's pages can be read back in order with few requests.
+//
+// Returns:
+//	the first slot of the run, or -1 if there is no such run free
+//----------------------------------------------------------------------
+
+int
+SwapArea::Reserve(int count)
+{
+    int first = slots->FindRun(0, count);
+
+    if (first != -1)
+	slots->MarkRun(first, count);
+    return first;
+}
+
+//----------------------------------------------------------------------
+// SwapArea::Allocate
+// 	Allocate any one free slot.  Returns -1 if every slot is in use.
+//----------------------------------------------------------------------
+
+int
+SwapArea::Allocate()
+{
+    return slots->Find();
+}
+
+//----------------------------------------------------------------------
+// SwapArea::Free
+// 	Give back a slot allocated by Reserve or Allocate.
+//----------------------------------------------------------------------
+
+void
+SwapArea::Free(int slot)
+{
+    ASSERT(slots->Test(slot));
+    if (cache != NULL && cache->Drop(slot))
+	return;				// cleared once it is written
+    slots->Clear(slot);
+}
+
+//----------------------------------------------------------------------
+// SwapArea::Write
+// 	Save one page in a slot.  Returns once it is in the compressed
+//	cache, or on the disk.  If the cache is getting full, have its
+//	coldest pages written out.
+//
+//	"slot" -- where to put it
+//	"from" -- the page's PageSize bytes
+//----------------------------------------------------------------------
+
+void
+SwapArea::Write(int slot, char *from)
+{
+    ASSERT(slot >= 0 && slot < numSlots);
+    if (cache == NULL || !cache->Put(slot, from))
+	DiskWrite(slot, from);
+    if (cache != NULL && cache->StartMigration())
+	workQueue->Queue(SwapMigrate, 0, WorkLow);
+}
+
+//----------------------------------------------------------------------
+// SwapArea::DiskWrite
+// 	Write one page to its slot on the disk.
+//----------------------------------------------------------------------
+
+void
+SwapArea::DiskWrite(int slot, char *from)
+{
+#ifdef FILESYS_STUB
+    file->WriteAt(from, PageSize, slot * PageSize);
+#else
+    if (PageSize == slotSectors * SectorSize)
+	stripe->Write(slot, from, 1);
+    else {				// pad it out to whole sectors
+	char *buf = new char[slotSectors * SectorSize];
+
+	bzero(buf, slotSectors * SectorSize);
+	bcopy(from, buf, PageSize);
+	stripe->Write(slot, buf, 1);
+	delete [] buf;
+    }
+#endif
+}
+
+//----------------------------------------------------------------------
+// SwapArea::Read
+// 	Read back the pages saved in a run of consecutive slots.  Those in
+//	the compressed cache are uncompressed; each run of the others is
+//	read with one request per disk.
+//
+//	"slot" -- the first slot
+//	"into" -- where to put the pages, one after the other
+//	"count" -- how many slots
+//----------------------------------------------------------------------
+
+void
+SwapArea::Read(int slot, char *into, int count)
+{
+    int i, end;
+
+    ASSERT(slot >= 0 && slot + count <= numSlots);
+    if (cache == NULL) {
+	DiskRead(slot, into, count);
+	return;
+    }
+    for (i = 0; i < count; i = end) {
+	end = i + 1;
+	if (cache->Get(slot + i, &into[i * PageSize]))
+	    continue;
+	while (end < count && !cache->Has(slot + end))
+	    end++;
+	DiskRead(slot + i, &into[i * PageSize], end - i);
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapArea::DiskRead
+// 	Read the pages in a run of consecutive slots from the disk.
+//----------------------------------------------------------------------
+
+void
+SwapArea::DiskRead(int slot, char *into, int count)
+{
+#ifdef FILESYS_STUB
+    file->ReadAt(into, count * PageSize, slot * PageSize);
+#else
+    if (PageSize == slotSectors * SectorSize)
+	stripe->Read(slot, into, count);
+    else {
+	char *buf = new char[count * slotSectors * SectorSize];
+
+	stripe->Read(slot, buf, count);
+	for (int i = 0; i < count; i++)
+	    bcopy(&buf[i * slotSectors * SectorSize], &into[i * PageSize],
+			PageSize);
+	delete [] buf;
+    }
+#endif
+}
+
+//----------------------------------------------------------------------
+// SwapArea::Migrate
+// 	Write the compressed cache's coldest pages to their slots on the
+//	disk, one at a time, until it is no more than 3/4 full.  A slot
+//	freed while its page was being written is freed now.
+//----------------------------------------------------------------------
+
+void
+SwapArea::Migrate()
+{
+    SwapCacheEntry *e;
+    char *page = new char[PageSize];
+    int slot;
+
+    while ((e = cache->Coldest()) != NULL) {
+	slot = e->slot;
+	cache->Expand(e, page);
+	DiskWrite(slot, page);
+	if (cache->Migrated())
+	    slots->Clear(slot);
+    }
+    delete [] page;
+}
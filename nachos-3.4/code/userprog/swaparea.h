@@ -0,0 +1,76 @@
+// swaparea.h
+//	Data structures for the backing store of user pages: one swap
+//	area shared by every address space, divided into page-sized
+//	slots.
+//
+//	With the real file system, the swap area is SwapSectors raw
+//	sectors at the end of the disk, which the free map keeps out of
+//	the file system; with FILESYS_STUB, it is one UNIX file, "SWAP".
+//	Either way a slot's place is computed from its number, so paging
+//	never touches a directory, a file header or the free map, and
+//	consecutive slots are read with a single request.  With "-nd",
+//	the slots are striped across the disks (see filesys/stripe.h):
+//	each disk has a swap area of its own, at the same place, and
+//	slot s is on disk s % numDisks, so a run of slots is read from
+//	all of them at once.
+//
+//	With "-zs", pages go through a compressed cache in memory first
+//	(see swapcache.h), and only reach the disk if they don't compress
+//	well, or later, in the background, once the cache fills up.
+//
+//	Slots are only allocated and freed without waiting, so the slot
+//	bitmap needs no lock of its own.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAPAREA_H
+#define SWAPAREA_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "bitmap.h"
+#include "filesys.h"
+#include "swapcache.h"
+#ifndef FILESYS_STUB
+#include "stripe.h"
+#endif
+
+#ifdef FILESYS_STUB
+#define SwapSlots	256		// pages the swap file can hold
+#endif
+
+class SwapArea {
+  public:
+    SwapArea(int cacheFrames = 0);	// Every slot free; cache pages
+					// in that many frames, if any
+    ~SwapArea();
+
+    int Reserve(int count);		// Allocate "count" consecutive
+					// slots; the first one, or -1
+    int Allocate();			// Allocate one slot; -1 if full
+    void Free(int slot);		// Give a slot back
+
+    void Write(int slot, char *from);	// Save one page in "slot"
+    void Read(int slot, char *into, int count);
+					// Read back "count" pages, from
+					// consecutive slots
+    void Migrate();			// Write cold cached pages to disk
+
+  private:
+    void DiskWrite(int slot, char *from);	// Write or read pages
+    void DiskRead(int slot, char *into, int count);	// on the disk
+
+    SwapCache *cache;			// compressed pages, or NULL
+    int numSlots;
+    BitMap *slots;			// which slots are in use
+#ifdef FILESYS_STUB
+    OpenFile *file;			// "SWAP"
+#else
+    int slotSectors;			// sectors per slot
+    StripeSet *stripe;			// where the slots are
+#endif
+};
+
+#endif // SWAPAREA_H
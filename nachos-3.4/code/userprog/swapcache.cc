@@ -0,0 +1,271 @@
+// swapcache.cc
+//	Routines to manage the compressed swap cache.  See swapcache.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "swapcache.h"
+
+#define MaxCompressed	(PageSize / 2)	// biggest page worth caching
+#define PageWords	(PageSize / (int) sizeof(int))
+
+//----------------------------------------------------------------------
+// SwapCache::SwapCache
+// 	Initialize an empty cache.
+//
+//	"frames" -- how much room it has, in frames (already taken out
+//		of the frame allocator)
+//	"slots" -- how many slots the swap area has
+//----------------------------------------------------------------------
+
+SwapCache::SwapCache(int frames, int slots)
+{
+    ASSERT(frames > 0 && PageSize % sizeof(int) == 0);
+    numSlots = slots;
+    capacity = frames * PageSize;
+    table = new SwapCacheEntry *[numSlots];
+    for (int i = 0; i < numSlots; i++)
+	table[i] = NULL;
+    lru = new IntrusiveList<SwapCacheEntry>;
+    // worst case: a header for every literal word
+    buffer = new char[2 * PageSize];
+    migrating = FALSE;
+    busySlot = -1;
+    busyEntry = NULL;
+    busyFreed = FALSE;
+
+    numStores = numRejects = numHits = numMigrations = bytesUsed = 0;
+    stats->Register("swapcache.stores", &numStores);
+    stats->Register("swapcache.rejects", &numRejects);
+    stats->Register("swapcache.hits", &numHits);
+    stats->Register("swapcache.migrations", &numMigrations);
+    stats->Register("swapcache.bytes", &bytesUsed);
+}
+
+SwapCache::~SwapCache()
+{
+    for (int i = 0; i < numSlots; i++)
+	Remove(i);
+    delete [] table;
+    delete lru;
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Put
+// 	Compress a page being swapped out, and keep it if it compressed
+//	well and there is room; either way, any older copy of the slot's
+//	page is forgotten.  A busy slot's page is always kept.
+//
+// Returns:
+//	TRUE if the page is kept, FALSE if it must be written to disk
+//----------------------------------------------------------------------
+
+bool
+SwapCache::Put(int slot, char *page)
+{
+    int size = Compress(page, buffer);
+    SwapCacheEntry *e;
+
+    ASSERT(slot >= 0 && slot < numSlots);
+    Remove(slot);
+    if (slot != busySlot &&
+	    (size > MaxCompressed || bytesUsed + size > capacity)) {
+	numRejects++;
+	return FALSE;
+    }
+    e = new SwapCacheEntry;
+    e->slot = slot;
+    e->size = size;
+    e->data = new char[size];
+    bcopy(buffer, e->data, size);
+    table[slot] = e;
+    lru->Append(e);
+    bytesUsed += size;
+    numStores++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Get
+// 	If the page for "slot" is cached, uncompress it into "into".  It
+//	stays cached (the page's swap copy must survive a clean eviction),
+//	and is now the most recently used.
+//----------------------------------------------------------------------
+
+bool
+SwapCache::Get(int slot, char *into)
+{
+    SwapCacheEntry *e = table[slot];
+
+    if (e == NULL)
+	return FALSE;
+    Expand(e, into);
+    if (e != busyEntry) {
+	lru->Detach(e);
+	lru->Append(e);
+    }
+    numHits++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Drop
+// 	"slot" has been freed: forget its page.
+//
+// Returns:
+//	TRUE if the slot is busy, in which case it mustn't be marked free
+//	until its write is done (Migrated returns TRUE)
+//----------------------------------------------------------------------
+
+bool
+SwapCache::Drop(int slot)
+{
+    Remove(slot);
+    if (slot != busySlot)
+	return FALSE;
+    busyFreed = TRUE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::StartMigration
+// 	Return TRUE if the cache is over 7/8 full and nothing is migrating
+//	pages to the disk -- and from now on something is; the caller
+//	must see to it.
+//----------------------------------------------------------------------
+
+bool
+SwapCache::StartMigration()
+{
+    if (migrating || bytesUsed <= capacity / 8 * 7)
+	return FALSE;
+    migrating = TRUE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Coldest
+// 	Pick the least recently used page to write to the disk, and make
+//	its slot busy -- unless the cache is down to 3/4 full, in which
+//	case migration stops.
+//
+// Returns:
+//	the page, which stays cached until Migrated; or NULL
+//----------------------------------------------------------------------
+
+SwapCacheEntry *
+SwapCache::Coldest()
+{
+    ASSERT(busySlot == -1);
+    if (bytesUsed <= capacity / 4 * 3 || lru->IsEmpty()) {
+	migrating = FALSE;
+	return NULL;
+    }
+    busyEntry = lru->Remove();
+    busySlot = busyEntry->slot;
+    return busyEntry;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Migrated
+// 	The page from Coldest is on the disk: drop it from the cache,
+//	unless a newer page for the slot has been stored meanwhile, and
+//	make the slot not busy.
+//
+// Returns:
+//	TRUE if the slot was freed while it was busy, and now may be
+//----------------------------------------------------------------------
+
+bool
+SwapCache::Migrated()
+{
+    bool freed = busyFreed;
+
+    ASSERT(busyEntry != NULL);
+    if (table[busySlot] == busyEntry) {
+	table[busySlot] = NULL;
+	bytesUsed -= busyEntry->size;
+    }
+    delete [] busyEntry->data;
+    delete busyEntry;
+    busyEntry = NULL;
+    busySlot = -1;
+    busyFreed = FALSE;
+    numMigrations++;
+    return freed;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Remove
+// 	Take the page for "slot" out of the cache, if it is there.  The
+//	page being migrated is left to Migrated, which is still using it.
+//----------------------------------------------------------------------
+
+void
+SwapCache::Remove(int slot)
+{
+    SwapCacheEntry *e = table[slot];
+
+    if (e == NULL)
+	return;
+    table[slot] = NULL;
+    bytesUsed -= e->size;
+    if (e == busyEntry)
+	return;
+    lru->Detach(e);
+    delete [] e->data;
+    delete e;
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Compress
+// 	Encode a page as runs of zero words and literal words (see 
+//	swapcache.h).
+//
+// Returns:
+//	the number of bytes written to "into"
+//----------------------------------------------------------------------
+
+int
+SwapCache::Compress(char *page, char *into)
+{
+    int *words = (int *) page, *out = (int *) into;
+    int i = 0, n = 0, zeros, literals;
+
+    while (i < PageWords) {
+	for (zeros = 0; i < PageWords && words[i] == 0; i++)
+	    zeros++;
+	for (literals = 0; i < PageWords && words[i] != 0; i++)
+	    out[n + 1 + literals++] = words[i];
+	out[n] = (zeros << 16) | literals;
+	n += 1 + literals;
+    }
+    return n * sizeof(int);
+}
+
+//----------------------------------------------------------------------
+// SwapCache::Expand
+// 	Uncompress a cached page into "into".
+//----------------------------------------------------------------------
+
+void
+SwapCache::Expand(SwapCacheEntry *e, char *into)
+{
+    int *in = (int *) e->data, *words = (int *) into;
+    int n = 0, i = 0, zeros, literals;
+
+    while (n < e->size / (int) sizeof(int)) {
+	zeros = (in[n] >> 16) & 0xffff;
+	literals = in[n] & 0xffff;
+	n++;
+	for (; zeros > 0; zeros--)
+	    words[i++] = 0;
+	for (; literals > 0; literals--)
+	    words[i++] = in[n++];
+    }
+    ASSERT(i == PageWords);
+}
@@ -0,0 +1,108 @@
+// swapcache.h
+//	Data structures for a compressed cache of swapped-out pages, kept
+//	in memory in front of the swap area.
+//
+//	Writing a page to swap costs a disk write, and reading it back a
+//	disk read, thousands of ticks each; but many pages -- zeroed
+//	stack, sparse arrays -- compress to almost nothing.  With "-zs",
+//	a page being swapped out is compressed, and if it shrinks to at
+//	most half its size, and there is room, it is kept here instead of
+//	being written; a page fault finds it here before going to the
+//	disk.  Pages that don't compress well go straight to disk.
+//
+//	The cache's room is taken out of physical memory: that share of
+//	the frames is allocated at boot, and never given to user pages.
+//	(The compressed data itself lives in host memory; the frames only
+//	account for it.)
+//
+//	Once it is more than 7/8 full, a work item takes the pages that
+//	have gone longest without being stored or read back, and writes
+//	them to the swap area, until it is down to 3/4.  A page stays in
+//	the cache until it is on the disk, so it can be read back
+//	meanwhile.  While a slot is being written, the slot is "busy": a
+//	new page for it is always cached (even if it compresses badly),
+//	and freeing it is put off until the write is done, so two writes
+//	to one slot are never queued for the disk at once.
+//
+//	The compression is a run-length code for zero words: each run is
+//	a header word, giving how many zero words are followed by how
+//	many literal ones, and then the literal words.
+//
+//	Like the slot bitmap, the cache is only changed without waiting,
+//	so it needs no lock of its own.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAPCACHE_H
+#define SWAPCACHE_H
+
+#include "copyright.h"
+#include "list.h"
+
+// One compressed page.
+
+class SwapCacheEntry {
+  public:
+    int slot;				// the swap slot the page belongs in
+    int size;				// bytes of compressed data
+    char *data;				// the compressed page
+
+    SwapCacheEntry *listNext, *listPrev;	// neighbours on the LRU list
+    int listKey;			// (unused)
+};
+
+// The following class defines the compressed cache.
+
+class SwapCache {
+  public:
+    SwapCache(int frames, int slots);
+					// Empty, with room for "frames"
+					// frames' worth of compressed pages
+    ~SwapCache();
+
+    bool Put(int slot, char *page);	// Keep a page for "slot"; FALSE if
+					// it must go to the disk instead
+    bool Get(int slot, char *into);	// Fetch a cached page; FALSE if
+					// it is on the disk
+    bool Has(int slot) { return table[slot] != NULL; }
+    bool Drop(int slot);		// Forget a freed slot's page; TRUE
+					// if the slot is busy, and mustn't
+					// be reused until Migrated
+
+    bool StartMigration();		// TRUE if over 7/8 full, and no
+					// migration was going; now one is
+    SwapCacheEntry *Coldest();		// The next page to migrate to the
+					// disk, or NULL if enough are done;
+					// its slot is busy until Migrated
+    void Expand(SwapCacheEntry *e, char *into);	// Uncompress one
+    bool Migrated();			// That page is on the disk now;
+					// TRUE if its slot was freed meanwhile
+
+    // Statistics, registered as "swapcache.*".
+    long long numStores;		// pages kept instead of written
+    long long numRejects;		// pages sent to the disk instead
+    long long numHits;			// pages read back from the cache
+    long long numMigrations;		// pages written to the disk later
+    long long bytesUsed;		// compressed bytes held
+
+  private:
+    int Compress(char *page, char *into);	// Returns the size
+    void Remove(int slot);		// Take a slot's page out of "table"
+
+    int numSlots;
+    int capacity;			// bytes of room
+    SwapCacheEntry **table;		// each slot's page, or NULL
+    IntrusiveList<SwapCacheEntry> *lru;	// cached pages, least recently
+					// stored or read first (not the
+					// one being migrated)
+    char *buffer;			// for compressing into
+
+    bool migrating;			// is a migration work item queued?
+    int busySlot;			// slot being written back, or -1
+    SwapCacheEntry *busyEntry;		// ... the page being written
+    bool busyFreed;			// ... freed while it was
+};
+
+#endif // SWAPCACHE_H
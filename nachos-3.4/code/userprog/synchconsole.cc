@@ -0,0 +1,210 @@
+// synchconsole.cc
+//	Routines to synchronously access the console.  The physical
+//	console is an asynchronous device (requests return immediately, and
+//	an interrupt happens later on).  This is a layer on top of
+//	the console providing a synchronous interface (requests wait until
+//	the request completes), with input collected a line at a time.
+//
+//	Use a semaphore to synchronize the interrupt handlers with the
+//	pending requests, and another one for mutual exclusion, so that
+//	only one thread at a time reads (or writes) the console.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "synchconsole.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ConsoleReadAvail, ConsoleWriteDone
+// 	Console interrupt handlers.  Need these to be C routines, because
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+ConsoleReadAvail(int arg)
+{
+    SynchConsole* console = (SynchConsole *)arg;
+
+    console->ReadAvail();
+}
+
+static void
+ConsoleWriteDone(int arg)
+{
+    SynchConsole* console = (SynchConsole *)arg;
+
+    console->WriteDone();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::SynchConsole
+// 	Initialize the synchronous interface to the console, in turn
+//	initializing the raw console.
+//
+//	"readFile" -- UNIX file simulating the keyboard (NULL -> use stdin)
+//	"writeFile" -- UNIX file simulating the display (NULL -> use stdout)
+//----------------------------------------------------------------------
+
+SynchConsole::SynchConsole(char *readFile, char *writeFile)
+{
+    inputHead = inputCount = linesReady = 0;
+    outputHead = outputCount = putCount = 0;
+    putBusy = FALSE;
+    lineAvail = new Semaphore("console line", 0);
+    readLock = new Semaphore("console read lock", 1);
+    spaceAvail = new Semaphore("console space", 0);
+    writeLock = new Semaphore("console write lock", 1);
+    console = new Console(readFile, writeFile, ConsoleReadAvail,
+			  ConsoleWriteDone, (int) this);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::~SynchConsole
+// 	De-allocate data structures needed for the synchronous console
+//	abstraction.
+//----------------------------------------------------------------------
+
+SynchConsole::~SynchConsole()
+{
+    delete console;
+    delete lineAvail;
+    delete readLock;
+    delete spaceAvail;
+    delete writeLock;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Read
+// 	Wait until a line has been typed (or the input buffer is full),
+//	and return its characters, up to the newline.  If the line is
+//	longer than "size", the rest is left for the next Read.
+//
+//	"into" -- the buffer to hold the characters
+//	"size" -- its size
+//
+// Returns:
+//	the number of characters read
+//----------------------------------------------------------------------
+
+int
+SynchConsole::Read(char *into, int size)
+{
+    IntStatus oldLevel;
+    int count = 0;
+
+    readLock->P();			// only one reader at a time
+    oldLevel = interrupt->SetLevel(IntOff);
+    while (linesReady == 0 && inputCount < ConsoleBufferSize)
+	lineAvail->P();			// wait for the rest of the line
+    while (count < size && inputCount > 0) {
+	char ch = input[inputHead];
+
+	inputHead = (inputHead + 1) % ConsoleBufferSize;
+	inputCount--;
+	into[count++] = ch;
+	if (ch == '\n') {
+	    linesReady--;
+	    break;
+	}
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    readLock->V();
+    return count;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Write
+// 	Queue characters to be written to the display.  We only wait if
+//	the output queue fills up; if the device is idle, we start it on
+//	what we queued before returning, and the interrupt handler 
+//	writes the rest.
+//
+//	"from" -- the characters to write
+//	"size" -- how many
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Write(char *from, int size)
+{
+    IntStatus oldLevel;
+
+    writeLock->P();			// only one writer at a time
+    oldLevel = interrupt->SetLevel(IntOff);
+    for (int i = 0; i < size; i++) {
+	while (outputCount == ConsoleBufferSize) {
+	    if (!putBusy)
+		StartOutput();
+	    spaceAvail->P();
+	}
+	output[(outputHead + outputCount) % ConsoleBufferSize] = from[i];
+	outputCount++;
+    }
+    if (!putBusy && outputCount > 0)	// device idle: start it
+	StartOutput();
+    (void) interrupt->SetLevel(oldLevel);
+    writeLock->V();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::ReadAvail
+// 	Console interrupt handler: a character has arrived, and maybe
+//	more behind it.  Add all of them to the input buffer (or drop the
+//	first, if the buffer is full), and wake up the reader for each
+//	line completed.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::ReadAvail()
+{
+    char chars[ConsoleBufferSize];
+    int n;
+
+    if (inputCount == ConsoleBufferSize) {
+	(void) console->GetChar();	// no room
+	return;
+    }
+    n = console->GetBlock(chars, ConsoleBufferSize - inputCount);
+    for (int i = 0; i < n; i++) {
+	input[(inputHead + inputCount) % ConsoleBufferSize] = chars[i];
+	inputCount++;
+	if (chars[i] == '\n')
+	    linesReady++;
+	if (chars[i] == '\n' || inputCount == ConsoleBufferSize)
+	    lineAvail->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::WriteDone
+// 	Console interrupt handler: the last block has been written.  Take
+//	it off the queue, and start on the rest, if there is any.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::WriteDone()
+{
+    outputHead = (outputHead + putCount) % ConsoleBufferSize;
+    outputCount -= putCount;
+    putBusy = FALSE;
+    spaceAvail->V();
+    if (outputCount > 0)
+	StartOutput();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::StartOutput
+// 	Start the idle device on the queued characters, as many as there
+//	are before the end of the circular buffer.  They stay queued 
+//	(the space isn't reused) until WriteDone.  Interrupts are off.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::StartOutput()
+{
+    putCount = min(outputCount, ConsoleBufferSize - outputHead);
+    putBusy = TRUE;
+    console->PutBlock(&output[outputHead], putCount);
+}
@@ -0,0 +1,68 @@
+// synchconsole.h
+// 	Data structures to export a synchronous interface to the raw
+//	console device, for user programs.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SYNCHCONSOLE_H
+#define SYNCHCONSOLE_H
+
+#include "console.h"
+#include "synch.h"
+
+#define ConsoleBufferSize	256	// characters queued each way
+
+// The following class defines a "synchronous" console abstraction,
+// built the same way as SynchDisk.  The raw console is asynchronous:
+// characters arrive, and finish being written, by interrupts.
+//
+// Input is line buffered: characters are collected as they arrive,
+// all that have been typed at each interrupt, and a reader waits until
+// a whole line has been typed.  Output is queued, and written with
+// the device's block transfers, as much of the queue at a time as is
+// contiguous; a writer only waits if the queue is full.  Either way,
+// only the calling thread waits -- the rest of the machine keeps
+// running.
+
+class SynchConsole {
+  public:
+    SynchConsole(char *readFile, char *writeFile);
+					// Initialize a synchronous console,
+					// by initializing the raw Console.
+					// NULL means stdin/stdout.
+    ~SynchConsole();			// De-allocate the synch console data
+
+    int Read(char *into, int size);	// Wait for a line of input, and
+					// return up to "size" characters
+					// of it (including the newline)
+    void Write(char *from, int size);	// Queue "size" characters for
+					// output
+
+    void ReadAvail();			// Called by the console device
+    void WriteDone();			// interrupt handlers
+
+  private:
+    void StartOutput();			// Write the front of the queue
+
+    Console *console;			// Raw console device
+
+    char input[ConsoleBufferSize];	// characters typed, not yet read
+    int inputHead, inputCount;		// (a circular buffer)
+    int linesReady;			// newlines in "input"
+    Semaphore *lineAvail;		// V'ed when a line is complete
+    Semaphore *readLock;		// one reader at a time
+
+    char output[ConsoleBufferSize];	// characters not yet written
+    int outputHead, outputCount;	// (a circular buffer)
+    bool putBusy;			// is the device writing some?
+    int putCount;			// ... how many, from outputHead
+    Semaphore *spaceAvail;		// V'ed when they have been written
+    Semaphore *writeLock;		// one writer at a time, so lines
+					// don't get mixed up
+};
+
+#endif // SYNCHCONSOLE_H
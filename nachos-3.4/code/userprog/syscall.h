@@ -29,6 +29,27 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_ExecTickets	11
+#define SC_Send		12
+#define SC_Receive	13
+#define SC_SendNB	14
+#define SC_ReceiveNB	15
+#define SC_Sbrk		16
+#define SC_Mmap		17
+#define SC_Munmap	18
+#define SC_ShmAttach	19
+#define SC_Wait		20
+#define SC_Wake		21
+#define SC_Pipe		22
+#define SC_ExecPiped	23
+#define SC_Sleep	24
+#define SC_ExecV	25
+#define SC_SpawnMany	26
+#define SC_AioRead	27
+#define SC_AioWrite	28
+#define SC_AioWait	29
+#define SC_AioPoll	30
+#define SC_RealTime	31
 
 #ifndef IN_ASM
 
@@ -58,6 +79,28 @@ typedef int SpaceId;
  * address space identifier
  */
 SpaceId Exec(char *name);
+
+/* Like Exec, but give the new program "tickets" shares of the CPU 
+ * (they only matter under stride scheduling).  Exec gives it as many 
+ * as the caller has.
+ */
+SpaceId ExecTickets(char *name, int tickets);
+
+/* Like Exec, but call the new program's main with "argv", a null-
+ * terminated array of strings, as its argv (and their number as argc).
+ * Exec passes none: argc is 0.  At most 16 strings of 256 bytes in all,
+ * which come out of the new program's stack.  Returns -1 if they are
+ * bad or too many.
+ */
+SpaceId ExecV(char *name, char **argv);
+
+/* Start "n" processes running the program in "name", opening it and 
+ * reading its header just once; they share its code pages.  Process i
+ * gets { name, "i" } as its argv.  Their ids go in ids[0..n-1], unless
+ * "ids" is 0.  Returns n, or -1 if "name" can't be opened or n is not
+ * between 1 and 64.
+ */
+int SpawnMany(char *name, int n, SpaceId *ids);
  
 /* Only return once the the user program "id" has finished.  
  * Return the exit status.
@@ -114,16 +157,181 @@ void Close(OpenFileId id);
  * threads to run within a user program. 
  */
 
-/* Fork a thread to run a procedure ("func") in the *same* address space 
- * as the current thread.
+/* Fork a new process to run a procedure ("func") in a copy of the
+ * current address space.  The copy is made lazily: pages are shared until
+ * one of the two processes writes them.  The child starts at "func" with
+ * a copy of the caller's stack, and should call Exit rather than return. 
+ * Returns the child's id to the parent.
  */
-void Fork(void (*func)());
+int Fork(void (*func)());
 
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 
  */
 void Yield();		
 
+/* Sleep for "ticks" ticks of simulated time, off the ready list, rather
+ * than calling Yield in a loop.  Returns 0.
+ */
+int Sleep(int ticks);
+
+/* Put this thread in the real-time class, scheduled earliest deadline
+ * first ahead of every other thread (cf. threads/scheduler.h).  Each
+ * time it wakes up from blocking -- from a Sleep until its next period,
+ * say -- it starts a job that must be done, by blocking again, within
+ * "deadline" ticks (0 means "period"), using no more than "cost" ticks
+ * of CPU; a job that runs longer loses its priority until the next.
+ * Jobs start "period" ticks apart, at least.  Returns 0, or -1 if the
+ * CPU time already promised leaves no room for another "cost" every
+ * "deadline" ticks.  A period of 0 leaves the class.
+ */
+int RealTime(int period, int deadline, int cost);
+
+
+/* Network operations: Send and Receive, on the post office's mailboxes
+ * (cf. network/post.h).  Only a kernel built in the network directory 
+ * has them; elsewhere they always fail.  Each Nachos is one machine, 
+ * named by its -m flag, with mailboxes 0 to 9.
+ *
+ * Messages may be lost (cf. the -l flag), but never corrupted, and each
+ * comes with the machine and mailbox to reply to.
+ */
+
+/* The most bytes one message can carry (MaxMailSize in network/post.h) */
+#define MaxMessageSize	40
+
+/* A mailbox on some machine. */
+typedef struct {
+    int machine;
+    int box;
+} MailAddress;
+
+/* Send "size" bytes from "buffer" to the mailbox "to"; replies should go
+ * to our mailbox "replyBox".  Returns 0 once the message is on its way 
+ * (not delivered), and -1 if the arguments are bad.  Waits only if too 
+ * many messages are already waiting to go out.
+ */
+int Send(MailAddress *to, int replyBox, char *buffer, int size);
+
+/* Wait for a message in our mailbox "box", and copy at most "size" bytes
+ * of it into "buffer", and where it came from into "from" (unless "from" 
+ * is 0).  Returns the number of bytes copied, or -1 if the arguments are
+ * bad.
+ */
+int Receive(int box, MailAddress *from, char *buffer, int size);
+
+/* Like Send and Receive, but never wait: return -1 instead. */
+int SendNB(MailAddress *to, int replyBox, char *buffer, int size);
+int ReceiveNB(int box, MailAddress *from, char *buffer, int size);
+
+
+/* Memory allocation.  The heap starts just above the stack (at the top 
+ * of the address space as loaded), and grows upwards; its new pages read
+ * as zeroes.
+ */
+
+/* Move the end of the heap "increment" bytes up.  Returns the old end, 
+ * where the new bytes start, or -1 if "increment" is negative or the
+ * heap would grow past the kernel's limit (MaxHeapSize in addrspace.h).
+ */
+void *Sbrk(int increment);
+
+/* Map the first "length" bytes of the Nachos file "name" into the 
+ * address space, above the heap, and return their address, or -1.  The
+ * file is read a page at a time as the pages are touched, and pages that
+ * were changed are written back to it when they leave memory, at Munmap,
+ * and at Exit.  Bytes past the end of the file read as zeroes.
+ */
+void *Mmap(char *name, int length);
+
+/* Write back and unmap the mapping Mmap put at "addr".  Returns 0, or -1
+ * if there is none.
+ */
+int Munmap(void *addr);
+
+
+/* Shared memory and synchronization between processes. */
+
+/* Map the shared memory segment "key" into the address space, and return
+ * its address, or -1.  If no process has it yet, it is made "size" bytes
+ * long, zeroed; otherwise "size" may be anything up to its size.  The
+ * segment stays in memory until the last process using it exits;
+ * children made by Fork share their parent's.
+ */
+void *ShmAttach(int key, int size);
+
+/* Not a system call (it is in start.s): if the word at "addr" holds 
+ * "expected", replace it with "replacement", atomically.  Returns what
+ * the word held, so the swap happened if that is "expected".
+ */
+int CompareAndSwap(int *addr, int expected, int replacement);
+
+/* Sleep until a Wake on "addr", a word in a shared memory segment, but
+ * only if it still holds "value" (so a Wake can't be missed between 
+ * looking at the word and calling Wait).  Returns 0 once woken, or -1
+ * at once if the word doesn't hold "value" or isn't in a segment.
+ */
+int Wait(int *addr, int value);
+
+/* Wake up to "count" processes waiting on "addr".  Returns how many 
+ * were woken.
+ */
+int Wake(int *addr, int count);
+
+
+/* Pipes: one-way streams of bytes between processes, read and written
+ * with Read and Write like files.  A pipe holds a few hundred bytes;
+ * writing to a full one waits for a reader, and reading an empty one 
+ * waits for a writer.  Once every write end is closed, Read returns 0;
+ * once every read end is closed, Write returns -1.
+ */
+
+/* Make a pipe, and put the OpenFileId of its read end in ends[0] and of
+ * its write end in ends[1].  Returns 0, or -1 if there is no room for
+ * them in the open file table.
+ */
+int Pipe(OpenFileId *ends);
+
+/* Like Exec, but the new program reads "input" as its ConsoleInput and
+ * writes "output" as its ConsoleOutput.  Each is either our own console
+ * id, or a pipe end open the right way round (a read end for "input").
+ * Exec'd and Fork'ed children always share their parent's console, 
+ * pipes included.  Returns -1 if the ids are bad.
+ */
+SpaceId ExecPiped(char *name, OpenFileId input, OpenFileId output);
+
+/* Asynchronous I/O.  AioRead and AioWrite start reading or writing 
+ * "size" bytes of a Nachos file (not the console or a pipe), at byte 
+ * "position", and return at once with a request id, or -1.  At most 
+ * 4096 bytes a request, and 8 requests until they are waited for.  
+ *
+ * AioWait waits for a request to finish, returns how many bytes it 
+ * transferred (or -1), and forgets it; only then is a read's data in
+ * "buffer".  A write's data is taken when it starts, so its buffer may
+ * be reused at once.  AioPoll returns 1 if the request has finished
+ * (AioWait won't wait), 0 if not, -1 if there is no such request.
+ * Closing a file waits for its requests to finish.
+ */
+typedef struct {
+    OpenFileId file;
+    int position;
+    char *buffer;
+    int size;
+} AioBlock;
+
+int AioRead(AioBlock *block);
+int AioWrite(AioBlock *block);
+int AioWait(int request);
+int AioPoll(int request);
+
+/* Not system calls, but part of the runtime in start.s: a simple 
+ * allocator on top of Sbrk.  "malloc" returns 8-byte aligned memory, or
+ * 0 if the heap can't grow; "free" does nothing (memory is only given 
+ * back when the process exits).
+ */
+void *malloc(unsigned int size);
+void free(void *ptr);
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */
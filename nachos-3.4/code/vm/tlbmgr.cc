@@ -0,0 +1,320 @@
+// tlbmgr.cc 
+//	Routines to manage the software-loaded TLB: refill it from the
+//	current address space's page table on a TLB miss, and keep the
+//	page table's use and dirty bits up to date.
+//
+//	Replacement policies:
+//	    FIFO  -- replace entries in the order they were loaded
+//	    LRU   -- replace the entry referenced longest ago (the 
+//		     simulated hardware stamps each TLB entry when used)
+//	    clock -- second chance, using the TLB entry's use bit
+//
+//	Address space IDs are handed out in order, and all recycled at
+//	once, with a flush, when they run out (see tlbmgr.h).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "tlbmgr.h"
+
+//----------------------------------------------------------------------
+// TLBManager::TLBManager
+// 	Initialize the TLB manager.  The TLB itself belongs to the machine
+//	(see machine->tlb and machine->tlbSize), and starts out empty.
+//
+//	"replacement" -- which entry to evict when the TLB is full
+//	"superpages" -- how many pages one entry may map (1: no superpages)
+//----------------------------------------------------------------------
+
+TLBManager::TLBManager(TLBPolicy replacement, int superpages)
+{
+    policy = replacement;
+    hand = 0;
+    maxPages = superpages;
+    source = new TranslationEntry *[machine->tlbSize];
+    for (int i = 0; i < machine->tlbSize; i++)
+	source[i] = NULL;
+    nextASID = 0;
+    generation = 0;
+    numRollovers = numKept = numStale = 0;
+    stats->Register("tlb.asidRollovers", &numRollovers);
+    stats->Register("tlb.entriesKept", &numKept);
+    stats->Register("tlb.entriesStale", &numStale);
+}
+
+//----------------------------------------------------------------------
+// TLBManager::~TLBManager
+// 	De-allocate the TLB manager.
+//----------------------------------------------------------------------
+
+TLBManager::~TLBManager()
+{
+    delete [] source;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::WriteBack
+// 	Take an entry out of the TLB.  The hardware may have set the use
+//	or dirty bit in the TLB copy, so merge them into the page table
+//	entry it came from; otherwise page replacement would never see
+//	that the page was ever referenced or modified.
+//
+//	"slot" -- the TLB entry to remove
+//----------------------------------------------------------------------
+
+void
+TLBManager::WriteBack(int slot)
+{
+    TLBEntry *entry = &machine->tlb[slot];
+
+    if (entry->valid && (source[slot] != NULL))
+	for (int i = 0; i < entry->numPages; i++) {
+	    if (entry->use)
+		source[slot][i].use = TRUE;
+	    if (entry->dirty)
+		source[slot][i].dirty = TRUE;
+	}
+    entry->valid = FALSE;
+    source[slot] = NULL;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::ChooseVictim
+// 	Pick the TLB entry to be replaced.  An invalid entry is always
+//	used first; otherwise, apply the replacement policy.
+//----------------------------------------------------------------------
+
+int
+TLBManager::ChooseVictim()
+{
+    TLBEntry *tlb = machine->tlb;
+    int size = machine->tlbSize;
+    int i, victim;
+
+    for (i = 0; i < size; i++)
+	if (!tlb[i].valid)
+	    return i;
+
+    switch (policy) {
+      case TLBLru:
+	victim = 0;
+	for (i = 1; i < size; i++)
+	    if (machine->tlbLastUse[i] < machine->tlbLastUse[victim])
+		victim = i;
+	return victim;
+
+      case TLBClock:
+	for (;;) {			// terminates: we clear as we go
+	    victim = hand;
+	    hand = (hand + 1) % size;
+	    if (!tlb[victim].use)
+		return victim;
+	    tlb[victim].use = FALSE;	// second chance; but remember
+	    for (i = 0; i < tlb[victim].numPages; i++)
+		source[victim][i].use = TRUE;	// it was used, for paging
+	}
+
+      case TLBFifo:
+      default:
+	victim = hand;
+	hand = (hand + 1) % size;
+	return victim;
+    }
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Load
+// 	Copy a page table entry into the TLB, on a TLB miss.  A superpage
+//	is loaded from its first page's entry; the caller has checked
+//	that its pages are in consecutive frames, with the same
+//	protection.
+//
+//	"pte" -- the current address space's (valid) entry for the page
+//	"vpn" -- the virtual page it is for (page table entries don't say)
+//	"pages" -- how many pages, and page table entries, from "pte" on
+//		the TLB entry is to map
+//----------------------------------------------------------------------
+
+void
+TLBManager::Load(TranslationEntry *pte, int vpn, int pages)
+{
+    int slot;
+
+    ASSERT(pte->valid && pages <= maxPages);
+    ASSERT(vpn % pages == 0 && pte->physicalPage % pages == 0);
+    Invalidate(vpn, pages);			// never have two copies
+    slot = ChooseVictim();
+    WriteBack(slot);
+
+    DEBUG('a', "TLB: loading vpn %d (frame %d, %d pages) into entry %d\n", 
+		vpn, pte->physicalPage, pages, slot);
+    if (pages > 1)
+	stats->numSuperpageLoads++;
+    *(TranslationEntry *) &machine->tlb[slot] = *pte;
+    machine->tlb[slot].virtualPage = vpn;
+    machine->tlb[slot].numPages = pages;
+    machine->tlb[slot].use = FALSE;
+    machine->tlb[slot].dirty = FALSE;
+    machine->tlb[slot].asid = machine->tlbASID;
+    machine->tlbLastUse[slot] = ++machine->tlbUseCount;
+    source[slot] = pte;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Invalidate
+// 	Remove pages of the current address space from the TLB, for 
+//	instance because a frame is being taken away.  A superpage mapping
+//	any of them goes entirely.  Use and dirty bits are copied back 
+//	first.  (Other address spaces' entries are checked when they are
+//	switched back to.)
+//
+//	"vpn" -- the first virtual page to remove
+//	"count" -- how many pages
+//----------------------------------------------------------------------
+
+void
+TLBManager::Invalidate(int vpn, int count)
+{
+    TLBEntry *entry;
+
+    for (int i = 0; i < machine->tlbSize; i++) {
+	entry = &machine->tlb[i];
+	if (entry->valid && entry->asid == machine->tlbASID
+			&& entry->virtualPage < vpn + count
+			&& vpn < entry->virtualPage + entry->numPages)
+	    WriteBack(i);
+    }
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Flush
+// 	Empty the TLB, copying back use and dirty bits: when the address
+//	space IDs run out.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Flush()
+{
+    for (int i = 0; i < machine->tlbSize; i++)
+	WriteBack(i);
+    machine->FlushXlateCache();
+}
+
+//----------------------------------------------------------------------
+// TLBManager::FlushSpace
+// 	Remove one address space's entries, copying back use and dirty
+//	bits: before its page table is freed or moved, or when its TLB
+//	entries could be out of date.  Nothing, if its ID is from an
+//	earlier generation (it has no entries).
+//
+//	"asid", "spaceGeneration" -- the address space's ID, as Activate
+//		left them
+//----------------------------------------------------------------------
+
+void
+TLBManager::FlushSpace(int asid, int spaceGeneration)
+{
+    if (spaceGeneration != generation)
+	return;
+    for (int i = 0; i < machine->tlbSize; i++)
+	if (machine->tlb[i].asid == asid)
+	    WriteBack(i);
+    machine->FlushXlateCache();
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Activate
+// 	Switch the TLB to an address space, on a context switch.  If its
+//	ID is from an earlier generation (or it never had one), give it
+//	the next one, flushing the TLB first if there are none left.
+//	Then drop whatever entries it left behind that are stale.
+//
+//	"asid", "spaceGeneration" -- the address space's ID, and the 
+//		generation it is from; -1 if it has none
+//----------------------------------------------------------------------
+
+void
+TLBManager::Activate(int *asid, int *spaceGeneration)
+{
+    if (*spaceGeneration != generation) {
+	if (nextASID == NumASIDs) {
+	    DEBUG('a', "TLB: address space IDs ran out, flushing\n");
+	    Flush();
+	    generation++;
+	    nextASID = 0;
+	    numRollovers++;
+	}
+	*asid = nextASID++;
+	*spaceGeneration = generation;
+    }
+    machine->tlbASID = *asid;
+    Revalidate(*asid);
+    machine->FlushXlateCache();
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Deactivate
+// 	Switch away from the current address space.  Its entries stay,
+//	but copy their use and dirty bits back to the page table now, and
+//	clear them, so that the pager sees how its pages were used while
+//	it isn't running.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Deactivate()
+{
+    TLBEntry *entry;
+
+    for (int i = 0; i < machine->tlbSize; i++) {
+	entry = &machine->tlb[i];
+	if (!entry->valid || entry->asid != machine->tlbASID 
+			|| source[i] == NULL)
+	    continue;
+	for (int j = 0; j < entry->numPages; j++) {
+	    if (entry->use)
+		source[i][j].use = TRUE;
+	    if (entry->dirty)
+		source[i][j].dirty = TRUE;
+	}
+	entry->use = entry->dirty = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Revalidate
+// 	Check an address space's entries, on switching back to it: while 
+//	it wasn't running, its pages may have been evicted, moved or made
+//	read-only.  Any entry not matching its page table entries exactly
+//	is dropped.  Its use and dirty bits were written back by 
+//	Deactivate, and nothing can have used it since.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Revalidate(int asid)
+{
+    TLBEntry *entry;
+    TranslationEntry *pte;
+    bool good;
+
+    for (int i = 0; i < machine->tlbSize; i++) {
+	entry = &machine->tlb[i];
+	if (!entry->valid || entry->asid != asid)
+	    continue;
+	good = (source[i] != NULL);
+	for (int j = 0; good && j < entry->numPages; j++) {
+	    pte = &source[i][j];
+	    good = pte->valid && pte->physicalPage == entry->physicalPage + j
+			&& pte->readOnly == entry->readOnly;
+	}
+	if (good)
+	    numKept++;
+	else {
+	    entry->valid = FALSE;
+	    source[i] = NULL;
+	    numStale++;
+	}
+    }
+}
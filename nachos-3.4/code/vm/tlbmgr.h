@@ -0,0 +1,102 @@
+// tlbmgr.h 
+//	Data structures for managing the software-loaded TLB.
+//
+//	When Nachos is built with USE_TLB, the simulated hardware only
+//	looks in machine->tlb; a miss raises a PageFaultException even if
+//	the page is sitting in memory.  The exception handler asks the
+//	TLB manager to copy the page table entry into the TLB, choosing
+//	which TLB entry to replace with one of a few policies.
+//
+//	The hardware sets the use and dirty bits in the TLB entry, not in
+//	the page table, so the manager copies them back whenever an
+//	entry leaves the TLB.
+//
+//	With "-sup n", one TLB entry may map an aligned group of up to n
+//	pages held in aligned consecutive frames (a superpage), which the
+//	address space works out from its page table (see 
+//	AddrSpace::LoadTLB).  Its use and dirty bits are copied back to
+//	every page of the group.
+//
+//	Entries are tagged with an address space ID, handed out by the
+//	manager, so a context switch needn't empty the TLB: switching away
+//	just writes the use and dirty bits back (the pager must see them,
+//	for any process), and switching back drops the entries whose page
+//	table entries changed meanwhile -- an evicted page, say.  There
+//	are NumASIDs IDs; when they run out, the TLB is flushed and every
+//	address space gets a new one as it next runs (a "generation"
+//	tells which IDs are current).  An ID's entries are flushed when 
+//	its page table is freed or moved.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TLBMGR_H
+#define TLBMGR_H
+
+#include "copyright.h"
+#include "translate.h"
+
+// TLB replacement policies, selected with "-tp" on the command line.
+enum TLBPolicy { TLBFifo, TLBLru, TLBClock };
+
+#define NumASIDs	64		// address space IDs the TLB can 
+					// tell apart, as on the R3000
+
+// The following class decides what goes into the hardware TLB.
+
+class TLBManager {
+  public:
+    TLBManager(TLBPolicy replacement, int superpages);
+					// Manage machine->tlb, with entries
+					// of up to "superpages" pages
+    ~TLBManager();
+
+    void Load(TranslationEntry *pte, int vpn, int pages = 1);
+					// Put a (valid) page table entry,
+					// for page "vpn", into the TLB,
+					// replacing another entry if
+					// necessary; with "pages",
+					// as the superpage of the "pages"
+					// entries from "pte" on
+    void Invalidate(int vpn, int count = 1);
+					// Remove the entries mapping any of
+					// the "count" virtual pages from
+					// "vpn", if they are in the TLB
+    void Flush();			// Remove every entry
+    void FlushSpace(int asid, int spaceGeneration);
+					// Remove an address space's entries
+    void Activate(int *asid, int *spaceGeneration);
+					// Switch to an address space: give it
+					// an ID of the current generation if
+					// it has none, and drop its stale
+					// entries
+    void Deactivate();			// Switch away from the current one,
+					// keeping its entries
+    int MaxPages() { return maxPages; }	// Largest superpage allowed
+
+    // Statistics, registered as "tlb.*".
+    long long numRollovers;		// times the IDs ran out
+    long long numKept;			// entries still good on a switch back
+    long long numStale;			// ... dropped as stale instead
+
+  private:
+    int ChooseVictim();			// Pick the TLB entry to replace
+    void WriteBack(int slot);		// Copy an entry's use/dirty bits
+					// back to its page table entry,
+					// and mark the TLB entry invalid
+
+    void Revalidate(int asid);		// Drop an ID's entries that no 
+					// longer match the page table
+
+    TLBPolicy policy;			// FIFO, LRU or clock
+    int hand;				// next FIFO victim, or clock hand
+    int maxPages;			// largest superpage, in pages
+    TranslationEntry **source;		// page table entry each TLB entry
+					// was loaded from (the first of
+					// them, for a superpage)
+    int nextASID;			// next ID to hand out
+    int generation;			// bumped each time they run out
+};
+
+#endif // TLBMGR_H